@@ -0,0 +1,343 @@
+/*
+Classe BillboardImpostor
+- Al caricamento renderizza un modello da una griglia di direzioni di vista (azimut ed elevazione) in due atlas: colore
+  diffusivo e normale in coordinate del modello, con una proiezione ortografica sulla sfera di contenimento del modello
+- Le istanze oltre la distanza di passaggio vengono renderizzate come un quad di 4 vertici rivolto verso la camera: lo shader
+  sceglie le quattro viste piu' vicine alla direzione di vista, in coordinate del modello, e le fonde con pesi bilineari,
+  in modo che il passaggio da una vista all'altra sia graduale
+- Dalla normale salvata nell'atlas lo shader ricalcola l'illuminazione Cook-Torrance, per cui il billboard resta coerente
+  con le luci e con l'orientamento dell'istanza, anche quando il modello e' rovesciato
+- La distanza di passaggio si puo' modificare durante l'esecuzione; vengono contate le istanze renderizzate con la mesh
+  e quelle renderizzate come billboard
+*/
+
+#ifndef BILLBOARD_H
+#define BILLBOARD_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <utils/shader.h>
+#include <utils/glstate.h>
+#include <utils/mesh.h>
+#include <utils/model.h>
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+// Numero di viste in azimut ed in elevazione: devono essere gli stessi di shaderBillboardCT.vert
+#define BILLBOARD_AZIMUTHS 8
+#define BILLBOARD_ELEVATIONS 5
+// Lato in pixel di una vista nell'atlas
+#define BILLBOARD_CELL_SIZE 128
+// Distanza iniziale dalla camera oltre la quale le istanze diventano billboard, in unita' del mondo
+#define BILLBOARD_DEFAULT_DISTANCE 30.0f
+
+/*
+ * Struttura che raccoglie i contatori delle istanze renderizzate con la mesh e come billboard
+ */
+struct BillboardStats {
+	size_t meshes;
+	size_t billboards;
+};
+
+/********** classe BILLBOARDIMPOSTOR **********/
+class BillboardImpostor {
+public:
+	// Costruttore della classe, l'atlas viene creato con Bake quando il contesto OpenGL e' attivo
+	BillboardImpostor() : distance(BILLBOARD_DEFAULT_DISTANCE), albedoAtlas(0), normalAtlas(0), quad(NULL), instanceVBO(0), instanceCapacity(0), frames(0) {
+		this->sphere = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		this->totals.meshes = 0;
+		this->totals.billboards = 0;
+	}
+
+	/*
+	 * Metodo che renderizza il modello da tutte le direzioni della griglia nei due atlas, e crea il quad dei billboard.
+	 * Restituisce false se il framebuffer non puo' essere creato: in quel caso il modello va renderizzato sempre con la mesh.
+	 * Prende in input i seguenti valori:
+	 * - model: Model, modello da renderizzare
+	 * - bakeShader: Shader, shader che scrive colore diffusivo e normale del modello nei due color attachment
+	 */
+	bool Bake(Model &model, Shader &bakeShader) {
+		this->sphere = glm::vec4(model.bounds.center, model.bounds.radius);
+
+		GLsizei width = BILLBOARD_AZIMUTHS * BILLBOARD_CELL_SIZE;
+		GLsizei height = BILLBOARD_ELEVATIONS * BILLBOARD_CELL_SIZE;
+
+		this->albedoAtlas = this->createAtlas(width, height);
+		this->normalAtlas = this->createAtlas(width, height);
+
+		GLuint framebuffer, depthbuffer;
+		glGenFramebuffers(1, &framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->albedoAtlas, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, this->normalAtlas, 0);
+
+		glGenRenderbuffers(1, &depthbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthbuffer);
+
+		GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, attachments);
+
+		bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		if (!complete) {
+			cout << "ERROR::BILLBOARD::FRAMEBUFFER_NOT_COMPLETE" << endl;
+		} else {
+			GLint viewport[4];
+			glGetIntegerv(GL_VIEWPORT, viewport);
+
+			// Lo sfondo ha alpha nulla: lo shader dei billboard scarta i pixel non coperti dal modello
+			glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			model.BindMaterials(bakeShader);
+			Uniform<glm::mat4> bakeMatrix = bakeShader.getUniform<glm::mat4>("bakeMatrix");
+
+			glm::vec3 center = model.bounds.center;
+			GLfloat radius = model.bounds.radius;
+			glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+
+			// Ogni vista occupa una cella dell'atlas: le celle non si sovrappongono, per cui basta pulire il depth buffer una volta
+			for (int e = 0; e < BILLBOARD_ELEVATIONS; e++) {
+				for (int a = 0; a < BILLBOARD_AZIMUTHS; a++) {
+					glm::mat4 view = glm::lookAt(center + this->direction(a, e) * 2.0f * radius, center, glm::vec3(0.0f, 1.0f, 0.0f));
+
+					glViewport(a * BILLBOARD_CELL_SIZE, e * BILLBOARD_CELL_SIZE, BILLBOARD_CELL_SIZE, BILLBOARD_CELL_SIZE);
+					bakeShader.set(bakeMatrix, projection * view);
+
+					for (size_t i = 0; i < model.meshes.size(); i++)
+						model.meshes[i].Draw();
+				}
+			}
+
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteRenderbuffers(1, &depthbuffer);
+		glDeleteFramebuffers(1, &framebuffer);
+
+		if (!complete) {
+			gl_state().DeleteTextures(1, &this->albedoAtlas);
+			gl_state().DeleteTextures(1, &this->normalAtlas);
+			this->albedoAtlas = this->normalAtlas = 0;
+			return false;
+		}
+
+		// Le mipmap evitano l'aliasing dei billboard lontani; lo shader divide per l'alpha il bordo sfumato con lo sfondo
+		GLuint atlases[2] = { this->albedoAtlas, this->normalAtlas };
+		for (int i = 0; i < 2; i++) {
+			gl_state().BindTexture(GL_TEXTURE_2D, atlases[i]);
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+
+		this->createQuad(model.bounds);
+
+		cout << "Billboard: " << BILLBOARD_AZIMUTHS * BILLBOARD_ELEVATIONS << " viste renderizzate in un atlas di " << width << "x" << height << " pixel" << endl;
+
+		return true;
+	}
+
+	/*
+	 * Metodo che indica se i billboard sono disponibili, cioe' se Bake e' andato a buon fine
+	 */
+	bool isReady() const {
+		return this->quad != NULL;
+	}
+
+	/*
+	 * Metodo che risolve i sampler degli atlas nello shader dei billboard e vi assegna le texture unit
+	 */
+	void BindMaterial(Shader &shader) {
+		if (this->quad != NULL)
+			this->quad->bindMaterial(shader);
+	}
+
+	/*
+	 * Metodo che indica se un'istanza e' oltre la distanza di passaggio, e va quindi renderizzata come billboard.
+	 * Prende in input i seguenti valori:
+	 * - modelMatrix: mat4, trasformazione dell'istanza
+	 * - cameraPosition: vec3, posizione della camera in coordinate mondo
+	 */
+	bool isDistant(const glm::mat4 &modelMatrix, const glm::vec3 &cameraPosition) const {
+		glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(glm::vec3(this->sphere), 1.0f));
+
+		return glm::length(center - cameraPosition) > this->distance;
+	}
+
+	/*
+	 * Metodo che carica le matrici ed i colori delle istanze nell'instance buffer collegato al quad, come Model::UploadInstances.
+	 * Prende in input i seguenti valori:
+	 * - instances: vector<InstanceData>, matrici e colore di ogni istanza
+	 */
+	void UploadInstances(const vector<InstanceData> &instances) {
+		if (instances.empty())
+			return;
+
+		if (this->instanceVBO == 0) {
+			glGenBuffers(1, &this->instanceVBO);
+			this->quad->setupInstances(this->instanceVBO);
+		}
+
+		gl_state().BindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+
+		if (instances.size() > this->instanceCapacity) {
+			this->instanceCapacity = instances.size();
+			glBufferData(GL_ARRAY_BUFFER, this->instanceCapacity * sizeof(InstanceData), &instances[0], GL_DYNAMIC_DRAW);
+		} else {
+			glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), &instances[0]);
+		}
+	}
+
+	/*
+	 * Metodo get per il quad, da inviare alla coda di rendering con le istanze caricate
+	 */
+	const Mesh& getMesh() const {
+		return *this->quad;
+	}
+
+	/*
+	 * Metodo get per la sfera di contenimento del modello: centro in xyz e raggio in w, da passare allo shader
+	 */
+	const glm::vec4& getSphere() const {
+		return this->sphere;
+	}
+
+	/*
+	 * Metodo che conta le istanze di un frame renderizzate con la mesh e come billboard
+	 */
+	void CountFrame(size_t meshes, size_t billboards) {
+		this->totals.meshes += meshes;
+		this->totals.billboards += billboards;
+		this->frames++;
+	}
+
+	/*
+	 * Metodi get e set per la distanza di passaggio, in unita' del mondo: ogni modifica viene stampata
+	 */
+	GLfloat getDistance() const {
+		return this->distance;
+	}
+
+	void setDistance(GLfloat distance) {
+		this->distance = distance > 0.0f ? distance : 0.0f;
+		cout << "Billboard: distanza di passaggio impostata a " << this->distance << endl;
+	}
+
+	/*
+	 * Metodo get per i contatori sommati su tutti i frame, e per il numero di frame
+	 */
+	const BillboardStats& getTotals() const {
+		return this->totals;
+	}
+
+	size_t getFrames() const {
+		return this->frames;
+	}
+
+	/*
+	 * Metodo che dealloca atlas, quad e instance buffer
+	 */
+	void Delete() {
+		if (this->quad != NULL) {
+			this->quad->Delete();
+			delete this->quad;
+			this->quad = NULL;
+		}
+
+		if (this->albedoAtlas != 0)
+			gl_state().DeleteTextures(1, &this->albedoAtlas);
+		if (this->normalAtlas != 0)
+			gl_state().DeleteTextures(1, &this->normalAtlas);
+		this->albedoAtlas = this->normalAtlas = 0;
+
+		if (this->instanceVBO != 0)
+			gl_state().DeleteBuffers(1, &this->instanceVBO);
+		this->instanceVBO = 0;
+		this->instanceCapacity = 0;
+	}
+
+private:
+	// Attributo che contiene la distanza di passaggio dalla mesh al billboard
+	GLfloat distance;
+	// Attributo che contiene la sfera di contenimento del modello, in coordinate del modello
+	glm::vec4 sphere;
+	// Attributi che contengono gli atlas del colore diffusivo e delle normali
+	GLuint albedoAtlas, normalAtlas;
+	// Attributo che contiene il quad renderizzato per ogni istanza, con gli atlas come texture del materiale
+	Mesh *quad;
+	// Attributi che rappresentano l'instance buffer e il numero di istanze che puo' contenere
+	GLuint instanceVBO;
+	size_t instanceCapacity;
+	// Attributi che contengono i contatori
+	BillboardStats totals;
+	size_t frames;
+
+	/*
+	 * Metodo che restituisce la direzione, dal centro del modello verso la camera, della vista di una cella della griglia.
+	 * Gli azimut partono da 0 con passo costante; le elevazioni sono centrate nelle fasce, per cui non raggiungono i poli.
+	 */
+	glm::vec3 direction(int azimuth, int elevation) const {
+		const GLfloat pi = 3.14159265f;
+		GLfloat phi = 2.0f * pi * azimuth / BILLBOARD_AZIMUTHS;
+		GLfloat theta = pi * ((elevation + 0.5f) / BILLBOARD_ELEVATIONS - 0.5f);
+
+		return glm::vec3(cos(theta) * cos(phi), sin(theta), cos(theta) * sin(phi));
+	}
+
+	/*
+	 * Metodo che crea una texture dell'atlas, con spazio per le mipmap
+	 */
+	GLuint createAtlas(GLsizei width, GLsizei height) {
+		GLuint texture;
+		glGenTextures(1, &texture);
+		gl_state().BindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		return texture;
+	}
+
+	/*
+	 * Metodo che crea il quad dei billboard: gli angoli in [-1, 1] vengono portati dal vertex shader sul piano rivolto verso la camera.
+	 * Gli atlas sono le texture del materiale del quad, per cui la coda di rendering li collega come le altre texture.
+	 */
+	void createQuad(const Bounds &bounds) {
+		const GLfloat corners[4][2] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f } };
+
+		vector<Vertex> vertices(4);
+		for (int i = 0; i < 4; i++) {
+			vertices[i].Position = glm::vec3(corners[i][0], corners[i][1], 0.0f);
+			vertices[i].Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+			vertices[i].TexCoords = glm::vec2(corners[i][0], corners[i][1]) * 0.5f + 0.5f;
+			vertices[i].Tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+			vertices[i].Bitangent = glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+
+		GLuint indices[6] = { 0, 1, 2, 2, 3, 0 };
+
+		vector<Texture> textures(2);
+		textures[0].id = this->albedoAtlas;
+		textures[0].type = "atlas_albedo";
+		textures[0].sampler = "atlas.albedo";
+		textures[1].id = this->normalAtlas;
+		textures[1].type = "atlas_normal";
+		textures[1].sampler = "atlas.normal";
+
+		this->quad = new Mesh(vertices, vector<GLuint>(indices, indices + 6), textures, VERTEX_POSITION);
+		this->quad->bounds = bounds;
+	}
+};
+
+#endif
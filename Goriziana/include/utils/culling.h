@@ -0,0 +1,226 @@
+/*
+Classe FrustumCuller
+- Raccoglie durante il frame i volumi di contenimento (Bounds) degli oggetti da renderizzare, portati in coordinate mondo
+  con la model matrix di ogni istanza, ricavata dalla trasformazione del corpo rigido della Bullet
+- L'AABB in coordinate mondo viene memorizzata come centro e semi-dimensioni, in vettori separati per componente (SoA):
+  il test contro i 6 piani del view frustum viene eseguito con istruzioni SSE su 4 oggetti alla volta
+- Un oggetto viene scartato se la sua AABB e' interamente dalla parte esterna di almeno un piano; vengono contati gli oggetti
+  testati e quelli scartati, per frame e in totale
+*/
+
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <utils/mesh.h>
+
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+
+/*
+ * Struttura che raccoglie i contatori del frustum culling
+ */
+struct CullingStats {
+	// Numero di volumi testati
+	size_t tested;
+	// Numero di volumi scartati perche' fuori dal view frustum
+	size_t culled;
+};
+
+/********** classe FRUSTUMCULLER **********/
+class FrustumCuller {
+public:
+	// Costruttore della classe
+	FrustumCuller() : count(0), frames(0) {
+		this->clearStats(this->lastFrame);
+		this->clearStats(this->totals);
+	}
+
+	/*
+	 * Metodo che inizia un nuovo frame: ricava i piani del view frustum e svuota i volumi del frame precedente.
+	 * Prende in input i seguenti valori:
+	 * - viewProjection: mat4, prodotto projection * view della camera
+	 */
+	void Begin(const glm::mat4 &viewProjection) {
+		// Metodo di Gribb e Hartmann: ogni piano e' la somma o la differenza tra la quarta riga della matrice ed una delle altre
+		for (int p = 0; p < 6; p++) {
+			int row = p / 2;
+			GLfloat sign = (p % 2 == 0) ? 1.0f : -1.0f;
+
+			GLfloat plane[4];
+			for (int c = 0; c < 4; c++)
+				plane[c] = viewProjection[c][3] + sign * viewProjection[c][row];
+
+			// I piani vengono normalizzati, in modo che la distanza dal piano sia in unita' del mondo
+			GLfloat length = sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			for (int c = 0; c < 4; c++)
+				this->planes[p][c] = plane[c] / length;
+		}
+
+		this->count = 0;
+		this->centerX.clear();
+		this->centerY.clear();
+		this->centerZ.clear();
+		this->extentX.clear();
+		this->extentY.clear();
+		this->extentZ.clear();
+		this->visible.clear();
+	}
+
+	/*
+	 * Metodo che aggiunge un volume da testare e ne restituisce l'indice, da passare a isVisible dopo Cull.
+	 * L'AABB in coordinate mondo racchiude quella del modello trasformata: il centro viene trasformato dalla model matrix,
+	 * le semi-dimensioni dal valore assoluto della sua parte 3x3.
+	 * Prende in input i seguenti valori:
+	 * - bounds: Bounds, volumi di contenimento in coordinate del modello
+	 * - modelMatrix: mat4, trasformazione dell'istanza
+	 */
+	size_t Add(const Bounds &bounds, const glm::mat4 &modelMatrix) {
+		glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+		glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+
+		glm::vec4 worldCenter = modelMatrix * glm::vec4(center, 1.0f);
+		GLfloat worldExtent[3];
+		for (int r = 0; r < 3; r++)
+			worldExtent[r] = fabs(modelMatrix[0][r]) * extent.x + fabs(modelMatrix[1][r]) * extent.y + fabs(modelMatrix[2][r]) * extent.z;
+
+		this->centerX.push_back(worldCenter.x);
+		this->centerY.push_back(worldCenter.y);
+		this->centerZ.push_back(worldCenter.z);
+		this->extentX.push_back(worldExtent[0]);
+		this->extentY.push_back(worldExtent[1]);
+		this->extentZ.push_back(worldExtent[2]);
+
+		return this->count++;
+	}
+
+	/*
+	 * Metodo che testa tutti i volumi aggiunti nel frame contro il view frustum
+	 */
+	void Cull() {
+		// I vettori vengono allungati ad un multiplo di 4 con volumi vuoti nell'origine, il cui esito viene ignorato
+		size_t padded = (this->count + 3) & ~(size_t) 3;
+		this->centerX.resize(padded, 0.0f);
+		this->centerY.resize(padded, 0.0f);
+		this->centerZ.resize(padded, 0.0f);
+		this->extentX.resize(padded, 0.0f);
+		this->extentY.resize(padded, 0.0f);
+		this->extentZ.resize(padded, 0.0f);
+		this->visible.resize(padded);
+
+		CullingStats stats;
+		stats.tested = this->count;
+		stats.culled = 0;
+
+#ifdef CULLING_SSE
+		__m128 zero = _mm_setzero_ps();
+
+		for (size_t i = 0; i < padded; i += 4) {
+			__m128 cx = _mm_loadu_ps(&this->centerX[i]);
+			__m128 cy = _mm_loadu_ps(&this->centerY[i]);
+			__m128 cz = _mm_loadu_ps(&this->centerZ[i]);
+			__m128 ex = _mm_loadu_ps(&this->extentX[i]);
+			__m128 ey = _mm_loadu_ps(&this->extentY[i]);
+			__m128 ez = _mm_loadu_ps(&this->extentZ[i]);
+			__m128 outside = _mm_setzero_ps();
+
+			for (int p = 0; p < 6; p++) {
+				const GLfloat *plane = this->planes[p];
+
+				// Distanza del centro dal piano, e proiezione delle semi-dimensioni sulla normale del piano
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane[0])), _mm_mul_ps(cy, _mm_set1_ps(plane[1]))),
+						_mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane[2])), _mm_set1_ps(plane[3])));
+				__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(fabs(plane[0]))), _mm_mul_ps(ey, _mm_set1_ps(fabs(plane[1])))),
+						_mm_mul_ps(ez, _mm_set1_ps(fabs(plane[2]))));
+
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+			}
+
+			int mask = _mm_movemask_ps(outside);
+			for (int k = 0; k < 4; k++)
+				this->visible[i + k] = (mask & (1 << k)) == 0;
+		}
+#else
+		for (size_t i = 0; i < padded; i++) {
+			bool outside = false;
+
+			for (int p = 0; p < 6 && !outside; p++) {
+				const GLfloat *plane = this->planes[p];
+
+				GLfloat distance = this->centerX[i] * plane[0] + this->centerY[i] * plane[1] + this->centerZ[i] * plane[2] + plane[3];
+				GLfloat radius = this->extentX[i] * fabs(plane[0]) + this->extentY[i] * fabs(plane[1]) + this->extentZ[i] * fabs(plane[2]);
+
+				outside = distance + radius < 0.0f;
+			}
+
+			this->visible[i] = !outside;
+		}
+#endif
+
+		for (size_t i = 0; i < this->count; i++)
+			if (!this->visible[i])
+				stats.culled++;
+
+		this->lastFrame = stats;
+		this->totals.tested += stats.tested;
+		this->totals.culled += stats.culled;
+		this->frames++;
+	}
+
+	/*
+	 * Metodo che indica se il volume con l'indice restituito da Add interseca il view frustum
+	 */
+	bool isVisible(size_t index) const {
+		return this->visible[index] != 0;
+	}
+
+	/*
+	 * Metodo get per i contatori dell'ultimo frame
+	 */
+	const CullingStats& getLastFrame() const {
+		return this->lastFrame;
+	}
+
+	/*
+	 * Metodo get per i contatori sommati su tutti i frame, e per il numero di frame
+	 */
+	const CullingStats& getTotals() const {
+		return this->totals;
+	}
+
+	size_t getFrames() const {
+		return this->frames;
+	}
+
+private:
+	// Attributo che contiene i piani del view frustum (normale e distanza), con la normale rivolta verso l'interno
+	GLfloat planes[6][4];
+	// Attributi che contengono centro e semi-dimensioni delle AABB in coordinate mondo, una componente per vettore
+	vector<GLfloat> centerX, centerY, centerZ;
+	vector<GLfloat> extentX, extentY, extentZ;
+	// Attributo che contiene l'esito del test di ogni volume
+	vector<unsigned char> visible;
+	// Attributo che contiene il numero di volumi aggiunti nel frame
+	size_t count;
+	// Attributi che contengono i contatori
+	CullingStats lastFrame;
+	CullingStats totals;
+	size_t frames;
+
+	void clearStats(CullingStats &stats) {
+		stats.tested = 0;
+		stats.culled = 0;
+	}
+};
+
+#endif
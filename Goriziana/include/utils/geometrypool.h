@@ -0,0 +1,397 @@
+/*
+Classe GeometryPool
+- Contiene la geometria statica della scena in pochi buffer condivisi: un'arena per ogni formato dei vertici e tipo di indice,
+  con un vertex buffer, un element buffer ed un VAO, piu' un instance buffer comune a tutte le arene
+- I modelli statici vengono aggiunti con la loro model matrix, che viene applicata ai vertici: la geometria della pool e' in
+  coordinate mondo, e viene renderizzata con una sola istanza con model matrix identita'
+- Le mesh di un modello con lo stesso insieme di texture vengono unite in un'unica mesh per materiale, renderizzata con una sola
+  draw call a partire dal suo base vertex; i livelli di dettaglio delle mesh unite vengono uniti livello per livello
+- Le arene crescono riallocando i propri buffer, per cui il numero di buffer OpenGL non cresce con i modelli aggiunti;
+  i buffer propri delle mesh aggiunte vengono deallocati
+*/
+
+#ifndef GEOMETRYPOOL_H
+#define GEOMETRYPOOL_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <utils/shader.h>
+#include <utils/glstate.h>
+#include <utils/mesh.h>
+#include <utils/model.h>
+#include <utils/vertexformat.h>
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+// Capacita' minima dei buffer di un'arena, in byte: i buffer crescono almeno del doppio ad ogni riallocazione
+#define GEOMETRY_POOL_MIN_BYTES (256 * 1024)
+
+/*
+ * Struttura che rappresenta un'arena della pool: vertex ed element buffer condivisi da tutte le mesh con lo stesso formato dei
+ * vertici e tipo di indice, collegati ad un solo VAO
+ */
+struct GeometryArena {
+	VertexLayout layout;
+	GLenum indexType;
+	GLuint VAO, VBO, EBO;
+	// Numero di vertici ed indici caricati, e capacita' dei buffer in byte
+	GLsizei vertexCount;
+	GLuint indexCount;
+	size_t vertexCapacity;
+	size_t indexCapacity;
+};
+
+/********** classe GEOMETRYPOOL **********/
+class GeometryPool {
+public:
+	// Attributo che contiene le mesh della pool, in coordinate mondo: una per ogni materiale dei modelli aggiunti
+	vector<Mesh> meshes;
+
+	// Costruttore della classe
+	GeometryPool() : instanceVBO(0), instanceCapacity(0), sourceMeshes(0) {
+	}
+
+	/*
+	 * Metodo che aggiunge un modello statico alla pool: le sue mesh vengono portate in coordinate mondo, unite per materiale
+	 * e caricate nelle arene, ed i loro buffer propri vengono deallocati. Il modello non va piu' renderizzato direttamente.
+	 * Prende in input i seguenti valori:
+	 * - model: Model, modello da aggiungere, gia' caricato con i suoi LOD
+	 * - modelMatrix: mat4, model matrix del modello, costante
+	 */
+	void Add(Model &model, const glm::mat4 &modelMatrix) {
+		if (this->instanceVBO == 0)
+			glGenBuffers(1, &this->instanceVBO);
+
+		// Raggruppo le mesh per insieme di texture: ogni gruppo diventa una mesh della pool
+		vector< vector<size_t> > groups;
+		for (size_t m = 0; m < model.meshes.size(); m++) {
+			size_t g = 0;
+			while (g < groups.size() && !sameTextures(model.meshes[groups[g][0]], model.meshes[m]))
+				g++;
+
+			if (g == groups.size())
+				groups.push_back(vector<size_t>());
+			groups[g].push_back(m);
+		}
+
+		size_t merged = 0;
+		for (size_t g = 0; g < groups.size(); g++)
+			if (this->merge(model, groups[g], modelMatrix))
+				merged++;
+
+		for (size_t m = 0; m < model.meshes.size(); m++)
+			model.meshes[m].Delete();
+		this->sourceMeshes += model.meshes.size();
+
+		cout << "Geometria statica: " << model.meshes.size() << " mesh di " << model.directory << " unite in " << merged << " mesh, una per materiale; "
+			 << this->meshes.size() << " mesh in " << this->arenas.size() << " arene, " << this->getBufferCount() << " buffer" << endl;
+	}
+
+	/*
+	 * Metodo che prepara il binding dei materiali di tutte le mesh della pool per lo shader con cui verranno renderizzate
+	 */
+	void BindMaterials(Shader &shader) {
+		for (size_t i = 0; i < this->meshes.size(); i++)
+			this->meshes[i].bindMaterial(shader);
+	}
+
+	/*
+	 * Metodo che carica le istanze nell'instance buffer della pool, letto dai VAO di tutte le arene.
+	 * La geometria e' gia' in coordinate mondo, per cui di norma c'e' una sola istanza con model matrix identita'.
+	 * Prende in input i seguenti valori:
+	 * - instances: vector<InstanceData>, matrici e colore di ogni istanza
+	 */
+	void UploadInstances(const vector<InstanceData> &instances) {
+		if (instances.empty() || this->instanceVBO == 0)
+			return;
+
+		gl_state().BindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+
+		if (instances.size() > this->instanceCapacity) {
+			this->instanceCapacity = instances.size();
+			glBufferData(GL_ARRAY_BUFFER, this->instanceCapacity * sizeof(InstanceData), &instances[0], GL_DYNAMIC_DRAW);
+		} else {
+			glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), &instances[0]);
+		}
+	}
+
+	/*
+	 * Metodo get per il numero di buffer OpenGL della pool, e per il numero di mesh dei modelli aggiunti
+	 */
+	size_t getBufferCount() const {
+		return this->arenas.size() * 2 + (this->instanceVBO != 0 ? 1 : 0);
+	}
+
+	size_t getSourceMeshes() const {
+		return this->sourceMeshes;
+	}
+
+	/*
+	 * Metodo che, alla chiusura dell'applicazione, dealloca VAO e buffer delle arene e l'instance buffer
+	 */
+	void Delete() {
+		for (size_t a = 0; a < this->arenas.size(); a++) {
+			gl_state().DeleteVertexArrays(1, &this->arenas[a].VAO);
+			gl_state().DeleteBuffers(1, &this->arenas[a].VBO);
+			gl_state().DeleteBuffers(1, &this->arenas[a].EBO);
+		}
+		this->arenas.clear();
+		this->meshes.clear();
+
+		if (this->instanceVBO != 0)
+			gl_state().DeleteBuffers(1, &this->instanceVBO);
+		this->instanceVBO = 0;
+	}
+
+private:
+	// Attributo che contiene le arene, una per formato dei vertici e tipo di indice
+	vector<GeometryArena> arenas;
+	// Attributi che rappresentano l'instance buffer e il numero di istanze che puo' contenere
+	GLuint instanceVBO;
+	size_t instanceCapacity;
+	// Attributo che contiene il numero di mesh dei modelli aggiunti
+	size_t sourceMeshes;
+
+	/*
+	 * Metodo che unisce le mesh indicate di un modello in una mesh della pool, e la carica nell'arena del suo formato.
+	 * Restituisce false se le mesh non hanno vertici.
+	 */
+	bool merge(const Model &model, const vector<size_t> &group, const glm::mat4 &modelMatrix) {
+		// Le normali si trasformano con l'inversa trasposta, le tangenti e le bitangenti con la model matrix;
+		// l'errore dei LOD passa in coordinate mondo con la scala piu' grande della model matrix
+		glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(modelMatrix));
+		glm::mat3 tangentMatrix = glm::mat3(modelMatrix);
+		GLfloat scale = glm::max(glm::length(glm::vec3(modelMatrix[0])), glm::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+
+		vector<Vertex> vertices;
+		vector<GLuint> offsets;
+		int components = VERTEX_POSITION;
+		size_t levelCount = 1;
+
+		for (size_t i = 0; i < group.size(); i++) {
+			const Mesh &mesh = model.meshes[group[i]];
+			offsets.push_back((GLuint) vertices.size());
+
+			for (size_t v = 0; v < mesh.vertices.size(); v++) {
+				Vertex vertex = mesh.vertices[v];
+				vertex.Position = glm::vec3(modelMatrix * glm::vec4(vertex.Position, 1.0f));
+				vertex.Normal = safeNormalize(normalMatrix * vertex.Normal);
+				vertex.Tangent = safeNormalize(tangentMatrix * vertex.Tangent);
+				vertex.Bitangent = safeNormalize(tangentMatrix * vertex.Bitangent);
+				vertices.push_back(vertex);
+			}
+
+			// La mesh unita carica le componenti presenti in almeno una mesh: le altre hanno comunque valori validi (nulli)
+			if (mesh.layout.find(1))
+				components |= VERTEX_NORMAL;
+			if (mesh.layout.find(2))
+				components |= VERTEX_TEXCOORDS;
+			if (mesh.layout.find(3))
+				components |= VERTEX_TANGENT;
+
+			levelCount = std::max(levelCount, mesh.lods.size());
+		}
+
+		if (vertices.empty())
+			return false;
+
+		// Livello l della mesh unita: il livello l di ogni mesh, o il suo livello meno dettagliato se ne ha meno,
+		// con l'errore piu' grande tra quelli delle mesh
+		vector< vector<GLuint> > levels(levelCount);
+		vector<GLfloat> errors(levelCount, 0.0f);
+
+		for (size_t l = 0; l < levelCount; l++)
+			for (size_t i = 0; i < group.size(); i++) {
+				const Mesh &mesh = model.meshes[group[i]];
+				size_t level = std::min(l, mesh.lods.size() - 1);
+				const vector<GLuint> &source = (level == 0) ? mesh.indices : mesh.lodIndices[level - 1];
+
+				for (size_t k = 0; k < source.size(); k++)
+					levels[l].push_back(source[k] + offsets[i]);
+				errors[l] = glm::max(errors[l], mesh.lods[level].error * scale);
+			}
+
+		VertexLayout layout;
+		vector<unsigned char> packed;
+		Mesh::PackVertices(vertices, components, layout, packed);
+
+		GLenum indexType = vertices.size() < 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		GeometryArena &arena = this->arena(layout, indexType);
+		GLint baseVertex = arena.vertexCount;
+		this->appendVertices(arena, packed, vertices.size());
+
+		Mesh result(vertices, levels[0], model.meshes[group[0]].textures, layout, indexType, arena.VAO, baseVertex);
+
+		// Tutti i livelli vengono accodati nell'element buffer dell'arena, ognuno come un intervallo
+		result.lods.clear();
+		for (size_t l = 0; l < levelCount; l++) {
+			MeshLod lod;
+			lod.firstIndex = this->appendIndices(arena, levels[l]);
+			lod.indexCount = (GLsizei) levels[l].size();
+			lod.error = errors[l];
+			result.lods.push_back(lod);
+		}
+		result.lodIndices.assign(levels.begin() + 1, levels.end());
+
+		// Volumi di contenimento in coordinate mondo, calcolati come in Model::processMesh
+		result.bounds.min = result.bounds.max = vertices[0].Position;
+		for (size_t v = 1; v < vertices.size(); v++) {
+			result.bounds.min = glm::min(result.bounds.min, vertices[v].Position);
+			result.bounds.max = glm::max(result.bounds.max, vertices[v].Position);
+		}
+
+		result.bounds.center = (result.bounds.min + result.bounds.max) * 0.5f;
+		result.bounds.radius = 0.0f;
+		for (size_t v = 0; v < vertices.size(); v++)
+			result.bounds.radius = glm::max(result.bounds.radius, glm::length(vertices[v].Position - result.bounds.center));
+
+		this->meshes.push_back(result);
+		return true;
+	}
+
+	/*
+	 * Metodo che restituisce l'arena con il formato dei vertici ed il tipo di indice indicati, creandola se non esiste.
+	 * Il VAO di una nuova arena legge gli attributi di istanza dall'instance buffer della pool; vertex ed element buffer
+	 * vengono creati al primo caricamento.
+	 */
+	GeometryArena& arena(const VertexLayout &layout, GLenum indexType) {
+		for (size_t a = 0; a < this->arenas.size(); a++)
+			if (this->arenas[a].indexType == indexType && sameLayout(this->arenas[a].layout, layout))
+				return this->arenas[a];
+
+		GeometryArena arena;
+		arena.layout = layout;
+		arena.indexType = indexType;
+		arena.VBO = arena.EBO = 0;
+		arena.vertexCount = 0;
+		arena.indexCount = 0;
+		arena.vertexCapacity = arena.indexCapacity = 0;
+
+		glGenVertexArrays(1, &arena.VAO);
+		gl_state().BindVertexArray(arena.VAO);
+		Mesh::SetupInstanceAttributes(this->instanceVBO);
+		gl_state().BindVertexArray(0);
+
+		this->arenas.push_back(arena);
+		return this->arenas.back();
+	}
+
+	/*
+	 * Metodo che accoda all'arena i vertici compressi indicati
+	 */
+	void appendVertices(GeometryArena &arena, const vector<unsigned char> &packed, size_t count) {
+		size_t used = (size_t) arena.vertexCount * arena.layout.stride;
+
+		// Il VAO memorizza il vertex buffer da cui legge gli attributi: se il buffer e' stato riallocato va ricollegato
+		if (this->reserve(arena.VBO, used, arena.vertexCapacity, used + packed.size())) {
+			gl_state().BindVertexArray(arena.VAO);
+			gl_state().BindBuffer(GL_ARRAY_BUFFER, arena.VBO);
+			Mesh::SetupVertexAttributes(arena.layout);
+			gl_state().BindVertexArray(0);
+		}
+
+		gl_state().BindBuffer(GL_ARRAY_BUFFER, arena.VBO);
+		glBufferSubData(GL_ARRAY_BUFFER, used, packed.size(), &packed[0]);
+		arena.vertexCount += (GLsizei) count;
+	}
+
+	/*
+	 * Metodo che accoda all'arena gli indici indicati, nel tipo di indice dell'arena, e restituisce la posizione del primo
+	 */
+	GLuint appendIndices(GeometryArena &arena, const vector<GLuint> &indices) {
+		GLuint first = arena.indexCount;
+		size_t size = arena.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		size_t used = arena.indexCount * size;
+
+		// L'element buffer fa parte dello stato del VAO: se e' stato riallocato va ricollegato
+		if (this->reserve(arena.EBO, used, arena.indexCapacity, used + indices.size() * size)) {
+			gl_state().BindVertexArray(arena.VAO);
+			gl_state().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.EBO);
+			gl_state().BindVertexArray(0);
+		}
+
+		// Gli indici vengono caricati tramite GL_COPY_WRITE_BUFFER, per non modificare l'element buffer del VAO attivo
+		if (!indices.empty()) {
+			gl_state().BindBuffer(GL_COPY_WRITE_BUFFER, arena.EBO);
+
+			if (arena.indexType == GL_UNSIGNED_SHORT) {
+				vector<GLushort> shorts(indices.begin(), indices.end());
+				glBufferSubData(GL_COPY_WRITE_BUFFER, used, shorts.size() * sizeof(GLushort), &shorts[0]);
+			} else {
+				glBufferSubData(GL_COPY_WRITE_BUFFER, used, indices.size() * sizeof(GLuint), &indices[0]);
+			}
+		}
+
+		arena.indexCount += (GLuint) indices.size();
+		return first;
+	}
+
+	/*
+	 * Metodo che garantisce che il buffer indicato possa contenere i byte richiesti: se non basta ne crea uno piu' grande,
+	 * vi copia i dati gia' caricati ed elimina il vecchio, per cui il numero di buffer resta lo stesso.
+	 * Restituisce true se il buffer e' stato sostituito.
+	 */
+	bool reserve(GLuint &buffer, size_t used, size_t &capacity, size_t required) {
+		if (buffer != 0 && required <= capacity)
+			return false;
+
+		size_t grown = std::max(std::max(capacity * 2, required), (size_t) GEOMETRY_POOL_MIN_BYTES);
+		GLuint replacement;
+		glGenBuffers(1, &replacement);
+		gl_state().BindBuffer(GL_COPY_WRITE_BUFFER, replacement);
+		glBufferData(GL_COPY_WRITE_BUFFER, grown, NULL, GL_STATIC_DRAW);
+
+		if (used > 0) {
+			gl_state().BindBuffer(GL_COPY_READ_BUFFER, buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+		}
+
+		if (buffer != 0)
+			gl_state().DeleteBuffers(1, &buffer);
+
+		buffer = replacement;
+		capacity = grown;
+		return true;
+	}
+
+	/*
+	 * Due mesh appartengono allo stesso materiale se usano le stesse texture con gli stessi sampler
+	 */
+	static bool sameTextures(const Mesh &a, const Mesh &b) {
+		if (a.textures.size() != b.textures.size())
+			return false;
+
+		for (size_t i = 0; i < a.textures.size(); i++)
+			if (a.textures[i].id != b.textures[i].id || a.textures[i].sampler != b.textures[i].sampler)
+				return false;
+
+		return true;
+	}
+
+	static bool sameLayout(const VertexLayout &a, const VertexLayout &b) {
+		if (a.stride != b.stride || a.attributes.size() != b.attributes.size())
+			return false;
+
+		for (size_t i = 0; i < a.attributes.size(); i++) {
+			const VertexAttributeFormat &x = a.attributes[i], &y = b.attributes[i];
+			if (x.location != y.location || x.size != y.size || x.type != y.type || x.normalized != y.normalized || x.offset != y.offset)
+				return false;
+		}
+
+		return true;
+	}
+
+	static glm::vec3 safeNormalize(const glm::vec3 &v) {
+		GLfloat length = glm::length(v);
+		return length > 0.0f ? v / length : v;
+	}
+};
+
+#endif
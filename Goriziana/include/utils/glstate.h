@@ -0,0 +1,413 @@
+/*
+Classe GLStateCache
+- Mantiene una copia (shadow) dei binding OpenGL correnti: program, texture unit attiva, texture 2D e cubemap di ogni unit,
+  VAO, buffer collegati a GL_ARRAY_BUFFER e GL_UNIFORM_BUFFER, funzione del depth test
+- Le chiamate che non cambierebbero lo stato vengono scartate senza raggiungere il driver; per ogni tipo di chiamata
+  vengono contate quelle eseguite e quelle scartate, per frame e in totale
+- In modalita' di verifica (setVerify, oppure compilando con GL_STATE_VERIFY) dopo ogni chiamata la shadow viene confrontata
+  con lo stato reale letto con glGetIntegerv: le differenze vengono segnalate e la shadow viene riallineata
+- Tutto il codice di rendering deve passare dall'istanza restituita da gl_state(): una chiamata diretta a glBind* rende la shadow
+  non valida, per cui codice esterno (librerie) deve essere seguito da Invalidate
+*/
+
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+using namespace std;
+
+// Numero di texture unit di cui viene mantenuta la shadow: le unit successive vengono sempre inoltrate al driver
+#define GL_STATE_TEXTURE_UNITS 16
+// Valore della shadow quando lo stato reale non e' noto (dopo Invalidate): la chiamata successiva viene sempre eseguita
+#define GL_STATE_UNKNOWN ((GLuint) -1)
+
+/*
+ * Tipi di chiamata di cui vengono raccolti i contatori
+ */
+enum GLStateCall {
+	GL_STATE_CALL_PROGRAM = 0,
+	GL_STATE_CALL_ACTIVE_TEXTURE,
+	GL_STATE_CALL_BIND_TEXTURE,
+	GL_STATE_CALL_BIND_VERTEX_ARRAY,
+	GL_STATE_CALL_BIND_BUFFER,
+	GL_STATE_CALL_DEPTH_FUNC,
+	GL_STATE_CALLS
+};
+
+/*
+ * Struttura che raccoglie i contatori delle chiamate eseguite e scartate, per tipo di chiamata
+ */
+struct GLStateStats {
+	size_t issued[GL_STATE_CALLS];
+	size_t elided[GL_STATE_CALLS];
+	// Numero di differenze trovate tra shadow e stato reale in modalita' di verifica
+	size_t mismatches;
+};
+
+/********** classe GLSTATECACHE **********/
+class GLStateCache {
+public:
+	// Costruttore della classe, lo stato iniziale e' quello di un contesto appena creato
+	GLStateCache() : frames(0) {
+#ifdef GL_STATE_VERIFY
+		this->verify = true;
+#else
+		this->verify = false;
+#endif
+		this->clearStats(this->frame);
+		this->clearStats(this->lastFrame);
+		this->clearStats(this->totals);
+
+		this->program = 0;
+		this->activeUnit = 0;
+		for (int i = 0; i < GL_STATE_TEXTURE_UNITS; i++) {
+			this->textures2D[i] = 0;
+			this->texturesCube[i] = 0;
+		}
+		this->vertexArray = 0;
+		this->arrayBuffer = 0;
+		this->uniformBuffer = 0;
+		this->depthFunc = GL_LESS;
+	}
+
+	/*
+	 * Metodo che sostituisce glUseProgram
+	 */
+	void UseProgram(GLuint program) {
+		if (this->program == program) {
+			this->elide(GL_STATE_CALL_PROGRAM);
+		} else {
+			glUseProgram(program);
+			this->program = program;
+			this->frame.issued[GL_STATE_CALL_PROGRAM]++;
+		}
+
+		if (this->verify)
+			this->program = this->check(GL_CURRENT_PROGRAM, this->program, "program");
+	}
+
+	/*
+	 * Metodo che sostituisce glActiveTexture.
+	 * Prende in input i seguenti valori:
+	 * - unit: GLenum, texture unit da rendere attiva (GL_TEXTURE0 + i)
+	 */
+	void ActiveTexture(GLenum unit) {
+		GLuint index = unit - GL_TEXTURE0;
+
+		if (this->activeUnit == index) {
+			this->elide(GL_STATE_CALL_ACTIVE_TEXTURE);
+		} else {
+			glActiveTexture(unit);
+			this->activeUnit = index;
+			this->frame.issued[GL_STATE_CALL_ACTIVE_TEXTURE]++;
+		}
+
+		if (this->verify)
+			this->activeUnit = this->checkActiveUnit();
+	}
+
+	/*
+	 * Metodo che sostituisce glBindTexture, sulla texture unit attiva.
+	 * La shadow viene mantenuta per GL_TEXTURE_2D e GL_TEXTURE_CUBE_MAP, gli altri target vengono sempre inoltrati.
+	 */
+	void BindTexture(GLenum target, GLuint texture) {
+		GLuint *shadow = this->textureShadow(target);
+
+		if (shadow != NULL && *shadow == texture) {
+			this->elide(GL_STATE_CALL_BIND_TEXTURE);
+		} else {
+			glBindTexture(target, texture);
+			if (shadow != NULL)
+				*shadow = texture;
+			this->frame.issued[GL_STATE_CALL_BIND_TEXTURE]++;
+		}
+
+		if (this->verify && shadow != NULL)
+			*shadow = this->check(target == GL_TEXTURE_2D ? GL_TEXTURE_BINDING_2D : GL_TEXTURE_BINDING_CUBE_MAP, *shadow, "texture");
+	}
+
+	/*
+	 * Metodo che sostituisce glBindVertexArray
+	 */
+	void BindVertexArray(GLuint vertexArray) {
+		if (this->vertexArray == vertexArray) {
+			this->elide(GL_STATE_CALL_BIND_VERTEX_ARRAY);
+		} else {
+			glBindVertexArray(vertexArray);
+			this->vertexArray = vertexArray;
+			this->frame.issued[GL_STATE_CALL_BIND_VERTEX_ARRAY]++;
+		}
+
+		if (this->verify)
+			this->vertexArray = this->check(GL_VERTEX_ARRAY_BINDING, this->vertexArray, "VAO");
+	}
+
+	/*
+	 * Metodo che sostituisce glBindBuffer.
+	 * La shadow viene mantenuta per GL_ARRAY_BUFFER e GL_UNIFORM_BUFFER; GL_ELEMENT_ARRAY_BUFFER fa parte dello stato del VAO
+	 * collegato, per cui viene sempre inoltrato come gli altri target.
+	 */
+	void BindBuffer(GLenum target, GLuint buffer) {
+		GLuint *shadow = this->bufferShadow(target);
+
+		if (shadow != NULL && *shadow == buffer) {
+			this->elide(GL_STATE_CALL_BIND_BUFFER);
+		} else {
+			glBindBuffer(target, buffer);
+			if (shadow != NULL)
+				*shadow = buffer;
+			this->frame.issued[GL_STATE_CALL_BIND_BUFFER]++;
+		}
+
+		if (this->verify && shadow != NULL)
+			*shadow = this->check(target == GL_ARRAY_BUFFER ? GL_ARRAY_BUFFER_BINDING : GL_UNIFORM_BUFFER_BINDING, *shadow, "buffer");
+	}
+
+	/*
+	 * Metodo che sostituisce glBindBufferBase: oltre al binding indicizzato modifica anche il binding generico del target,
+	 * per cui la chiamata viene sempre eseguita e la shadow aggiornata
+	 */
+	void BindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+		glBindBufferBase(target, index, buffer);
+		this->frame.issued[GL_STATE_CALL_BIND_BUFFER]++;
+
+		GLuint *shadow = this->bufferShadow(target);
+		if (shadow != NULL)
+			*shadow = buffer;
+	}
+
+	/*
+	 * Metodo che sostituisce glDepthFunc
+	 */
+	void DepthFunc(GLenum func) {
+		if (this->depthFunc == func) {
+			this->elide(GL_STATE_CALL_DEPTH_FUNC);
+		} else {
+			glDepthFunc(func);
+			this->depthFunc = func;
+			this->frame.issued[GL_STATE_CALL_DEPTH_FUNC]++;
+		}
+
+		if (this->verify)
+			this->depthFunc = this->check(GL_DEPTH_FUNC, this->depthFunc, "depth func");
+	}
+
+	/*
+	 * Metodi che sostituiscono glDeleteTextures, glDeleteVertexArrays e glDeleteBuffers:
+	 * OpenGL scollega gli oggetti eliminati, per cui la shadow torna a 0 dove li conteneva
+	 */
+	void DeleteTextures(GLsizei count, const GLuint *textures) {
+		for (GLsizei n = 0; n < count; n++)
+			for (int i = 0; i < GL_STATE_TEXTURE_UNITS; i++) {
+				if (this->textures2D[i] == textures[n])
+					this->textures2D[i] = 0;
+				if (this->texturesCube[i] == textures[n])
+					this->texturesCube[i] = 0;
+			}
+
+		glDeleteTextures(count, textures);
+	}
+
+	void DeleteVertexArrays(GLsizei count, const GLuint *vertexArrays) {
+		for (GLsizei n = 0; n < count; n++)
+			if (this->vertexArray == vertexArrays[n])
+				this->vertexArray = 0;
+
+		glDeleteVertexArrays(count, vertexArrays);
+	}
+
+	void DeleteBuffers(GLsizei count, const GLuint *buffers) {
+		for (GLsizei n = 0; n < count; n++) {
+			if (this->arrayBuffer == buffers[n])
+				this->arrayBuffer = 0;
+			if (this->uniformBuffer == buffers[n])
+				this->uniformBuffer = 0;
+		}
+
+		glDeleteBuffers(count, buffers);
+	}
+
+	/*
+	 * Metodo che rende sconosciuto tutto lo stato: va chiamato dopo codice che modifica i binding senza passare dalla cache
+	 */
+	void Invalidate() {
+		this->program = GL_STATE_UNKNOWN;
+		this->activeUnit = GL_STATE_UNKNOWN;
+		for (int i = 0; i < GL_STATE_TEXTURE_UNITS; i++) {
+			this->textures2D[i] = GL_STATE_UNKNOWN;
+			this->texturesCube[i] = GL_STATE_UNKNOWN;
+		}
+		this->vertexArray = GL_STATE_UNKNOWN;
+		this->arrayBuffer = GL_STATE_UNKNOWN;
+		this->uniformBuffer = GL_STATE_UNKNOWN;
+		this->depthFunc = GL_STATE_UNKNOWN;
+	}
+
+	/*
+	 * Metodo che confronta tutta la shadow con lo stato reale, comprese le texture di tutte le unit
+	 */
+	void Verify() {
+		this->program = this->check(GL_CURRENT_PROGRAM, this->program, "program");
+		this->vertexArray = this->check(GL_VERTEX_ARRAY_BINDING, this->vertexArray, "VAO");
+		this->arrayBuffer = this->check(GL_ARRAY_BUFFER_BINDING, this->arrayBuffer, "buffer");
+		this->uniformBuffer = this->check(GL_UNIFORM_BUFFER_BINDING, this->uniformBuffer, "buffer");
+		this->depthFunc = this->check(GL_DEPTH_FUNC, this->depthFunc, "depth func");
+
+		this->activeUnit = this->checkActiveUnit();
+
+		// Le texture si leggono per la unit attiva: scorro le unit e poi ripristino quella di partenza
+		for (int i = 0; i < GL_STATE_TEXTURE_UNITS; i++) {
+			glActiveTexture(GL_TEXTURE0 + i);
+			this->textures2D[i] = this->check(GL_TEXTURE_BINDING_2D, this->textures2D[i], "texture");
+			this->texturesCube[i] = this->check(GL_TEXTURE_BINDING_CUBE_MAP, this->texturesCube[i], "texture");
+		}
+		glActiveTexture(GL_TEXTURE0 + this->activeUnit);
+	}
+
+	/*
+	 * Metodo che chiude il frame: i contatori del frame vengono salvati e sommati ai totali.
+	 * In modalita' di verifica viene controllata tutta la shadow.
+	 */
+	void EndFrame() {
+		if (this->verify)
+			this->Verify();
+
+		for (int c = 0; c < GL_STATE_CALLS; c++) {
+			this->totals.issued[c] += this->frame.issued[c];
+			this->totals.elided[c] += this->frame.elided[c];
+		}
+		this->totals.mismatches += this->frame.mismatches;
+
+		this->lastFrame = this->frame;
+		this->clearStats(this->frame);
+		this->frames++;
+	}
+
+	/*
+	 * Metodo set per la modalita' di verifica
+	 */
+	void setVerify(bool verify) {
+		this->verify = verify;
+	}
+
+	/*
+	 * Metodo get per i contatori dell'ultimo frame
+	 */
+	const GLStateStats& getLastFrame() const {
+		return this->lastFrame;
+	}
+
+	/*
+	 * Metodo get per i contatori sommati su tutti i frame, e per il numero di frame
+	 */
+	const GLStateStats& getTotals() const {
+		return this->totals;
+	}
+
+	size_t getFrames() const {
+		return this->frames;
+	}
+
+	/*
+	 * Metodo che restituisce il nome di un tipo di chiamata, per stampare i contatori
+	 */
+	static const char* getCallName(int call) {
+		static const char *names[GL_STATE_CALLS] = { "glUseProgram", "glActiveTexture", "glBindTexture", "glBindVertexArray", "glBindBuffer", "glDepthFunc" };
+		return names[call];
+	}
+
+private:
+	// Attributo che indica se la shadow va confrontata con lo stato reale
+	bool verify;
+	// Attributi che contengono la shadow dello stato OpenGL
+	GLuint program;
+	GLuint activeUnit;
+	GLuint textures2D[GL_STATE_TEXTURE_UNITS];
+	GLuint texturesCube[GL_STATE_TEXTURE_UNITS];
+	GLuint vertexArray;
+	GLuint arrayBuffer;
+	GLuint uniformBuffer;
+	GLuint depthFunc;
+	// Attributi che contengono i contatori del frame corrente, dell'ultimo frame e totali
+	GLStateStats frame;
+	GLStateStats lastFrame;
+	GLStateStats totals;
+	size_t frames;
+
+	/*
+	 * Metodo che conta una chiamata scartata
+	 */
+	void elide(GLStateCall call) {
+		this->frame.elided[call]++;
+	}
+
+	/*
+	 * Metodo che restituisce la shadow della texture collegata al target indicato nella unit attiva, NULL se non viene mantenuta
+	 */
+	GLuint* textureShadow(GLenum target) {
+		if (this->activeUnit >= GL_STATE_TEXTURE_UNITS)
+			return NULL;
+
+		if (target == GL_TEXTURE_2D)
+			return &this->textures2D[this->activeUnit];
+		if (target == GL_TEXTURE_CUBE_MAP)
+			return &this->texturesCube[this->activeUnit];
+		return NULL;
+	}
+
+	/*
+	 * Metodo che restituisce la shadow del buffer collegato al target indicato, NULL se non viene mantenuta
+	 */
+	GLuint* bufferShadow(GLenum target) {
+		if (target == GL_ARRAY_BUFFER)
+			return &this->arrayBuffer;
+		if (target == GL_UNIFORM_BUFFER)
+			return &this->uniformBuffer;
+		return NULL;
+	}
+
+	/*
+	 * Metodo che legge lo stato reale e lo confronta con la shadow, segnalando le differenze.
+	 * Restituisce lo stato reale, con cui la shadow viene riallineata.
+	 */
+	GLuint check(GLenum name, GLuint shadow, const char *label) {
+		GLint real;
+		glGetIntegerv(name, &real);
+
+		if (shadow != GL_STATE_UNKNOWN && (GLuint) real != shadow) {
+			cout << "ERROR::GLSTATE::MISMATCH: " << label << " " << shadow << " nella shadow, " << real << " nel contesto" << endl;
+			this->frame.mismatches++;
+		}
+
+		return (GLuint) real;
+	}
+
+	/*
+	 * Metodo che confronta la texture unit attiva, conservata nella shadow come indice a partire da GL_TEXTURE0
+	 */
+	GLuint checkActiveUnit() {
+		GLuint shadow = this->activeUnit == GL_STATE_UNKNOWN ? GL_STATE_UNKNOWN : this->activeUnit + GL_TEXTURE0;
+		return this->check(GL_ACTIVE_TEXTURE, shadow, "texture unit attiva") - GL_TEXTURE0;
+	}
+
+	void clearStats(GLStateStats &stats) {
+		for (int c = 0; c < GL_STATE_CALLS; c++) {
+			stats.issued[c] = 0;
+			stats.elided[c] = 0;
+		}
+		stats.mismatches = 0;
+	}
+};
+
+/*
+ * Funzione che restituisce la cache dello stato del contesto OpenGL dell'applicazione, unica per tutto il codice di rendering
+ */
+inline GLStateCache& gl_state() {
+	static GLStateCache cache;
+	return cache;
+}
+
+#endif
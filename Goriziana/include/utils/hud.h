@@ -0,0 +1,226 @@
+/*
+Classe HudLayer
+- Contiene gli elementi di testo dell'HUD (punteggi, giocatore di turno, etichetta del replay) in modalita' retained:
+  ogni elemento conserva i vertici gia' calcolati del suo testo, ricalcolati solo quando il testo o la posizione cambiano
+- I vertici di tutti gli elementi visibili vengono caricati in un unico vertex buffer solo quando un elemento cambia;
+  negli altri frame l'HUD viene renderizzato da quel buffer con una draw call per pagina dell'atlas, senza allocare memoria
+- Se l'atlas svuota una pagina tutti gli elementi vengono ricalcolati, perche' i loro vertici potrebbero riferirsi a glyph eliminati
+- Un elemento con un glyph che non e' entrato nell'atlas pieno viene ricalcolato nel frame successivo, finche' il glyph non viene caricato
+*/
+
+#ifndef HUD_H
+#define HUD_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <utils/shader.h>
+#include <utils/text.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Struttura che raccoglie i contatori dell'HUD
+ */
+struct HudStats {
+	// Numero di volte in cui un elemento e' stato ricalcolato
+	size_t layouts;
+	// Numero di volte in cui il vertex buffer e' stato ricaricato
+	size_t uploads;
+	// Numero di frame renderizzati
+	size_t frames;
+};
+
+/********** classe HUDLAYER **********/
+class HudLayer {
+public:
+	// Costruttore della classe, il buffer viene creato con Setup quando il contesto OpenGL e' attivo
+	HudLayer() : changed(true), atlasEvictions(0) {
+		this->stats.layouts = 0;
+		this->stats.uploads = 0;
+		this->stats.frames = 0;
+	}
+
+	/*
+	 * Metodo che crea il vertex buffer dell'HUD
+	 */
+	void Setup() {
+		this->batch.Setup();
+	}
+
+	/*
+	 * Metodo che aggiunge un elemento di testo all'HUD e ne restituisce l'indice.
+	 * Prende in input i seguenti valori:
+	 * - text: const char*, testo dell'elemento, codificato in UTF-8
+	 * - x, y: GLfloat, posizione della baseline del primo carattere, in pixel
+	 * - size: GLfloat, altezza del font in pixel
+	 * - color: vec3, colore del testo
+	 */
+	int AddText(const char *text, GLfloat x, GLfloat y, GLfloat size, const glm::vec3 &color) {
+		Element element;
+		element.text = text;
+		element.position = glm::vec2(x, y);
+		element.size = size;
+		element.color = color;
+		element.visible = true;
+		element.dirty = true;
+		element.deferred = false;
+
+		this->elements.push_back(element);
+		return (int) this->elements.size() - 1;
+	}
+
+	/*
+	 * Metodo set per il testo di un elemento: il confronto con il testo attuale non alloca memoria,
+	 * per cui puo' essere chiamato ad ogni frame con il valore corrente
+	 */
+	void SetText(int id, const char *text) {
+		Element &element = this->elements[id];
+
+		if (strcmp(element.text.c_str(), text) != 0) {
+			element.text.assign(text);
+			element.dirty = true;
+		}
+	}
+
+	/*
+	 * Metodo set per la posizione di un elemento
+	 */
+	void SetPosition(int id, GLfloat x, GLfloat y) {
+		Element &element = this->elements[id];
+
+		if (element.position.x != x || element.position.y != y) {
+			element.position = glm::vec2(x, y);
+			element.dirty = true;
+		}
+	}
+
+	/*
+	 * Metodo set per la visibilita' di un elemento: i suoi vertici restano validi, cambia solo il contenuto del buffer
+	 */
+	void SetVisible(int id, bool visible) {
+		Element &element = this->elements[id];
+
+		if (element.visible != visible) {
+			element.visible = visible;
+			this->changed = true;
+		}
+	}
+
+	/*
+	 * Metodo che ricalcola gli elementi cambiati, ricarica il buffer se necessario e renderizza l'HUD.
+	 * Prende in input i seguenti valori:
+	 * - shader: Shader, shader del testo
+	 * - atlas: FontAtlas, atlas da cui leggere i glyph
+	 */
+	void Draw(Shader &shader, FontAtlas &atlas) {
+		// Il calcolo dei vertici puo' svuotare una pagina usata da un elemento calcolato in precedenza: in quel caso si ripete
+		// il calcolo di tutti gli elementi, che termina perche' le pagine usate nel frame corrente non vengono svuotate
+		while (atlas.getEvictions() != this->atlasEvictions || this->hasDirty()) {
+			if (atlas.getEvictions() != this->atlasEvictions) {
+				this->atlasEvictions = atlas.getEvictions();
+				for (size_t i = 0; i < this->elements.size(); i++)
+					this->elements[i].dirty = true;
+			}
+
+			for (size_t i = 0; i < this->elements.size(); i++) {
+				Element &element = this->elements[i];
+				if (!element.dirty)
+					continue;
+
+				// I vettori dei vertici mantengono la loro memoria, per cui ricalcolare un elemento di lunghezza simile non alloca
+				for (size_t p = 0; p < element.vertices.size(); p++)
+					element.vertices[p].clear();
+				element.deferred = !layout_text(atlas, element.text, element.position.x, element.position.y, element.size, element.color, element.vertices);
+
+				element.dirty = false;
+				this->changed = true;
+				this->stats.layouts++;
+			}
+		}
+
+		// Gli elementi con glyph rimandati vengono ricalcolati nel frame successivo, quando le pagine di questo frame possono essere svuotate
+		for (size_t i = 0; i < this->elements.size(); i++)
+			if (this->elements[i].deferred)
+				this->elements[i].dirty = true;
+
+		if (this->changed) {
+			this->batch.Begin();
+			for (size_t i = 0; i < this->elements.size(); i++)
+				if (this->elements[i].visible)
+					this->batch.Append(this->elements[i].vertices);
+			this->batch.Upload();
+
+			this->changed = false;
+			this->stats.uploads++;
+		}
+
+		this->batch.Draw(shader, atlas);
+		this->stats.frames++;
+	}
+
+	/*
+	 * Metodo get per il numero di draw call dell'ultimo frame
+	 */
+	int getDrawCalls() const {
+		return this->batch.getDrawCalls();
+	}
+
+	/*
+	 * Metodo get per i contatori dell'HUD
+	 */
+	const HudStats& getStats() const {
+		return this->stats;
+	}
+
+	/*
+	 * Metodo che, nel momento della chiusura dell'applicazione, dealloca il buffer
+	 */
+	void Delete() {
+		this->batch.Delete();
+	}
+
+private:
+	/*
+	 * Metodo che indica se almeno un elemento deve essere ricalcolato
+	 */
+	bool hasDirty() const {
+		for (size_t i = 0; i < this->elements.size(); i++)
+			if (this->elements[i].dirty)
+				return true;
+		return false;
+	}
+
+	/*
+	 * Struttura che rappresenta un elemento di testo ed i suoi vertici, divisi per pagina dell'atlas
+	 */
+	struct Element {
+		string text;
+		glm::vec2 position;
+		GLfloat size;
+		glm::vec3 color;
+		bool visible;
+		bool dirty;
+		// Indica se almeno un glyph del testo non e' entrato nell'atlas
+		bool deferred;
+		vector< vector<TextVertex> > vertices;
+	};
+
+	// Attributo che contiene gli elementi dell'HUD, indicizzati dal valore restituito da AddText
+	vector<Element> elements;
+	// Attributo che contiene il buffer con i vertici di tutti gli elementi visibili
+	TextBatch batch;
+	// Attributo che indica se il buffer va ricaricato
+	bool changed;
+	// Attributo che contiene il numero di pagine svuotate dall'atlas all'ultimo calcolo dei vertici
+	size_t atlasEvictions;
+	// Attributo che contiene i contatori dell'HUD
+	HudStats stats;
+};
+
+#endif
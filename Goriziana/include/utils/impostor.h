@@ -0,0 +1,124 @@
+/*
+Classe SphereImpostor
+- Renderizza le sfere (le biglie) come impostor: ogni istanza e' un quad di 4 vertici rivolto verso la camera, ed il fragment
+  shader calcola l'intersezione del raggio di vista con la sfera analitica, scartando i pixel che la mancano
+- Il fragment shader scrive la profondita' del punto di intersezione e calcola normale e illuminazione Cook-Torrance
+  sul punto esatto della sfera, per cui la silhouette e' precisa a qualsiasi distanza
+- Le istanze usano le stesse InstanceData delle mesh: il centro della sfera e' la traslazione della model matrix ed il raggio
+  e' quello della mesh originale scalato dalla model matrix, per cui culling e raccolta delle istanze non cambiano
+*/
+
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <utils/glstate.h>
+#include <utils/mesh.h>
+
+#include <vector>
+
+using namespace std;
+
+/********** classe SPHEREIMPOSTOR **********/
+class SphereImpostor {
+public:
+	// Costruttore della classe, il quad viene creato con Setup quando il contesto OpenGL e' attivo
+	SphereImpostor() : quad(NULL), instanceVBO(0), instanceCapacity(0) {
+		this->sphere = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	/*
+	 * Metodo che crea il quad condiviso da tutte le istanze, ed imposta la sfera da renderizzare.
+	 * Prende in input i seguenti valori:
+	 * - bounds: Bounds, volumi di contenimento della mesh sostituita dall'impostor, in coordinate del modello
+	 */
+	void Setup(const Bounds &bounds) {
+		this->sphere = glm::vec4(bounds.center, bounds.radius);
+
+		// I vertici del quad sono gli angoli in [-1, 1]: il vertex shader li porta sul piano della sfera rivolto verso la camera
+		const GLfloat corners[4][2] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f } };
+
+		vector<Vertex> vertices(4);
+		for (int i = 0; i < 4; i++) {
+			vertices[i].Position = glm::vec3(corners[i][0], corners[i][1], 0.0f);
+			vertices[i].Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+			vertices[i].TexCoords = glm::vec2(corners[i][0], corners[i][1]) * 0.5f + 0.5f;
+			vertices[i].Tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+			vertices[i].Bitangent = glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+
+		GLuint indices[6] = { 0, 1, 2, 2, 3, 0 };
+
+		// Lo shader legge solo la posizione dell'angolo
+		this->quad = new Mesh(vertices, vector<GLuint>(indices, indices + 6), vector<Texture>(), VERTEX_POSITION);
+		this->quad->bounds = bounds;
+	}
+
+	/*
+	 * Metodo che carica le matrici ed i colori delle istanze nell'instance buffer collegato al quad, come Model::UploadInstances.
+	 * Prende in input i seguenti valori:
+	 * - instances: vector<InstanceData>, matrici e colore di ogni istanza
+	 */
+	void UploadInstances(const vector<InstanceData> &instances) {
+		if (instances.empty())
+			return;
+
+		if (this->instanceVBO == 0) {
+			glGenBuffers(1, &this->instanceVBO);
+			this->quad->setupInstances(this->instanceVBO);
+		}
+
+		gl_state().BindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+
+		if (instances.size() > this->instanceCapacity) {
+			this->instanceCapacity = instances.size();
+			glBufferData(GL_ARRAY_BUFFER, this->instanceCapacity * sizeof(InstanceData), &instances[0], GL_DYNAMIC_DRAW);
+		} else {
+			glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), &instances[0]);
+		}
+	}
+
+	/*
+	 * Metodo get per il quad, da inviare alla coda di rendering con le istanze caricate
+	 */
+	const Mesh& getMesh() const {
+		return *this->quad;
+	}
+
+	/*
+	 * Metodo get per la sfera in coordinate del modello: centro in xyz e raggio in w, da passare allo shader
+	 */
+	const glm::vec4& getSphere() const {
+		return this->sphere;
+	}
+
+	/*
+	 * Metodo che dealloca il quad e l'instance buffer
+	 */
+	void Delete() {
+		if (this->quad != NULL) {
+			this->quad->Delete();
+			delete this->quad;
+			this->quad = NULL;
+		}
+
+		if (this->instanceVBO != 0)
+			gl_state().DeleteBuffers(1, &this->instanceVBO);
+		this->instanceVBO = 0;
+		this->instanceCapacity = 0;
+	}
+
+private:
+	// Attributo che contiene il quad renderizzato per ogni istanza
+	Mesh *quad;
+	// Attributo che contiene la sfera in coordinate del modello: centro e raggio
+	glm::vec4 sphere;
+	// Attributi che rappresentano l'instance buffer e il numero di istanze che puo' contenere
+	GLuint instanceVBO;
+	size_t instanceCapacity;
+};
+
+#endif
@@ -0,0 +1,189 @@
+/*
+Classe LodSelector
+- Ogni mesh puo' avere piu' livelli di dettaglio (LOD), generati offline con l'opzione --build-lod e salvati accanto al modello
+  nel file <modello>.lod: tutti i livelli condividono i vertici della mesh e differiscono solo per gli indici
+- Ogni livello conserva l'errore geometrico della semplificazione, in unita' del modello: a runtime l'errore viene proiettato
+  sullo schermo in base alla distanza dalla camera, e viene scelto il livello meno dettagliato il cui errore proiettato
+  resta sotto la soglia in pixel
+- La soglia si puo' modificare durante l'esecuzione; vengono contati i triangoli renderizzati, quelli che si sarebbero
+  renderizzati al massimo dettaglio, ed i cambi di livello
+*/
+
+#ifndef LOD_H
+#define LOD_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <assimp/postprocess.h>
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+// Opzioni di importazione dei modelli: devono essere le stesse per il gioco e per la generazione dei LOD,
+// perche' i livelli salvati si riferiscono ai vertici cosi' come vengono importati
+#define MODEL_IMPORT_FLAGS (aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace)
+
+// Intestazione e versione del file dei LOD
+#define LOD_FILE_MAGIC "GLOD"
+#define LOD_FILE_VERSION 1
+// Numero massimo di livelli per mesh, compreso il livello 0 a dettaglio pieno
+#define LOD_MAX_LEVELS 4
+// Soglia iniziale dell'errore proiettato, in pixel
+#define LOD_DEFAULT_THRESHOLD 1.0f
+
+/*
+ * Struttura che rappresenta un livello di dettaglio di una mesh: intervallo nell'element buffer ed errore geometrico
+ */
+struct MeshLod {
+	GLuint firstIndex;
+	GLsizei indexCount;
+	GLfloat error;
+};
+
+/*
+ * Struttura che raccoglie i contatori della selezione dei LOD
+ */
+struct LodStats {
+	// Numero di triangoli renderizzati, e di triangoli che si sarebbero renderizzati usando sempre il livello 0
+	size_t triangles;
+	size_t fullTriangles;
+	// Numero di volte in cui e' stato scelto ogni livello
+	size_t selections[LOD_MAX_LEVELS];
+	// Numero di cambi di livello rispetto al frame precedente
+	size_t switches;
+};
+
+/********** classe LODSELECTOR **********/
+class LodSelector {
+public:
+	// Costruttore della classe
+	LodSelector() : threshold(LOD_DEFAULT_THRESHOLD), pixelsPerUnit(1.0f), frames(0) {
+		this->clearStats(this->frame);
+		this->clearStats(this->lastFrame);
+		this->clearStats(this->totals);
+	}
+
+	/*
+	 * Metodo che imposta la proiezione prospettica della camera, da cui dipende la dimensione sullo schermo dell'errore.
+	 * Prende in input i seguenti valori:
+	 * - projection: mat4, projection matrix: l'elemento [1][1] vale 1 / tan(fovY / 2)
+	 * - screenHeight: GLfloat, altezza della finestra in pixel
+	 */
+	void setProjection(const glm::mat4 &projection, GLfloat screenHeight) {
+		this->pixelsPerUnit = projection[1][1] * screenHeight * 0.5f;
+	}
+
+	/*
+	 * Metodo che inizia un nuovo frame, con la posizione corrente della camera
+	 */
+	void Begin(const glm::vec3 &cameraPosition) {
+		this->camera = cameraPosition;
+	}
+
+	/*
+	 * Metodo che restituisce la distanza dalla camera del punto piu' vicino di una sfera in coordinate mondo
+	 */
+	GLfloat Distance(const glm::vec3 &center, GLfloat radius) const {
+		return glm::length(center - this->camera) - radius;
+	}
+
+	/*
+	 * Metodo che sceglie il livello di una mesh: il meno dettagliato il cui errore proiettato non supera la soglia.
+	 * Prende in input i seguenti valori:
+	 * - lods: vector<MeshLod>, livelli della mesh, dal piu' dettagliato
+	 * - distance: GLfloat, distanza della mesh dalla camera (vedi Distance); se la camera e' dentro la sfera si usa il livello 0
+	 * - scale: GLfloat, fattore di scala della model matrix, con cui l'errore passa da unita' del modello ad unita' del mondo
+	 * - current: int&, livello scelto nel frame precedente, aggiornato con quello scelto ora
+	 * - instances: GLsizei, numero di istanze renderizzate con il livello scelto, per i contatori dei triangoli
+	 */
+	int Select(const vector<MeshLod> &lods, GLfloat distance, GLfloat scale, int &current, GLsizei instances) {
+		int level = 0;
+		if (distance > 0.0f)
+			while (level + 1 < (int) lods.size() && lods[level + 1].error * scale * this->pixelsPerUnit / distance <= this->threshold)
+				level++;
+
+		if (level != current) {
+			this->frame.switches++;
+			current = level;
+		}
+
+		this->frame.selections[level]++;
+		this->frame.triangles += (size_t) (lods[level].indexCount / 3) * instances;
+		this->frame.fullTriangles += (size_t) (lods[0].indexCount / 3) * instances;
+
+		return level;
+	}
+
+	/*
+	 * Metodo che chiude il frame: i contatori vengono salvati, e letti con getLastFrame, e sommati ai totali stampati all'uscita
+	 */
+	void EndFrame() {
+		this->totals.triangles += this->frame.triangles;
+		this->totals.fullTriangles += this->frame.fullTriangles;
+		for (int l = 0; l < LOD_MAX_LEVELS; l++)
+			this->totals.selections[l] += this->frame.selections[l];
+		this->totals.switches += this->frame.switches;
+
+		this->lastFrame = this->frame;
+		this->clearStats(this->frame);
+		this->frames++;
+	}
+
+	/*
+	 * Metodi get e set per la soglia dell'errore proiettato, in pixel: ogni modifica viene stampata
+	 */
+	GLfloat getThreshold() const {
+		return this->threshold;
+	}
+
+	void setThreshold(GLfloat threshold) {
+		this->threshold = threshold > 0.0f ? threshold : 0.0f;
+		cout << "LOD: soglia dell'errore proiettato impostata a " << this->threshold << " px" << endl;
+	}
+
+	/*
+	 * Metodo get per i contatori dell'ultimo frame
+	 */
+	const LodStats& getLastFrame() const {
+		return this->lastFrame;
+	}
+
+	/*
+	 * Metodo get per i contatori sommati su tutti i frame, e per il numero di frame
+	 */
+	const LodStats& getTotals() const {
+		return this->totals;
+	}
+
+	size_t getFrames() const {
+		return this->frames;
+	}
+
+private:
+	// Attributo che contiene la soglia dell'errore proiettato, in pixel
+	GLfloat threshold;
+	// Attributo che contiene il numero di pixel occupati da un'unita' del mondo a distanza 1 dalla camera
+	GLfloat pixelsPerUnit;
+	// Attributo che contiene la posizione della camera nel frame corrente
+	glm::vec3 camera;
+	// Attributi che contengono i contatori del frame corrente, dell'ultimo frame e totali
+	LodStats frame;
+	LodStats lastFrame;
+	LodStats totals;
+	size_t frames;
+
+	void clearStats(LodStats &stats) {
+		stats.triangles = 0;
+		stats.fullTriangles = 0;
+		for (int l = 0; l < LOD_MAX_LEVELS; l++)
+			stats.selections[l] = 0;
+		stats.switches = 0;
+	}
+};
+
+#endif
@@ -1,7 +1,11 @@
 /*
 Classe Mesh
 - Alloca e inizializza i buffer (VBO, VAO, EBO), e imposta come OpenGL deve interpretare i dati nei buffer 
-- Carica ed applica le texture
+- Carica ed applica le texture, tramite un record di binding (texture unit, texture e sampler) preparato una sola volta
+- Renderizza piu' istanze della stessa mesh con una sola draw call, leggendo matrici e colore di ogni istanza da un instance buffer
+- Carica i vertici nel vertex buffer in un formato compresso, scelto per la mesh e descritto da un VertexLayout
+- Carica gli indici nell'element buffer a 16 bit se la mesh ha meno di 65536 vertici, altrimenti a 32 bit
+- Una mesh puo' anche non possedere buffer propri, ed usare quelli condivisi di una GeometryPool a partire da un base vertex
 */
 
 #ifndef MESH_H
@@ -13,6 +17,9 @@ Classe Mesh
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <utils/shader.h>
+#include <utils/glstate.h>
+#include <utils/lod.h>
+#include <utils/vertexformat.h>
 
 #include <string>
 #include <fstream>
@@ -37,6 +44,34 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+/*
+ * Variabile globale che rappresenta la struttura dati per i dati di una singola istanza
+ */
+struct InstanceData {
+    glm::mat4 modelMatrix;
+
+    glm::mat3 normalMatrix;
+
+    glm::vec3 color;
+};
+
+/*
+ * Variabile globale che rappresenta i volumi di contenimento di una mesh o di un modello, in coordinate del modello:
+ * AABB (min, max) e sfera (center, radius)
+ */
+struct Bounds {
+    glm::vec3 min;
+
+    glm::vec3 max;
+
+    glm::vec3 center;
+
+    GLfloat radius;
+};
+
+// Location del primo attributo di istanza: la model matrix occupa 4 location, la normal matrix 3 ed il colore 1
+#define INSTANCE_ATTRIBUTE_LOCATION 5
+
 /*
  * Variabile globale che rappresenta la struttura dati per le textures
  */
@@ -44,6 +79,17 @@ struct Texture {
     GLuint id;
     string type;
     string path;
+    // Nome del sampler nello shader, secondo la convenzione "material.texture_diffuseN"
+    string sampler;
+};
+
+/*
+ * Variabile globale che rappresenta il binding di una texture del materiale: texture unit, texture e sampler dello shader
+ */
+struct MaterialBinding {
+    GLuint unit;
+    GLuint texture;
+    Uniform<int> sampler;
 };
 
 /********** classe MESH **********/
@@ -55,117 +101,338 @@ public:
     vector<GLuint> indices;
     // Attributo che memorizza le texture da assegnare alle facce
     vector<Texture> textures;
+    // Attributo che memorizza il binding delle texture, una per texture unit
+    vector<MaterialBinding> material;
+    // Attributo che memorizza i volumi di contenimento della mesh, calcolati da Model::processMesh
+    Bounds bounds;
+    // Attributo che memorizza i livelli di dettaglio della mesh, dal livello 0 che contiene tutti gli indici
+    vector<MeshLod> lods;
+    // Attributo che memorizza gli indici dei livelli successivi al primo, letti da GeometryPool per unire le mesh
+    vector< vector<GLuint> > lodIndices;
+    // Attributo che memorizza il livello scelto da LodSelector nell'ultimo frame
+    int lodLevel;
+    // Attributo che memorizza il formato dei vertici nel vertex buffer
+    VertexLayout layout;
+    // Attributo che memorizza il tipo degli indici nell'element buffer (GL_UNSIGNED_SHORT o GL_UNSIGNED_INT)
+    GLenum indexType;
+    // Attributo che memorizza la posizione del primo vertice della mesh nel vertex buffer, aggiunta ad ogni indice
+    GLint baseVertex;
     
 	// Attributo che memorizza il Vertex Attribut Object, utilizzato per renderizzare la mesh
 	GLuint VAO;
 
     /*
      * Costruttore
-     * Prende in input i vertici, gli indici dei vertici e le texture in modo da renderizzare la mesh.
+     * Prende in input i vertici, gli indici dei vertici e le texture in modo da renderizzare la mesh, e le componenti
+     * dei vertici (VertexComponents) da caricare nel vertex buffer oltre alla posizione.
      * Chiama il metodo setupMesh per settare i parametri iniziali (VAO, VBO ed EBO).
      */
-    Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures) { // @suppress("Class members should be properly initialized")
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+    Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures, int components = VERTEX_ALL) { // @suppress("Class members should be properly initialized")
+        this->initialize(vertices, indices, textures);
 
-        this->setupMesh();
+        this->indexType = this->vertices.size() < 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        this->baseVertex = 0;
+
+        this->setupMesh(components);
     }
 
     /*
-     * Metodo utilizzato per renderizzare effettivamente la mesh mediante lo shader in input.
+     * Costruttore di una mesh della GeometryPool: vertici ed indici sono gia' caricati nei buffer condivisi della pool,
+     * per cui la mesh non crea buffer propri. La pool ne imposta poi i livelli di dettaglio nel proprio element buffer.
      * Prende in input i seguenti valori:
-     * - shader: Shader, rappresenta lo shader compilato con tutte le informazioni per la corretta renderizzazione.
-     */
-    void Draw(Shader shader) {
-        GLuint diffuseNr  = 1;
-        GLuint specularNr = 1;
-        GLuint normalNr   = 1;
-        GLuint heightNr   = 1;
-        
-		for(GLuint i = 0; i < this->textures.size(); i++) {
-            // Attiva la texture unit adatta
-			glActiveTexture(GL_TEXTURE0 + i);
-            // Recupera il numero della texture, partendo dalla convenzione "texture_diffuseN"
-            stringstream ss;
-			string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-				ss << diffuseNr++;
-			else if(name == "texture_specular")
-					ss << specularNr++;
-				 else if(name == "texture_normal")
-						 ss << normalNr++;
-					  else if(name == "texture_height")
-							  ss << heightNr++;
-
-            shader.setFloat(("material." + name + number).c_str(), i);
-
-            glBindTexture(GL_TEXTURE_2D, this->textures[i].id);
+     * - vertices, indices, textures: come per il costruttore principale
+     * - layout: VertexLayout, formato dei vertici nel vertex buffer condiviso
+     * - indexType: GLenum, tipo degli indici nell'element buffer condiviso
+     * - VAO: GLuint, VAO della pool che collega i buffer condivisi
+     * - baseVertex: GLint, posizione del primo vertice della mesh nel vertex buffer condiviso
+     */
+    Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures, const VertexLayout &layout, GLenum indexType, GLuint VAO, GLint baseVertex) {
+        this->initialize(vertices, indices, textures);
+
+        this->layout = layout;
+        this->indexType = indexType;
+        this->baseVertex = baseVertex;
+        this->VAO = VAO;
+        this->VBO = 0;
+        this->EBO = 0;
+    }
+
+    /*
+     * Metodo che aggiunge i livelli di dettaglio semplificati: i loro indici vengono accodati a quelli del livello 0
+     * nell'element buffer, in modo che ogni livello sia un intervallo dello stesso buffer.
+     * Prende in input i seguenti valori:
+     * - levels: vector<vector<GLuint>>, indici dei livelli successivi al primo, dal piu' dettagliato
+     * - errors: vector<GLfloat>, errore geometrico di ogni livello, in unita' del modello
+     */
+    void SetLods(const vector< vector<GLuint> > &levels, const vector<GLfloat> &errors) {
+        this->lods.resize(1);
+
+        vector<GLuint> all(this->indices);
+        for (size_t l = 0; l < levels.size() && this->lods.size() < LOD_MAX_LEVELS; l++) {
+            MeshLod lod;
+            lod.firstIndex = (GLuint) all.size();
+            lod.indexCount = (GLsizei) levels[l].size();
+            lod.error = errors[l];
+
+            all.insert(all.end(), levels[l].begin(), levels[l].end());
+            this->lods.push_back(lod);
         }
-        
-        // Rende attivo il VAO
-        glBindVertexArray(VAO);
+        this->lodIndices.assign(levels.begin(), levels.begin() + (this->lods.size() - 1));
+
+        // L'element buffer fa parte dello stato del VAO, per cui va collegato con il VAO della mesh attivo
+        gl_state().BindVertexArray(this->VAO);
+        this->uploadIndices(all);
+        gl_state().BindVertexArray(0);
+    }
+
+    /*
+     * Metodo che risolve i sampler del materiale nello shader indicato e vi assegna le texture unit.
+     * I sampler fanno parte dello stato del program shader, quindi vengono impostati una sola volta e non ad ogni draw.
+     * I sampler che lo shader non utilizza vengono ignorati.
+     * Prende in input i seguenti valori:
+     * - shader: Shader, shader con cui verra' renderizzata la mesh
+     */
+    void bindMaterial(Shader &shader) {
+        shader.Use();
+
+        for (GLuint i = 0; i < this->material.size(); i++) {
+            MaterialBinding &binding = this->material[i];
+
+            if (!shader.hasUniform(this->textures[i].sampler))
+                continue;
+
+            binding.sampler = shader.getUniform<int>(this->textures[i].sampler);
+            shader.set(binding.sampler, binding.unit);
+        }
+    }
+
+    /*
+     * Metodo utilizzato per renderizzare effettivamente la mesh, con lo shader attivo.
+     */
+    void Draw() {
+        this->bindTextures();
+
+        // Rende attivo il VAO, che resta collegato: la cache dello stato scarta il binding se la draw successiva usa lo stesso VAO
+        gl_state().BindVertexArray(VAO);
 		// Renderizza i dati presenti nel VAO appena collegato
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-		// Scollega il VAO
-        glBindVertexArray(0);
+        glDrawElementsBaseVertex(GL_TRIANGLES, indices.size(), this->indexType, (GLvoid*)(size_t) (this->lods[0].firstIndex * this->indexSize()), this->baseVertex);
+    }
 
-        for (GLuint i = 0; i < this->textures.size(); i++) {
-            glActiveTexture(GL_TEXTURE0 + i);
-            glBindTexture(GL_TEXTURE_2D, 0);
+    /*
+     * Metodo che renderizza piu' istanze della mesh con una sola draw call.
+     * Le matrici ed il colore di ogni istanza vengono letti dall'instance buffer collegato con setupInstances.
+     * Lo shader attivo deve leggere gli attributi di istanza a partire dalla location INSTANCE_ATTRIBUTE_LOCATION.
+     * Prende in input i seguenti valori:
+     * - count: GLsizei, numero di istanze da renderizzare
+     */
+    void DrawInstanced(GLsizei count) {
+        this->bindTextures();
+
+        gl_state().BindVertexArray(VAO);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indices.size(), this->indexType, (GLvoid*)(size_t) (this->lods[0].firstIndex * this->indexSize()), count, this->baseVertex);
+    }
+
+    /*
+     * Metodo che collega al VAO della mesh gli attributi di istanza, letti dal buffer indicato con un passo di una InstanceData per istanza.
+     * Prende in input i seguenti valori:
+     * - instanceVBO: GLuint, buffer contenente un vettore di InstanceData
+     */
+    void setupInstances(GLuint instanceVBO) {
+        gl_state().BindVertexArray(VAO);
+        SetupInstanceAttributes(instanceVBO);
+        gl_state().BindVertexArray(0);
+    }
+
+    /*
+     * Metodo che imposta nel VAO attivo gli attributi di istanza, letti dal buffer indicato: usato anche da GeometryPool per il proprio VAO.
+     * Prende in input i seguenti valori:
+     * - instanceVBO: GLuint, buffer contenente un vettore di InstanceData
+     */
+    static void SetupInstanceAttributes(GLuint instanceVBO) {
+        gl_state().BindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+        // Model matrix, una colonna per location
+        for (GLuint i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION + i);
+            glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (GLvoid*)(offsetof(InstanceData, modelMatrix) + i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(INSTANCE_ATTRIBUTE_LOCATION + i, 1);
+        }
+        // Normal matrix, una colonna per location
+        for (GLuint i = 0; i < 3; i++) {
+            glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION + 4 + i);
+            glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION + 4 + i, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (GLvoid*)(offsetof(InstanceData, normalMatrix) + i * sizeof(glm::vec3)));
+            glVertexAttribDivisor(INSTANCE_ATTRIBUTE_LOCATION + 4 + i, 1);
+        }
+        // Colore
+        glEnableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION + 7);
+        glVertexAttribPointer(INSTANCE_ATTRIBUTE_LOCATION + 7, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (GLvoid*)offsetof(InstanceData, color));
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE_LOCATION + 7, 1);
+
+        gl_state().BindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    /*
+     * Metodo che imposta nel VAO attivo i puntatori agli attributi descritti dal formato indicato (posizione, normale, coordinate
+     * texture, tangente), letti dal vertex buffer collegato a GL_ARRAY_BUFFER: gli attributi assenti restano disattivati,
+     * e lo shader ne legge il valore costante
+     */
+    static void SetupVertexAttributes(const VertexLayout &layout) {
+        for (size_t i = 0; i < layout.attributes.size(); i++) {
+            const VertexAttributeFormat &attribute = layout.attributes[i];
+
+            glEnableVertexAttribArray(attribute.location);
+            glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, layout.stride, (GLvoid*)(size_t) attribute.offset);
+        }
+    }
+
+    /*
+     * Metodo che sceglie il formato dei vertici indicati e li scrive compressi nel buffer indicato.
+     * La bitangente non viene scritta: il suo verso rispetto a normale e tangente e' il segno nella componente w della tangente.
+     * Prende in input i seguenti valori:
+     * - vertices: vector<Vertex>, vertici da comprimere
+     * - components: int, componenti dei vertici da scrivere oltre alla posizione (VertexComponents)
+     * - layout: VertexLayout, formato scelto
+     * - packed: vector<unsigned char>, vertici compressi
+     */
+    static void PackVertices(const vector<Vertex> &vertices, int components, VertexLayout &layout, vector<unsigned char> &packed) {
+        const Vertex *first = vertices.empty() ? NULL : &vertices[0];
+        layout.Choose(first ? &first->Position : NULL, first ? &first->TexCoords : NULL, sizeof(Vertex), vertices.size(), components);
+
+        packed.assign(vertices.size() * layout.stride, 0);
+
+        for (size_t v = 0; v < vertices.size(); v++) {
+            const Vertex &vertex = vertices[v];
+            unsigned char *data = &packed[v * layout.stride];
+
+            for (size_t i = 0; i < layout.attributes.size(); i++) {
+                const VertexAttributeFormat &attribute = layout.attributes[i];
+                glm::vec4 value(0.0f);
+
+                if (attribute.location == 0) {
+                    value = glm::vec4(vertex.Position, 1.0f);
+                } else if (attribute.location == 1) {
+                    value = glm::vec4(vertex.Normal, 0.0f);
+                } else if (attribute.location == 2) {
+                    value = glm::vec4(vertex.TexCoords.x, vertex.TexCoords.y, 0.0f, 0.0f);
+                } else if (attribute.location == 3) {
+                    GLfloat handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+                    value = glm::vec4(vertex.Tangent, handedness);
+                }
+
+                VertexLayout::Write(data, attribute, value);
+            }
         }
     }
 	
+    /*
+     * Metodo che restituisce la dimensione dei vertici nel vertex buffer, e quella che avrebbero con la struttura Vertex
+     */
+    size_t vertexBytes() const {
+        return this->vertices.size() * this->layout.stride;
+    }
+
+    size_t uncompressedVertexBytes() const {
+        return this->vertices.size() * sizeof(Vertex);
+    }
+
+    /*
+     * Metodo che restituisce la dimensione di un indice nell'element buffer, in byte
+     */
+    GLsizei indexSize() const {
+        return this->indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+    }
+
 	/*
 	 * Metodo che, nel momento della chiusura dell'applicazione, dealloca i buffer utilizzati.
+	 * Le mesh della GeometryPool non possiedono buffer, e le mesh gia' deallocate non fanno nulla.
 	 */
     void Delete(){
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
-        glDeleteBuffers(1, &EBO);
+        if (this->VBO == 0)
+            return;
+
+        gl_state().DeleteVertexArrays(1, &VAO);
+        gl_state().DeleteBuffers(1, &VBO);
+        gl_state().DeleteBuffers(1, &EBO);
+        this->VAO = this->VBO = this->EBO = 0;
     }
 
 private:
     // Attributi che rappresentano il Vertex Buffer Object e Element Buffer Object
     GLuint VBO, EBO;
 
+    /*
+     * Metodo che collega le texture del materiale alle rispettive texture unit.
+     * Le texture non vengono scollegate dopo il draw: la mesh successiva sovrascrive i binding che le servono.
+     */
+    void bindTextures() {
+        for (GLuint i = 0; i < this->material.size(); i++) {
+            gl_state().ActiveTexture(GL_TEXTURE0 + this->material[i].unit);
+            gl_state().BindTexture(GL_TEXTURE_2D, this->material[i].texture);
+        }
+    }
+
+    /*
+     * Metodo che memorizza i dati della mesh, prepara il binding delle texture ed il livello di dettaglio 0
+     */
+    void initialize(const vector<Vertex> &vertices, const vector<GLuint> &indices, const vector<Texture> &textures) {
+        this->vertices = vertices;
+        this->indices = indices;
+        this->textures = textures;
+
+        // Ogni texture occupa la texture unit corrispondente alla sua posizione; i sampler vengono risolti da bindMaterial
+        this->material.resize(this->textures.size());
+        for (GLuint i = 0; i < this->textures.size(); i++) {
+            this->material[i].unit = i;
+            this->material[i].texture = this->textures[i].id;
+        }
+
+        // Senza LOD generati offline la mesh ha un solo livello, a dettaglio pieno
+        MeshLod full;
+        full.firstIndex = 0;
+        full.indexCount = (GLsizei) this->indices.size();
+        full.error = 0.0f;
+        this->lods.assign(1, full);
+        this->lodLevel = 0;
+    }
+
     /*
      * Metodo utilizzato per inizializzare VAO, VBO e EBO
      */
-    void setupMesh(){
+    void setupMesh(int components){
         // Crea i buffer
         glGenVertexArrays(1, &this->VAO);
         glGenBuffers(1, &this->VBO);
         glGenBuffers(1, &this->EBO);
 		
 		// Rende attivo il VAO
-        glBindVertexArray(VAO);
-        // Carica i dati nel VBO - devo indicare la dimensione dei dati, e il puntatore alla struttura dati che li contiene
-        glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-        glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), &this->vertices[0], GL_STATIC_DRAW);  
-		// Carica i dati nell' EBO - devo indicare la dimensione dei dati, e il puntatore alla struttura dati che li contiene
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), &this->indices[0], GL_STATIC_DRAW);
-
-        // Setto nel VAO i puntatori ai vari attributi del vertice (con relativi offset all'interno della struttura dati)
-        // Posizioni dei vertici
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
-        // Normali
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Normal));
-        // Coordinate texture
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
-        // Tangenti
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Tangent));
-        // Bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        gl_state().BindVertexArray(VAO);
+        // Carica i dati nel VBO, compressi nel formato scelto per la mesh
+        vector<unsigned char> packed;
+        PackVertices(this->vertices, components, this->layout, packed);
+        gl_state().BindBuffer(GL_ARRAY_BUFFER, this->VBO);
+        glBufferData(GL_ARRAY_BUFFER, packed.size(), &packed[0], GL_STATIC_DRAW);
+		// Carica i dati nell' EBO, nel tipo di indice scelto per la mesh
+        this->uploadIndices(this->indices);
+
+        // Setto nel VAO i puntatori agli attributi descritti dal formato della mesh
+        SetupVertexAttributes(this->layout);
+
+        gl_state().BindVertexArray(0);
+    }
+
+    /*
+     * Metodo che carica gli indici indicati nell'element buffer, convertiti a 16 bit se la mesh usa GL_UNSIGNED_SHORT.
+     * Il VAO della mesh deve essere attivo.
+     */
+    void uploadIndices(const vector<GLuint> &all) {
+        gl_state().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+
+        if (this->indexType == GL_UNSIGNED_SHORT) {
+            vector<GLushort> shorts(all.begin(), all.end());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shorts.size() * sizeof(GLushort), shorts.empty() ? NULL : &shorts[0], GL_STATIC_DRAW);
+        } else {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, all.size() * sizeof(GLuint), all.empty() ? NULL : &all[0], GL_STATIC_DRAW);
+        }
     }
 };
 #endif
@@ -3,6 +3,11 @@ Classe Model
 - Implementazione classe per caricamento modello OBJ tramite libreria Assimp
 - Crea le strutture dati per la creazione e inizializzazione degli VBO, VAO e EBO
 - Carica ed applica le texture eventualmente definite nel modello, come esportate dal SW di modellazione
+- Renderizza piu' istanze del modello con una draw call per mesh, indipendentemente dal numero di istanze
+- Se accanto al modello e' presente il file <modello>.lod, generato con --build-lod, carica i livelli di dettaglio delle mesh
+- Dopo il caricamento stampa la memoria occupata dai vertici compressi, rispetto a quella della struttura Vertex
+- All'importazione riordina triangoli e vertici delle mesh per la cache dei vertici, l'overdraw ed il fetch (VertexCache),
+  e stampa l'ACMR del modello prima e dopo l'ottimizzazione
 */
 
 #ifndef MODEL_H
@@ -22,8 +27,13 @@ Classe Model
 
 #include <utils/mesh.h>
 #include <utils/shader.h>
+#include <utils/glstate.h>
+#include <utils/lod.h>
+#include <utils/vertexcache.h>
 
 #include <string>
+#include <cstring>
+#include <cstdint>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -44,6 +54,8 @@ public:
     string directory;
     // Attributo booleano per l'attivazione della gammaCorrection
     bool gammaCorrection;
+    // Attributo che contiene i volumi di contenimento dell'intero modello, che racchiudono quelli di tutte le mesh
+    Bounds bounds;
 
     /*
      * Costruttore
@@ -51,18 +63,80 @@ public:
      * - path: string, contiene il path del modello da caricare
      * - gamma: bool, utilizzato per attivare/disattivare la gammaCorrection
      */
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma) {
+    Model(string const &path, bool gamma = false) : gammaCorrection(gamma), instanceVBO(0), instanceCapacity(0), cacheTriangles(0), cacheMissesBefore(0), cacheMissesAfter(0) {
         this->loadModel(path);
+        this->computeBounds();
+        this->loadLods(path + ".lod");
+        this->reportVertexMemory(path);
+        this->reportVertexCache(path);
+
+        // Le tabelle di rinumerazione servono solo a leggere il file dei LOD
+        this->vertexRemaps.clear();
+    }
+
+    /*
+     * Metodo che prepara il binding dei materiali di tutte le mesh per lo shader con cui verra' renderizzato il modello.
+     * Va chiamato una sola volta dopo il caricamento.
+     * Prende in input i seguenti valori:
+     * - shader: Shader, shader con cui verra' renderizzato il modello
+     */
+    void BindMaterials(Shader &shader){
+        for(GLuint i = 0; i < this->meshes.size(); i++)
+            this->meshes[i].bindMaterial(shader);
+    }
+
+    /*
+     * Metodo che renderizza il modello, con lo shader attivo, chiamando il metodo di rendering delle istanze della classe Mesh
+     */
+    void Draw(){
+        for(GLuint i = 0; i < this->meshes.size(); i++)
+            this->meshes[i].Draw();
     }
 
     /*
-     * Metodo che renderizza il modello chiamando il metodo di rendering delle istanze della classe Mesh
+     * Metodo che renderizza piu' istanze del modello: carica le matrici ed i colori di tutte le istanze nell'instance buffer
+     * ed esegue una sola draw call per ogni mesh.
+     * Lo shader attivo deve leggere gli attributi di istanza a partire dalla location INSTANCE_ATTRIBUTE_LOCATION.
      * Prende in input i seguenti valori:
-     * - shader: Shader, rappresenta lo shader compilato con tutte le informazioni per la corretta renderizzazione.
+     * - instances: vector<InstanceData>, matrici e colore di ogni istanza
      */
-    void Draw(Shader shader){
+    void DrawInstanced(const vector<InstanceData> &instances){
+        if (instances.empty())
+            return;
+
+        this->UploadInstances(instances);
+
         for(GLuint i = 0; i < this->meshes.size(); i++)
-            this->meshes[i].Draw(shader);
+            this->meshes[i].DrawInstanced((GLsizei) instances.size());
+    }
+
+    /*
+     * Metodo che carica le matrici ed i colori delle istanze nell'instance buffer, senza renderizzare il modello.
+     * Le mesh possono poi essere renderizzate con Mesh::DrawInstanced, o da una RenderQueue, fino al caricamento successivo.
+     * Prende in input i seguenti valori:
+     * - instances: vector<InstanceData>, matrici e colore di ogni istanza
+     */
+    void UploadInstances(const vector<InstanceData> &instances){
+        if (instances.empty())
+            return;
+
+        // Alla prima chiamata creo l'instance buffer e lo collego ai VAO di tutte le mesh
+        if (this->instanceVBO == 0) {
+            glGenBuffers(1, &this->instanceVBO);
+
+            for(GLuint i = 0; i < this->meshes.size(); i++)
+                this->meshes[i].setupInstances(this->instanceVBO);
+        }
+
+        gl_state().BindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+
+        // Rialloco il buffer solo se le istanze non ci stanno piu', altrimenti ne aggiorno il contenuto
+        if (instances.size() > this->instanceCapacity) {
+            this->instanceCapacity = instances.size();
+            glBufferData(GL_ARRAY_BUFFER, this->instanceCapacity * sizeof(InstanceData), &instances[0], GL_DYNAMIC_DRAW);
+        } else {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), &instances[0]);
+        }
     }
 	
 	/*
@@ -72,9 +146,21 @@ public:
     virtual ~Model(){
         for(GLuint i = 0; i < this->meshes.size(); i++)
             this->meshes[i].Delete();
+
+        if (this->instanceVBO != 0)
+            gl_state().DeleteBuffers(1, &this->instanceVBO);
     }
     
 private:
+    // Attributi che rappresentano l'instance buffer e il numero di istanze che puo' contenere
+    GLuint instanceVBO;
+    size_t instanceCapacity;
+    // Attributo che contiene, per ogni mesh, la nuova posizione dei vertici di Assimp dopo l'ottimizzazione (vuoto se non riordinati)
+    vector< vector<GLuint> > vertexRemaps;
+    // Attributi che contengono il numero di triangoli e di vertici trasformati prima e dopo l'ottimizzazione, per l'ACMR
+    size_t cacheTriangles;
+    size_t cacheMissesBefore;
+    size_t cacheMissesAfter;
 
     /*
      * Metodo che carica il modello usando la libreria Assimp, e processa i nodi per ottenere un vector di istanze di Mesh
@@ -84,7 +170,7 @@ private:
     void loadModel(string const &path){
         // Legge il file utilizzando la classe Importer della libreria
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
 		
         // Controlla eventuali errori
         if(!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || !scene->mRootNode){
@@ -99,6 +185,154 @@ private:
         this->processNode(scene->mRootNode, scene);
     }
 
+    /*
+     * Metodo che stampa la memoria occupata dai vertici del modello nei vertex buffer compressi, e quella che occuperebbero
+     * con la struttura Vertex non compressa.
+     * Prende in input i seguenti valori:
+     * - path: string, path del modello
+     */
+    void reportVertexMemory(string const &path){
+        size_t vertices = 0, bytes = 0, uncompressed = 0;
+        for(GLuint i = 0; i < this->meshes.size(); i++){
+            vertices += this->meshes[i].vertices.size();
+            bytes += this->meshes[i].vertexBytes();
+            uncompressed += this->meshes[i].uncompressedVertexBytes();
+        }
+
+        if (vertices == 0)
+            return;
+
+        cout << "Vertici di " << path << ": " << vertices << " in " << bytes / 1024.0 << " KB (" << (double) bytes / vertices << " byte per vertice) contro "
+             << uncompressed / 1024.0 << " KB non compressi, " << 100.0 * bytes / uncompressed << "%" << endl;
+    }
+
+    /*
+     * Metodo che stampa l'ACMR del modello prima e dopo l'ottimizzazione, e la memoria occupata dagli indici del livello 0.
+     * Prende in input i seguenti valori:
+     * - path: string, path del modello
+     */
+    void reportVertexCache(string const &path){
+        size_t bytes = 0, shortMeshes = 0;
+        for(GLuint i = 0; i < this->meshes.size(); i++){
+            bytes += this->meshes[i].indices.size() * this->meshes[i].indexSize();
+            if (this->meshes[i].indexType == GL_UNSIGNED_SHORT)
+                shortMeshes++;
+        }
+
+        if (this->cacheTriangles == 0)
+            return;
+
+        cout << "ACMR di " << path << ": " << (double) this->cacheMissesBefore / this->cacheTriangles << " -> " << (double) this->cacheMissesAfter / this->cacheTriangles
+             << " (cache FIFO di " << VERTEX_CACHE_FIFO_SIZE << " vertici), indici in " << bytes / 1024.0 << " KB, a 16 bit in " << shortMeshes << " mesh su " << this->meshes.size() << endl;
+    }
+
+    /*
+     * Metodo che carica i livelli di dettaglio generati offline, se il file esiste.
+     * Il file contiene le mesh nello stesso ordine di processNode; se non corrisponde al modello (numero di mesh o di vertici
+     * diversi, ad esempio perche' il modello e' stato modificato) viene ignorato ed il modello resta a dettaglio pieno.
+     * Gli indici del file si riferiscono ai vertici nell'ordine di Assimp: vengono rinumerati come i vertici delle mesh,
+     * ed i triangoli di ogni livello vengono riordinati per la cache dei vertici.
+     * Prende in input i seguenti valori:
+     * - path: string, path del file dei LOD
+     */
+    void loadLods(const string &path){
+        ifstream file(path.c_str(), ios::binary);
+        if (!file)
+            return;
+
+        char magic[4];
+        uint32_t version = 0, meshCount = 0;
+        file.read(magic, 4);
+        file.read((char*) &version, sizeof(version));
+        file.read((char*) &meshCount, sizeof(meshCount));
+
+        if (!file || memcmp(magic, LOD_FILE_MAGIC, 4) != 0 || version != LOD_FILE_VERSION || meshCount != this->meshes.size()) {
+            cout << "ERROR::LOD::FILE_NOT_VALID: " << path << endl;
+            return;
+        }
+
+        // Leggo tutti i livelli prima di applicarli, cosi' un file troncato non lascia il modello a meta'
+        vector< vector< vector<GLuint> > > levels(meshCount);
+        vector< vector<GLfloat> > errors(meshCount);
+
+        for (uint32_t m = 0; m < meshCount; m++) {
+            uint32_t vertexCount = 0, indexCount = 0, levelCount = 0;
+            file.read((char*) &vertexCount, sizeof(vertexCount));
+            file.read((char*) &indexCount, sizeof(indexCount));
+            file.read((char*) &levelCount, sizeof(levelCount));
+
+            if (!file || vertexCount != this->meshes[m].vertices.size() || indexCount != this->meshes[m].indices.size() || levelCount >= LOD_MAX_LEVELS) {
+                cout << "ERROR::LOD::MESH_MISMATCH: " << path << " (mesh " << m << ")" << endl;
+                return;
+            }
+
+            levels[m].resize(levelCount);
+            errors[m].resize(levelCount);
+            for (uint32_t l = 0; l < levelCount; l++) {
+                uint32_t count = 0;
+                file.read((char*) &errors[m][l], sizeof(GLfloat));
+                file.read((char*) &count, sizeof(count));
+                if (!file || count > indexCount) {
+                    cout << "ERROR::LOD::FILE_NOT_VALID: " << path << endl;
+                    return;
+                }
+
+                levels[m][l].resize(count);
+                if (count > 0)
+                    file.read((char*) &levels[m][l][0], count * sizeof(GLuint));
+
+                for (uint32_t i = 0; i < count; i++)
+                    if (levels[m][l][i] >= vertexCount) {
+                        cout << "ERROR::LOD::FILE_NOT_VALID: " << path << endl;
+                        return;
+                    }
+            }
+        }
+
+        if (!file) {
+            cout << "ERROR::LOD::FILE_NOT_VALID: " << path << endl;
+            return;
+        }
+
+        for (uint32_t m = 0; m < meshCount; m++) {
+            const vector<GLuint> &remap = this->vertexRemaps[m];
+
+            for (size_t l = 0; l < levels[m].size(); l++) {
+                if (!remap.empty())
+                    for (size_t i = 0; i < levels[m][l].size(); i++)
+                        levels[m][l][i] = remap[levels[m][l][i]];
+
+                VertexCache::OptimizeTriangles(levels[m][l], this->meshes[m].vertices.size());
+            }
+
+            this->meshes[m].SetLods(levels[m], errors[m]);
+        }
+    }
+
+    /*
+     * Metodo che calcola i volumi di contenimento del modello a partire da quelli delle mesh:
+     * la sfera e' centrata nell'AABB del modello e racchiude le sfere di tutte le mesh
+     */
+    void computeBounds(){
+        if (this->meshes.empty()) {
+            this->bounds.min = this->bounds.max = this->bounds.center = glm::vec3(0.0f);
+            this->bounds.radius = 0.0f;
+            return;
+        }
+
+        this->bounds.min = this->meshes[0].bounds.min;
+        this->bounds.max = this->meshes[0].bounds.max;
+        for(GLuint i = 1; i < this->meshes.size(); i++){
+            this->bounds.min = glm::min(this->bounds.min, this->meshes[i].bounds.min);
+            this->bounds.max = glm::max(this->bounds.max, this->meshes[i].bounds.max);
+        }
+
+        this->bounds.center = (this->bounds.min + this->bounds.max) * 0.5f;
+        this->bounds.radius = 0.0f;
+        for(GLuint i = 0; i < this->meshes.size(); i++)
+            this->bounds.radius = glm::max(this->bounds.radius, glm::length(this->meshes[i].bounds.center - this->bounds.center) + this->meshes[i].bounds.radius);
+    }
+
     /*
      * Metodo che processa ricorsivamente i nodi della struttura dati di Assimp
      * Prende in input i seguenti valori:
@@ -194,6 +428,26 @@ private:
             for(GLuint j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);
         }
+
+        // Riordina i triangoli per la cache dei vertici e per l'overdraw, poi i vertici nell'ordine in cui vengono usati.
+        // Le mesh con punti o linee restano nell'ordine di Assimp, perche' gli indici non sono tutti triangoli
+        vector<GLuint> remap;
+        if ((mesh->mPrimitiveTypes & ~aiPrimitiveType_TRIANGLE) == 0 && !vertices.empty()) {
+            this->cacheTriangles += indices.size() / 3;
+            this->cacheMissesBefore += VertexCache::CacheMisses(indices, vertices.size());
+
+            VertexCache::OptimizeTriangles(indices, vertices.size());
+            VertexCache::OptimizeOverdraw(indices, &vertices[0].Position, sizeof(Vertex), vertices.size());
+            VertexCache::OptimizeVertexFetch(indices, vertices.size(), remap);
+
+            vector<Vertex> ordered(vertices.size());
+            for(GLuint i = 0; i < vertices.size(); i++)
+                ordered[remap[i]] = vertices[i];
+            vertices.swap(ordered);
+
+            this->cacheMissesAfter += VertexCache::CacheMisses(indices, vertices.size());
+        }
+        this->vertexRemaps.push_back(remap);
 		
         // Processa i materiali definiti nel file del modello
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
@@ -217,8 +471,29 @@ private:
         std::vector<Texture> heightMaps = this->loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
         
+        // Nel vertex buffer vengono caricate solo le componenti che la mesh ha davvero
+        int components = VERTEX_NORMAL;
+        if (mesh->mTextureCoords[0])
+            components |= VERTEX_TEXCOORDS;
+        if (mesh->mTextureCoords[0] && mesh->mTangents)
+            components |= VERTEX_TANGENT;
+
         // Restituisce un'istanza della classe Mesh, avente le liste di vertici e facce appena create
-        return Mesh(vertices, indices, textures);
+        Mesh result(vertices, indices, textures, components);
+
+        // Volumi di contenimento: l'AABB dei vertici, e la sfera centrata nell'AABB con raggio pari al vertice piu' lontano
+        result.bounds.min = result.bounds.max = vertices.empty() ? glm::vec3(0.0f) : vertices[0].Position;
+        for(GLuint i = 1; i < vertices.size(); i++){
+            result.bounds.min = glm::min(result.bounds.min, vertices[i].Position);
+            result.bounds.max = glm::max(result.bounds.max, vertices[i].Position);
+        }
+
+        result.bounds.center = (result.bounds.min + result.bounds.max) * 0.5f;
+        result.bounds.radius = 0.0f;
+        for(GLuint i = 0; i < vertices.size(); i++)
+            result.bounds.radius = glm::max(result.bounds.radius, glm::length(vertices[i].Position - result.bounds.center));
+
+        return result;
     }
 
     /*
@@ -256,6 +531,9 @@ private:
                 textures.push_back(texture);
                 textures_loaded.push_back(texture); 
             }
+
+            // Il sampler dipende dalla posizione della texture nel materiale, e va assegnato anche alle texture gia' caricate
+            textures.back().sampler = "material." + typeName + to_string(i + 1);
         }
         return textures;
     }
@@ -287,7 +565,7 @@ GLuint TextureFromFile(const char *path, const string &directory, bool gamma){
 			 else if (nrComponents == 4)
 					  format = GL_RGBA;
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        gl_state().BindTexture(GL_TEXTURE_2D, textureID);
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
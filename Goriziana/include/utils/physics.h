@@ -2,18 +2,90 @@
 Classe Physics
 - Definisce tutte le variabili necessarie alla creazione del dynamicsWorld
 - Crea un rigidBody, completo di tutto, in base ai parametri passati dall'utente
+- Avanza la simulazione a tick fissi, divisi in substep piu' fitti solo finche' ci sono corpi veloci
+- Il gioco e tutti i mondi clonati (anteprima, replay, dataset) eseguono la stessa sequenza di substep a partire dallo stesso stato
+- Risolve i contatti con un solver che sceglie il numero di iterazioni di ogni isola in base al numero di contatti
 */
 
 #pragma once
 
+#include <cmath>
+
 #include <bullet/btBulletDynamicsCommon.h>
 #include <bullet/btBulletCollisionCommon.h>
 
+#include <utils/solver.h>
+
+// Numero di tick al secondo e durata fissa di un tick, uguali per il mondo di gioco e per i mondi clonati.
+// Grazie alla CCD ed ai substep adattivi il tick puo' essere piu' lungo dello step da 1/60 s usato in precedenza
+#define PHYSICS_TICKS_PER_SECOND 30
+#define PHYSICS_TICK (1.0f / PHYSICS_TICKS_PER_SECOND)
+// Step fisso usato prima dei substep adattivi, con cui vengono confrontati i substep eseguiti
+#define PHYSICS_BASELINE_STEP (1.0f / 60.0f)
+// Step minimo, usato quando i corpi si muovono alla massima velocita' di un tiro
+#define PHYSICS_MIN_STEP (1.0f / 240.0f)
+// Spostamento massimo di un corpo in un substep
+#define PHYSICS_SAFE_DISTANCE 0.25f
+
+/********** classe ADAPTIVEDYNAMICSWORLD **********/
+class AdaptiveDynamicsWorld : public btDiscreteDynamicsWorld {
+public:
+	// Attributi che contano i tick eseguiti, i substep in cui sono stati divisi e quelli a step ridotto
+	unsigned long ticks;
+	unsigned long substeps;
+	unsigned long fastSubsteps;
+
+	/*
+	 * Costruttore
+	 * Prende in input gli stessi valori del btDiscreteDynamicsWorld
+	 */
+	AdaptiveDynamicsWorld(btDispatcher* dispatcher, btBroadphaseInterface* pairCache, btConstraintSolver* solver, btCollisionConfiguration* configuration)
+		: btDiscreteDynamicsWorld(dispatcher, pairCache, solver, configuration), ticks(0), substeps(0), fastSubsteps(0) {}
+
+protected:
+	/*
+	 * Metodo chiamato dalla Bullet per ogni tick, sia dallo step interpolato del gioco sia dallo step singolo dei mondi clonati.
+	 * Il tick viene dimezzato, fino a PHYSICS_MIN_STEP, finche' lo spostamento del corpo piu' veloce in un substep supera PHYSICS_SAFE_DISTANCE:
+	 * la scelta dipende solo dallo stato dei corpi, quindi la sequenza di substep non cambia con la durata dei frame.
+	 * Prende in input i seguenti valori:
+	 * - timeStep: btScalar, durata del tick
+	 */
+	virtual void internalSingleStepSimulation(btScalar timeStep){
+		btScalar maxSpeed = 0.0f;
+
+		for (int i = 0; i < this->getNumCollisionObjects(); i++){
+			btRigidBody* body = btRigidBody::upcast(this->getCollisionObjectArray()[i]);
+
+			if (!body || body->getInvMass() == 0.0f || !body->isActive())
+				continue;
+
+			btScalar speed = body->getLinearVelocity().length();
+			if (speed > maxSpeed)
+				maxSpeed = speed;
+		}
+
+		btScalar step = timeStep;
+		int count = 1;
+		while (step > PHYSICS_MIN_STEP && maxSpeed * step > PHYSICS_SAFE_DISTANCE){
+			step *= 0.5f;
+			count *= 2;
+		}
+
+		for (int i = 0; i < count; i++)
+			btDiscreteDynamicsWorld::internalSingleStepSimulation(step);
+
+		this->ticks++;
+		this->substeps += count;
+		if (count > 1)
+			this->fastSubsteps += count;
+	}
+};
+
 /********** classe PHYSICS **********/
 class Physics{
 public:
 	// Attributo che rappresenta la classe fondamentale per la simulazione fisica
-    btDiscreteDynamicsWorld* dynamicsWorld;
+    AdaptiveDynamicsWorld* dynamicsWorld;
     // Attributo che conserva tutte le Collision Shape di tutti gli elementi della scena
     btAlignedObjectArray<btCollisionShape*> collisionShapes;
     // Attributo che rappresenta la configurazione per il collision manager
@@ -23,8 +95,10 @@ public:
     // Attributo che rappresenta la tipologia di collision detection
     btBroadphaseInterface* overlappingPairCache;
     // Atributo che gestisce i constraint della scena
-    btSequentialImpulseConstraintSolver* solver;
-    
+    AdaptiveConstraintSolver* solver;
+    // Attributo che indica se la configurazione del collision manager e' condivisa con un'altra istanza, e quindi non va deallocata
+    bool sharedConfiguration;
+
     /*
      * Costruttore
      * Vengono impostati i parametri di base per la creazione del dynamicsWorld
@@ -32,14 +106,41 @@ public:
     Physics(){
 
         this->collisionConfiguration = new btDefaultCollisionConfiguration();
+        this->sharedConfiguration = false;
+
+        this->createWorld();
+    }
+
+    /*
+     * Costruttore
+     * Utilizza una configurazione del collision manager gia' esistente, in modo da evitare l'allocazione dei suoi pool di memoria
+     * quando il dynamicsWorld viene ricreato spesso (ad esempio per le simulazioni del replay).
+     * Prende in input i seguenti valori:
+     * - configuration: btDefaultCollisionConfiguration*, configurazione condivisa, deallocata da chi l'ha creata
+     */
+    Physics(btDefaultCollisionConfiguration* configuration){
+
+        this->collisionConfiguration = configuration;
+        this->sharedConfiguration = true;
+
+        this->createWorld();
+    }
+
+    /*
+     * Metodo che crea il dynamicsWorld e le sue componenti a partire dalla configurazione del collision manager
+     */
+    void createWorld(){
 
         this->dispatcher = new btCollisionDispatcher(collisionConfiguration);
 
         this->overlappingPairCache = new btDbvtBroadphase(); // @suppress("Abstract class cannot be instantiated")
 
-        this->solver = new btSequentialImpulseConstraintSolver;
+        this->solver = new AdaptiveConstraintSolver;
 
-        this->dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher,overlappingPairCache,solver,collisionConfiguration); // @suppress("Abstract class cannot be instantiated")
+        this->dynamicsWorld = new AdaptiveDynamicsWorld(dispatcher,overlappingPairCache,solver,collisionConfiguration); // @suppress("Abstract class cannot be instantiated")
+
+        // Ogni isola viene passata al solver separatamente, invece di raggrupparle, in modo che abbia il proprio numero di iterazioni
+        this->dynamicsWorld->getSolverInfo().m_minimumSolverBatchSize = 1;
 
         this->dynamicsWorld->setGravity(btVector3(0,-9.82,0));
     }
@@ -121,11 +222,55 @@ public:
 
         btRigidBody* body = new btRigidBody(rbInfo);
 
+        if (isDynamic)
+            this->configureCcd(body, type, size);
+
         this->dynamicsWorld->addRigidBody(body);
 
         return body;
     }
 
+    /*
+     * Metodo che imposta la continuous collision detection di un corpo dinamico, in base alla sua forma.
+     * La CCD interviene solo quando in uno step il corpo si sposta piu' della motion threshold, e in quel caso
+     * ne fa scorrere una sfera interna di raggio swept sphere radius lungo tutto lo spostamento, evitando che attraversi
+     * corpi sottili (birilli e bordi del tavolo).
+     * Prende in input i seguenti valori:
+     * - body: btRigidBody*, corpo da configurare
+     * - type: int, tipo della Collision Shape, come in createRigidBody
+     * - size: glm::vec3, dimensione del rigidBody, come in createRigidBody
+     */
+    void configureCcd(btRigidBody* body, int type, glm::vec3 size){
+        btScalar thickness;
+
+        // Sfera: la dimensione minima e' il raggio
+        if (type == 1)
+            thickness = size.x;
+        // Cilindro: la dimensione minima e' il raggio di base
+        else if (type == 2)
+            thickness = fmin(size.x, size.z);
+        // Box: la dimensione minima e' la meta' del lato piu' corto
+        else
+            thickness = fmin(size.x, fmin(size.y, size.z));
+
+        body->setCcdMotionThreshold(thickness * 0.5f);
+        body->setCcdSweptSphereRadius(thickness * 0.9f);
+    }
+
+    /*
+     * Metodo che avanza la simulazione di gioco di deltaTime secondi, a tick fissi di PHYSICS_TICK.
+     * Il tempo che avanza viene accumulato dalla Bullet ed usato per interpolare le motion state, mentre ogni tick viene diviso
+     * in substep da AdaptiveDynamicsWorld: la sequenza e' la stessa che eseguono i mondi clonati con SimulationClone::Step.
+     * Prende in input i seguenti valori:
+     * - deltaTime: btScalar, tempo trascorso dall'ultimo aggiornamento
+     * Restituisce il numero di tick eseguiti.
+     */
+    int stepWorld(btScalar deltaTime){
+        int maxTicks = (int) ceil(deltaTime / PHYSICS_TICK) + 1;
+
+        return this->dynamicsWorld->stepSimulation(deltaTime, maxTicks, PHYSICS_TICK);
+    }
+
     /*
      * Metodo utilizzato per pulire la memoria dagli oggetti della simulazione fisica, una volta che il ciclo di rendering  terminato
      */
@@ -157,7 +302,8 @@ public:
 
         delete this->dispatcher;
 
-        delete this->collisionConfiguration;
+        if (!this->sharedConfiguration)
+            delete this->collisionConfiguration;
 
         this->collisionShapes.clear();
     }
@@ -0,0 +1,358 @@
+/*
+Classe RenderQueue
+- Raccoglie i pacchetti di rendering (draw packet) inviati dagli oggetti della scena durante il frame, invece di renderizzarli subito
+- Ogni pacchetto ha una chiave a 64 bit composta da livello, program shader, texture, materiale e mesh: ordinando i pacchetti
+  per chiave (radix sort) quelli che condividono lo stesso stato OpenGL diventano consecutivi
+- Durante il rendering lo stato viene cambiato solo quando differisce da quello del pacchetto precedente, e vengono contati
+  i cambi di program, materiale, texture e VAO di ogni frame
+*/
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <glad/glad.h>
+
+#include <utils/shader.h>
+#include <utils/glstate.h>
+#include <utils/mesh.h>
+#include <utils/model.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+// Numero massimo di texture unit di cui la coda tiene traccia
+#define RENDER_QUEUE_TEXTURE_UNITS 16
+
+/*
+ * Livelli di rendering, renderizzati in ordine: il livello di sfondo (skybox) viene renderizzato dopo gli oggetti opachi,
+ * con il depth test GL_LEQUAL, in modo che i frammenti coperti dalla scena vengano scartati dal depth test
+ */
+enum RenderLayer {
+	RENDER_LAYER_OPAQUE = 0,
+	RENDER_LAYER_BACKGROUND = 1
+};
+
+/*
+ * Classe base dei materiali: imposta nel program shader attivo lo stato comune a tutti i pacchetti del materiale (uniform, texture aggiuntive)
+ */
+class RenderMaterial {
+public:
+	virtual ~RenderMaterial() {
+	}
+
+	/*
+	 * Metodo che imposta il materiale nello shader, gia' attivo
+	 */
+	virtual void Apply(Shader &shader) const = 0;
+};
+
+/*
+ * Struttura che rappresenta un pacchetto di rendering: una mesh, con il suo materiale ed il suo program shader
+ */
+struct DrawPacket {
+	uint64_t key;
+	Shader *shader;
+	const RenderMaterial *material;
+	const Mesh *mesh;
+	// Numero di istanze da renderizzare dall'instance buffer del modello, 0 per una draw call non istanziata
+	GLsizei instances;
+	// Intervallo dell'element buffer da renderizzare, cioe' il livello di dettaglio scelto per la mesh
+	GLuint firstIndex;
+	GLsizei indexCount;
+};
+
+/*
+ * Struttura che raccoglie i contatori di un frame della coda
+ */
+struct RenderQueueStats {
+	// Numero di pacchetti e di draw call
+	size_t packets;
+	size_t drawCalls;
+	// Numero di cambi di program shader, materiale, texture e VAO
+	size_t programChanges;
+	size_t materialChanges;
+	size_t textureBinds;
+	size_t vertexArrayBinds;
+};
+
+/********** classe RENDERQUEUE **********/
+class RenderQueue {
+public:
+	// Costruttore della classe
+	RenderQueue() {
+		this->clearStats(this->lastFrame);
+		this->clearStats(this->totals);
+		this->frames = 0;
+	}
+
+	/*
+	 * Metodo che aggiunge alla coda tutte le mesh di un modello, renderizzate una sola volta.
+	 * Prende in input i seguenti valori:
+	 * - layer: RenderLayer, livello di rendering
+	 * - shader: Shader, program shader con cui renderizzare il modello
+	 * - material: RenderMaterial, materiale del modello
+	 * - model: Model, modello da renderizzare
+	 */
+	void Submit(RenderLayer layer, Shader &shader, const RenderMaterial &material, const Model &model) {
+		for (size_t i = 0; i < model.meshes.size(); i++)
+			this->push(layer, shader, material, model.meshes[i], 0);
+	}
+
+	/*
+	 * Metodo che carica le istanze nell'instance buffer del modello ed aggiunge alla coda tutte le sue mesh, renderizzate con istanze.
+	 * L'instance buffer non deve essere ricaricato fino al Flush della coda.
+	 * Prende in input i seguenti valori:
+	 * - layer, shader, material, model: come per Submit
+	 * - instances: vector<InstanceData>, matrici e colore di ogni istanza
+	 */
+	void SubmitInstanced(RenderLayer layer, Shader &shader, const RenderMaterial &material, Model &model, const vector<InstanceData> &instances) {
+		if (instances.empty())
+			return;
+
+		model.UploadInstances(instances);
+
+		for (size_t i = 0; i < model.meshes.size(); i++)
+			this->push(layer, shader, material, model.meshes[i], (GLsizei) instances.size());
+	}
+
+	/*
+	 * Metodo che aggiunge alla coda una sola mesh di un modello, renderizzata con istanze dall'instance buffer gia' caricato
+	 * con Model::UploadInstances: permette di inviare solo le mesh visibili di un modello.
+	 * Prende in input i seguenti valori:
+	 * - layer, shader, material: come per Submit
+	 * - mesh: Mesh, mesh da renderizzare
+	 * - instances: GLsizei, numero di istanze caricate nell'instance buffer
+	 * - lod: int, livello di dettaglio della mesh da renderizzare
+	 */
+	void SubmitMesh(RenderLayer layer, Shader &shader, const RenderMaterial &material, const Mesh &mesh, GLsizei instances, int lod = 0) {
+		if (instances > 0)
+			this->push(layer, shader, material, mesh, instances, lod);
+	}
+
+	/*
+	 * Metodo che ordina i pacchetti del frame per chiave e li renderizza, cambiando lo stato OpenGL solo quando necessario.
+	 * Alla fine la coda viene svuotata, mantenendo la memoria allocata.
+	 */
+	void Flush() {
+		RenderQueueStats stats;
+		this->clearStats(stats);
+		stats.packets = this->packets.size();
+
+		this->sort();
+
+		Shader *shader = NULL;
+		const RenderMaterial *material = NULL;
+		GLuint vertexArray = 0;
+		GLuint textures[RENDER_QUEUE_TEXTURE_UNITS];
+		memset(textures, 0, sizeof(textures));
+		int layer = RENDER_LAYER_OPAQUE;
+
+		for (size_t i = 0; i < this->order.size(); i++) {
+			const DrawPacket &packet = this->packets[this->order[i]];
+			int packetLayer = (int) (packet.key >> 56);
+
+			if (packetLayer != layer) {
+				gl_state().DepthFunc(packetLayer == RENDER_LAYER_BACKGROUND ? GL_LEQUAL : GL_LESS);
+				layer = packetLayer;
+			}
+
+			// Cambiando program il materiale va reimpostato, perche' le uniform fanno parte dello stato del program
+			if (packet.shader != shader) {
+				packet.shader->Use();
+				shader = packet.shader;
+				material = NULL;
+				stats.programChanges++;
+			}
+
+			if (packet.material != material) {
+				packet.material->Apply(*shader);
+				material = packet.material;
+				stats.materialChanges++;
+			}
+
+			for (size_t t = 0; t < packet.mesh->material.size(); t++) {
+				const MaterialBinding &binding = packet.mesh->material[t];
+
+				if (binding.unit >= RENDER_QUEUE_TEXTURE_UNITS || textures[binding.unit] != binding.texture) {
+					gl_state().ActiveTexture(GL_TEXTURE0 + binding.unit);
+					gl_state().BindTexture(GL_TEXTURE_2D, binding.texture);
+					if (binding.unit < RENDER_QUEUE_TEXTURE_UNITS)
+						textures[binding.unit] = binding.texture;
+					stats.textureBinds++;
+				}
+			}
+
+			if (packet.mesh->VAO != vertexArray) {
+				gl_state().BindVertexArray(packet.mesh->VAO);
+				vertexArray = packet.mesh->VAO;
+				stats.vertexArrayBinds++;
+			}
+
+			const GLvoid *offset = (const GLvoid*) (size_t) (packet.firstIndex * packet.mesh->indexSize());
+			// Il base vertex e' 0 per le mesh con buffer propri, e la posizione della mesh nel vertex buffer per quelle di una GeometryPool
+			if (packet.instances > 0)
+				glDrawElementsInstancedBaseVertex(GL_TRIANGLES, packet.indexCount, packet.mesh->indexType, offset, packet.instances, packet.mesh->baseVertex);
+			else
+				glDrawElementsBaseVertex(GL_TRIANGLES, packet.indexCount, packet.mesh->indexType, offset, packet.mesh->baseVertex);
+			stats.drawCalls++;
+		}
+
+		if (layer != RENDER_LAYER_OPAQUE)
+			gl_state().DepthFunc(GL_LESS);
+
+		this->packets.clear();
+
+		this->lastFrame = stats;
+		this->frames++;
+		this->totals.packets += stats.packets;
+		this->totals.drawCalls += stats.drawCalls;
+		this->totals.programChanges += stats.programChanges;
+		this->totals.materialChanges += stats.materialChanges;
+		this->totals.textureBinds += stats.textureBinds;
+		this->totals.vertexArrayBinds += stats.vertexArrayBinds;
+	}
+
+	/*
+	 * Metodo get per i contatori dell'ultimo frame
+	 */
+	const RenderQueueStats& getLastFrame() const {
+		return this->lastFrame;
+	}
+
+	/*
+	 * Metodo get per i contatori sommati su tutti i frame, e per il numero di frame
+	 */
+	const RenderQueueStats& getTotals() const {
+		return this->totals;
+	}
+
+	size_t getFrames() const {
+		return this->frames;
+	}
+
+private:
+	// Attributo che contiene i pacchetti del frame, nell'ordine in cui sono stati inviati
+	vector<DrawPacket> packets;
+	// Attributi che contengono gli indici dei pacchetti in ordine di chiave, ed il buffer di appoggio del radix sort
+	vector<uint32_t> order;
+	vector<uint32_t> scratch;
+	// Attributi che assegnano ad ogni program, materiale, insieme di texture e mesh un identificativo compatto per la chiave
+	unordered_map<const Shader*, uint64_t> shaderIds;
+	unordered_map<const RenderMaterial*, uint64_t> materialIds;
+	unordered_map<const Mesh*, uint64_t> meshIds;
+	unordered_map<const Mesh*, uint64_t> meshTextureIds;
+	vector< vector<GLuint> > textureSets;
+	// Attributi che contengono i contatori
+	RenderQueueStats lastFrame;
+	RenderQueueStats totals;
+	size_t frames;
+
+	/*
+	 * Metodo che costruisce la chiave di un pacchetto e lo aggiunge alla coda.
+	 * La chiave contiene, dai bit piu' significativi: livello (8 bit), program (8 bit), insieme di texture (16 bit),
+	 * materiale (16 bit) e mesh (16 bit): i cambi di stato piu' costosi sono quelli che vengono raggruppati per primi.
+	 */
+	void push(RenderLayer layer, Shader &shader, const RenderMaterial &material, const Mesh &mesh, GLsizei instances, int lod = 0) {
+		DrawPacket packet;
+		packet.key = ((uint64_t) layer << 56) | ((this->intern(this->shaderIds, &shader) & 0xFF) << 48) | ((this->textureSetId(mesh) & 0xFFFF) << 32) |
+				((this->intern(this->materialIds, &material) & 0xFFFF) << 16) | (this->intern(this->meshIds, &mesh) & 0xFFFF);
+		packet.shader = &shader;
+		packet.material = &material;
+		packet.mesh = &mesh;
+		packet.instances = instances;
+		packet.firstIndex = mesh.lods[lod].firstIndex;
+		packet.indexCount = mesh.lods[lod].indexCount;
+
+		this->packets.push_back(packet);
+	}
+
+	/*
+	 * Metodo che restituisce l'identificativo di un oggetto, assegnandone uno nuovo la prima volta che viene incontrato
+	 */
+	template <typename T>
+	uint64_t intern(unordered_map<const T*, uint64_t> &ids, const T *object) {
+		typename unordered_map<const T*, uint64_t>::iterator found = ids.find(object);
+		if (found != ids.end())
+			return found->second;
+
+		uint64_t id = ids.size();
+		ids[object] = id;
+		return id;
+	}
+
+	/*
+	 * Metodo che restituisce l'identificativo dell'insieme di texture di una mesh: mesh con le stesse texture hanno lo stesso identificativo
+	 */
+	uint64_t textureSetId(const Mesh &mesh) {
+		unordered_map<const Mesh*, uint64_t>::iterator found = this->meshTextureIds.find(&mesh);
+		if (found != this->meshTextureIds.end())
+			return found->second;
+
+		vector<GLuint> set;
+		for (size_t t = 0; t < mesh.material.size(); t++)
+			set.push_back(mesh.material[t].texture);
+
+		uint64_t id = 0;
+		while (id < this->textureSets.size() && this->textureSets[id] != set)
+			id++;
+		if (id == this->textureSets.size())
+			this->textureSets.push_back(set);
+
+		this->meshTextureIds[&mesh] = id;
+		return id;
+	}
+
+	/*
+	 * Metodo che ordina gli indici dei pacchetti per chiave con un radix sort LSD, 8 bit per passata.
+	 * Le passate in cui tutte le chiavi hanno lo stesso byte vengono saltate, per cui il costo dipende solo dai byte che variano.
+	 */
+	void sort() {
+		size_t count = this->packets.size();
+
+		this->order.resize(count);
+		this->scratch.resize(count);
+		for (size_t i = 0; i < count; i++)
+			this->order[i] = (uint32_t) i;
+
+		for (int shift = 0; shift < 64; shift += 8) {
+			size_t histogram[256];
+			memset(histogram, 0, sizeof(histogram));
+
+			for (size_t i = 0; i < count; i++)
+				histogram[(this->packets[i].key >> shift) & 0xFF]++;
+
+			if (count == 0 || histogram[(this->packets[0].key >> shift) & 0xFF] == count)
+				continue;
+
+			size_t offset = 0;
+			for (int b = 0; b < 256; b++) {
+				size_t bucket = histogram[b];
+				histogram[b] = offset;
+				offset += bucket;
+			}
+
+			// La passata e' stabile, per cui l'ordine delle passate precedenti viene mantenuto a parita' di byte
+			for (size_t i = 0; i < count; i++) {
+				uint32_t index = this->order[i];
+				this->scratch[histogram[(this->packets[index].key >> shift) & 0xFF]++] = index;
+			}
+
+			this->order.swap(this->scratch);
+		}
+	}
+
+	void clearStats(RenderQueueStats &stats) {
+		stats.packets = 0;
+		stats.drawCalls = 0;
+		stats.programChanges = 0;
+		stats.materialChanges = 0;
+		stats.textureBinds = 0;
+		stats.vertexArrayBinds = 0;
+	}
+};
+
+#endif
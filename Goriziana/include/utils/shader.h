@@ -1,6 +1,8 @@
 /*
 Classe Shader
 - implementazione classe per caricamento Vertex Shader, Fragment Shader e creazione Program Shader
+- dopo il link legge una sola volta tutte le uniform attive in una tabella ordinata per nome, da cui si ottengono degli handle tipizzati:
+  i metodi set che ricevono un handle eseguono solo la chiamata glUniform, senza costruire stringhe ne' cercare la location
 */
 
 #ifndef SHADER_H
@@ -9,7 +11,11 @@ Classe Shader
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <utils/glstate.h>
+
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <cstring>
 #include <cstdlib>
 #include <fstream>
@@ -18,11 +24,66 @@ Classe Shader
 
 using namespace std;
 
+/*
+ * Struttura che rappresenta una uniform attiva del program shader, come letta dopo il link
+ */
+struct UniformInfo {
+    string name;
+    GLint location;
+    GLenum type;
+};
+
+/*
+ * Handle tipizzato di una uniform: contiene la location, risolta una volta con Shader::getUniform e riutilizzata ad ogni frame.
+ * Una location pari a -1 indica una uniform non trovata, e viene ignorata da OpenGL.
+ */
+template <typename T>
+struct Uniform {
+    GLint location;
+
+    Uniform() : location(-1) {}
+
+    bool isValid() const {
+        return this->location != -1;
+    }
+};
+
+/*
+ * Tipi OpenGL compatibili con il tipo C++ di un handle, usati per verificare gli handle al momento della risoluzione
+ */
+template <typename T> struct UniformType;
+template <> struct UniformType<int> {
+    static bool accepts(GLenum type) { return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_CUBE; }
+};
+template <> struct UniformType<float> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT; }
+};
+template <> struct UniformType<glm::vec2> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT_VEC2; }
+};
+template <> struct UniformType<glm::vec3> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT_VEC3; }
+};
+template <> struct UniformType<glm::vec4> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT_VEC4; }
+};
+template <> struct UniformType<glm::mat2> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT_MAT2; }
+};
+template <> struct UniformType<glm::mat3> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT_MAT3; }
+};
+template <> struct UniformType<glm::mat4> {
+    static bool accepts(GLenum type) { return type == GL_FLOAT_MAT4; }
+};
+
 /********** classe SHADER **********/
 class Shader{
 
 private:
 	string shaderName;
+	// Attributo che contiene le uniform attive del program shader, ordinate per nome
+	vector<UniformInfo> uniforms;
 	
 public:
 	// Attributo che conterra' l'ID con cui verra' salvato il Program Shader in memoria
@@ -125,6 +186,9 @@ public:
             glAttachShader(this->ID, geometry);
         glLinkProgram(this->ID);
         checkCompileErrors(this->ID, "PROGRAM");
+
+        // Passo 4: leggo le uniform attive, una volta per tutte
+        this->reflectUniforms();
         
 		// gli shader sono linkati allo Shader Program, li posso cancellare
         glDetachShader(this->ID, vertex);
@@ -140,7 +204,7 @@ public:
      * Metodo che attiva il program shader come parte del processo di rendering attuale
      */
     void Use() { 
-        glUseProgram(this->ID); 
+        gl_state().UseProgram(this->ID); 
     }
 
 	/*
@@ -149,6 +213,105 @@ public:
     void Delete() {    
 		glDeleteProgram(this->ID); 
 	}
+
+    /*
+     * Metodo che risolve l'handle tipizzato di una uniform, da chiamare una sola volta dopo la creazione dello shader.
+     * Gli elementi degli array si indicano con il loro indice, ad esempio "lightVectors[1]"; il nome senza indice si riferisce al primo elemento.
+     * Se la uniform non esiste o il tipo non corrisponde viene segnalato un errore e restituito un handle non valido.
+     * Prende in input i seguenti valori:
+     * - name: string, nome della uniform nello shader
+     */
+    template <typename T>
+    Uniform<T> getUniform(const string &name) const {
+        Uniform<T> handle;
+        const UniformInfo* info = this->findUniform(name);
+
+        if (!info) {
+            cout << "ERROR::SHADER::UNIFORM_NOT_FOUND: " << name << " in SHADER: " << shaderName << endl;
+            return handle;
+        }
+
+        if (!UniformType<T>::accepts(info->type)) {
+            cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH: " << name << " in SHADER: " << shaderName << endl;
+            return handle;
+        }
+
+        handle.location = info->location;
+
+        return handle;
+    }
+
+    /*
+     * Metodo che collega un uniform block dello shader ad un binding point, a cui viene poi collegato l'uniform buffer condiviso.
+     * Prende in input i seguenti valori:
+     * - name: string, nome dell'uniform block nello shader
+     * - binding: GLuint, binding point dell'uniform buffer
+     * Restituisce false se lo shader non contiene il blocco.
+     */
+    bool bindUniformBlock(const string &name, GLuint binding) {
+        GLuint index = glGetUniformBlockIndex(this->ID, name.c_str());
+
+        if (index == GL_INVALID_INDEX) {
+            cout << "ERROR::SHADER::UNIFORM_BLOCK_NOT_FOUND: " << name << " in SHADER: " << shaderName << endl;
+            return false;
+        }
+
+        glUniformBlockBinding(this->ID, index, binding);
+
+        return true;
+    }
+
+    /*
+     * Metodo che indica se lo shader contiene la uniform attiva indicata
+     */
+    bool hasUniform(const string &name) const {
+        return this->findUniform(name) != nullptr;
+    }
+
+    /*
+     * Metodo get per la tabella delle uniform attive, ordinata per nome
+     */
+    const vector<UniformInfo>& getUniforms() const {
+        return this->uniforms;
+    }
+
+    /*
+     * Metodi che settano una uniform dello shader attivo tramite il suo handle.
+     * Prendono in input i seguenti valori:
+     * - uniform: Uniform, handle della uniform ottenuto con getUniform
+     * - value: valore da dare alla uniform, dello stesso tipo dell'handle
+     */
+    void set(const Uniform<int> &uniform, int value) const {
+        glUniform1i(uniform.location, value);
+    }
+
+    void set(const Uniform<float> &uniform, float value) const {
+        glUniform1f(uniform.location, value);
+    }
+
+    void set(const Uniform<glm::vec2> &uniform, const glm::vec2 &value) const {
+        glUniform2fv(uniform.location, 1, &value[0]);
+    }
+
+    void set(const Uniform<glm::vec3> &uniform, const glm::vec3 &value) const {
+        glUniform3fv(uniform.location, 1, &value[0]);
+    }
+
+    void set(const Uniform<glm::vec4> &uniform, const glm::vec4 &value) const {
+        glUniform4fv(uniform.location, 1, &value[0]);
+    }
+
+    void set(const Uniform<glm::mat2> &uniform, const glm::mat2 &mat) const {
+        glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    void set(const Uniform<glm::mat3> &uniform, const glm::mat3 &mat) const {
+        glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    void set(const Uniform<glm::mat4> &uniform, const glm::mat4 &mat) const {
+        glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
 	
     /*
      * Metodo di utility. Utilizzato per settare un bool nello shader attivo.
@@ -157,7 +320,7 @@ public:
      * - value: bool, valore da dare alla variabile uniform individuata dal precedente parametro
      */
     void setBool(const string &name, bool value) const {
-        glUniform1i(glGetUniformLocation(this->ID, name.c_str()), (int)value); 
+        glUniform1i(this->getLocation(name), (int)value); 
     }
     
     /*
@@ -167,7 +330,7 @@ public:
 	 * - value: int, valore da dare alla variabile uniform individuata dal precedente parametro
 	 */
     void setInt(const string &name, int value) const {
-        glUniform1i(glGetUniformLocation(this->ID, name.c_str()), value); 
+        glUniform1i(this->getLocation(name), value); 
     }
     
     /*
@@ -177,7 +340,7 @@ public:
 	 * - value: float, valore da dare alla variabile uniform individuata dal precedente parametro
 	 */
     void setFloat(const string &name, float value) const {
-        glUniform1f(glGetUniformLocation(this->ID, name.c_str()), value); 
+        glUniform1f(this->getLocation(name), value); 
     }
     
     /*
@@ -187,7 +350,7 @@ public:
 	 * - value: vec2, valore da dare alla variabile uniform individuata dal precedente parametro
 	 */
     void setVec2(const string &name, const glm::vec2 &value) const {
-        glUniform2fv(glGetUniformLocation(this->ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(this->getLocation(name), 1, &value[0]); 
     }
 	
     /*
@@ -197,7 +360,7 @@ public:
 	 * - x, y: float, valori da dare alla variabile uniform individuata dal precedente parametro
 	 */
     void setVec2(const string &name, float x, float y) const {
-        glUniform2f(glGetUniformLocation(this->ID, name.c_str()), x, y); 
+        glUniform2f(this->getLocation(name), x, y); 
     }
     
     /*
@@ -207,7 +370,7 @@ public:
 	 * - value: vec3, valore da dare alla variabile uniform individuata dal precedente parametro
 	 */
     void setVec3(const string &name, const glm::vec3 &value) const {
-        glUniform3fv(glGetUniformLocation(this->ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(this->getLocation(name), 1, &value[0]); 
     }
 	
     /*
@@ -217,7 +380,7 @@ public:
 	 * - x, y, z: float, valori da dare alla variabile uniform individuata dal precedente parametro
 	 */
     void setVec3(const string &name, float x, float y, float z) const {
-        glUniform3f(glGetUniformLocation(this->ID, name.c_str()), x, y, z); 
+        glUniform3f(this->getLocation(name), x, y, z); 
     }
     
     /*
@@ -227,7 +390,7 @@ public:
 	 * - value: vec4, valore da dare alla variabile uniform individuata dal precedente parametro
 	 */
     void setVec4(const string &name, const glm::vec4 &value) const {
-        glUniform4fv(glGetUniformLocation(this->ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(this->getLocation(name), 1, &value[0]); 
     }
 	
     /*
@@ -237,7 +400,7 @@ public:
 	 * - x, y, z, w: float, valori da dare alla variabile uniform individuata dal precedente parametro
 	 */
     void setVec4(const string &name, float x, float y, float z, float w) {
-        glUniform4f(glGetUniformLocation(this->ID, name.c_str()), x, y, z, w); 
+        glUniform4f(this->getLocation(name), x, y, z, w); 
     }
     
     /*
@@ -247,7 +410,7 @@ public:
 	 * - value: mat2, valore da dare alla variabile uniform individuata dal precedente parametro
 	 */
     void setMat2(const string &name, const glm::mat2 &mat) const {
-        glUniformMatrix2fv(glGetUniformLocation(this->ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(this->getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     
     /*
@@ -257,7 +420,7 @@ public:
 	 * - value: mat3, valore da dare alla variabile uniform individuata dal precedente parametro
 	 */
     void setMat3(const string &name, const glm::mat3 &mat) const {
-        glUniformMatrix3fv(glGetUniformLocation(this->ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(this->getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     
     /*
@@ -267,10 +430,85 @@ public:
 	 * - value: mat4, valore da dare alla variabile uniform individuata dal precedente parametro
 	 */
     void setMat4(const string &name, const glm::mat4 &mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(this->ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(this->getLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    /*
+     * Metodo che legge tutte le uniform attive del program shader e ne salva nome, location e tipo nella tabella ordinata.
+     * Gli array vengono restituiti da OpenGL con il solo nome del primo elemento ("nome[0]"): salvo ogni elemento,
+     * piu' il nome senza indice che si riferisce al primo.
+     * Le uniform contenute in un uniform block non hanno location, e non vengono salvate.
+     */
+    void reflectUniforms() {
+        GLint count = 0, maxLength = 0;
+
+        glGetProgramiv(this->ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(this->ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+
+            glGetActiveUniform(this->ID, i, (GLsizei) buffer.size(), &length, &size, &type, &buffer[0]);
+
+            string name(&buffer[0], length);
+            size_t bracket = name.find('[');
+
+            if (bracket == string::npos) {
+                this->addUniform(name, type);
+                continue;
+            }
+
+            string base = name.substr(0, bracket);
+
+            this->addUniform(base, type);
+            for (GLint e = 0; e < size; e++)
+                this->addUniform(base + "[" + to_string(e) + "]", type);
+        }
+
+        sort(this->uniforms.begin(), this->uniforms.end(), [](const UniformInfo &a, const UniformInfo &b) { return a.name < b.name; });
+    }
+
+    /*
+     * Metodo che aggiunge una uniform alla tabella, se ha una location valida
+     */
+    void addUniform(const string &name, GLenum type) {
+        UniformInfo info;
+
+        info.name = name;
+        info.location = glGetUniformLocation(this->ID, name.c_str());
+        info.type = type;
+
+        if (info.location != -1)
+            this->uniforms.push_back(info);
+    }
+
+    /*
+     * Metodo che cerca una uniform nella tabella ordinata. Restituisce nullptr se non e' presente.
+     */
+    const UniformInfo* findUniform(const string &name) const {
+        vector<UniformInfo>::const_iterator it = lower_bound(this->uniforms.begin(), this->uniforms.end(), name,
+                [](const UniformInfo &info, const string &value) { return info.name < value; });
+
+        if (it == this->uniforms.end() || it->name != name)
+            return nullptr;
+
+        return &(*it);
+    }
+
+    /*
+     * Metodo che restituisce la location di una uniform dalla tabella, -1 se non e' presente
+     */
+    GLint getLocation(const string &name) const {
+        const UniformInfo* info = this->findUniform(name);
+
+        return info ? info->location : -1;
+    }
+
     /*
      * Metodo utilizzato per controllare eventuali errori nella compilazione di VS e FS e nel link per la creazione del PS.
      * In caso affermativo, viene segnalato un messaggio con informazioni riguardo l'errore.
@@ -0,0 +1,189 @@
+/*
+Classi WorldSnapshot e SimulationClone
+- WorldSnapshot salva e ripristina lo stato completo dei corpi dinamici della scena (trasformazione, velocita', activation state)
+- SimulationClone mantiene un dynamicsWorld separato da quello di gioco, che viene ricostruito da zero ad ogni ripristino:
+  in questo modo pair cache, manifold e solver partono sempre dallo stesso stato, e la risimulazione da uno snapshot e' deterministica
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include <utils/physics.h>
+
+using namespace std;
+
+/*
+ * Funzione che popola la simulazione con gli oggetti della scena, restituendo i corpi dinamici sempre nello stesso ordine
+ */
+typedef void (*SceneBuilder)(Physics &simulation, vector<btRigidBody*> &bodies);
+
+/*
+ * Struttura che rappresenta lo stato di un singolo corpo rigido
+ */
+struct BodySnapshot {
+	btTransform transform;
+	btVector3 linearVelocity;
+	btVector3 angularVelocity;
+	int activationState;
+	btScalar deactivationTime;
+};
+
+/********** classe WORLDSNAPSHOT **********/
+class WorldSnapshot {
+public:
+	// Attributo che contiene lo stato dei corpi, nello stesso ordine del vettore da cui e' stato catturato
+	vector<BodySnapshot> bodies;
+
+	/*
+	 * Metodo che salva lo stato dei corpi.
+	 * Prende in input i seguenti valori:
+	 * - source: vector<btRigidBody*>, corpi dinamici della scena
+	 */
+	void Capture(const vector<btRigidBody*> &source) {
+		this->bodies.resize(source.size());
+
+		for (size_t i = 0; i < source.size(); i++) {
+			BodySnapshot &state = this->bodies[i];
+
+			state.transform = source[i]->getWorldTransform();
+			state.linearVelocity = source[i]->getLinearVelocity();
+			state.angularVelocity = source[i]->getAngularVelocity();
+			state.activationState = source[i]->getActivationState();
+			state.deactivationTime = source[i]->getDeactivationTime();
+		}
+	}
+
+	/*
+	 * Metodo che riporta i corpi allo stato salvato, aggiornando anche le motion state ed azzerando le forze accumulate.
+	 * Prende in input i seguenti valori:
+	 * - target: vector<btRigidBody*>, corpi dinamici su cui ripristinare lo stato
+	 */
+	void Restore(const vector<btRigidBody*> &target) const {
+		for (size_t i = 0; i < target.size() && i < this->bodies.size(); i++) {
+			const BodySnapshot &state = this->bodies[i];
+			btRigidBody* body = target[i];
+
+			body->setWorldTransform(state.transform);
+			body->setInterpolationWorldTransform(state.transform);
+			body->getMotionState()->setWorldTransform(state.transform);
+
+			body->setLinearVelocity(state.linearVelocity);
+			body->setAngularVelocity(state.angularVelocity);
+			body->setInterpolationLinearVelocity(state.linearVelocity);
+			body->setInterpolationAngularVelocity(state.angularVelocity);
+
+			body->clearForces();
+
+			body->forceActivationState(state.activationState);
+			body->setDeactivationTime(state.deactivationTime);
+		}
+	}
+};
+
+/********** classe SIMULATIONCLONE **********/
+class SimulationClone {
+public:
+	/*
+	 * Costruttore
+	 * Prende in input i seguenti valori:
+	 * - builder: SceneBuilder, funzione che crea gli oggetti della scena nel mondo clonato
+	 */
+	SimulationClone(SceneBuilder builder) : builder(builder), configuration(nullptr), simulation(nullptr), adaptiveSolver(true) {}
+
+	// Distruttore della classe, dealloca il mondo clonato e la configurazione condivisa
+	~SimulationClone() {
+		this->destroy();
+
+		delete this->configuration;
+	}
+
+	/*
+	 * Metodo che ricostruisce il mondo da zero e vi ripristina lo stato indicato.
+	 * La configurazione del collision manager viene mantenuta tra una ricostruzione e l'altra, perche' alloca dei pool di memoria
+	 * che non influenzano il risultato della simulazione.
+	 * Prende in input i seguenti valori:
+	 * - snapshot: WorldSnapshot, stato da cui ripartire
+	 */
+	void Reset(const WorldSnapshot &snapshot) {
+		this->destroy();
+
+		if (!this->configuration)
+			this->configuration = new btDefaultCollisionConfiguration();
+
+		this->simulation = new Physics(this->configuration);
+		this->simulation->solver->setAdaptive(this->adaptiveSolver);
+		this->builder(*this->simulation, this->bodies);
+
+		snapshot.Restore(this->bodies);
+	}
+
+	/*
+	 * Metodo set per la modalita' del solver dei mondi ricostruiti da Reset: iterazioni scelte per ogni isola o numero fisso della Bullet
+	 */
+	void setAdaptiveSolver(bool adaptive) {
+		this->adaptiveSolver = adaptive;
+	}
+
+	/*
+	 * Metodo che avanza la simulazione di un solo tick di PHYSICS_TICK, senza interpolazione.
+	 * Il tick viene diviso negli stessi substep che esegue il mondo di gioco partendo dallo stesso stato.
+	 */
+	void Step() {
+		if (this->simulation)
+			this->simulation->dynamicsWorld->stepSimulation(PHYSICS_TICK, 0);
+	}
+
+	/*
+	 * Metodo che indica se la simulazione e' ferma, cioe' se nessun corpo si muove piu' in modo apprezzabile
+	 */
+	bool isIdle() const {
+		for (size_t i = 0; i < this->bodies.size(); i++) {
+			if (!this->bodies[i]->isActive())
+				continue;
+
+			if (this->bodies[i]->getLinearVelocity().length2() > 0.0001f || this->bodies[i]->getAngularVelocity().length2() > 0.0001f)
+				return false;
+		}
+
+		return true;
+	}
+
+	/*
+	 * Metodo get per i corpi dinamici del mondo clonato, nello stesso ordine restituito dal SceneBuilder
+	 */
+	const vector<btRigidBody*>& getBodies() const {
+		return this->bodies;
+	}
+
+	/*
+	 * Metodo get per il mondo clonato, nullptr finche' non viene chiamato Reset
+	 */
+	Physics* getSimulation() {
+		return this->simulation;
+	}
+
+private:
+	SceneBuilder builder;
+	btDefaultCollisionConfiguration* configuration;
+	Physics* simulation;
+	bool adaptiveSolver;
+	vector<btRigidBody*> bodies;
+
+	void destroy() {
+		if (this->simulation) {
+			this->simulation->Clear();
+			delete this->simulation;
+			this->simulation = nullptr;
+		}
+
+		this->bodies.clear();
+	}
+};
+
+#endif
@@ -0,0 +1,199 @@
+/*
+Classe AdaptiveConstraintSolver
+- Estende il solver a impulsi sequenziali della Bullet, scegliendo il numero di iterazioni di ogni isola invece di usarne sempre lo stesso
+- Il budget di un'isola cresce con il numero di contatti: una biglia che rotola da sola sul tavolo si risolve in poche iterazioni,
+  mentre il gruppo di birilli colpito da una biglia ne riceve di piu'
+- Le iterazioni si fermano prima del budget quando l'errore residuo (somma dei quadrati delle correzioni di impulso) e' trascurabile,
+  e proseguono oltre il budget, fino al limite massimo, finche' l'errore resta troppo alto
+- Conta le iterazioni eseguite in ogni step, per confrontarle con quelle del numero fisso di iterazioni della Bullet
+*/
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+/*
+ * Struttura che raccoglie i contatori del solver in uno step, o in piu' step se sommati
+ */
+struct SolverStepStats {
+	// Numero di step considerati
+	unsigned long steps;
+	// Numero di isole con almeno un contatto o un constraint
+	unsigned long islands;
+	// Numero di punti di contatto risolti
+	unsigned long contacts;
+	// Numero di iterazioni eseguite, sommate su tutte le isole
+	unsigned long iterations;
+	// Numero massimo di iterazioni eseguite su una singola isola
+	int maxIslandIterations;
+};
+
+/********** classe ADAPTIVECONSTRAINTSOLVER **********/
+class AdaptiveConstraintSolver : public btSequentialImpulseConstraintSolver {
+public:
+	/*
+	 * Costruttore
+	 * Imposta dei limiti adatti alla scena del biliardo: da 4 a 20 iterazioni, una in piu' ogni 2 contatti
+	 */
+	AdaptiveConstraintSolver() : adaptive(true), minIterations(4), maxIterations(20), contactsPerIteration(2),
+			convergedResidual(1e-7f), acceptableResidual(1e-4f) {
+		this->clearStats(this->current);
+		this->clearStats(this->lastStep);
+		this->clearStats(this->totals);
+	}
+
+	/*
+	 * Metodo set per la modalita' del solver: se adaptive e' false vengono eseguite, come nella Bullet, sempre m_numIterations iterazioni
+	 */
+	void setAdaptive(bool adaptive) {
+		this->adaptive = adaptive;
+	}
+
+	/*
+	 * Metodo set per i limiti del numero di iterazioni di un'isola.
+	 * Prende in input i seguenti valori:
+	 * - minIterations: int, iterazioni eseguite anche dall'isola con un solo contatto
+	 * - maxIterations: int, tetto massimo, raggiunto solo se l'errore residuo resta sopra acceptableResidual
+	 * - contactsPerIteration: int, numero di contatti che aggiungono un'iterazione al budget dell'isola
+	 */
+	void setIterationLimits(int minIterations, int maxIterations, int contactsPerIteration) {
+		this->minIterations = btMax(minIterations, 1);
+		this->maxIterations = btMax(maxIterations, this->minIterations);
+		this->contactsPerIteration = btMax(contactsPerIteration, 1);
+	}
+
+	/*
+	 * Metodo set per le soglie dell'errore residuo.
+	 * Prende in input i seguenti valori:
+	 * - convergedResidual: btScalar, sotto questa soglia l'isola e' risolta e le iterazioni si fermano subito
+	 * - acceptableResidual: btScalar, sotto questa soglia le iterazioni si fermano una volta esaurito il budget
+	 */
+	void setResidualThresholds(btScalar convergedResidual, btScalar acceptableResidual) {
+		this->convergedResidual = convergedResidual;
+		this->acceptableResidual = btMax(acceptableResidual, convergedResidual);
+	}
+
+	/*
+	 * Metodo get per i contatori dell'ultimo step completato
+	 */
+	const SolverStepStats& getLastStep() const {
+		return this->lastStep;
+	}
+
+	/*
+	 * Metodo get per i contatori sommati su tutti gli step dalla creazione del solver o dall'ultimo resetStats
+	 */
+	const SolverStepStats& getTotals() const {
+		return this->totals;
+	}
+
+	/*
+	 * Metodo che azzera i contatori sommati
+	 */
+	void resetStats() {
+		this->clearStats(this->totals);
+	}
+
+	/*
+	 * Metodo chiamato dal dynamicsWorld al termine di ogni step, dopo aver risolto tutte le isole: chiude i contatori dello step
+	 */
+	virtual void allSolved(const btContactSolverInfo& info, btIDebugDraw* debugDrawer) {
+		btSequentialImpulseConstraintSolver::allSolved(info, debugDrawer);
+
+		this->current.steps = 1;
+		this->lastStep = this->current;
+
+		this->totals.steps++;
+		this->totals.islands += this->current.islands;
+		this->totals.contacts += this->current.contacts;
+		this->totals.iterations += this->current.iterations;
+		this->totals.maxIslandIterations = btMax(this->totals.maxIslandIterations, this->current.maxIslandIterations);
+
+		this->clearStats(this->current);
+	}
+
+protected:
+	/*
+	 * Metodo che esegue le iterazioni del solver su un'isola, sostituendo il ciclo a numero fisso della Bullet.
+	 * Il budget viene calcolato dal numero di contatti dell'isola; se l'errore residuo e' ancora sopra acceptableResidual
+	 * alla fine del budget le iterazioni continuano fino a maxIterations.
+	 */
+	virtual btScalar solveGroupCacheFriendlyIterations(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds,
+			btTypedConstraint** constraints, int numConstraints, const btContactSolverInfo& infoGlobal, btIDebugDraw* debugDrawer) {
+		// Un'isola senza contatti ne' constraint non ha nulla da risolvere
+		if (numManifolds + numConstraints == 0)
+			return 0.0f;
+
+		int contacts = 0;
+		for (int i = 0; i < numManifolds; i++)
+			contacts += manifoldPtr[i]->getNumContacts();
+
+		btContactSolverInfo info = infoGlobal;
+		int limit, budget;
+		btScalar converged, acceptable;
+
+		if (this->adaptive) {
+			limit = btMax(this->maxIterations, this->m_maxOverrideNumSolverIterations);
+			budget = btMin(this->minIterations + (contacts + numConstraints) / this->contactsPerIteration, limit);
+			converged = this->convergedResidual;
+			acceptable = this->acceptableResidual;
+
+			// Anche le iterazioni di split impulse, che correggono le compenetrazioni, seguono il budget dell'isola
+			info.m_numIterations = budget;
+			info.m_leastSquaresResidualThreshold = converged;
+		} else {
+			// Stesso criterio della Bullet: m_numIterations iterazioni, interrotte solo dalla soglia m_leastSquaresResidualThreshold
+			limit = btMax(infoGlobal.m_numIterations, this->m_maxOverrideNumSolverIterations);
+			budget = limit;
+			converged = infoGlobal.m_leastSquaresResidualThreshold;
+			acceptable = -1.0f;
+		}
+
+		this->solveGroupCacheFriendlySplitImpulseIterations(bodies, numBodies, manifoldPtr, numManifolds, constraints, numConstraints, info, debugDrawer);
+
+		int used = 0;
+		for (int iteration = 0; iteration < limit; iteration++) {
+			this->m_leastSquaresResidual = this->solveSingleIteration(iteration, bodies, numBodies, manifoldPtr, numManifolds, constraints, numConstraints, info, debugDrawer);
+			used = iteration + 1;
+
+			if (this->m_leastSquaresResidual <= converged)
+				break;
+
+			if (used >= budget && this->m_leastSquaresResidual <= acceptable)
+				break;
+		}
+
+		this->current.islands++;
+		this->current.contacts += contacts;
+		this->current.iterations += used;
+		this->current.maxIslandIterations = btMax(this->current.maxIslandIterations, used);
+
+		return 0.0f;
+	}
+
+private:
+	// Attributo che indica se il numero di iterazioni viene scelto per ogni isola
+	bool adaptive;
+	// Attributi che rappresentano i limiti del numero di iterazioni
+	int minIterations;
+	int maxIterations;
+	int contactsPerIteration;
+	// Attributi che rappresentano le soglie dell'errore residuo
+	btScalar convergedResidual;
+	btScalar acceptableResidual;
+	// Attributi che contengono i contatori dello step in corso, dell'ultimo step completato e la loro somma
+	SolverStepStats current;
+	SolverStepStats lastStep;
+	SolverStepStats totals;
+
+	void clearStats(SolverStepStats &stats) {
+		stats.steps = 0;
+		stats.islands = 0;
+		stats.contacts = 0;
+		stats.iterations = 0;
+		stats.maxIslandIterations = 0;
+	}
+};
+
+#endif
@@ -0,0 +1,718 @@
+/*
+Classe FontAtlas e TextBatch
+- FontAtlas tiene aperto il font con la FreeType e rasterizza ogni carattere Unicode solo al primo utilizzo, impacchettandolo
+  riga per riga in pagine dell'atlas (una texture per pagina); all'avvio non viene caricato nessun glyph
+- Le pagine occupano al massimo la memoria indicata con setMemoryLimit: quando sono tutte piene viene svuotata la pagina
+  usata meno di recente, ed i suoi glyph verranno rasterizzati di nuovo quando serviranno
+- L'atlas non contiene i bitmap dei glyph ma il loro campo di distanza con segno (SDF): lo shader ricostruisce il contorno ad ogni
+  scala, per cui una sola dimensione di rasterizzazione serve testo di qualsiasi dimensione
+- TextBatch decodifica le stringhe UTF-8 e raccoglie i quad di tutte le stringhe scritte in un frame in un unico vertex buffer,
+  con il colore per vertice, renderizzato con una draw call per ogni pagina dell'atlas usata nel frame; caricamento e
+  rendering sono separati, per poter renderizzare piu' volte un buffer che non cambia
+*/
+
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <utils/shader.h>
+#include <utils/glstate.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+
+using namespace std;
+
+// Dimensione in pixel a cui le celle dell'atlas corrispondono 1:1 allo schermo, fattore di sovracampionamento con cui i glyph
+// vengono rasterizzati per calcolare le distanze, e distanza massima dal contorno rappresentata nell'atlas, in pixel dell'atlas
+#define FONT_SDF_SIZE 32
+#define FONT_SDF_OVERSAMPLE 4
+#define FONT_SDF_SPREAD 4
+// Lato in pixel di una pagina dell'atlas e spazio lasciato tra un glyph e l'altro, per evitare che il filtro lineare legga i glyph vicini
+#define FONT_ATLAS_PAGE_SIZE 512
+#define FONT_ATLAS_PADDING 1
+// Memoria massima predefinita delle pagine dell'atlas, in byte (4 pagine)
+#define FONT_ATLAS_DEFAULT_MEMORY (4 * FONT_ATLAS_PAGE_SIZE * FONT_ATLAS_PAGE_SIZE)
+// Carattere usato al posto delle sequenze UTF-8 non valide
+#define UTF8_REPLACEMENT_CHARACTER 0xFFFD
+
+/*
+ * Variabile globale che rappresenta le informazioni di un glyph nell'atlas
+ */
+struct GlyphInfo {
+	// Coordinate texture dell'angolo in alto a sinistra e in basso a destra del glyph
+	glm::vec2 uvMin;
+	glm::vec2 uvMax;
+	// Dimensione della cella del glyph, in pixel alla dimensione FONT_SDF_SIZE
+	glm::vec2 size;
+	// Offset dalla baseline all'angolo in alto a sinistra della cella
+	glm::vec2 bearing;
+	// Spostamento orizzontale fino al carattere successivo
+	GLfloat advance;
+	// Pagina dell'atlas che contiene il glyph, -1 per i caratteri senza bitmap come lo spazio
+	int page;
+};
+
+/*
+ * Variabile globale che rappresenta un vertice del testo: posizione sullo schermo, coordinate texture e colore
+ */
+struct TextVertex {
+	glm::vec2 position;
+
+	glm::vec2 texCoords;
+
+	glm::vec3 color;
+};
+
+/*
+ * Struttura che raccoglie i contatori dell'atlas
+ */
+struct FontAtlasStats {
+	// Numero di glyph presenti nell'atlas
+	size_t glyphs;
+	// Numero di glyph rasterizzati dalla creazione dell'atlas, compresi quelli rasterizzati di nuovo dopo un'eliminazione
+	size_t rasterized;
+	// Numero di pagine allocate e memoria da esse occupata, in byte
+	size_t pages;
+	size_t bytes;
+	// Numero di pagine svuotate per far posto a nuovi glyph
+	size_t evictions;
+};
+
+/*
+ * Funzione che decodifica il carattere UTF-8 che inizia alla posizione i del testo, e sposta i all'inizio del carattere successivo.
+ * Le sequenze non valide o troncate diventano UTF8_REPLACEMENT_CHARACTER, consumando solo il primo byte.
+ */
+inline uint32_t decode_utf8(const string &text, size_t &i) {
+	unsigned char first = (unsigned char) text[i++];
+	if (first < 0x80)
+		return first;
+
+	int extra;
+	uint32_t codepoint, minimum;
+
+	if ((first & 0xE0) == 0xC0) {
+		extra = 1; codepoint = first & 0x1F; minimum = 0x80;
+	} else if ((first & 0xF0) == 0xE0) {
+		extra = 2; codepoint = first & 0x0F; minimum = 0x800;
+	} else if ((first & 0xF8) == 0xF0) {
+		extra = 3; codepoint = first & 0x07; minimum = 0x10000;
+	} else
+		return UTF8_REPLACEMENT_CHARACTER;
+
+	for (int k = 0; k < extra; k++) {
+		if (i + k >= text.size() || ((unsigned char) text[i + k] & 0xC0) != 0x80)
+			return UTF8_REPLACEMENT_CHARACTER;
+		codepoint = (codepoint << 6) | ((unsigned char) text[i + k] & 0x3F);
+	}
+	i += extra;
+
+	// Scarto le codifiche piu' lunghe del necessario, i surrogati UTF-16 ed i valori oltre l'ultimo carattere Unicode
+	if (codepoint < minimum || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+		return UTF8_REPLACEMENT_CHARACTER;
+
+	return codepoint;
+}
+
+/********** classe FONTATLAS **********/
+class FontAtlas {
+public:
+	// Costruttore della classe, l'atlas e' vuoto finche' non viene aperto un font con Open
+	FontAtlas() : library(NULL), face(NULL), maxPages(1), current(-1), frame(1), rasterized(0), evictions(0) {
+		this->empty = GlyphInfo();
+		this->empty.page = -1;
+		this->setMemoryLimit(FONT_ATLAS_DEFAULT_MEMORY);
+	}
+
+	/*
+	 * Metodo che apre il font, tenuto aperto fino a Delete per rasterizzare i glyph al primo utilizzo.
+	 * Prende in input i seguenti valori:
+	 * - path: string, percorso del file del font
+	 */
+	bool Open(const string &path) {
+		if (FT_Init_FreeType(&this->library)) {
+			cout << "ERROR::FONTATLAS::FREETYPE_NOT_INITIALIZED" << endl;
+			this->library = NULL;
+			return false;
+		}
+
+		if (FT_New_Face(this->library, path.c_str(), 0, &this->face) || FT_Set_Pixel_Sizes(this->face, 0, FONT_SDF_SIZE * FONT_SDF_OVERSAMPLE)) {
+			cout << "ERROR::FONTATLAS::FONT_NOT_LOADED: " << path << endl;
+			this->face = NULL;
+			return false;
+		}
+
+		return true;
+	}
+
+	/*
+	 * Metodo set per la memoria massima delle pagine dell'atlas, in byte; viene comunque mantenuta almeno una pagina
+	 */
+	void setMemoryLimit(size_t bytes) {
+		this->maxPages = max((int) (bytes / (FONT_ATLAS_PAGE_SIZE * FONT_ATLAS_PAGE_SIZE)), 1);
+	}
+
+	/*
+	 * Metodo get per le informazioni di un glyph, rasterizzato ed aggiunto all'atlas se non e' gia' presente.
+	 * I caratteri che il font non contiene usano il glyph '?'. Se l'atlas e' pieno di glyph usati nel frame corrente
+	 * viene restituito un glyph vuoto, ed il carattere verra' caricato in un frame successivo.
+	 * Prende in input i seguenti valori:
+	 * - codepoint: uint32_t, codice Unicode del carattere
+	 */
+	const GlyphInfo& getGlyph(uint32_t codepoint) {
+		unordered_map<uint32_t, GlyphInfo>::iterator found = this->glyphs.find(codepoint);
+
+		if (found == this->glyphs.end()) {
+			GlyphInfo glyph;
+
+			if (this->face == NULL)
+				return this->empty;
+
+			if (FT_Get_Char_Index(this->face, codepoint) == 0 && codepoint != '?') {
+				// Il glyph sostitutivo viene registrato anche con il codice del carattere mancante, nella stessa pagina
+				const GlyphInfo &replacement = this->getGlyph('?');
+				if (&replacement == &this->empty)
+					return this->empty;
+				glyph = replacement;
+			} else if (!this->loadGlyph(codepoint, glyph))
+				return this->empty;
+
+			if (glyph.page >= 0)
+				this->pages[glyph.page].codepoints.push_back(codepoint);
+
+			found = this->glyphs.insert(make_pair(codepoint, glyph)).first;
+		}
+
+		if (found->second.page >= 0)
+			this->pages[found->second.page].lastUsed = this->frame;
+
+		return found->second;
+	}
+
+	/*
+	 * Metodo che indica se un glyph restituito da getGlyph e' vuoto perche' l'atlas era pieno, e va quindi richiesto in un frame successivo
+	 */
+	bool isDeferred(const GlyphInfo &glyph) const {
+		return &glyph == &this->empty && this->face != NULL;
+	}
+
+	/*
+	 * Metodo che segna una pagina come usata nel frame corrente, per i glyph letti in un frame precedente e riutilizzati
+	 */
+	void Touch(int page) {
+		this->pages[page].lastUsed = this->frame;
+	}
+
+	/*
+	 * Metodo get per il numero di pagine svuotate: quando cambia, i vertici calcolati in precedenza possono riferirsi a glyph non piu' presenti
+	 */
+	size_t getEvictions() const {
+		return this->evictions;
+	}
+
+	/*
+	 * Metodo che chiude il frame corrente: le pagine usate da qui in avanti potranno essere svuotate solo nei frame successivi
+	 */
+	void EndFrame() {
+		this->frame++;
+	}
+
+	/*
+	 * Metodo get per la dimensione in pixel a cui le metriche dei glyph corrispondono ai pixel dell'atlas
+	 */
+	GLfloat getPixelSize() const {
+		return (GLfloat) FONT_SDF_SIZE;
+	}
+
+	/*
+	 * Metodi get per il numero di pagine dell'atlas e per la texture di una pagina
+	 */
+	int getPageCount() const {
+		return (int) this->pages.size();
+	}
+
+	GLuint getPageTexture(int page) const {
+		return this->pages[page].texture;
+	}
+
+	/*
+	 * Metodo get per i contatori dell'atlas
+	 */
+	FontAtlasStats getStats() const {
+		FontAtlasStats stats;
+		stats.glyphs = this->glyphs.size();
+		stats.rasterized = this->rasterized;
+		stats.pages = this->pages.size();
+		stats.bytes = this->pages.size() * FONT_ATLAS_PAGE_SIZE * FONT_ATLAS_PAGE_SIZE;
+		stats.evictions = this->evictions;
+		return stats;
+	}
+
+	/*
+	 * Metodo che, nel momento della chiusura dell'applicazione, dealloca le pagine dell'atlas e chiude il font
+	 */
+	void Delete() {
+		for (size_t p = 0; p < this->pages.size(); p++)
+			gl_state().DeleteTextures(1, &this->pages[p].texture);
+		this->pages.clear();
+		this->glyphs.clear();
+		this->current = -1;
+
+		if (this->face != NULL)
+			FT_Done_Face(this->face);
+		if (this->library != NULL)
+			FT_Done_FreeType(this->library);
+		this->face = NULL;
+		this->library = NULL;
+	}
+
+private:
+	/*
+	 * Struttura che rappresenta una pagina dell'atlas: texture, posizione di inserimento della riga corrente,
+	 * ultimo frame in cui e' stata usata e caratteri che contiene, da rimuovere quando la pagina viene svuotata
+	 */
+	struct Page {
+		GLuint texture;
+		int x, y, rowHeight;
+		unsigned long lastUsed;
+		vector<uint32_t> codepoints;
+	};
+
+	// Attributi che rappresentano la libreria FreeType ed il font aperto
+	FT_Library library;
+	FT_Face face;
+	// Attributo che contiene le informazioni dei glyph caricati, indicizzate dal codice Unicode
+	unordered_map<uint32_t, GlyphInfo> glyphs;
+	// Attributi che rappresentano le pagine, il loro numero massimo e la pagina in cui vengono inseriti i nuovi glyph
+	vector<Page> pages;
+	int maxPages;
+	int current;
+	// Attributo che conta i frame, per scegliere la pagina usata meno di recente
+	unsigned long frame;
+	// Attributi che contano i glyph rasterizzati e le pagine svuotate
+	size_t rasterized;
+	size_t evictions;
+	// Glyph vuoto, restituito quando un carattere non puo' essere caricato
+	GlyphInfo empty;
+
+	/*
+	 * Metodo che rasterizza un glyph, ne calcola il campo di distanza e lo copia in una pagina dell'atlas
+	 */
+	bool loadGlyph(uint32_t codepoint, GlyphInfo &glyph) {
+		const int oversample = FONT_SDF_OVERSAMPLE, spread = FONT_SDF_SPREAD;
+
+		if (FT_Load_Char(this->face, codepoint, FT_LOAD_RENDER)) {
+			cout << "ERROR::FONTATLAS::GLYPH_NOT_LOADED: " << codepoint << endl;
+			return false;
+		}
+
+		FT_GlyphSlot slot = this->face->glyph;
+		glyph = GlyphInfo();
+		glyph.page = -1;
+		// L'advance della FreeType e' espresso in 1/64 di pixel
+		glyph.advance = slot->advance.x / (64.0f * oversample);
+
+		// Gli spazi non hanno un bitmap, quindi nessuna cella nell'atlas
+		if (slot->bitmap.width == 0 || slot->bitmap.rows == 0)
+			return true;
+
+		// La cella contiene il glyph ridotto piu' un bordo di spread pixel, dove la distanza decresce fino a 0
+		glm::ivec2 cell(((int) slot->bitmap.width + oversample - 1) / oversample + 2 * spread,
+						((int) slot->bitmap.rows + oversample - 1) / oversample + 2 * spread);
+		glm::ivec2 origin;
+
+		glyph.page = this->allocate(cell, origin);
+		if (glyph.page < 0)
+			return false;
+
+		glyph.size = glm::vec2((GLfloat) cell.x, (GLfloat) cell.y);
+		glyph.bearing = glm::vec2((GLfloat) slot->bitmap_left / oversample - spread, (GLfloat) slot->bitmap_top / oversample + spread);
+		glyph.uvMin = glm::vec2((GLfloat) origin.x / FONT_ATLAS_PAGE_SIZE, (GLfloat) origin.y / FONT_ATLAS_PAGE_SIZE);
+		glyph.uvMax = glm::vec2((GLfloat) (origin.x + cell.x) / FONT_ATLAS_PAGE_SIZE, (GLfloat) (origin.y + cell.y) / FONT_ATLAS_PAGE_SIZE);
+
+		vector<unsigned char> distances;
+		this->computeDistanceField(slot->bitmap, cell, distances);
+
+		// Le righe della cella hanno 1 byte per pixel, per cui disattivo l'allineamento a 4 byte di OpenGL
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		gl_state().BindTexture(GL_TEXTURE_2D, this->pages[glyph.page].texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, origin.x, origin.y, cell.x, cell.y, GL_RED, GL_UNSIGNED_BYTE, &distances[0]);
+
+		this->rasterized++;
+		return true;
+	}
+
+	/*
+	 * Metodo che riserva lo spazio per una cella nella pagina corrente. Quando la pagina e' piena si passa ad una nuova pagina,
+	 * oppure, raggiunto il limite di memoria, alla pagina usata meno di recente, che viene svuotata.
+	 * Restituisce l'indice della pagina, o -1 se tutte le pagine sono state usate nel frame corrente.
+	 */
+	int allocate(const glm::ivec2 &cell, glm::ivec2 &origin) {
+		if (cell.x + 2 * FONT_ATLAS_PADDING > FONT_ATLAS_PAGE_SIZE || cell.y + 2 * FONT_ATLAS_PADDING > FONT_ATLAS_PAGE_SIZE)
+			return -1;
+
+		if (this->current >= 0 && this->fit(this->pages[this->current], cell, origin))
+			return this->current;
+
+		if ((int) this->pages.size() < this->maxPages) {
+			Page page;
+			page.lastUsed = this->frame;
+			glGenTextures(1, &page.texture);
+			gl_state().BindTexture(GL_TEXTURE_2D, page.texture);
+			// Il filtro lineare interpola le distanze, ed e' questo che rende il contorno nitido a qualsiasi scala
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+			this->pages.push_back(page);
+			this->current = (int) this->pages.size() - 1;
+		} else {
+			int oldest = -1;
+			for (int p = 0; p < (int) this->pages.size(); p++)
+				if (this->pages[p].lastUsed < this->frame && (oldest < 0 || this->pages[p].lastUsed < this->pages[oldest].lastUsed))
+					oldest = p;
+
+			if (oldest < 0)
+				return -1;
+
+			for (size_t i = 0; i < this->pages[oldest].codepoints.size(); i++)
+				this->glyphs.erase(this->pages[oldest].codepoints[i]);
+			this->pages[oldest].codepoints.clear();
+			this->pages[oldest].lastUsed = this->frame;
+			this->evictions++;
+			this->current = oldest;
+		}
+
+		// La pagina nuova o svuotata viene azzerata, cosi' il filtro lineare ai bordi delle celle legge solo distanze nulle
+		Page &page = this->pages[this->current];
+		vector<unsigned char> zero(FONT_ATLAS_PAGE_SIZE * FONT_ATLAS_PAGE_SIZE, 0);
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		gl_state().BindTexture(GL_TEXTURE_2D, page.texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, FONT_ATLAS_PAGE_SIZE, FONT_ATLAS_PAGE_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, &zero[0]);
+
+		page.x = FONT_ATLAS_PADDING;
+		page.y = FONT_ATLAS_PADDING;
+		page.rowHeight = 0;
+
+		this->fit(page, cell, origin);
+		return this->current;
+	}
+
+	/*
+	 * Metodo che inserisce una cella nella riga corrente della pagina, o in una nuova riga se non c'e' spazio
+	 */
+	bool fit(Page &page, const glm::ivec2 &cell, glm::ivec2 &origin) {
+		if (page.x + cell.x + FONT_ATLAS_PADDING > FONT_ATLAS_PAGE_SIZE) {
+			page.x = FONT_ATLAS_PADDING;
+			page.y += page.rowHeight + FONT_ATLAS_PADDING;
+			page.rowHeight = 0;
+		}
+
+		if (page.y + cell.y + FONT_ATLAS_PADDING > FONT_ATLAS_PAGE_SIZE)
+			return false;
+
+		origin = glm::ivec2(page.x, page.y);
+		page.x += cell.x + FONT_ATLAS_PADDING;
+		page.rowHeight = max(page.rowHeight, cell.y);
+		return true;
+	}
+
+	/*
+	 * Metodo che calcola il campo di distanza di un glyph e lo campiona nella sua cella dell'atlas.
+	 * La distanza con segno (positiva dentro il glyph) viene portata in [0, 255], con il contorno a 128 e spread pixel
+	 * dell'atlas di distanza massima rappresentabile da entrambi i lati.
+	 */
+	void computeDistanceField(const FT_Bitmap &bitmap, const glm::ivec2 &cell, vector<unsigned char> &out) {
+		const int oversample = FONT_SDF_OVERSAMPLE, border = FONT_SDF_SPREAD * FONT_SDF_OVERSAMPLE;
+		const int w = cell.x * oversample, h = cell.y * oversample;
+
+		// Pixel del glyph ad alta risoluzione, con il bordo attorno
+		vector<bool> inside(w * h, false);
+		for (unsigned int row = 0; row < bitmap.rows; row++)
+			for (unsigned int col = 0; col < bitmap.width; col++)
+				inside[(row + border) * w + col + border] = bitmap.buffer[row * bitmap.pitch + col] >= 128;
+
+		// Distanze al quadrato di ogni pixel dal pixel piu' vicino fuori e dentro il glyph
+		vector<float> toOutside, toInside;
+		distanceTransform(inside, w, h, false, toOutside);
+		distanceTransform(inside, w, h, true, toInside);
+
+		out.resize(cell.x * cell.y);
+		for (int row = 0; row < cell.y; row++) {
+			for (int col = 0; col < cell.x; col++) {
+				// Campiono il pixel ad alta risoluzione al centro del pixel dell'atlas
+				int i = (row * oversample + oversample / 2) * w + col * oversample + oversample / 2;
+				float distance = (sqrt(toOutside[i]) - sqrt(toInside[i])) / oversample;
+				float value = 0.5f + 0.5f * distance / FONT_SDF_SPREAD;
+
+				out[row * cell.x + col] = (unsigned char) (255.0f * min(max(value, 0.0f), 1.0f));
+			}
+		}
+	}
+
+	/*
+	 * Metodo che calcola la trasformata della distanza euclidea al quadrato (algoritmo di Felzenszwalb e Huttenlocher):
+	 * per ogni pixel la distanza dal pixel piu' vicino con inside uguale a target, in due passate separabili per colonne e righe.
+	 */
+	static void distanceTransform(const vector<bool> &inside, int w, int h, bool target, vector<float> &grid) {
+		const float INF = 1e20f;
+
+		grid.resize(w * h);
+		for (int i = 0; i < w * h; i++)
+			grid[i] = inside[i] == target ? 0.0f : INF;
+
+		int n = max(w, h);
+		vector<float> f(n), d(n), z(n + 1);
+		vector<int> v(n);
+
+		for (int col = 0; col < w; col++) {
+			for (int row = 0; row < h; row++)
+				f[row] = grid[row * w + col];
+			distanceTransform1D(f, h, d, v, z);
+			for (int row = 0; row < h; row++)
+				grid[row * w + col] = d[row];
+		}
+
+		for (int row = 0; row < h; row++) {
+			for (int col = 0; col < w; col++)
+				f[col] = grid[row * w + col];
+			distanceTransform1D(f, w, d, v, z);
+			for (int col = 0; col < w; col++)
+				grid[row * w + col] = d[col];
+		}
+	}
+
+	/*
+	 * Metodo che calcola la trasformata della distanza al quadrato di una riga, come inviluppo inferiore delle parabole centrate in ogni pixel
+	 */
+	static void distanceTransform1D(const vector<float> &f, int n, vector<float> &d, vector<int> &v, vector<float> &z) {
+		const float INF = 1e20f;
+		int k = 0;
+
+		v[0] = 0;
+		z[0] = -INF;
+		z[1] = INF;
+
+		for (int q = 1; q < n; q++) {
+			float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * q - 2.0f * v[k]);
+			while (s <= z[k]) {
+				k--;
+				s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * q - 2.0f * v[k]);
+			}
+			k++;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = INF;
+		}
+
+		k = 0;
+		for (int q = 0; q < n; q++) {
+			while (z[k + 1] < q)
+				k++;
+			d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+		}
+	}
+};
+
+/*
+ * Funzione che calcola i quad di una stringa e li aggiunge ai vertici della pagina dell'atlas che contiene ciascun glyph.
+ * Prende in input i seguenti valori:
+ * - atlas: FontAtlas, atlas da cui leggere i glyph
+ * - text: string, testo da scrivere, codificato in UTF-8
+ * - x, y: GLfloat, posizione della baseline del primo carattere, in pixel
+ * - size: GLfloat, altezza del font in pixel
+ * - color: vec3, colore del testo
+ * - pages: vector<vector<TextVertex>>, vertici divisi per pagina
+ * Restituisce false se almeno un glyph non e' stato aggiunto all'atlas perche' pieno, e la stringa va ricalcolata in un frame successivo.
+ */
+inline bool layout_text(FontAtlas &atlas, const string &text, GLfloat x, GLfloat y, GLfloat size, const glm::vec3 &color, vector< vector<TextVertex> > &pages) {
+	GLfloat scale = size / atlas.getPixelSize();
+	bool complete = true;
+
+	for (size_t i = 0; i < text.size(); ) {
+		const GlyphInfo &glyph = atlas.getGlyph(decode_utf8(text, i));
+
+		if (atlas.isDeferred(glyph))
+			complete = false;
+
+		// Gli spazi non hanno un bitmap: sposto solo la posizione del carattere successivo
+		if (glyph.page >= 0) {
+			GLfloat xpos = x + glyph.bearing.x * scale;
+			GLfloat ypos = y - (glyph.size.y - glyph.bearing.y) * scale;
+			GLfloat w = glyph.size.x * scale;
+			GLfloat h = glyph.size.y * scale;
+
+			TextVertex topLeft = { glm::vec2(xpos, ypos + h), glyph.uvMin, color };
+			TextVertex bottomLeft = { glm::vec2(xpos, ypos), glm::vec2(glyph.uvMin.x, glyph.uvMax.y), color };
+			TextVertex bottomRight = { glm::vec2(xpos + w, ypos), glyph.uvMax, color };
+			TextVertex topRight = { glm::vec2(xpos + w, ypos + h), glm::vec2(glyph.uvMax.x, glyph.uvMin.y), color };
+
+			if (glyph.page >= (int) pages.size())
+				pages.resize(glyph.page + 1);
+
+			vector<TextVertex> &page = pages[glyph.page];
+			page.push_back(topLeft);
+			page.push_back(bottomLeft);
+			page.push_back(bottomRight);
+			page.push_back(topLeft);
+			page.push_back(bottomRight);
+			page.push_back(topRight);
+		}
+
+		x += glyph.advance * scale;
+	}
+
+	return complete;
+}
+
+/********** classe TEXTBATCH **********/
+class TextBatch {
+public:
+	// Costruttore della classe, i buffer vengono creati con Setup quando il contesto OpenGL e' attivo
+	TextBatch() : VAO(0), VBO(0), capacity(0), drawCalls(0) {
+	}
+
+	/*
+	 * Metodo che crea il VAO ed il VBO del testo, riutilizzati per tutti i frame
+	 */
+	void Setup() {
+		glGenVertexArrays(1, &this->VAO);
+		glGenBuffers(1, &this->VBO);
+
+		gl_state().BindVertexArray(this->VAO);
+		gl_state().BindBuffer(GL_ARRAY_BUFFER, this->VBO);
+
+		// Posizione e coordinate texture nella location 0, come vec4
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (GLvoid*) offsetof(TextVertex, position));
+		// Colore
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (GLvoid*) offsetof(TextVertex, color));
+
+		gl_state().BindVertexArray(0);
+		gl_state().BindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	/*
+	 * Metodo che svuota il batch all'inizio del frame; la memoria dei vettori di vertici viene mantenuta
+	 */
+	void Begin() {
+		for (size_t p = 0; p < this->vertices.size(); p++)
+			this->vertices[p].clear();
+	}
+
+	/*
+	 * Metodo che aggiunge al batch dei vertici gia' calcolati con layout_text, divisi per pagina dell'atlas
+	 */
+	void Append(const vector< vector<TextVertex> > &pages) {
+		if (pages.size() > this->vertices.size())
+			this->vertices.resize(pages.size());
+
+		for (size_t p = 0; p < pages.size(); p++)
+			this->vertices[p].insert(this->vertices[p].end(), pages[p].begin(), pages[p].end());
+	}
+
+	/*
+	 * Metodo che carica nel VBO i vertici del batch, uno di seguito all'altro in ordine di pagina
+	 */
+	void Upload() {
+		size_t count = 0;
+		for (size_t p = 0; p < this->vertices.size(); p++)
+			count += this->vertices[p].size();
+
+		if (count > 0) {
+			GLsizeiptr size = count * sizeof(TextVertex);
+
+			gl_state().BindBuffer(GL_ARRAY_BUFFER, this->VBO);
+			// Il buffer cresce raddoppiando; altrimenti viene riallocato della stessa dimensione (orphaning),
+			// cosi' il driver non deve attendere che la GPU abbia finito di leggere i vertici del frame precedente
+			if (size > this->capacity)
+				this->capacity = max(size, 2 * this->capacity);
+			glBufferData(GL_ARRAY_BUFFER, this->capacity, NULL, GL_STREAM_DRAW);
+
+			GLintptr offset = 0;
+			for (size_t p = 0; p < this->vertices.size(); p++) {
+				if (this->vertices[p].empty())
+					continue;
+				glBufferSubData(GL_ARRAY_BUFFER, offset, this->vertices[p].size() * sizeof(TextVertex), &this->vertices[p][0]);
+				offset += this->vertices[p].size() * sizeof(TextVertex);
+			}
+		}
+	}
+
+	/*
+	 * Metodo che renderizza i vertici caricati con l'ultimo Upload, con una draw call per ogni pagina dell'atlas usata.
+	 * Le pagine renderizzate vengono segnate come usate nel frame corrente, cosi' l'atlas non le svuota.
+	 * Prende in input i seguenti valori:
+	 * - shader: Shader, shader del testo
+	 * - atlas: FontAtlas, atlas da cui sono stati letti i glyph
+	 */
+	void Draw(Shader &shader, FontAtlas &atlas) {
+		this->drawCalls = 0;
+
+		size_t count = 0;
+		for (size_t p = 0; p < this->vertices.size(); p++)
+			count += this->vertices[p].size();
+
+		if (count > 0) {
+			shader.Use();
+			gl_state().ActiveTexture(GL_TEXTURE0);
+			gl_state().BindVertexArray(this->VAO);
+
+			GLint first = 0;
+			for (size_t p = 0; p < this->vertices.size(); p++) {
+				if (this->vertices[p].empty())
+					continue;
+				atlas.Touch((int) p);
+				gl_state().BindTexture(GL_TEXTURE_2D, atlas.getPageTexture((int) p));
+				glDrawArrays(GL_TRIANGLES, first, (GLsizei) this->vertices[p].size());
+				first += (GLint) this->vertices[p].size();
+				this->drawCalls++;
+			}
+		}
+	}
+
+	/*
+	 * Metodo get per il numero di draw call dell'ultimo Draw
+	 */
+	int getDrawCalls() const {
+		return this->drawCalls;
+	}
+
+	/*
+	 * Metodo che, nel momento della chiusura dell'applicazione, dealloca i buffer
+	 */
+	void Delete() {
+		gl_state().DeleteVertexArrays(1, &this->VAO);
+		gl_state().DeleteBuffers(1, &this->VBO);
+		this->VAO = 0;
+		this->VBO = 0;
+		this->capacity = 0;
+	}
+
+private:
+	// Attributo che contiene i vertici di tutte le stringhe del frame, divisi per pagina dell'atlas
+	vector< vector<TextVertex> > vertices;
+	// Attributi che rappresentano i buffer OpenGL e la dimensione allocata del VBO
+	GLuint VAO, VBO;
+	GLsizeiptr capacity;
+	// Attributo che conta le draw call dell'ultimo Flush
+	int drawCalls;
+};
+
+#endif
@@ -0,0 +1,308 @@
+/*
+Classe VertexCache
+- Ottimizza all'importazione l'ordine di triangoli e vertici di una mesh, senza cambiarne la geometria
+- I triangoli vengono riordinati per la cache post-transform dei vertici con l'algoritmo di Forsyth: ad ogni passo viene emesso
+  il triangolo con il punteggio piu' alto, dato dalla posizione dei suoi vertici in una cache LRU simulata e dal numero di
+  triangoli che restano da emettere per ogni vertice
+- L'ordine ottenuto viene diviso in cluster nei punti in cui la cache riparte da zero, ed i cluster vengono ordinati dal piu'
+  esterno al piu' interno: renderizzando prima le superfici che coprono le altre, il depth test scarta piu' frammenti (overdraw)
+- I vertici vengono rinumerati nell'ordine in cui i triangoli li usano, in modo che il fetch legga il vertex buffer in sequenza
+- L'ACMR (numero medio di vertici trasformati per triangolo) viene misurato simulando una cache FIFO, come quella delle GPU
+*/
+
+#ifndef VERTEXCACHE_H
+#define VERTEXCACHE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+// Dimensione della cache LRU simulata dall'algoritmo di Forsyth
+#define VERTEX_CACHE_SIZE 32
+// Dimensione della cache FIFO con cui viene misurato l'ACMR
+#define VERTEX_CACHE_FIFO_SIZE 16
+// Indice dei vertici non ancora rinumerati
+#define VERTEX_CACHE_UNUSED ((GLuint) -1)
+
+/********** classe VERTEXCACHE **********/
+class VertexCache {
+public:
+	/*
+	 * Metodo che riordina i triangoli per la cache dei vertici (algoritmo di Forsyth).
+	 * Prende in input i seguenti valori:
+	 * - indices: vector<GLuint>, indici dei triangoli, riordinati sul posto
+	 * - vertexCount: size_t, numero di vertici della mesh
+	 */
+	static void OptimizeTriangles(vector<GLuint> &indices, size_t vertexCount) {
+		size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		// Triangoli adiacenti ad ogni vertice, in un unico vettore: i primi valence[v] di ogni vertice sono quelli ancora da emettere
+		vector<GLuint> valence(vertexCount, 0);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			valence[indices[i]]++;
+
+		vector<GLuint> offsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; v++)
+			offsets[v + 1] = offsets[v] + valence[v];
+
+		vector<GLuint> adjacency(triangleCount * 3);
+		vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[fill[indices[i]]++] = (GLuint) (i / 3);
+
+		vector<int> cachePosition(vertexCount, -1);
+		vector<GLfloat> vertexScore(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+			vertexScore[v] = score(-1, valence[v]);
+
+		vector<GLfloat> triangleScore(triangleCount);
+		vector<bool> emitted(triangleCount, false);
+		for (size_t t = 0; t < triangleCount; t++)
+			triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+		vector<GLuint> cache, nextCache;
+		cache.reserve(VERTEX_CACHE_SIZE + 3);
+		nextCache.reserve(VERTEX_CACHE_SIZE + 3);
+
+		vector<GLuint> result;
+		result.reserve(triangleCount * 3);
+
+		size_t cursor = 0;
+		long best = -1;
+
+		while (result.size() < triangleCount * 3) {
+			// Se nessun triangolo dei vertici in cache e' ancora da emettere, riparto dal primo triangolo non emesso
+			if (best < 0) {
+				while (emitted[cursor])
+					cursor++;
+				best = (long) cursor;
+			}
+
+			const GLuint *triangle = &indices[best * 3];
+			emitted[best] = true;
+			result.insert(result.end(), triangle, triangle + 3);
+
+			// Il triangolo emesso viene spostato in fondo ai triangoli ancora da emettere dei suoi vertici
+			for (int k = 0; k < 3; k++) {
+				GLuint v = triangle[k];
+				GLuint *first = &adjacency[offsets[v]];
+				GLuint *last = first + valence[v] - 1;
+				*std::find(first, last, (GLuint) best) = *last;
+				*last = (GLuint) best;
+				valence[v]--;
+			}
+
+			// Cache LRU: i vertici del triangolo in testa, seguiti da quelli che c'erano gia'
+			nextCache.assign(triangle, triangle + 3);
+			for (size_t i = 0; i < cache.size(); i++)
+				if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2])
+					nextCache.push_back(cache[i]);
+
+			// Aggiorno i punteggi dei vertici, compresi quelli usciti dalla cache
+			for (size_t i = 0; i < nextCache.size(); i++) {
+				GLuint v = nextCache[i];
+				cachePosition[v] = i < VERTEX_CACHE_SIZE ? (int) i : -1;
+				vertexScore[v] = score(cachePosition[v], valence[v]);
+			}
+
+			// Il prossimo triangolo e' il migliore tra quelli dei vertici toccati, gli unici il cui punteggio e' cambiato
+			best = -1;
+			GLfloat bestScore = -1.0f;
+			for (size_t i = 0; i < nextCache.size(); i++) {
+				GLuint v = nextCache[i];
+
+				for (GLuint a = offsets[v]; a < offsets[v] + valence[v]; a++) {
+					GLuint t = adjacency[a];
+					triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+					if (triangleScore[t] > bestScore) {
+						bestScore = triangleScore[t];
+						best = (long) t;
+					}
+				}
+			}
+
+			if (nextCache.size() > VERTEX_CACHE_SIZE)
+				nextCache.resize(VERTEX_CACHE_SIZE);
+			cache.swap(nextCache);
+		}
+
+		indices.swap(result);
+	}
+
+	/*
+	 * Metodo che riordina i cluster di triangoli per ridurre l'overdraw, da chiamare dopo OptimizeTriangles.
+	 * Un cluster inizia ad ogni triangolo con tutti e tre i vertici fuori dalla cache FIFO: spostare i cluster interi non
+	 * peggiora l'ACMR, perche' ognuno riparte comunque con la cache vuota. I cluster vengono ordinati per la distanza dal
+	 * centro della mesh lungo la loro normale media: prima quelli esterni e rivolti verso l'esterno, che coprono gli altri.
+	 * Prende in input i seguenti valori:
+	 * - indices: vector<GLuint>, indici dei triangoli, riordinati sul posto
+	 * - positions: vec3*, posizione del primo vertice, letta con il passo indicato
+	 * - stride: size_t, passo tra un vertice e l'altro
+	 * - vertexCount: size_t, numero di vertici della mesh
+	 */
+	static void OptimizeOverdraw(vector<GLuint> &indices, const glm::vec3 *positions, size_t stride, size_t vertexCount) {
+		size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		// Inizio di ogni cluster, dalla simulazione della cache FIFO
+		vector<size_t> clusters;
+		vector<size_t> timestamps(vertexCount, 0);
+		size_t time = VERTEX_CACHE_FIFO_SIZE + 1;
+
+		for (size_t t = 0; t < triangleCount; t++) {
+			int misses = 0;
+			for (int k = 0; k < 3; k++)
+				if (miss(timestamps, indices[t * 3 + k], time))
+					misses++;
+
+			// Il primo cluster parte sempre da 0: un triangolo degenere iniziale ha meno di tre miss, e andrebbe perso
+			if (t == 0 || misses == 3)
+				clusters.push_back(t);
+		}
+		clusters.push_back(triangleCount);
+
+		if (clusters.size() <= 2)
+			return;
+
+		// Centro della mesh, pesato sull'area dei triangoli come i centri dei cluster
+		glm::vec3 meshCenter(0.0f);
+		GLfloat meshArea = 0.0f;
+		vector<glm::vec3> centers(clusters.size() - 1, glm::vec3(0.0f));
+		vector<glm::vec3> normals(clusters.size() - 1, glm::vec3(0.0f));
+		vector<GLfloat> areas(clusters.size() - 1, 0.0f);
+
+		for (size_t c = 0; c + 1 < clusters.size(); c++) {
+			for (size_t t = clusters[c]; t < clusters[c + 1]; t++) {
+				const glm::vec3 &p0 = position(positions, stride, indices[t * 3]);
+				const glm::vec3 &p1 = position(positions, stride, indices[t * 3 + 1]);
+				const glm::vec3 &p2 = position(positions, stride, indices[t * 3 + 2]);
+
+				glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+				GLfloat area = glm::length(normal);
+
+				centers[c] += (p0 + p1 + p2) * (area / 3.0f);
+				normals[c] += normal;
+				areas[c] += area;
+			}
+
+			meshCenter += centers[c];
+			meshArea += areas[c];
+		}
+
+		if (meshArea <= 0.0f)
+			return;
+		meshCenter /= meshArea;
+
+		vector< pair<GLfloat, size_t> > order(clusters.size() - 1);
+		for (size_t c = 0; c + 1 < clusters.size(); c++) {
+			GLfloat key = 0.0f;
+			if (areas[c] > 0.0f && glm::length(normals[c]) > 0.0f)
+				key = glm::dot(centers[c] / areas[c] - meshCenter, glm::normalize(normals[c]));
+
+			order[c] = make_pair(-key, c);
+		}
+		std::stable_sort(order.begin(), order.end());
+
+		vector<GLuint> result;
+		result.reserve(indices.size());
+		for (size_t i = 0; i < order.size(); i++) {
+			size_t c = order[i].second;
+			result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+		}
+
+		// I cluster coprono tutti i triangoli: il riordino non deve perderne nessuno
+		assert(result.size() == indices.size());
+
+		indices.swap(result);
+	}
+
+	/*
+	 * Metodo che rinumera i vertici nell'ordine in cui vengono usati dai triangoli; i vertici non usati finiscono in fondo.
+	 * Gli indici vengono aggiornati sul posto, ed i vertici vanno spostati con la tabella restituita.
+	 * Prende in input i seguenti valori:
+	 * - indices: vector<GLuint>, indici dei triangoli
+	 * - vertexCount: size_t, numero di vertici della mesh
+	 * - remap: vector<GLuint>, per ogni vertice la sua nuova posizione
+	 */
+	static void OptimizeVertexFetch(vector<GLuint> &indices, size_t vertexCount, vector<GLuint> &remap) {
+		remap.assign(vertexCount, VERTEX_CACHE_UNUSED);
+		GLuint next = 0;
+
+		for (size_t i = 0; i < indices.size(); i++) {
+			if (remap[indices[i]] == VERTEX_CACHE_UNUSED)
+				remap[indices[i]] = next++;
+			indices[i] = remap[indices[i]];
+		}
+
+		for (size_t v = 0; v < vertexCount; v++)
+			if (remap[v] == VERTEX_CACHE_UNUSED)
+				remap[v] = next++;
+	}
+
+	/*
+	 * Metodo che restituisce il numero di vertici trasformati renderizzando gli indici, con una cache FIFO di VERTEX_CACHE_FIFO_SIZE vertici:
+	 * diviso per il numero di triangoli e' l'ACMR
+	 * Prende in input i seguenti valori:
+	 * - indices: vector<GLuint>, indici dei triangoli
+	 * - vertexCount: size_t, numero di vertici della mesh
+	 */
+	static size_t CacheMisses(const vector<GLuint> &indices, size_t vertexCount) {
+		vector<size_t> timestamps(vertexCount, 0);
+		size_t time = VERTEX_CACHE_FIFO_SIZE + 1;
+		size_t misses = 0;
+
+		for (size_t i = 0; i < indices.size(); i++)
+			if (miss(timestamps, indices[i], time))
+				misses++;
+
+		return misses;
+	}
+
+private:
+	/*
+	 * Punteggio di un vertice secondo Forsyth: cresce con la posizione in cache (i vertici dell'ultimo triangolo hanno un punteggio
+	 * fisso, per non riusarli subito) e con il numero ridotto di triangoli ancora da emettere, per chiudere i vertici isolati
+	 */
+	static GLfloat score(int cachePosition, GLuint valence) {
+		if (valence == 0)
+			return -1.0f;
+
+		GLfloat result = 0.0f;
+		if (cachePosition >= 0) {
+			if (cachePosition < 3)
+				result = 0.75f;
+			else
+				result = pow(1.0f - (GLfloat) (cachePosition - 3) / (VERTEX_CACHE_SIZE - 3), 1.5f);
+		}
+
+		return result + 2.0f * pow((GLfloat) valence, -0.5f);
+	}
+
+	/*
+	 * Un vertice e' nella cache FIFO se e' stato inserito negli ultimi VERTEX_CACHE_FIFO_SIZE inserimenti; altrimenti viene inserito
+	 */
+	static bool miss(vector<size_t> &timestamps, GLuint vertex, size_t &time) {
+		if (time - timestamps[vertex] <= VERTEX_CACHE_FIFO_SIZE)
+			return false;
+
+		timestamps[vertex] = time++;
+		return true;
+	}
+
+	static const glm::vec3& position(const glm::vec3 *positions, size_t stride, GLuint vertex) {
+		return *(const glm::vec3*) ((const char*) positions + vertex * stride);
+	}
+};
+
+#endif
@@ -0,0 +1,225 @@
+/*
+Classe VertexLayout
+- Descrive il formato compresso con cui i vertici di una mesh vengono caricati nel vertex buffer: per ogni attributo
+  location, numero di componenti, tipo, normalizzazione ed offset, ed il passo tra un vertice e l'altro
+- Il formato viene scelto mesh per mesh in base ai dati: posizioni in half float se l'errore di quantizzazione resta sotto
+  la tolleranza, altrimenti in float; normali e tangenti in 10:10:10:2 normalizzato, con il segno della bitangente nelle
+  due componenti alte della tangente; coordinate texture a 16 bit, normalizzate se sono tutte in [0, 1] ed in half float
+  altrimenti. La bitangente non viene caricata, perche' si ricava da normale, tangente e segno
+- Gli attributi che la mesh non ha (coordinate texture e tangenti delle biglie, per esempio) non occupano spazio
+*/
+
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Errore massimo delle posizioni in half float, in frazione della dimensione della mesh: oltre si usano i float
+#define VERTEX_POSITION_TOLERANCE 0.001f
+
+/*
+ * Componenti presenti nei vertici di una mesh, oltre alla posizione
+ */
+enum VertexComponents {
+	VERTEX_POSITION = 0,
+	VERTEX_NORMAL = 1,
+	VERTEX_TEXCOORDS = 2,
+	VERTEX_TANGENT = 4,
+	VERTEX_ALL = VERTEX_NORMAL | VERTEX_TEXCOORDS | VERTEX_TANGENT
+};
+
+/*
+ * Struttura che descrive un attributo del vertice nel vertex buffer, con i parametri di glVertexAttribPointer
+ */
+struct VertexAttributeFormat {
+	GLuint location;
+	GLint size;
+	GLenum type;
+	GLboolean normalized;
+	GLuint offset;
+};
+
+/********** classe VERTEXLAYOUT **********/
+class VertexLayout {
+public:
+	// Attributo che contiene gli attributi presenti nel vertex buffer
+	vector<VertexAttributeFormat> attributes;
+	// Attributo che contiene il passo tra un vertice e l'altro, in byte
+	GLsizei stride;
+
+	// Costruttore della classe
+	VertexLayout() : stride(0) {
+	}
+
+	/*
+	 * Metodo che sceglie il formato piu' compatto per i vertici indicati.
+	 * Prende in input i seguenti valori:
+	 * - positions, texCoords: vec3* e vec2*, posizione e coordinate texture del primo vertice, lette con il passo indicato;
+	 *   texCoords e' ignorato se le componenti non comprendono VERTEX_TEXCOORDS
+	 * - stride: size_t, passo tra un vertice e l'altro nei dati di origine
+	 * - count: size_t, numero di vertici
+	 * - components: int, componenti presenti (VertexComponents)
+	 */
+	void Choose(const glm::vec3 *positions, const glm::vec2 *texCoords, size_t stride, size_t count, int components) {
+		this->attributes.clear();
+		this->stride = 0;
+
+		// Posizioni: l'errore del half float cresce con la distanza dall'origine, per cui viene misurato sui vertici
+		glm::vec3 min(0.0f), max(0.0f);
+		GLfloat error = 0.0f;
+		for (size_t i = 0; i < count; i++) {
+			const glm::vec3 &p = *(const glm::vec3*) ((const char*) positions + i * stride);
+			min = (i == 0) ? p : glm::min(min, p);
+			max = (i == 0) ? p : glm::max(max, p);
+			for (int c = 0; c < 3; c++)
+				error = glm::max(error, fabs(unpackHalf(packHalf(p[c])) - p[c]));
+		}
+
+		bool halfPositions = count > 0 && error <= glm::length(max - min) * VERTEX_POSITION_TOLERANCE;
+		if (halfPositions)
+			this->add(0, 3, GL_HALF_FLOAT, GL_FALSE, 4 * sizeof(uint16_t));
+		else
+			this->add(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat));
+
+		if (components & VERTEX_NORMAL)
+			this->add(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(uint32_t));
+
+		// Coordinate texture: normalizzate a 16 bit se stanno tutte in [0, 1], cosa che il half float non garantisce
+		if (components & VERTEX_TEXCOORDS) {
+			bool unit = true;
+			for (size_t i = 0; i < count && unit; i++) {
+				const glm::vec2 &uv = *(const glm::vec2*) ((const char*) texCoords + i * stride);
+				unit = uv.x >= 0.0f && uv.x <= 1.0f && uv.y >= 0.0f && uv.y <= 1.0f;
+			}
+
+			if (unit)
+				this->add(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, 2 * sizeof(uint16_t));
+			else
+				this->add(2, 2, GL_HALF_FLOAT, GL_FALSE, 2 * sizeof(uint16_t));
+		}
+
+		if (components & VERTEX_TANGENT)
+			this->add(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(uint32_t));
+	}
+
+	/*
+	 * Metodo che restituisce l'attributo con la location indicata, o NULL se il formato non lo comprende
+	 */
+	const VertexAttributeFormat* find(GLuint location) const {
+		for (size_t i = 0; i < this->attributes.size(); i++)
+			if (this->attributes[i].location == location)
+				return &this->attributes[i];
+		return NULL;
+	}
+
+	/*
+	 * Metodo che scrive un attributo di un vertice nel buffer compresso, nel formato scelto.
+	 * Prende in input i seguenti valori:
+	 * - data: unsigned char*, inizio del vertice nel buffer compresso
+	 * - attribute: VertexAttributeFormat, attributo da scrivere
+	 * - value: vec4, valore dell'attributo; per normali e tangenti w e' il segno della bitangente
+	 */
+	static void Write(unsigned char *data, const VertexAttributeFormat &attribute, const glm::vec4 &value) {
+		unsigned char *target = data + attribute.offset;
+
+		if (attribute.type == GL_FLOAT) {
+			memcpy(target, &value[0], attribute.size * sizeof(GLfloat));
+		} else if (attribute.type == GL_HALF_FLOAT) {
+			uint16_t halves[4] = { 0, 0, 0, 0 };
+			for (int c = 0; c < attribute.size; c++)
+				halves[c] = packHalf(value[c]);
+			memcpy(target, halves, attribute.size * sizeof(uint16_t));
+		} else if (attribute.type == GL_UNSIGNED_SHORT) {
+			uint16_t shorts[4];
+			for (int c = 0; c < attribute.size; c++)
+				shorts[c] = (uint16_t) floor(glm::clamp(value[c], 0.0f, 1.0f) * 65535.0f + 0.5f);
+			memcpy(target, shorts, attribute.size * sizeof(uint16_t));
+		} else if (attribute.type == GL_INT_2_10_10_10_REV) {
+			uint32_t packed = packSnorm(value.x, 511.0f, 0) | packSnorm(value.y, 511.0f, 10) | packSnorm(value.z, 511.0f, 20) | packSnorm(value.w, 1.0f, 30);
+			memcpy(target, &packed, sizeof(uint32_t));
+		}
+	}
+
+	/*
+	 * Metodo che converte un float in half float (IEEE 754 a 16 bit), con arrotondamento al piu' vicino
+	 */
+	static uint16_t packHalf(GLfloat value) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		uint16_t sign = (uint16_t) ((bits >> 16) & 0x8000);
+		int exponent = (int) ((bits >> 23) & 0xFF) - 127 + 15;
+		uint32_t mantissa = bits & 0x7FFFFF;
+
+		// Valori troppo grandi (e infiniti) diventano infinito, valori troppo piccoli zero
+		if (exponent >= 31)
+			return sign | 0x7C00;
+		if (exponent <= -10)
+			return sign;
+
+		// Numeri denormalizzati: la mantissa viene spostata insieme al bit implicito
+		if (exponent <= 0) {
+			mantissa |= 0x800000;
+			int shift = 14 - exponent;
+			uint32_t half = mantissa >> shift;
+			if ((mantissa >> (shift - 1)) & 1)
+				half++;
+			return sign | (uint16_t) half;
+		}
+
+		// L'arrotondamento puo' propagarsi all'esponente, che e' il comportamento corretto
+		uint32_t half = ((uint32_t) exponent << 10) | (mantissa >> 13);
+		if (mantissa & 0x1000)
+			half++;
+		return sign | (uint16_t) half;
+	}
+
+	/*
+	 * Metodo che converte un half float in float
+	 */
+	static GLfloat unpackHalf(uint16_t half) {
+		int exponent = (half >> 10) & 0x1F;
+		int mantissa = half & 0x3FF;
+		GLfloat value;
+
+		if (exponent == 0)
+			value = ldexp((GLfloat) mantissa, -24);
+		else if (exponent == 31)
+			value = INFINITY;
+		else
+			value = ldexp((GLfloat) (mantissa | 0x400), exponent - 25);
+
+		return (half & 0x8000) ? -value : value;
+	}
+
+private:
+	void add(GLuint location, GLint size, GLenum type, GLboolean normalized, GLuint bytes) {
+		VertexAttributeFormat attribute;
+		attribute.location = location;
+		attribute.size = size;
+		attribute.type = type;
+		attribute.normalized = normalized;
+		attribute.offset = this->stride;
+
+		this->attributes.push_back(attribute);
+		// Ogni attributo resta allineato a 4 byte
+		this->stride += (bytes + 3) & ~3u;
+	}
+
+	static uint32_t packSnorm(GLfloat value, GLfloat scale, int shift) {
+		int quantized = (int) floor(glm::clamp(value, -1.0f, 1.0f) * scale + 0.5f);
+		uint32_t mask = (shift == 30) ? 0x3 : 0x3FF;
+		return ((uint32_t) quantized & mask) << shift;
+	}
+};
+
+#endif
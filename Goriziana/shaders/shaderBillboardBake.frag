@@ -0,0 +1,25 @@
+#version 330 core
+
+//Colore diffusivo, nel primo color attachment
+layout (location = 0) out vec4 albedoFrag;
+//Normale in coordinate del modello, portata in [0, 1], nel secondo color attachment
+layout (location = 1) out vec4 normalFrag;
+
+//Normale in coordinate del modello
+in vec3 vNormal;
+
+//Coordinate UV interpolate
+in vec2 interp_UV;
+
+//Texture del materiale, collegate dal binding del materiale della mesh
+struct Material {
+	sampler2D texture_diffuse1;
+};
+uniform Material material;
+
+void main(){
+	//L'alpha indica i pixel coperti dal modello
+	albedoFrag = vec4( texture(material.texture_diffuse1, interp_UV).rgb, 1.0 );
+
+	normalFrag = vec4( normalize(vNormal) * 0.5 + 0.5, 1.0 );
+}
@@ -0,0 +1,26 @@
+#version 330 core
+
+//Posizione vertice in coordinate del modello
+layout (location = 0) in vec3 position;
+//Normale al vertice
+layout (location = 1) in vec3 normal;
+//Coordinate UV
+layout (location = 2) in vec2 UV;
+
+//Matrice ortografica della vista da renderizzare nell'atlas, gia' moltiplicata per la sua view matrix
+uniform mat4 bakeMatrix;
+
+//Normale in coordinate del modello
+out vec3 vNormal;
+
+//Variabile di output per le coordinate UV
+out vec2 interp_UV;
+
+void main(){
+	//La normale resta in coordinate del modello: lo shader dei billboard la trasforma con la normal matrix dell'istanza
+	vNormal = normal;
+
+	interp_UV = UV;
+
+	gl_Position = bakeMatrix * vec4( position, 1.0 );
+}
@@ -0,0 +1,121 @@
+#version 330 core
+
+//Numero di directional light nella scena
+#define NR_LIGHTS 2
+
+//Numero di viste in azimut ed in elevazione dell'atlas, gli stessi di BillboardImpostor
+#define AZIMUTHS 8
+#define ELEVATIONS 5
+
+//Costante PI
+const float PI = 3.14159;
+
+//Variabile di output
+out vec4 colorFrag;
+
+//Dati comuni a tutti gli shader, caricati una volta per frame (layout std140)
+layout (std140) uniform FrameData {
+	//View matrix
+	mat4 viewMatrix;
+	//Projection matrix
+	mat4 projectionMatrix;
+	//Vettori di incidenza delle directional light, gia' in coordinate vista
+	vec4 lightDirs[NR_LIGHTS];
+};
+//Vettore da vertice a camera
+in vec3 vViewPosition;
+
+//Coordinate del fragment nelle quattro viste, cella dell'atlas e peso di ogni vista
+in vec2 vViewUV[4];
+flat in vec2 vCells[4];
+flat in vec4 vWeights;
+
+//Matrice di trasformazione delle normali dell'istanza
+flat in mat3 vNormalMatrix;
+
+//Atlas delle viste del modello, collegati dal binding del materiale del quad
+struct Atlas {
+	sampler2D albedo;
+	sampler2D normal;
+};
+uniform Atlas atlas;
+
+uniform float m; //Rugosita' superficie
+uniform float F0; //Fresnel Reflectance
+uniform float Kd; //Componente diffusiva della riflettanza
+
+void main(){
+	//Fondo le quattro viste: fuori dalla propria cella una vista non contribuisce, invece di leggere la cella vicina
+	vec4 albedo = vec4(0.0);
+	vec4 encodedNormal = vec4(0.0);
+
+	for (int k = 0; k < 4; k++){
+		vec2 uv = clamp( vViewUV[k], 0.0, 1.0 );
+		float inside = ( uv == vViewUV[k] ) ? vWeights[k] : 0.0;
+		vec2 atlasUV = ( vCells[k] + uv ) / vec2(AZIMUTHS, ELEVATIONS);
+
+		albedo += texture(atlas.albedo, atlasUV) * inside;
+		encodedNormal += texture(atlas.normal, atlasUV) * inside;
+	}
+
+	//L'alpha e' la copertura del modello: i pixel dello sfondo vengono scartati
+	if (albedo.a < 0.5)
+		discard;
+
+	//Colore e normale vengono divisi per la copertura, che le mipmap e la fusione hanno moltiplicato
+	vec4 surfaceColor = vec4( albedo.rgb / albedo.a, 1.0 );
+	vec3 N = normalize( vNormalMatrix * ( encodedNormal.rgb / encodedNormal.a * 2.0 - 1.0 ) );
+
+	vec4 color = vec4(0.0, 0.0, 0.0, 1.0);
+
+	//Stesso modello di illuminazione di shaderTextureCT.frag
+	for (int i = 0; i < NR_LIGHTS; i++){
+		//Normalizzo il vettore di incidenza della directional light i
+		vec3 L = normalize(lightDirs[i].xyz);
+
+		//Calcolo il coefficiente di Lambert
+		float lambertian = max(dot(L,N), 0.0);
+
+		float specular = 0.0;
+
+		//Se il coefficiente di Lambert e' positivo, posso calcolare la componente speculare
+		if(lambertian > 0.0){
+			//Normalizzo il vettore di vista
+			vec3 V = normalize( vViewPosition );
+
+			//Calcolo Half Vector
+			vec3 H = normalize(L + V);
+
+			//Calcolo il coseno tra i vettori ed i parametri che mi serviranno per calcolare le singole componenti
+			float NdotH = max(dot(N, H), 0.0);
+			float NdotV = max(dot(N, V), 0.0);
+			float VdotH = max(dot(V, H), 0.0);
+			float mSquared = m * m;
+
+			//Calcolo il fattore geometrico G
+			float NH2 = 2.0 * NdotH;
+			float g1 = (NH2 * NdotV) / VdotH;
+			float g2 = (NH2 * lambertian) / VdotH;
+			float geoAtt = min(1.0, min(g1, g2));
+
+			//Rugosita' D
+			//Distribuzione di Beckmann
+			float r1 = 1.0 / ( 4.0 * mSquared * pow(NdotH, 4.0));
+			float r2 = (NdotH * NdotH - 1.0) / (mSquared * NdotH * NdotH);
+			float roughness = r1 * exp(r2);
+
+			//Riflettanza di Fresnel F con approssimazione di Schlick
+			float fresnel = pow(1.0 - VdotH, 5.0);
+			fresnel *= (1.0 - F0);
+			fresnel += F0;
+
+			//Calcolo la componente speculare
+			specular = (fresnel * geoAtt * roughness) / (PI * NdotV * lambertian);
+
+			//Calcolo colore finale per la directional light i e lo sommo al colore finale
+			color += surfaceColor * lambertian * (Kd + specular * (1.0 - Kd));
+		}
+	}
+
+	colorFrag = color;
+}
@@ -0,0 +1,109 @@
+#version 330 core
+
+//Numero di directional light nella scena
+#define NR_LIGHTS 2
+
+//Numero di viste in azimut ed in elevazione dell'atlas, gli stessi di BillboardImpostor
+#define AZIMUTHS 8
+#define ELEVATIONS 5
+
+//Costante PI
+const float PI = 3.14159;
+
+//Angolo del quad, in [-1, 1]
+layout (location = 0) in vec3 position;
+
+//Model matrix dell'istanza
+layout (location = 5) in mat4 modelMatrix;
+//Matrice di trasformazione delle normali dell'istanza
+layout (location = 9) in mat3 normalMatrix;
+
+//Dati comuni a tutti gli shader, caricati una volta per frame (layout std140)
+layout (std140) uniform FrameData {
+	//View matrix
+	mat4 viewMatrix;
+	//Projection matrix
+	mat4 projectionMatrix;
+	//Vettori di incidenza delle directional light, gia' in coordinate vista
+	vec4 lightDirs[NR_LIGHTS];
+};
+
+//Sfera di contenimento del modello, in coordinate del modello: centro in xyz e raggio in w
+uniform vec4 sphere;
+
+//Vettore da vertice a camera
+out vec3 vViewPosition;
+
+//Coordinate del vertice nelle quattro viste da fondere, in [0, 1] all'interno della vista
+out vec2 vViewUV[4];
+
+//Cella dell'atlas di ogni vista e peso con cui viene fusa
+flat out vec2 vCells[4];
+flat out vec4 vWeights;
+
+//Matrice di trasformazione delle normali dell'istanza, per portare in coordinate vista le normali dell'atlas
+flat out mat3 vNormalMatrix;
+
+//Direzione dal centro del modello alla camera della vista (azimut a, elevazione e), come in BillboardImpostor::direction
+vec3 view_direction(float a, float e){
+	float phi = 2.0 * PI * a / AZIMUTHS;
+	float theta = PI * ((e + 0.5) / ELEVATIONS - 0.5);
+
+	return vec3( cos(theta) * cos(phi), sin(theta), cos(theta) * sin(phi) );
+}
+
+//Base dello schermo di una camera che guarda il centro del modello dalla direzione indicata, come glm::lookAt con l'asse y in alto
+void screen_axes(vec3 direction, out vec3 right, out vec3 up){
+	vec3 side = cross( -direction, vec3(0.0, 1.0, 0.0) );
+
+	//Guardando il modello dall'alto o dal basso l'asse y e' parallelo alla vista, e si usa l'asse x come riferimento
+	right = length(side) > 0.001 ? normalize(side) : vec3(1.0, 0.0, 0.0);
+	up = cross( right, -direction );
+}
+
+void main(){
+	//Posizione della camera in coordinate mondo, ricavata dalla view matrix
+	vec3 cameraPosition = -transpose( mat3(viewMatrix) ) * viewMatrix[3].xyz;
+
+	//Direzione dal centro del modello alla camera, in coordinate del modello: l'istanza ha solo rotazione e scala uniforme
+	vec3 center = ( modelMatrix * vec4( sphere.xyz, 1.0 ) ).xyz;
+	vec3 direction = normalize( transpose( mat3(modelMatrix) ) * ( cameraPosition - center ) );
+
+	//Il quad giace sul piano, in coordinate del modello, passante per il centro e perpendicolare alla direzione di vista
+	vec3 right, up;
+	screen_axes(direction, right, up);
+	vec3 corner = sphere.xyz + ( right * position.x + up * position.y ) * sphere.w;
+
+	//Le quattro viste piu' vicine in azimut ed elevazione, con i pesi dell'interpolazione bilineare
+	float azimuth = atan(direction.z, direction.x) / (2.0 * PI) * AZIMUTHS;
+	float elevation = clamp( (asin(clamp(direction.y, -1.0, 1.0)) / PI + 0.5) * ELEVATIONS - 0.5, 0.0, ELEVATIONS - 1.0 );
+
+	float a0 = floor(azimuth);
+	float e0 = min( floor(elevation), ELEVATIONS - 2.0 );
+	float fa = azimuth - a0;
+	float fe = elevation - e0;
+
+	vec2 cells[4] = vec2[4]( vec2(a0, e0), vec2(a0 + 1.0, e0), vec2(a0, e0 + 1.0), vec2(a0 + 1.0, e0 + 1.0) );
+	vWeights = vec4( (1.0 - fa) * (1.0 - fe), fa * (1.0 - fe), (1.0 - fa) * fe, fa * fe );
+
+	//Ogni vista e' una proiezione ortografica lungo la sua direzione: il vertice viene proiettato sul suo piano
+	for (int k = 0; k < 4; k++){
+		vec3 cellRight, cellUp;
+		screen_axes(view_direction(cells[k].x, cells[k].y), cellRight, cellUp);
+
+		vec3 offset = ( corner - sphere.xyz ) / sphere.w;
+		vViewUV[k] = vec2( dot(offset, cellRight), dot(offset, cellUp) ) * 0.5 + 0.5;
+		vCells[k] = vec2( mod(cells[k].x, AZIMUTHS), cells[k].y );
+	}
+
+	vNormalMatrix = normalMatrix;
+
+	//Calcolo la posizione del vertice in coordinate ModelView
+	vec4 mvPosition = viewMatrix * modelMatrix * vec4( corner, 1.0 );
+
+	//Calcolo la direzione di vista, negata per avere il verso dal vertice alla camera
+	vViewPosition = -mvPosition.xyz;
+
+	//Applico la Projection Matrix alla posizione del vertice
+	gl_Position = projectionMatrix * mvPosition;
+}
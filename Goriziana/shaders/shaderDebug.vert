@@ -1,11 +1,23 @@
 #version 330 core
+
+//Numero di directional light nella scena
+#define NR_LIGHTS 2
+
+//Dati comuni a tutti gli shader, caricati una volta per frame (layout std140)
+layout (std140) uniform FrameData {
+	//View matrix
+	mat4 viewMatrix;
+	//Projection matrix
+	mat4 projectionMatrix;
+	//Vettori di incidenza delle directional light, gia' in coordinate vista
+	vec4 lightDirs[NR_LIGHTS];
+};
+
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 color;
 
 out vec3 vColor;
 
-uniform mat4 projectionMatrix;
-uniform mat4 viewMatrix;
 uniform mat4 modelMatrix;
 
 void main(){
@@ -0,0 +1,114 @@
+#version 330 core
+//Con la profondita' conservativa la GPU sa che il punto della sfera e' sempre davanti al quad, e puo' continuare ad
+//usare l'early depth test anche se lo shader scrive gl_FragDepth
+#extension GL_ARB_conservative_depth : enable
+
+//Numero di directional light nella scena
+#define NR_LIGHTS 2
+
+//Costante PI
+const float PI = 3.14159;
+
+//Variabile di output
+out vec4 colorFrag;
+
+#ifdef GL_ARB_conservative_depth
+layout (depth_less) out float gl_FragDepth;
+#endif
+
+//Dati comuni a tutti gli shader, caricati una volta per frame (layout std140)
+layout (std140) uniform FrameData {
+	//View matrix
+	mat4 viewMatrix;
+	//Projection matrix
+	mat4 projectionMatrix;
+	//Vettori di incidenza delle directional light, gia' in coordinate vista
+	vec4 lightDirs[NR_LIGHTS];
+};
+//Vettore dal punto del quad alla camera
+in vec3 vViewPosition;
+//Centro e raggio della sfera in coordinate vista
+flat in vec3 vCenter;
+flat in float vRadius;
+//Colore diffusivo dell'istanza
+flat in vec3 vColor;
+
+uniform float m; //Rugosita' superficie
+uniform float F0[NR_LIGHTS]; //Fresnel Reflectance
+uniform float Kd; //Componente diffusiva della riflettanza
+
+void main(){
+	//Intersezione del raggio dalla camera (l'origine in coordinate vista) verso il punto del quad con la sfera
+	vec3 D = normalize( -vViewPosition );
+	float b = dot( D, vCenter );
+	float discriminant = b * b - ( dot( vCenter, vCenter ) - vRadius * vRadius );
+
+	//Il raggio manca la sfera: il pixel e' fuori dalla silhouette
+	if (discriminant < 0.0)
+		discard;
+
+	//Prima intersezione, cioe' la piu' vicina alla camera
+	vec3 hit = D * ( b - sqrt(discriminant) );
+
+	//Scrivo la profondita' del punto della sfera, con lo stesso depth range della pipeline
+	vec4 clipPosition = projectionMatrix * vec4( hit, 1.0 );
+	gl_FragDepth = ( ( gl_DepthRange.diff * clipPosition.z / clipPosition.w ) + gl_DepthRange.near + gl_DepthRange.far ) * 0.5;
+
+	vec3 color = vec3(0.0);
+
+	//Normale analitica della sfera nel punto di intersezione
+	vec3 N = ( hit - vCenter ) / vRadius;
+
+	//Stesso modello di illuminazione di shaderNoTextureCT.frag
+	for ( int i = 0; i < NR_LIGHTS; i++){
+		//Normalizzo il vettore di incidenza della directional light i
+		vec3 L = normalize(lightDirs[i].xyz);
+
+		//Calcolo il coefficiente di Lambert
+		float lambertian = max(dot(L,N), 0.0);
+
+		float specular = 0.0;
+
+		//Se il coefficiente di Lambert e' positivo, posso calcolare la componente speculare
+		if(lambertian > 0.0){
+			//Il vettore di vista va dal punto della sfera alla camera
+			vec3 V = -D;
+
+			//Calcolo Half Vector
+			vec3 H = normalize(L + V);
+
+			//Calcolo il coseno tra i vettori ed i parametri che mi serviranno per calcolare le singole componenti
+			float NdotH = max(dot(N, H), 0.0);
+			float NdotV = max(dot(N, V), 0.0);
+			float VdotH = max(dot(V, H), 0.0);
+			float mSquared = m * m;
+
+			//Calcolo il fattore geometrico G
+			float NH2 = 2.0 * NdotH;
+			float g1 = (NH2 * NdotV) / VdotH;
+			float g2 = (NH2 * lambertian) / VdotH;
+			float geoAtt = min(1.0, min(g1, g2));
+
+			//Rugosita' D
+			//Distribuzione di Beckmann
+			float r1 = 1.0 / ( 4.0 * mSquared * pow(NdotH, 4.0));
+			float r2 = (NdotH * NdotH - 1.0) / (mSquared * NdotH * NdotH);
+			float roughness = r1 * exp(r2);
+
+			//Riflettanza di Fresnel F con approssimazione di Schlick
+			float fresnel = pow(1.0 - VdotH, 5.0);
+			fresnel *= (1.0 - F0[i]);
+			fresnel += F0[i];
+
+			//Calcolo la componente speculare
+			specular = (fresnel * geoAtt * roughness) / (PI * NdotV * lambertian);
+
+			//Calcolo colore finale per la directional light i e lo sommo al colore finale
+			color += lambertian * (Kd + specular * (1.0 - Kd));
+		}
+	}
+
+	color *= vColor;
+
+	colorFrag = vec4(color, 1.0);
+}
@@ -0,0 +1,65 @@
+#version 330 core
+
+//Numero di directional light nella scena
+#define NR_LIGHTS 2
+
+//Angolo del quad, in [-1, 1]
+layout (location = 0) in vec3 position;
+
+//Model matrix dell'istanza
+layout (location = 5) in mat4 modelMatrix;
+//Colore dell'istanza
+layout (location = 12) in vec3 color;
+
+//Dati comuni a tutti gli shader, caricati una volta per frame (layout std140)
+layout (std140) uniform FrameData {
+	//View matrix
+	mat4 viewMatrix;
+	//Projection matrix
+	mat4 projectionMatrix;
+	//Vettori di incidenza delle directional light, gia' in coordinate vista
+	vec4 lightDirs[NR_LIGHTS];
+};
+
+//Sfera in coordinate del modello: centro in xyz e raggio in w
+uniform vec4 sphere;
+
+//Vettore da vertice a camera
+out vec3 vViewPosition;
+
+//Centro e raggio della sfera in coordinate vista
+flat out vec3 vCenter;
+flat out float vRadius;
+
+//Colore diffusivo dell'istanza
+flat out vec3 vColor;
+
+
+void main(){
+	//Calcolo centro e raggio della sfera in coordinate vista: il raggio viene scalato dalla model matrix
+	vec4 mvCenter = viewMatrix * modelMatrix * vec4( sphere.xyz, 1.0 );
+	float radius = sphere.w * length( modelMatrix[0].xyz );
+
+	//Il quad giace sul piano passante per il centro e perpendicolare alla direzione della camera
+	float centerDistance = length( mvCenter.xyz );
+	vec3 axis = mvCenter.xyz / centerDistance;
+	vec3 right = normalize( cross( axis, abs(axis.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0) ) );
+	vec3 up = cross( right, axis );
+
+	//Su quel piano il cono tangente alla sfera ha raggio r * d / sqrt(d^2 - r^2), maggiore di r:
+	//il quad viene allargato di conseguenza, limitando l'allargamento quando la camera e' molto vicina
+	float size = radius * centerDistance / sqrt( max( centerDistance * centerDistance - radius * radius, 0.01 * radius * radius ) );
+	vec3 corner = mvCenter.xyz + ( right * position.x + up * position.y ) * size;
+
+	//Calcolo la direzione di vista, negata per avere il verso dal vertice alla camera
+	vViewPosition = -corner;
+
+	vCenter = mvCenter.xyz;
+	vRadius = radius;
+
+	//Passo al fragment il colore dell'istanza
+	vColor = color;
+
+	//Applico la Projection Matrix alla posizione del vertice
+	gl_Position = projectionMatrix * vec4( corner, 1.0 );
+}
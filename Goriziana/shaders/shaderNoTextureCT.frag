@@ -9,14 +9,22 @@ const float PI = 3.14159;
 //Variabile di output
 out vec4 colorFrag;
 
-//Vettori di incidenza delle directional light
-in vec3 lightDirs[NR_LIGHTS];
+//Dati comuni a tutti gli shader, caricati una volta per frame (layout std140)
+layout (std140) uniform FrameData {
+	//View matrix
+	mat4 viewMatrix;
+	//Projection matrix
+	mat4 projectionMatrix;
+	//Vettori di incidenza delle directional light, gia' in coordinate vista
+	vec4 lightDirs[NR_LIGHTS];
+};
 //Vettore normale, calcolato nel vertex
 in vec3 vNormal;
 //Vettore da vertice a camera
 in vec3 vViewPosition;
+//Colore diffusivo dell'istanza
+in vec3 vColor;
 
-uniform vec3 diffuseColor; 
 uniform float m; //Rugosità superficie
 uniform float F0[NR_LIGHTS]; //Fresnel Reflectance
 uniform float Kd; //Componente diffusiva della riflettanza
@@ -75,7 +83,7 @@ void main(){
 		}	
 	}    
     
-	color *= diffuseColor;
+	color *= vColor;
 	
     colorFrag = vec4(color, 1.0);
 }
\ No newline at end of file
@@ -8,21 +8,22 @@ layout (location = 0) in vec3 position;
 //Normale al vertice
 layout (location = 1) in vec3 normal;
 
-//Model matrix
-uniform mat4 modelMatrix;
-//View matrix
-uniform mat4 viewMatrix;
-//Projection matrix
-uniform mat4 projectionMatrix;
-
-//Matrice di trasformazione delle normali
-uniform mat3 normalMatrix;
-
-//Vettori di incidenza delle diverse directional light
-uniform vec3 lightVectors[NR_LIGHTS];
-
-//Vettori di incidenza in coordinate vista
-out vec3 lightDirs[NR_LIGHTS];
+//Model matrix dell'istanza
+layout (location = 5) in mat4 modelMatrix;
+//Matrice di trasformazione delle normali dell'istanza
+layout (location = 9) in mat3 normalMatrix;
+//Colore dell'istanza
+layout (location = 12) in vec3 color;
+
+//Dati comuni a tutti gli shader, caricati una volta per frame (layout std140)
+layout (std140) uniform FrameData {
+	//View matrix
+	mat4 viewMatrix;
+	//Projection matrix
+	mat4 projectionMatrix;
+	//Vettori di incidenza delle directional light, gia' in coordinate vista
+	vec4 lightDirs[NR_LIGHTS];
+};
 
 //Vettori normali in coordinate vista
 out vec3 vNormal;
@@ -30,6 +31,9 @@ out vec3 vNormal;
 //Vettore da vertice a camera
 out vec3 vViewPosition;
 
+//Colore diffusivo dell'istanza
+out vec3 vColor;
+
 
 void main(){
 	//Calcolo la posizione del vertice in coordinate ModelView
@@ -41,10 +45,8 @@ void main(){
 	//Applico le trasformazioni alle coordinate dei vettori normali
 	vNormal = normalize( normalMatrix * normal );
 
-	//Calcolo il vettore di incidenza delle directional light
-	for (int i = 0; i < NR_LIGHTS; i++){
-		lightDirs[i] = vec3(viewMatrix  * vec4(lightVectors[i], 0.0));
-	}	
+	//Passo al fragment il colore dell'istanza
+	vColor = color;
 
 	//Applico la Projection Matrix alla posizione del vertice
 	gl_Position = projectionMatrix * mvPosition;
@@ -1,15 +1,27 @@
 #version 330 core
+
+//Numero di directional light nella scena
+#define NR_LIGHTS 2
+
+//Dati comuni a tutti gli shader, caricati una volta per frame (layout std140)
+layout (std140) uniform FrameData {
+	//View matrix
+	mat4 viewMatrix;
+	//Projection matrix
+	mat4 projectionMatrix;
+	//Vettori di incidenza delle directional light, gia' in coordinate vista
+	vec4 lightDirs[NR_LIGHTS];
+};
+
 layout (location = 0) in vec3 position;
 
 out vec3 TexCoord;
 
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
-
 void main(){
 	TexCoord = position;
 
-    vec4 pos = projectionMatrix * viewMatrix * vec4(position, 1.0);
+    //Elimino la traslazione dalla view matrix, in modo che lo skybox resti centrato sulla camera
+    vec4 pos = projectionMatrix * mat4(mat3(viewMatrix)) * vec4(position, 1.0);
 	
     gl_Position = pos.xyww;
 }  
\ No newline at end of file
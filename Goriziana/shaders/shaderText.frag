@@ -1,17 +1,22 @@
 #version 330 core
 in vec2 TexCoords;
+//Colore da dare al testo
+in vec3 TextColor;
 
 out vec4 colorFrag;
 
-//Immagine mono-colore bitmap del glyph
+//Atlas contenente il campo di distanza con segno di tutti i glyph: 0.5 sul contorno, valori maggiori dentro il glyph
 uniform sampler2D text;
-//Colore da dare al testo
-uniform vec3 textColor;
 
 void main(){
-	//Campiono il colore della texture come alpha value, in modo da gestire la trasparenza
-    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(text, TexCoords).r);
-	
+	float distance = texture(text, TexCoords).r;
+
+	//Larghezza della transizione tra dentro e fuori, pari a circa un pixel dello schermo qualunque sia la scala del testo
+	float width = 0.7 * fwidth(distance);
+
+	//Uso la distanza dal contorno come alpha value, in modo da gestire la trasparenza con bordi antialiasing
+	float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+
 	//Il valore di output del fragment è il colore effettivo da dare al testo
-	colorFrag = vec4(textColor, 1.0) * sampled;
+	colorFrag = vec4(TextColor, alpha);
 }
\ No newline at end of file
@@ -1,7 +1,10 @@
 #version 330 core
 layout (location = 0) in vec4 vertex;
+//Colore del testo, per vertice in modo da renderizzare stringhe di colori diversi con una sola draw call
+layout (location = 1) in vec3 color;
 
 out vec2 TexCoords;
+out vec3 TextColor;
 
 //Projection Matrix
 uniform mat4 projectionMatrix;
@@ -11,4 +14,5 @@ void main(){
 	gl_Position = projectionMatrix * vec4(vertex.xy, 0.0, 1.0);
 	
 	TexCoords = vertex.zw;
+	TextColor = color;
 }
\ No newline at end of file
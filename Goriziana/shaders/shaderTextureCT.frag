@@ -9,8 +9,15 @@ const float PI = 3.14159;
 //Variabile di output
 out vec4 colorFrag;
 
-//Vettori di incidenza delle directional light
-in vec3 lightDirs[NR_LIGHTS];
+//Dati comuni a tutti gli shader, caricati una volta per frame (layout std140)
+layout (std140) uniform FrameData {
+	//View matrix
+	mat4 viewMatrix;
+	//Projection matrix
+	mat4 projectionMatrix;
+	//Vettori di incidenza delle directional light, gia' in coordinate vista
+	vec4 lightDirs[NR_LIGHTS];
+};
 //Vettore normale, calcolato nel vertex
 in vec3 vNormal;
 //Vettore da vertice a camera
@@ -22,8 +29,11 @@ in vec2 interp_UV;
 //Numero di ripetizioni della texture
 uniform float repeat;
 
-//Sampler della texture
-uniform sampler2D tex;
+//Texture del materiale, collegate dal binding del materiale della mesh
+struct Material {
+	sampler2D texture_diffuse1;
+};
+uniform Material material;
 
 uniform float m; //Rugosità superficie
 uniform float F0; //Fresnel Reflectance
@@ -32,7 +42,7 @@ uniform float Kd; //Componente diffusiva della riflettanza
 void main(){
 	//Determino la texture da applicare mediante gli UVs ed il numero di ripetizioni
     vec2 repeated_Uv = mod(interp_UV*repeat, 1.0);
-    vec4 surfaceColor = texture(tex, repeated_Uv);
+    vec4 surfaceColor = texture(material.texture_diffuse1, repeated_Uv);
 
     // normalization of the per-fragment normal
     vec3 N = normalize(vNormal);
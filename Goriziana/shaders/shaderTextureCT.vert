@@ -10,21 +10,20 @@ layout (location = 1) in vec3 normal;
 //Coordinate UV
 layout (location = 2) in vec2 UV;
 
-//Model matrix
-uniform mat4 modelMatrix;
-//View matrix
-uniform mat4 viewMatrix;
-//Projection matrix
-uniform mat4 projectionMatrix;
-
-//Matrice di trasformazione delle normali
-uniform mat3 normalMatrix;
-
-//Vettori di incidenza delle diverse directional light
-uniform vec3 lightVectors[NR_LIGHTS];
-
-//Vettori di incidenza in coordinate vista
-out vec3 lightDirs[NR_LIGHTS];
+//Model matrix dell'istanza
+layout (location = 5) in mat4 modelMatrix;
+//Matrice di trasformazione delle normali dell'istanza
+layout (location = 9) in mat3 normalMatrix;
+
+//Dati comuni a tutti gli shader, caricati una volta per frame (layout std140)
+layout (std140) uniform FrameData {
+	//View matrix
+	mat4 viewMatrix;
+	//Projection matrix
+	mat4 projectionMatrix;
+	//Vettori di incidenza delle directional light, gia' in coordinate vista
+	vec4 lightDirs[NR_LIGHTS];
+};
 
 //Vettori normali in coordinate vista
 out vec3 vNormal;
@@ -45,11 +44,6 @@ void main(){
 	//Applico le trasformazioni alle coordinate dei vettori normali
 	vNormal = normalize( normalMatrix * normal );
 	
-	//Calcolo il vettore di incidenza delle directional light
-	for(int i = 0; i < NR_LIGHTS; i++){
-		lightDirs[i] = vec3(viewMatrix  * vec4(lightVectors[i], 0.0));
-	}
-	
 	//Applico la Projection Matrix alla posizione del vertice
 	gl_Position = projectionMatrix * mvPosition;
 	
@@ -1,58 +1,113 @@
 #include "BulletDebugDrawer.h"
 
-GLuint VBO, VAO;
+#include <algorithm>
+#include <cstddef>
 
 BulletDebugDrawer::BulletDebugDrawer(){
 	this->m_debugMode = 1;
+	this->VAO = 0;
+	this->VBO = 0;
+	this->capacity = 0;
+	this->lastLineCount = 0;
+	this->contactNormalLength = 0.5f;
 }
 
 BulletDebugDrawer::~BulletDebugDrawer(){}
 
-void BulletDebugDrawer::SetMatrices(Shader *shader, glm::mat4 projectionMatrix, glm::mat4 viewMatrix, glm::mat4 modelMatrix){
+void BulletDebugDrawer::SetMatrices(Shader *shader, Uniform<glm::mat4> modelUniform, glm::mat4 modelMatrix){
 	shader->Use();
 
-	shader->setMat4("projectionMatrix", projectionMatrix);
-	shader->setMat4("viewMatrix", viewMatrix);
-	shader->setMat4("modelMatrix", modelMatrix);
+	shader->set(modelUniform, modelMatrix);
 }
 
-void BulletDebugDrawer::drawLine(const btVector3& from, const btVector3& to, const btVector3& color){
-	// Vertex data
-	GLfloat points[12];
-
-	points[0] = from.x();
-	points[1] = from.y();
-	points[2] = from.z();
-	points[3] = 0.0f;
-	points[4] = 0.0f;
-	points[5] = 0.0f;
-
-	points[6] = to.x();
-	points[7] = to.y();
-	points[8] = to.z();
-	points[9] = 0.0f;
-	points[10] = 0.0f;
-	points[11] = 0.0f;
-
-	glDeleteBuffers(1, &VBO);
-	glDeleteVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenVertexArrays(1, &VAO);
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(points), &points, GL_STATIC_DRAW);
+void BulletDebugDrawer::Setup(){
+	glGenVertexArrays(1, &this->VAO);
+	glGenBuffers(1, &this->VBO);
+
+	gl_state().BindVertexArray(this->VAO);
+	gl_state().BindBuffer(GL_ARRAY_BUFFER, this->VBO);
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), 0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (GLvoid*)offsetof(DebugVertex, position));
 	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-	glBindVertexArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (GLvoid*)offsetof(DebugVertex, color));
+	gl_state().BindVertexArray(0);
+	gl_state().BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void BulletDebugDrawer::Flush(Shader *shader){
+	this->lastLineCount = this->vertices.size() / 2;
+
+	if (this->vertices.empty() || this->VAO == 0) {
+		this->vertices.clear();
+		return;
+	}
+
+	GLsizeiptr size = this->vertices.size() * sizeof(DebugVertex);
+
+	gl_state().BindBuffer(GL_ARRAY_BUFFER, this->VBO);
+	// Il buffer cresce raddoppiando; altrimenti viene riallocato della stessa dimensione (orphaning),
+	// cosi' il driver non deve attendere che la GPU abbia finito di leggere le linee del frame precedente
+	if (size > this->capacity)
+		this->capacity = std::max(size, 2 * this->capacity);
+	glBufferData(GL_ARRAY_BUFFER, this->capacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, &this->vertices[0]);
+
+	shader->Use();
+
+	gl_state().BindVertexArray(this->VAO);
+	glDrawArrays(GL_LINES, 0, (GLsizei) this->vertices.size());
+
+	// Il vettore mantiene la sua memoria, per cui nei frame successivi raccogliere le linee non alloca
+	this->vertices.clear();
+}
+
+void BulletDebugDrawer::Delete(){
+	gl_state().DeleteVertexArrays(1, &this->VAO);
+	gl_state().DeleteBuffers(1, &this->VBO);
+	this->VAO = 0;
+	this->VBO = 0;
+	this->capacity = 0;
+}
 
-	glBindVertexArray(VAO);
-	glDrawArrays(GL_LINES, 0, 2);
-	glBindVertexArray(0);
+size_t BulletDebugDrawer::getLastLineCount() const {
+	return this->lastLineCount;
+}
+
+void BulletDebugDrawer::addVertex(const btVector3 &position, const btVector3 &color){
+	DebugVertex vertex = { { position.x(), position.y(), position.z() }, { color.x(), color.y(), color.z() } };
+	this->vertices.push_back(vertex);
+}
+
+void BulletDebugDrawer::drawLine(const btVector3& from, const btVector3& to, const btVector3& color){
+	this->addVertex(from, color);
+	this->addVertex(to, color);
+}
+
+void BulletDebugDrawer::drawContactPoint(const btVector3 &pointOnB, const btVector3 &normalOnB, btScalar distance, int, const btVector3 &color) {
+	// La distanza e' negativa quando i corpi si compenetrano
+	btScalar length = btMax(btFabs(distance), this->contactNormalLength);
+
+	this->addVertex(pointOnB, color);
+	this->addVertex(pointOnB + normalOnB * length, color);
+}
+
+void BulletDebugDrawer::drawAabb(const btVector3 &from, const btVector3 &to, const btVector3 &color) {
+	// Gli 8 vertici della AABB, indicizzati dai bit (x, y, z): 0 per from, 1 per to
+	btVector3 corners[8];
+	for (int i = 0; i < 8; i++)
+		corners[i] = btVector3((i & 1) ? to.x() : from.x(), (i & 2) ? to.y() : from.y(), (i & 4) ? to.z() : from.z());
+
+	// Ogni spigolo unisce due vertici che differiscono di un solo bit
+	for (int i = 0; i < 8; i++) {
+		for (int bit = 1; bit < 8; bit <<= 1) {
+			if (!(i & bit)) {
+				this->addVertex(corners[i], color);
+				this->addVertex(corners[i | bit], color);
+			}
+		}
+	}
 }
 
-void BulletDebugDrawer::drawContactPoint(const btVector3 &, const btVector3 &, btScalar, int, const btVector3 &) {}
 void BulletDebugDrawer::reportErrorWarning(const char *warningString) {
 	std::cout << warningString << std::endl;
 }
@@ -62,3 +117,7 @@ void BulletDebugDrawer::setDebugMode(int p) {
 }
 
 int BulletDebugDrawer::getDebugMode() const { return m_debugMode; }
+
+void BulletDebugDrawer::setContactNormalLength(btScalar length) {
+	this->contactNormalLength = length;
+}
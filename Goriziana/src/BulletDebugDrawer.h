@@ -1,6 +1,8 @@
 /*
 Classe BulletDebugDrawer
 - Eredita e ridefinisce da btIDebugDraw parte dei metodi ed attributi utili per il debug della simulazione fisica
+- Le linee, i punti di contatto e le AABB disegnati dalla Bullet durante un frame vengono raccolti in un vettore di vertici con
+  colore per vertice, caricato e renderizzato una sola volta per frame da un vertex buffer creato una sola volta
 
 Codice di partenza: https://pybullet.org/Bullet/phpBB3/viewtopic.php?t=11517
 */
@@ -9,9 +11,19 @@ Codice di partenza: https://pybullet.org/Bullet/phpBB3/viewtopic.php?t=11517
 #define BULLETDEBUGDRAWER_H
 
 #include <iostream>
+#include <vector>
 
 #include <bullet/LinearMath/btIDebugDraw.h>
 #include <utils/shader.h>
+#include <utils/glstate.h>
+
+/*
+ * Struttura che rappresenta un vertice delle linee di debug: posizione e colore
+ */
+struct DebugVertex {
+	GLfloat position[3];
+	GLfloat color[3];
+};
 
 /********** classe BULLETDEBUGDRAWER **********/
 class BulletDebugDrawer : public btIDebugDraw {
@@ -25,21 +37,54 @@ public:
 	~BulletDebugDrawer();
 	
 	/*
-	 * Metodo utilizzato per settare le matrici Projection, View e Model dello shader del debugger.
+	 * Metodo utilizzato per settare la matrice Model dello shader del debugger.
+	 * Le matrici Projection e View vengono lette dall'uniform buffer del frame, condiviso da tutti gli shader.
 	 * Prende in input i seguenti valori:
 	 * - shader: Shader*, puntatore allo shader associato al debugger
-	 * - viewMatrix: glm::mat4, matrice View della scena
-	 * - projectionMatrix: glm::mat4, matrice Projection della scena
+	 * - modelUniform: Uniform<glm::mat4>, handle della uniform modelMatrix, risolto una sola volta dopo la creazione dello shader
 	 * - modelMatrix: glm::mat4, matrice Model della scena
 	 */
-	void SetMatrices(Shader *shader, glm::mat4 viewMatrix, glm::mat4 projectionMatrix, glm::mat4 modelMatrix);
+	void SetMatrices(Shader *shader, Uniform<glm::mat4> modelUniform, glm::mat4 modelMatrix);
+
+	/*
+	 * Metodo che crea il VAO ed il VBO delle linee, riutilizzati per tutti i frame.
+	 * Va chiamato dopo la creazione del contesto OpenGL.
+	 */
+	void Setup();
+
+	/*
+	 * Metodo che carica nel VBO tutte le linee raccolte dall'ultimo Flush e le renderizza con una sola draw call.
+	 * Prende in input i seguenti valori:
+	 * - shader: Shader*, puntatore allo shader associato al debugger
+	 */
+	void Flush(Shader *shader);
+
+	/*
+	 * Metodo che, nel momento della chiusura dell'applicazione, dealloca i buffer
+	 */
+	void Delete();
+
+	/*
+	 * Metodo get per il numero di linee renderizzate dall'ultimo Flush
+	 */
+	size_t getLastLineCount() const;
 
 	/*
-	 * Metodo utilizzato per disegnare effettivamente i contorni degli oggetti fisici
+	 * Metodo utilizzato per raccogliere i contorni degli oggetti fisici, renderizzati poi da Flush
 	 */
 	virtual void drawLine(const btVector3& from, const btVector3& to, const btVector3& color);
-	
-	virtual void drawContactPoint(const btVector3&, const btVector3&, btScalar, int, const btVector3&);
+
+	/*
+	 * Metodo utilizzato per raccogliere un punto di contatto: la normale viene disegnata dal punto, lunga quanto la compenetrazione
+	 * e comunque almeno contactNormalLength, in modo da essere visibile anche per i contatti appena toccati
+	 */
+	virtual void drawContactPoint(const btVector3& pointOnB, const btVector3& normalOnB, btScalar distance, int lifeTime, const btVector3& color);
+
+	/*
+	 * Metodo utilizzato per raccogliere i 12 spigoli di una AABB, senza passare per 12 chiamate virtuali a drawLine
+	 */
+	virtual void drawAabb(const btVector3& from, const btVector3& to, const btVector3& color);
+
 	virtual void reportErrorWarning(const char *);
 	virtual void draw3dText(const btVector3 &, const char *);
 	
@@ -52,6 +97,24 @@ public:
 	 * Metodo get per m_debugMode;
 	 */
 	virtual int getDebugMode() const;
+
+	/*
+	 * Metodo set per la lunghezza minima delle normali dei punti di contatto
+	 */
+	void setContactNormalLength(btScalar length);
+
+private:
+	// Attributo che contiene i vertici delle linee del frame, a coppie
+	std::vector<DebugVertex> vertices;
+	// Attributi che rappresentano i buffer OpenGL e la dimensione allocata del VBO
+	GLuint VAO, VBO;
+	GLsizeiptr capacity;
+	// Attributo che contiene il numero di linee renderizzate dall'ultimo Flush
+	size_t lastLineCount;
+	// Attributo che contiene la lunghezza minima delle normali dei punti di contatto
+	btScalar contactNormalLength;
+
+	void addVertex(const btVector3 &position, const btVector3 &color);
 };
 
 #endif // BULLETDEBUGDRAWER_H
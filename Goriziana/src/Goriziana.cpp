@@ -2,7 +2,9 @@
 #include <fstream>
 #include <string>
 #include <vector>
-#include <map>
+#include <ctime>
+#include <cstdio>
+#include <cstdlib>
 // THIS IS OPTIONAL AND NOT REQUIRED, ONLY USE THIS IF YOU DON'T WANT GLAD TO INCLUDE windows.h
 // GLAD will include windows.h for APIENTRY if it was not previously defined.
 // Make sure you have the correct definition for APIENTRY for platforms which define _WIN32 but don't use __stdcall
@@ -19,9 +21,19 @@
 #endif
 
 #include <utils/shader.h>
+#include <utils/glstate.h>
 #include <utils/camera.h>
 #include <utils/model.h>
 #include <utils/physics.h>
+#include <utils/snapshot.h>
+#include <utils/text.h>
+#include <utils/hud.h>
+#include <utils/renderqueue.h>
+#include <utils/culling.h>
+#include <utils/lod.h>
+#include <utils/impostor.h>
+#include <utils/billboard.h>
+#include <utils/geometrypool.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -35,26 +47,24 @@
 
 #include <bullet/btBulletDynamicsCommon.h>
 #include "BulletDebugDrawer.h"
-
-#include <ft2build.h>
-#include FT_FREETYPE_H
+#include "Replay.h"
+#include "ReplayViewer.h"
+#include "ShotPreview.h"
+#include "ShotCache.h"
+#include "ShotSurrogate.h"
+#include "SolverBenchmark.h"
+#include "MeshSimplifier.h"
 
 #define NR_LIGHTS 2
+//Altezza in pixel del testo dell'HUD
+#define TEXT_SIZE 36.0f
+//Memoria massima delle pagine dell'atlas del font, in byte
+#define FONT_ATLAS_MEMORY (1024 * 1024)
+//Binding point dell'uniform buffer con i dati del frame
+#define FRAME_UNIFORMS_BINDING 0
 
 using namespace std;
 
-/********** struct CHARACTER **********/
-struct Character {
-	//Campo utilizzato per memorizzare l'ID della texture del glyph
-	GLuint textureID;
-	//Campo in cui  salvata la dimensione del glyph
-	glm::ivec2 size;
-	//Campo in cui  salvato l'offset dalla baseline all'angolo in alto a sinistra
-	glm::ivec2 bearing;
-	//Campo in cui  salvato l'offset dal punto advance al carattere successivo
-	GLuint advance;
-};
-
 //Dimensioni della finestra dell'applicazione
 const GLuint SCR_WIDTH = 1280, SCR_HEIGHT = 720;
 
@@ -115,15 +125,25 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 
 //Funzioni di utility
 GLuint load_cubemap(vector<string> faces);
-void draw_model_notexture(Shader &shaderNT, Model &ball, btRigidBody* bodyWhite, btRigidBody* bodyRed, btRigidBody* bodyYellow);
-void draw_model_texture(Shader &shaderT, Model &table, Model &pin, vector<btRigidBody*> vectorPin);
-void draw_skybox(Shader &shaderSB, Model &box, GLuint texture);
+void collect_model_notexture(Model &ball, btRigidBody* bodyWhite, btRigidBody* bodyRed, btRigidBody* bodyYellow);
+void collect_model_texture(Model &pin, const vector<btRigidBody*> &vectorPin);
+void submit_scene(Shader &shaderNT, Shader &shaderT, Shader &shaderIMP, Shader &shaderBB, Model &ball, Model &pin);
+glm::mat4 table_model_matrix();
+void submit_skybox(Shader &shaderSB, Model &box);
+void draw_aim_preview(Shader &shaderD);
+void push_instance(vector<InstanceData> &target, btRigidBody* body, const glm::mat4 &local, const glm::vec3 &color);
+void resolve_uniforms(Shader &shaderNT, Shader &shaderT, Shader &shaderIMP, Shader &shaderBB, Shader &shaderD, Shader &shaderSB, Shader &shaderTX);
+void setup_materials(GLuint textureSkybox);
+void update_frame_uniforms();
 bool check_idle_ball(btVector3 linearVelocity);
-void create_dictionary(FT_Face face);
-void render_text(Shader &shader, string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color);
+void physics_tick_callback(btDynamicsWorld *world, btScalar timeStep);
 
 //Funzioni per gestire il gioco
+void create_table(Physics &simulation, vector<btRigidBody*> &bodies);
 void throw_ball(btRigidBody* ball);
+void compute_shot_impulse(btVector3 &impulse, btVector3 &relPos);
+void update_aim_preview(const ShotPreviewResult &preview);
+bool load_replay_shot();
 
 //Libreria per la simulazione fisica
 Physics poolSimulation;
@@ -133,8 +153,125 @@ BulletDebugDrawer debugger;
 vector<btRigidBody*> playersBall;
 //Vettore contenente i btRigidBody associati ai birilli della scena
 vector<btRigidBody*> vectorPin;
-//Map contenente i caratteri pre-caricati per la scrittura del testo
-map<GLchar, Character> dictionary;
+//Vettore contenente tutti i corpi dinamici della scena, nell'ordine: biglia bianca, gialla, rossa e i 5 birilli
+vector<btRigidBody*> sceneBodies;
+//Classe che registra la partita su file per il replay
+ReplayWriter replayRecorder;
+//Classe che permette di scorrere avanti ed indietro nel tempo un tiro, risimulandolo in un mondo separato
+ReplayViewer replayViewer(create_table);
+//File di replay passato da riga di comando: se aperto, i tiri da rivedere vengono caricati da esso
+ReplayReader replayFile;
+size_t replayShotIndex = 0;
+//Stato della scena e parametri dell'ultimo tiro della partita in corso, utilizzati per rivederlo
+WorldSnapshot lastShotState;
+int lastShotPlayer = 0;
+btVector3 lastShotImpulse, lastShotRelPos;
+bool hasLastShot = false;
+//Cache degli esiti dei tiri gia' simulati, condivisa dai thread che simulano i tiri e salvata su disco tra una sessione e l'altra
+ShotCache shotCache(32 * 1024 * 1024);
+//Classe che calcola in un thread dedicato la traiettoria prevista del tiro mentre il giocatore mira
+ShotPreview shotPreview(create_table, &shotCache);
+//Ultimo risultato della previsione e stato della scena da cui viene calcolata
+ShotPreviewResult aimPreview;
+WorldSnapshot aimState;
+//Buffer con i segmenti della traiettoria prevista
+GLuint previewVAO, previewVBO;
+GLsizei previewVertexCount = 0;
+vector<GLfloat> previewVertices;
+//Istanze di un modello raccolte nel frame: vengono inviate alla coda di rendering solo dopo il frustum culling
+struct SceneBatch {
+	vector<InstanceData> instances;
+	//Indice nel FrustumCuller del volume della prima istanza, oppure della prima mesh per i modelli testati mesh per mesh
+	size_t firstBounds;
+};
+SceneBatch ballBatch, tableBatch, pinBatch;
+//Geometria statica della scena (il tavolo) in buffer condivisi, gia' in coordinate mondo ed unita in una mesh per materiale
+GeometryPool staticGeometry;
+//Frustum culling degli oggetti della scena, e istanze visibili del modello da inviare alla coda
+FrustumCuller frustumCuller;
+vector<InstanceData> visibleInstances;
+//Scelta del livello di dettaglio delle mesh in base alla distanza dalla camera
+LodSelector lodSelector;
+//Impostor delle biglie: un quad per biglia, su cui il fragment shader calcola l'intersezione con la sfera analitica
+SphereImpostor ballImpostor;
+//Variabile booleana che indica se le biglie vengono renderizzate come impostor o con la mesh del modello
+bool impostorMode = true;
+//Billboard dei birilli: viste del modello pre-renderizzate in un atlas, usate per i birilli oltre la distanza di passaggio
+BillboardImpostor pinBillboard;
+vector<InstanceData> billboardInstances;
+//Handle delle uniform degli shader, risolti una sola volta dopo la creazione dei program shader
+struct CookTorranceUniforms {
+	Uniform<float> F0[NR_LIGHTS];
+	Uniform<float> m, Kd, repeat;
+	//Sfera di contenimento del modello, usata solo dagli shader degli impostor
+	Uniform<glm::vec4> sphere;
+} uniformsNT, uniformsT, uniformsIMP, uniformsBB;
+struct {
+	Uniform<glm::mat4> modelMatrix;
+} uniformsD;
+struct {
+	Uniform<int> skyboxTexture;
+} uniformsSB;
+struct {
+	Uniform<glm::mat4> projectionMatrix;
+} uniformsTX;
+//Materiale degli oggetti renderizzati con gli shader Cook-Torrance: parametri del modello di illuminazione
+class CookTorranceMaterial : public RenderMaterial {
+public:
+	CookTorranceUniforms *uniforms;
+	GLfloat F0[NR_LIGHTS];
+	GLfloat m, Kd, repeat;
+
+	virtual void Apply(Shader &shader) const {
+		for (int i = 0; i < NR_LIGHTS; i++)
+			if (this->uniforms->F0[i].isValid())
+				shader.set(this->uniforms->F0[i], this->F0[i]);
+
+		shader.set(this->uniforms->m, this->m);
+		shader.set(this->uniforms->Kd, this->Kd);
+
+		if (this->uniforms->repeat.isValid())
+			shader.set(this->uniforms->repeat, this->repeat);
+	}
+} materialBall, materialTable, materialPin;
+//Materiale degli oggetti renderizzati come impostor: oltre ai parametri Cook-Torrance imposta la sfera in coordinate del modello
+class ImpostorMaterial : public CookTorranceMaterial {
+public:
+	glm::vec4 sphere;
+
+	virtual void Apply(Shader &shader) const {
+		CookTorranceMaterial::Apply(shader);
+
+		shader.set(this->uniforms->sphere, this->sphere);
+	}
+} materialBallImpostor, materialPinBillboard;
+//Materiale dello skybox: la cubemap viene collegata alla texture unit 0
+class SkyboxMaterial : public RenderMaterial {
+public:
+	GLuint texture;
+
+	virtual void Apply(Shader &shader) const {
+		gl_state().ActiveTexture(GL_TEXTURE0);
+		gl_state().BindTexture(GL_TEXTURE_CUBE_MAP, this->texture);
+
+		shader.set(uniformsSB.skyboxTexture, 0);
+	}
+} materialSkybox;
+//Coda di rendering: gli oggetti della scena inviano i loro pacchetti, renderizzati ordinati per stato OpenGL
+RenderQueue renderQueue;
+//Contenuto dell'uniform block FrameData, con la stessa disposizione std140 degli shader: view e projection matrix e
+//vettori di incidenza delle luci in coordinate vista (vec4, perche' std140 allinea a 16 byte ogni elemento di un array)
+struct FrameUniforms {
+	glm::mat4 viewMatrix;
+	glm::mat4 projectionMatrix;
+	glm::vec4 lightDirs[NR_LIGHTS];
+};
+//Uniform buffer con i dati del frame, caricato una volta per frame e collegato a tutti gli shader della scena
+GLuint frameUBO;
+//Atlas contenente i caratteri pre-caricati per la scrittura del testo
+FontAtlas fontAtlas;
+//HUD con i punteggi ed il giocatore di turno, i cui vertici vengono ricalcolati solo quando il testo cambia
+HudLayer hud;
 
 glm::mat4 projection(1.0f);
 glm::mat4 view(1.0f);
@@ -142,14 +279,51 @@ glm::mat4 model(1.0f);
 glm::mat3 normal(1.0f);
 
 bool debugMode = false;
+bool replayMode = false;
 
 bool checkShoot = false;
+// Variabile booleana che indica che la mira e' cambiata, e che quindi va richiesta una nuova traiettoria prevista
+bool aimChanged = true;
 // Variabile booleana che utilizzo per switchare tra i due giocatori.
 // false=0 primo giocatore, biglia bianca.
 // true=1 secondo giocatore, biglia gialla.
 bool player = false;
 
-int main() {
+int main(int argc, char *argv[]) {
+	//Con l'opzione --train-surrogate [numero di tiri] addestro la rete che approssima l'esito dei tiri, senza avviare il gioco
+	if (argc > 1 && string(argv[1]) == "--train-surrogate") {
+		//Il numero di tiri viene controllato prima della conversione a size_t, in cui un valore negativo diventerebbe enorme
+		int sampleCount = argc > 2 ? atoi(argv[2]) : 4000;
+		if (sampleCount < SURROGATE_MIN_SAMPLES) {
+			cout << "ERROR::SURROGATE::INVALID_SAMPLE_COUNT: uso --train-surrogate [numero di tiri], con almeno " << SURROGATE_MIN_SAMPLES << " tiri" << endl;
+			return -1;
+		}
+
+		ShotSurrogate::RunTraining(create_table, poolPinPoint, (size_t) sampleCount, "surrogate.bin");
+		return 0;
+	}
+
+	//Con l'opzione --benchmark-solver [numero di tiri] confronto il solver con iterazioni adattive con quello a iterazioni fisse
+	if (argc > 1 && string(argv[1]) == "--benchmark-solver") {
+		//Come per --train-surrogate, il numero di tiri viene controllato prima della conversione a size_t
+		int shotCount = argc > 2 ? atoi(argv[2]) : 200;
+		if (shotCount < SOLVER_BENCHMARK_MIN_SHOTS) {
+			cout << "ERROR::SOLVER::INVALID_SHOT_COUNT: uso --benchmark-solver [numero di tiri], con almeno " << SOLVER_BENCHMARK_MIN_SHOTS << " tiro" << endl;
+			return -1;
+		}
+
+		SolverBenchmark::Run(create_table, (size_t) shotCount);
+		return 0;
+	}
+
+	//Con l'opzione --build-lod <modello> ... genero i livelli di dettaglio dei modelli indicati, salvati accanto ad ognuno nel file .lod
+	if (argc > 2 && string(argv[1]) == "--build-lod") {
+		bool built = true;
+		for (int i = 2; i < argc; i++)
+			built = MeshSimplifier::BuildLods(argv[i]) && built;
+		return built ? 0 : -1;
+	}
+
 	//INIZIALIZZO GLFW
 	if (!glfwInit()) {
 		cout << "Errore nell'inizializzazione di GLFW!\n" << endl;
@@ -201,117 +375,129 @@ int main() {
 	glfwSetCursorPos(window, (double) (SCR_WIDTH / 2), (double) (SCR_HEIGHT / 2));
 
 	//SETTO LE COMPONENTI PER LA LIBRERIA DI TEXTRENDERING
-	FT_Library library;
-	if (FT_Init_FreeType(&library))
-		cout << "Errore nell'inizializzazione della libreria FreeType!" << endl;
-
-	FT_Face face;
-	if (FT_New_Face(library, "font/arial.ttf", 0, &face))
+	//Il font resta aperto: ogni carattere viene rasterizzato nell'atlas solo la prima volta che viene scritto
+	fontAtlas.setMemoryLimit(FONT_ATLAS_MEMORY);
+	if (!fontAtlas.Open("font/arial.ttf"))
 		cout << "Errore nel caricamento del font!" << endl;
-
-	FT_Set_Pixel_Sizes(face, 0, 36);
-
-	//Setto questo valore per accettare anche texture da 1 byte (Di default OpenGL accetta solo texture che abbiano una dimensione multipla di 4 byte).
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-	//Carico tutti i 128 caratteri in memoria, generando la relativa texture, in modo da avere il dizionario completo a rapido accesso.
-	create_dictionary(face);
-
-	//Libero la memoria occupata dalle componenti
-	FT_Done_Face(face);
-	FT_Done_FreeType(library);
+	hud.Setup();
 
 	//VETTORE UTILIZZATO PER CARICARE LA CUBEMAP
 	vector<string> faces = { "skybox/right.jpg", "skybox/left.jpg", "skybox/top.jpg", "skybox/bottom.jpg", "skybox/front.jpg", "skybox/back.jpg" };
 
 	//UTILIZZO LA CLASSE SHADER CREATA PER COMPILARE IL VS ED IL FS, E LINKARLI NEL PS
 	Shader shaderNoTexture("shaders/shaderNoTextureCT.vert", "shaders/shaderNoTextureCT.frag");
+	Shader shaderImpostor("shaders/shaderImpostorCT.vert", "shaders/shaderImpostorCT.frag");
+	Shader shaderBillboard("shaders/shaderBillboardCT.vert", "shaders/shaderBillboardCT.frag");
 	Shader shaderTexture("shaders/shaderTextureCT.vert", "shaders/shaderTextureCT.frag");
 	Shader shaderDebugger("shaders/shaderDebug.vert", "shaders/shaderDebug.frag");
 	Shader shaderSkybox("shaders/shaderSkybox.vert", "shaders/shaderSkybox.frag");
 	Shader shaderText("shaders/shaderText.vert", "shaders/shaderText.frag");
 
+	resolve_uniforms(shaderNoTexture, shaderTexture, shaderImpostor, shaderBillboard, shaderDebugger, shaderSkybox, shaderText);
+
+	//CREO L'UNIFORM BUFFER CON I DATI DEL FRAME E LO COLLEGO AGLI SHADER DELLA SCENA
+	glGenBuffers(1, &frameUBO);
+	gl_state().BindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+	gl_state().BindBuffer(GL_UNIFORM_BUFFER, 0);
+	gl_state().BindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, frameUBO);
+
+	shaderNoTexture.bindUniformBlock("FrameData", FRAME_UNIFORMS_BINDING);
+	shaderTexture.bindUniformBlock("FrameData", FRAME_UNIFORMS_BINDING);
+	shaderImpostor.bindUniformBlock("FrameData", FRAME_UNIFORMS_BINDING);
+	shaderBillboard.bindUniformBlock("FrameData", FRAME_UNIFORMS_BINDING);
+	shaderDebugger.bindUniformBlock("FrameData", FRAME_UNIFORMS_BINDING);
+	shaderSkybox.bindUniformBlock("FrameData", FRAME_UNIFORMS_BINDING);
+
+	//CREO I BUFFER DELLE LINEE DI DEBUG DELLA BULLET
+	debugger.Setup();
+
 	//UTILIZZO LA CLASSE MODEL CREATA PER CARICARE E VISUALIZZARE IL MODELLO 3D
 	Model modelTable("models/table/gTable.obj");
 	Model modelBall("models/ball/ball.obj");
 	Model modelPin("models/pin/scaledPin.obj");
 	Model modelSkybox("models/cube/cube.obj");
 
-	//CREO IL CORPO RIGIDO DA ASSEGNARE AL TAVOLO
-	glm::vec3 bodyTablePos = glm::vec3(0.0f, 6.02f, 0.0f);
-	glm::vec3 bodyTableSize = glm::vec3(12.3f, 0.1f, 5.5f);
-	glm::vec3 bodyTableRotation = glm::vec3(0.0f, 0.0f, 0.0f);
-
-	btRigidBody* bodyTable = poolSimulation.createRigidBody(0, bodyTablePos, bodyTableSize, bodyTableRotation, 0.0, 0.6, 0.0);
+	//CARICO LA GEOMETRIA STATICA NEI BUFFER CONDIVISI: IL TAVOLO VIENE PORTATO IN COORDINATE MONDO ED UNITO PER MATERIALE
+	staticGeometry.Add(modelTable, table_model_matrix());
 
-	//CREO I BORDI DEL TAVOLO
-	//LATO LUNGO POSTERIORE
-	glm::vec3 bodyTableLSPos = glm::vec3(0.0f, 6.8f, -5.5f);
-	glm::vec3 bodyTableLSSize = glm::vec3(12.3f, 1.0f, 0.1f);
-	glm::vec3 bodyTableLSRotation = glm::vec3(0.0f, 0.0f, 0.0f);
+	//PREPARO IL BINDING DEI MATERIALI PER GLI SHADER CON CUI VERRANNO RENDERIZZATI I MODELLI
+	staticGeometry.BindMaterials(shaderTexture);
+	modelBall.BindMaterials(shaderNoTexture);
+	modelPin.BindMaterials(shaderTexture);
+	modelSkybox.BindMaterials(shaderSkybox);
 
-	bodyTable = poolSimulation.createRigidBody(0, bodyTableLSPos, bodyTableLSSize, bodyTableLSRotation, 0.0, 0.5, 0.7);
+	//PREPARO L'IMPOSTOR DELLE BIGLIE, CON LA SFERA CHE RACCHIUDE LA MESH DEL MODELLO
+	ballImpostor.Setup(modelBall.bounds);
 
-	//LATO LUNGO ANTERIORE
-	bodyTableLSPos = glm::vec3(0.0f, 6.8f, 5.5f);
+	//RENDERIZZO LE VISTE DEL BIRILLO NELL'ATLAS DEI BILLBOARD
+	//Lo shader di pre-rendering serve solo in questa fase; se il framebuffer non e' disponibile i birilli usano sempre la mesh
+	Shader shaderBillboardBake("shaders/shaderBillboardBake.vert", "shaders/shaderBillboardBake.frag");
+	if (pinBillboard.Bake(modelPin, shaderBillboardBake))
+		pinBillboard.BindMaterial(shaderBillboard);
+	shaderBillboardBake.Delete();
 
-	bodyTable = poolSimulation.createRigidBody(0, bodyTableLSPos, bodyTableLSSize, bodyTableLSRotation, 0.0, 0.5, 0.7);
-
-	//LATO CORTO SINISTRO
-	glm::vec3 bodyTableSSPos = glm::vec3(-12.13f, 6.8f, 0.0f);
-	glm::vec3 bodyTableSSSize = glm::vec3(0.1f, 1.0f, 5.5f);
-	glm::vec3 bodyTableSSRotation = glm::vec3(0.0f, 0.0f, 0.0f);
+	//CREO I CORPI RIGIDI DELLA SCENA
+	create_table(poolSimulation, sceneBodies);
 
-	bodyTable = poolSimulation.createRigidBody(0, bodyTableSSPos, bodyTableSSSize, bodyTableSSRotation, 0.0, 0.5, 0.7);
+	btRigidBody* bodyBallWhite = sceneBodies[0];
+	btRigidBody* bodyBallYellow = sceneBodies[1];
+	btRigidBody* bodyBallRed = sceneBodies[2];
 
-	//LATO CORTO DESTRO
-	bodyTableSSPos = glm::vec3(12.2f, 6.8f, 0.0f);
-
-	bodyTable = poolSimulation.createRigidBody(0, bodyTableSSPos, bodyTableSSSize, bodyTableSSRotation, 0.0, 0.5, 0.7);
-
-	//CREO IL CORPO RIGIDO DA ASSEGNARE AI BIRILLI
-	// Dimensione rigibody Cylinder per modello birillo
-	glm::vec3 bodyPinSize = glm::vec3(0.05f, 0.18f, 0.05f);
+	//Inserisco le biglie all'interno del vettore per gestire i giocatori
+	playersBall.push_back(bodyBallWhite);
+	playersBall.push_back(bodyBallYellow);
 
-	glm::vec3 bodyPinRotation = glm::vec3(0.0f, 0.0f, 0.0f);
+	vectorPin.assign(sceneBodies.begin() + 3, sceneBodies.end());
 
-	for (int i = 0; i < 5; i++) {
-		btRigidBody* bodyPin = poolSimulation.createRigidBody(2, poolPinPos[i], bodyPinSize, bodyPinRotation, 0.1, 0.4, 0.0);
-		vectorPin.push_back(bodyPin);
-	}
+	//AVVIO LA REGISTRAZIONE DELLA PARTITA
+	//Il nome del file contiene data ed ora di inizio, in modo da conservare tutte le partite giocate
+	char replayName[64];
+	time_t now = time(nullptr);
+	strftime(replayName, sizeof(replayName), "replay_%Y%m%d_%H%M%S.grp", localtime(&now));
 
-	//CREO IL CORPO RIGIDO DA ASSEGNARE ALLE BIGLIE
-	glm::vec3 bodyBallRadius = sphereSize;
-	glm::vec3 bodyBallRotation = glm::vec3(0.0f, 0.0f, 0.0f);
+	if (replayRecorder.Open(replayName, sceneBodies.size(), PHYSICS_TICK))
+		replayRecorder.RecordKeyframe(sceneBodies);
 
-	btRigidBody* bodyBallWhite = poolSimulation.createRigidBody(1, poolBallPos[0], bodyBallRadius, bodyBallRotation, 1.0, 0.7, 0.4);
-	btRigidBody* bodyBallYellow = poolSimulation.createRigidBody(1, poolBallPos[1], bodyBallRadius, bodyBallRotation, 1.0, 0.7, 0.4);
-	btRigidBody* bodyBallRed = poolSimulation.createRigidBody(1, poolBallPos[2], bodyBallRadius, bodyBallRotation, 1.0, 0.7, 0.4);
+	//Se viene passato un file di replay, lo apro per rivedere i tiri in esso registrati
+	if (argc > 1)
+		replayFile.Open(argv[1]);
 
-	//Lo uso per evitare che la biglia salti
-	bodyBallWhite->setLinearFactor(btVector3(1, 0, 1));
-	bodyBallYellow->setLinearFactor(btVector3(1, 0, 1));
-	bodyBallRed->setLinearFactor(btVector3(1, 0, 1));
+	//Ad ogni step interno della simulazione registro le trasformazioni dei corpi
+	poolSimulation.dynamicsWorld->setInternalTickCallback(physics_tick_callback);
 
-	bodyBallWhite->setAngularFactor(0.1);
-	bodyBallYellow->setAngularFactor(0.1);
-	bodyBallRed->setAngularFactor(1.0);
+	//AVVIO IL THREAD CHE CALCOLA LA TRAIETTORIA PREVISTA DEL TIRO
+	//Prima carico gli esiti dei tiri simulati nelle sessioni precedenti
+	shotCache.Load("shot_cache.bin");
+	shotPreview.Start();
 
-	//Inserisco le biglie all'interno del vettore per gestire i giocatori
-	playersBall.push_back(bodyBallWhite);
-	playersBall.push_back(bodyBallYellow);
+	//Il buffer viene creato una sola volta e riempito solo quando arriva un nuovo risultato
+	glGenVertexArrays(1, &previewVAO);
+	glGenBuffers(1, &previewVBO);
+	gl_state().BindVertexArray(previewVAO);
+	gl_state().BindBuffer(GL_ARRAY_BUFFER, previewVBO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), 0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (GLvoid*) (3 * sizeof(GLfloat)));
+	gl_state().BindVertexArray(0);
 
 	//CARICO LE TEXTURE
 	//Carico le texture per lo skybox
 	GLuint textureSkybox = load_cubemap(faces);
 
+	//IMPOSTO I MATERIALI DEGLI OGGETTI DELLA SCENA
+	setup_materials(textureSkybox);
+
 	//INIZIALIZZO LA ORTHOGRAPHIC MATRIX PER IL TEXTRENDERING
 	projection = glm::ortho(0.0f, static_cast<GLfloat>(SCR_WIDTH), 0.0f, static_cast<GLfloat>(SCR_HEIGHT));
 	shaderText.Use();
-	shaderText.setMat4("projectionMatrix",projection);
+	shaderText.set(uniformsTX.projectionMatrix, projection);
 
 	//INIZIALIZZO LA PROJECTION MATRIX
 	projection = glm::perspective(45.0f, (float) SCR_WIDTH / (float) SCR_HEIGHT, 1.0f, 10000.0f);
+	//La dimensione in pixel dell'errore dei livelli di dettaglio dipende dalla proiezione
+	lodSelector.setProjection(projection, (GLfloat) SCR_HEIGHT);
 
 	//CREO LE VARIABILI DI SUPPORTO
 	// imposto il delta di tempo massimo per aggiornare la simulazione fisica
@@ -320,7 +506,7 @@ int main() {
 	camera.setObjectPos(poolBallPos[0]);
 
 	btTransform transform;
-	btVector3 linearVelocity, origin, temp;
+	btVector3 linearVelocity, origin, temp, aimImpulse, aimRelPos;
 
 	glm::vec3 position;
 	GLfloat playerIndexOffset = 40.0f;
@@ -328,6 +514,17 @@ int main() {
 
 	int counterPoint[] = {0, 0};
 
+	vector<btRigidBody*> replayPins;
+	char replayLabel[64];
+
+	//CREO GLI ELEMENTI DELL'HUD
+	char pointLabel[16];
+	int hudPlayer = hud.AddText("*", 15.0f, 670.0f, TEXT_SIZE, glm::vec3(1.0f));
+	hud.AddText("Giocatore 1 | ", 40.0f, 675.0f, TEXT_SIZE, glm::vec3(1.0f));
+	hud.AddText("Giocatore 2 | ", 40.0f, 635.0f, TEXT_SIZE, glm::vec3(1.0f));
+	int hudPoint[] = { hud.AddText("0", 250.0f, 675.0f, TEXT_SIZE, glm::vec3(1.0f)), hud.AddText("0", 250.0f, 635.0f, TEXT_SIZE, glm::vec3(1.0f)) };
+	int hudReplay = hud.AddText("", 40.0f, 40.0f, TEXT_SIZE, glm::vec3(1.0f));
+
 	//AVVIO IL RENDER LOOP
 	while (!glfwWindowShouldClose(window)) {
 		GLfloat currentFrame = glfwGetTime();
@@ -339,42 +536,103 @@ int main() {
 
 		glfwPollEvents();
 
-		//INIZIALIZZO LA VIEW MATRIX
+		//INIZIALIZZO LA VIEW MATRIX E CARICO I DATI DEL FRAME
 		view = camera.GetViewMatrix();
 
+		update_frame_uniforms();
+
 		if (debugMode)
-			debugger.setDebugMode(btIDebugDraw::DBG_DrawWireframe);
+			debugger.setDebugMode(btIDebugDraw::DBG_DrawWireframe | btIDebugDraw::DBG_DrawContactPoints | btIDebugDraw::DBG_DrawAabb);
 		else
 			debugger.setDebugMode(btIDebugDraw::DBG_NoDebug);
 
 		//SETTO LA SIMULAZIONE FISICA ED IL DEBUGGER
 		poolSimulation.dynamicsWorld->setDebugDrawer(&debugger);
 
-		debugger.SetMatrices(&shaderDebugger, projection, view, model);
+		//Le linee raccolte dal debugger vengono renderizzate tutte insieme con una sola draw call
+		debugger.SetMatrices(&shaderDebugger, uniformsD.modelMatrix, model);
 		poolSimulation.dynamicsWorld->debugDrawWorld();
+		debugger.Flush(&shaderDebugger);
+
+		//Durante il replay la partita resta in pausa
+		if (!replayMode)
+			poolSimulation.stepWorld(deltaTime < maxSecPerFrame ? deltaTime : maxSecPerFrame);
 
-		poolSimulation.dynamicsWorld->stepSimulation((deltaTime < maxSecPerFrame ? deltaTime : maxSecPerFrame), 10);
+		//AGGIORNO LA TRAIETTORIA PREVISTA DEL TIRO
+		//La richiesta viene inviata al piu' una volta per frame, solo mentre il giocatore sta mirando, ed annulla quella precedente
+		if (aimChanged && !checkShoot && !replayMode) {
+			compute_shot_impulse(aimImpulse, aimRelPos);
+			aimState.Capture(sceneBodies);
+
+			shotPreview.Request(aimState, player, aimImpulse, aimRelPos);
+
+			aimChanged = false;
+		}
+
+		if (shotPreview.getResult(aimPreview))
+			update_aim_preview(aimPreview);
 
 		//RENDERIZZO GLI OGGETTI DELLA SCENA
-		draw_model_notexture(shaderNoTexture, modelBall, bodyBallWhite, bodyBallRed, bodyBallYellow);
+		//Raccolgo le istanze ed i loro volumi di contenimento, aggiornati dalle trasformazioni dei corpi rigidi
+		frustumCuller.Begin(projection * view);
+		lodSelector.Begin(camera.Position);
+
+		if (replayMode) {
+			//La posizione orizzontale del mouse indica l'istante del tiro da visualizzare
+			replayViewer.Seek((mouseX / SCR_WIDTH) * replayViewer.getDuration());
+
+			const vector<btRigidBody*> &replayBodies = replayViewer.getBodies();
+			replayPins.assign(replayBodies.begin() + 3, replayBodies.end());
+
+			collect_model_notexture(modelBall, replayBodies[0], replayBodies[2], replayBodies[1]);
+
+			collect_model_texture(modelPin, replayPins);
+		} else {
+			collect_model_notexture(modelBall, bodyBallWhite, bodyBallRed, bodyBallYellow);
+
+			collect_model_texture(modelPin, vectorPin);
+		}
+
+		//Tutti i volumi vengono testati insieme contro il view frustum, ed alla coda arrivano solo gli oggetti visibili
+		frustumCuller.Cull();
+
+		submit_scene(shaderNoTexture, shaderTexture, shaderImpostor, shaderBillboard, modelBall, modelPin);
+
+		//Lo skybox circonda la camera, per cui e' sempre visibile e non viene testato
+		submit_skybox(shaderSkybox, modelSkybox);
 
-		draw_model_texture(shaderTexture, modelTable, modelPin, vectorPin);
+		//I pacchetti vengono ordinati per program, texture, materiale e mesh e renderizzati insieme
+		renderQueue.Flush();
 
-		draw_skybox(shaderSkybox, modelSkybox, textureSkybox);
+		//Chiudo il frame della scelta dei LOD, che somma i contatori del frame alle statistiche stampate all'uscita
+		lodSelector.EndFrame();
+
+		if (!replayMode && !checkShoot)
+			draw_aim_preview(shaderDebugger);
 
 		//RENDERIZZO IL TESTO
-		render_text(shaderText, "*", 15.0f, 670.0f - playerIndexOffset * player, 1.0f, glm::vec3(1.0f));
-		render_text(shaderText, "Giocatore 1 | ", 40.0f, 675.0f, 1.0f, glm::vec3(1.0f));
-		render_text(shaderText, to_string(counterPoint[0]), 250.0f, 675.0f, 1.0f, glm::vec3(1.0f));
-		render_text(shaderText, "Giocatore 2 | ", 40.0f, 635.0f, 1.0f, glm::vec3(1.0f));
-		render_text(shaderText, to_string(counterPoint[1]), 250.0f, 635.0f, 1.0f, glm::vec3(1.0f));
+		//Aggiorno gli elementi dell'HUD con i valori correnti: vengono ricalcolati solo quelli che sono cambiati
+		hud.SetPosition(hudPlayer, 15.0f, 670.0f - playerIndexOffset * player);
+		for (int i = 0; i < 2; i++) {
+			snprintf(pointLabel, sizeof(pointLabel), "%d", counterPoint[i]);
+			hud.SetText(hudPoint[i], pointLabel);
+		}
+
+		hud.SetVisible(hudReplay, replayMode);
+		if (replayMode) {
+			snprintf(replayLabel, sizeof(replayLabel), "Replay %.2f / %.2f s", replayViewer.getTime(), replayViewer.getDuration());
+			hud.SetText(hudReplay, replayLabel);
+		}
+
+		hud.Draw(shaderText, fontAtlas);
+		fontAtlas.EndFrame();
 
 		model = mat4(1.0f);
 
 		//GESTISCO IL CAMBIO GIOCATORE
 		linearVelocity = playersBall[player]->getLinearVelocity();
 
-		if (check_idle_ball(linearVelocity) && checkShoot) {
+		if (!replayMode && check_idle_ball(linearVelocity) && checkShoot) {
 			// Non appena la biglia del giocatore si ferma, passo all'altro giocatore, spostando la camera sull'altra biglia
 			playersBall[!player]->getMotionState()->getWorldTransform(transform);
 			origin = transform.getOrigin();
@@ -409,18 +667,110 @@ int main() {
 			checkShoot = false;
 
 			player = !player;
+
+			aimChanged = true;
+
+			//Registro il cambio di turno, e lo stato dei birilli appena riposizionati
+			replayRecorder.RecordTurn(player, counterPoint);
+			replayRecorder.RecordKeyframe(sceneBodies);
 		}
 
+		//Chiudo il frame della cache dello stato OpenGL, che conta i binding eseguiti e quelli scartati perche' ridondanti
+		gl_state().EndFrame();
+
 		glfwSwapBuffers(window);
 	}
 
 	//PULISCO LA MEMORIA
 	shaderTexture.Delete();
 	shaderNoTexture.Delete();
+	shaderImpostor.Delete();
+	shaderBillboard.Delete();
 	shaderDebugger.Delete();
 	shaderSkybox.Delete();
 	shaderText.Delete();
 
+	shotPreview.Stop();
+
+	ShotCacheStats cacheStats = shotCache.getStats();
+	cout << "Cache dei tiri: " << cacheStats.hits << " hit, " << cacheStats.misses << " miss (hit rate "
+		 << (cacheStats.hits + cacheStats.misses > 0 ? 100.0 * cacheStats.hits / (cacheStats.hits + cacheStats.misses) : 0.0) << "%), "
+		 << cacheStats.entries << " voci, " << cacheStats.bytes / 1024 << " KB, " << cacheStats.evictions << " eliminate" << endl;
+
+	shotCache.Save("shot_cache.bin");
+
+	FontAtlasStats fontStats = fontAtlas.getStats();
+	cout << "Atlas del font: " << fontStats.glyphs << " glyph, " << fontStats.rasterized << " rasterizzati, "
+		 << fontStats.pages << " pagine (" << fontStats.bytes / 1024 << " KB), " << fontStats.evictions << " pagine svuotate" << endl;
+
+	const RenderQueueStats &queueStats = renderQueue.getTotals();
+	double queueFrames = renderQueue.getFrames() > 0 ? (double) renderQueue.getFrames() : 1.0;
+	cout << "Coda di rendering, media per frame: " << queueStats.packets / queueFrames << " pacchetti, " << queueStats.drawCalls / queueFrames << " draw call, "
+		 << queueStats.programChanges / queueFrames << " cambi di program, " << queueStats.materialChanges / queueFrames << " cambi di materiale, "
+		 << queueStats.textureBinds / queueFrames << " texture collegate, " << queueStats.vertexArrayBinds / queueFrames << " VAO collegati" << endl;
+
+	const CullingStats &cullingStats = frustumCuller.getTotals();
+	double cullingFrames = frustumCuller.getFrames() > 0 ? (double) frustumCuller.getFrames() : 1.0;
+	cout << "Frustum culling, media per frame: " << cullingStats.tested / cullingFrames << " volumi testati, " << cullingStats.culled / cullingFrames << " scartati" << endl;
+
+	const LodStats &lodStats = lodSelector.getTotals();
+	double lodFrames = lodSelector.getFrames() > 0 ? (double) lodSelector.getFrames() : 1.0;
+	cout << "Livelli di dettaglio, media per frame: " << lodStats.triangles / lodFrames << " triangoli contro " << lodStats.fullTriangles / lodFrames
+		 << " al massimo dettaglio (" << (lodStats.fullTriangles > 0 ? 100.0 * lodStats.triangles / lodStats.fullTriangles : 100.0) << "%), "
+		 << lodStats.switches / lodFrames << " cambi di livello; mesh per livello:";
+	for (int l = 0; l < LOD_MAX_LEVELS; l++)
+		cout << " " << l << ": " << lodStats.selections[l] / lodFrames;
+	cout << endl;
+
+	const BillboardStats &billboardStats = pinBillboard.getTotals();
+	double billboardFrames = pinBillboard.getFrames() > 0 ? (double) pinBillboard.getFrames() : 1.0;
+	cout << "Birilli visibili, media per frame: " << billboardStats.meshes / billboardFrames << " con la mesh, " << billboardStats.billboards / billboardFrames
+		 << " come billboard (distanza di passaggio " << pinBillboard.getDistance() << ")" << endl;
+
+	const HudStats &hudStats = hud.getStats();
+	cout << "HUD: " << hudStats.frames << " frame, " << hudStats.layouts << " elementi ricalcolati, " << hudStats.uploads << " caricamenti del buffer" << endl;
+
+	const GLStateStats &glStats = gl_state().getTotals();
+	double glFrames = gl_state().getFrames() > 0 ? (double) gl_state().getFrames() : 1.0;
+	cout << "Stato OpenGL, media per frame (eseguite / scartate):";
+	for (int c = 0; c < GL_STATE_CALLS; c++)
+		cout << " " << GLStateCache::getCallName(c) << " " << glStats.issued[c] / glFrames << " / " << glStats.elided[c] / glFrames;
+	cout << endl;
+	if (glStats.mismatches > 0)
+		cout << "ERROR::GLSTATE::VERIFY: " << glStats.mismatches << " differenze tra la cache e lo stato reale" << endl;
+
+	gl_state().DeleteVertexArrays(1, &previewVAO);
+	gl_state().DeleteBuffers(1, &previewVBO);
+	gl_state().DeleteBuffers(1, &frameUBO);
+	hud.Delete();
+	staticGeometry.Delete();
+	ballImpostor.Delete();
+	pinBillboard.Delete();
+	debugger.Delete();
+	fontAtlas.Delete();
+
+	replayRecorder.Close();
+	replayFile.Close();
+
+	//Confronto i substep eseguiti con quelli dello step fisso da 1/60 s usato in precedenza, e con quelli che sarebbero serviti
+	//per avere sempre la precisione dello step minimo
+	const AdaptiveDynamicsWorld *world = poolSimulation.dynamicsWorld;
+	double baselineSteps = world->ticks * PHYSICS_TICK / PHYSICS_BASELINE_STEP;
+	double uniformSteps = world->ticks * PHYSICS_TICK / PHYSICS_MIN_STEP;
+	cout << "Substep adattivi: " << world->substeps << " in " << world->ticks << " tick (" << world->fastSubsteps << " ridotti per corpi veloci) contro "
+		 << (unsigned long) baselineSteps << " con lo step fisso da " << PHYSICS_BASELINE_STEP << " s ("
+		 << (baselineSteps > 0.0 ? 100.0 * (1.0 - world->substeps / baselineSteps) : 0.0) << "% in meno) e "
+		 << (unsigned long) uniformSteps << " con step uniforme da " << PHYSICS_MIN_STEP << " s ("
+		 << (uniformSteps > 0.0 ? 100.0 * (1.0 - world->substeps / uniformSteps) : 0.0) << "% in meno)" << endl;
+
+	//Confronto le iterazioni del solver con quelle che avrebbe eseguito il numero fisso di iterazioni della Bullet su ogni isola
+	const SolverStepStats &solverStats = poolSimulation.solver->getTotals();
+	if (solverStats.steps > 0)
+		cout << "Iterazioni del solver: " << (double) solverStats.iterations / solverStats.steps << " per step (massimo "
+			 << solverStats.maxIslandIterations << " per isola) contro "
+			 << (double) solverStats.islands * poolSimulation.dynamicsWorld->getSolverInfo().m_numIterations / solverStats.steps
+			 << " con " << poolSimulation.dynamicsWorld->getSolverInfo().m_numIterations << " iterazioni fisse" << endl;
+
 	poolSimulation.Clear();
 
 	glfwTerminate();
@@ -437,6 +787,43 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	//Se viene premuto D, attiva/disattiva la visualizzazione del debugger della Bullet
 	if (key == GLFW_KEY_D && action == GLFW_PRESS)
 		debugMode = !debugMode;
+
+	//Se viene premuto R, entra/esce dalla modalita' replay dell'ultimo tiro
+	if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+		replayMode = replayMode ? false : load_replay_shot();
+
+		aimChanged = true;
+	}
+
+	//Durante il replay di un file, le frecce sinistra e destra selezionano il tiro precedente o successivo
+	if ((key == GLFW_KEY_LEFT || key == GLFW_KEY_RIGHT) && action == GLFW_PRESS && replayMode && !replayFile.getShots().empty()) {
+		size_t count = replayFile.getShots().size();
+
+		replayShotIndex = (key == GLFW_KEY_RIGHT) ? (replayShotIndex + 1) % count : (replayShotIndex + count - 1) % count;
+		replayMode = load_replay_shot();
+	}
+
+	//Se viene premuto B, le biglie passano dalla mesh del modello agli impostor e viceversa
+	if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+		impostorMode = !impostorMode;
+
+		if (impostorMode)
+			cout << "Biglie renderizzate come impostor: 4 vertici per biglia" << endl;
+		else
+			cout << "Biglie renderizzate con la mesh del modello" << endl;
+	}
+
+	//Con [ e ] si dimezza o si raddoppia la distanza oltre la quale i birilli vengono renderizzati come billboard
+	if (key == GLFW_KEY_LEFT_BRACKET && action == GLFW_PRESS)
+		pinBillboard.setDistance(pinBillboard.getDistance() * 0.5f);
+	if (key == GLFW_KEY_RIGHT_BRACKET && action == GLFW_PRESS)
+		pinBillboard.setDistance(pinBillboard.getDistance() * 2.0f);
+
+	//Con - e = si dimezza o si raddoppia la soglia in pixel dell'errore dei livelli di dettaglio
+	if (key == GLFW_KEY_MINUS && action == GLFW_PRESS)
+		lodSelector.setThreshold(lodSelector.getThreshold() * 0.5f);
+	if (key == GLFW_KEY_EQUAL && action == GLFW_PRESS)
+		lodSelector.setThreshold(lodSelector.getThreshold() * 2.0f);
 }
 
 //GESTISCO LA CREAZIONE DELLA FINESTRA
@@ -458,48 +845,205 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
 	lastX = xpos;
 	lastY = ypos;
 
-	view = camera.RotateAroundPoint(xOffset, glm::vec3(0.0f, 1.0f, 0.0f));
+	//Durante il replay il mouse scorre il tiro, quindi la camera resta ferma
+	if (!replayMode)
+		view = camera.RotateAroundPoint(xOffset, glm::vec3(0.0f, 1.0f, 0.0f));
 
 	mouseX = xpos;
 	mouseY = ypos;
+
+	aimChanged = true;
 }
 
 //GESTISCO GLI INPUT DEL MOUSE
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
-	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
+	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && !replayMode) {
 		throw_ball(playersBall[player]);
 	}
 }
 
+//FUNZIONE UTILIZZATA PER CREARE I CORPI RIGIDI DELLA SCENA
+//Popola la simulazione con tavolo, bordi, birilli e biglie. I corpi dinamici vengono restituiti nell'ordine: biglia bianca, gialla, rossa e i 5 birilli.
+//La stessa funzione crea sia il mondo di gioco sia quelli usati per il replay, in modo che le due simulazioni siano identiche.
+void create_table(Physics &simulation, vector<btRigidBody*> &bodies) {
+	//CREO IL CORPO RIGIDO DA ASSEGNARE AL TAVOLO
+	glm::vec3 bodyTablePos = glm::vec3(0.0f, 6.02f, 0.0f);
+	glm::vec3 bodyTableSize = glm::vec3(12.3f, 0.1f, 5.5f);
+	glm::vec3 bodyTableRotation = glm::vec3(0.0f, 0.0f, 0.0f);
+
+	simulation.createRigidBody(0, bodyTablePos, bodyTableSize, bodyTableRotation, 0.0, 0.6, 0.0);
+
+	//CREO I BORDI DEL TAVOLO
+	//LATO LUNGO POSTERIORE
+	glm::vec3 bodyTableLSPos = glm::vec3(0.0f, 6.8f, -5.5f);
+	glm::vec3 bodyTableLSSize = glm::vec3(12.3f, 1.0f, 0.1f);
+	glm::vec3 bodyTableLSRotation = glm::vec3(0.0f, 0.0f, 0.0f);
+
+	simulation.createRigidBody(0, bodyTableLSPos, bodyTableLSSize, bodyTableLSRotation, 0.0, 0.5, 0.7);
+
+	//LATO LUNGO ANTERIORE
+	bodyTableLSPos = glm::vec3(0.0f, 6.8f, 5.5f);
+
+	simulation.createRigidBody(0, bodyTableLSPos, bodyTableLSSize, bodyTableLSRotation, 0.0, 0.5, 0.7);
+
+	//LATO CORTO SINISTRO
+	glm::vec3 bodyTableSSPos = glm::vec3(-12.13f, 6.8f, 0.0f);
+	glm::vec3 bodyTableSSSize = glm::vec3(0.1f, 1.0f, 5.5f);
+	glm::vec3 bodyTableSSRotation = glm::vec3(0.0f, 0.0f, 0.0f);
+
+	simulation.createRigidBody(0, bodyTableSSPos, bodyTableSSSize, bodyTableSSRotation, 0.0, 0.5, 0.7);
+
+	//LATO CORTO DESTRO
+	bodyTableSSPos = glm::vec3(12.2f, 6.8f, 0.0f);
+
+	simulation.createRigidBody(0, bodyTableSSPos, bodyTableSSSize, bodyTableSSRotation, 0.0, 0.5, 0.7);
+
+	//CREO IL CORPO RIGIDO DA ASSEGNARE AI BIRILLI
+	// Dimensione rigibody Cylinder per modello birillo
+	glm::vec3 bodyPinSize = glm::vec3(0.05f, 0.18f, 0.05f);
+
+	glm::vec3 bodyPinRotation = glm::vec3(0.0f, 0.0f, 0.0f);
+
+	vector<btRigidBody*> pins;
+
+	for (int i = 0; i < 5; i++) {
+		btRigidBody* bodyPin = simulation.createRigidBody(2, poolPinPos[i], bodyPinSize, bodyPinRotation, 0.1, 0.4, 0.0);
+		pins.push_back(bodyPin);
+	}
+
+	//CREO IL CORPO RIGIDO DA ASSEGNARE ALLE BIGLIE
+	glm::vec3 bodyBallRadius = sphereSize;
+	glm::vec3 bodyBallRotation = glm::vec3(0.0f, 0.0f, 0.0f);
+
+	btRigidBody* bodyBallWhite = simulation.createRigidBody(1, poolBallPos[0], bodyBallRadius, bodyBallRotation, 1.0, 0.7, 0.4);
+	btRigidBody* bodyBallYellow = simulation.createRigidBody(1, poolBallPos[1], bodyBallRadius, bodyBallRotation, 1.0, 0.7, 0.4);
+	btRigidBody* bodyBallRed = simulation.createRigidBody(1, poolBallPos[2], bodyBallRadius, bodyBallRotation, 1.0, 0.7, 0.4);
+
+	//Lo uso per evitare che la biglia salti
+	bodyBallWhite->setLinearFactor(btVector3(1, 0, 1));
+	bodyBallYellow->setLinearFactor(btVector3(1, 0, 1));
+	bodyBallRed->setLinearFactor(btVector3(1, 0, 1));
+
+	bodyBallWhite->setAngularFactor(0.1);
+	bodyBallYellow->setAngularFactor(0.1);
+	bodyBallRed->setAngularFactor(1.0);
+
+	bodies.push_back(bodyBallWhite);
+	bodies.push_back(bodyBallYellow);
+	bodies.push_back(bodyBallRed);
+	bodies.insert(bodies.end(), pins.begin(), pins.end());
+}
+
 //FUNZIONE UTILIZZATA PER IL LANCIO DELLA BIGLIA
 //Applico un impulso al centro della biglia, calcolando la direzione mediante la posizione del mouse.
 void throw_ball(btRigidBody* ball) {
 	// Se la palla non  ancora ferma, l'altro giocatore non pu tirare.
 	if (!checkShoot) {
-		glm::mat4 screenToWorld = glm::inverse(projection * view);
-
-		GLfloat shootInitialSpeed = 20.0f;
-
-		GLfloat x = (mouseX / SCR_WIDTH) * 2 - 1,
-				y = -(mouseY / SCR_HEIGHT) * 2 + 1;
-
 		btVector3 impulse, relPos;
 
-		glm::vec4 mousePos = glm::vec4(x, y, 1.0f, 1.0f);
+		compute_shot_impulse(impulse, relPos);
 
-		glm::vec4 direction = glm::normalize(screenToWorld * mousePos) * shootInitialSpeed;
+		//Registro lo stato completo della scena prima del tiro, insieme al tiro stesso, in modo da poterlo risimulare
+		replayRecorder.RecordKeyframe(sceneBodies);
+		replayRecorder.RecordShot(player, impulse, relPos);
 
-		impulse = btVector3(direction.x, direction.y, direction.z);
-
-		relPos = btVector3(1.0, 1.0, 1.0);
+		lastShotState.Capture(sceneBodies);
+		lastShotPlayer = player;
+		lastShotImpulse = impulse;
+		lastShotRelPos = relPos;
+		hasLastShot = true;
 
 		ball->activate(true);
 		ball->applyImpulse(impulse, relPos);
 
+		//Durante il tiro la traiettoria prevista non viene mostrata
+		shotPreview.Cancel();
+
 		checkShoot = true;
 	}
 }
 
+//FUNZIONE UTILIZZATA PER CALCOLARE L'IMPULSO DEL TIRO
+//La direzione viene calcolata mediante la posizione del mouse, riportata nello spazio del mondo.
+//E' usata sia per il tiro vero e proprio sia per la previsione della traiettoria, in modo che coincidano.
+void compute_shot_impulse(btVector3 &impulse, btVector3 &relPos) {
+	glm::mat4 screenToWorld = glm::inverse(projection * view);
+
+	GLfloat shootInitialSpeed = 20.0f;
+
+	GLfloat x = (mouseX / SCR_WIDTH) * 2 - 1,
+			y = -(mouseY / SCR_HEIGHT) * 2 + 1;
+
+	glm::vec4 mousePos = glm::vec4(x, y, 1.0f, 1.0f);
+
+	glm::vec4 direction = glm::normalize(screenToWorld * mousePos) * shootInitialSpeed;
+
+	impulse = btVector3(direction.x, direction.y, direction.z);
+
+	relPos = btVector3(1.0, 1.0, 1.0);
+}
+
+//FUNZIONE UTILIZZATA PER AGGIORNARE LA TRAIETTORIA PREVISTA DEL TIRO
+//Converte l'ultimo risultato del thread di previsione in una lista di segmenti colorati, caricata nel buffer una sola volta
+void update_aim_preview(const ShotPreviewResult &preview) {
+	static const glm::vec3 pathColors[PREVIEW_BALLS] = {
+		glm::vec3(1.0f, 1.0f, 1.0f), // biglia bianca
+		glm::vec3(1.0f, 1.0f, 0.0f), // biglia gialla
+		glm::vec3(1.0f, 0.0f, 0.0f) // biglia rossa
+	};
+	static const glm::vec3 collisionColor = glm::vec3(1.0f, 0.0f, 1.0f);
+	static const GLfloat collisionSize = 0.15f;
+
+	previewVertices.clear();
+
+	for (int i = 0; i < PREVIEW_BALLS; i++) {
+		for (size_t j = 1; j < preview.paths[i].size(); j++) {
+			const btVector3 &from = preview.paths[i][j - 1];
+			const btVector3 &to = preview.paths[i][j];
+
+			GLfloat segment[12] = { from.x(), from.y(), from.z(), pathColors[i].x, pathColors[i].y, pathColors[i].z,
+									to.x(), to.y(), to.z(), pathColors[i].x, pathColors[i].y, pathColors[i].z };
+			previewVertices.insert(previewVertices.end(), segment, segment + 12);
+		}
+	}
+
+	//Ogni urto previsto viene segnato con una piccola croce sui tre assi
+	for (size_t i = 0; i < preview.collisions.size(); i++) {
+		const btVector3 &point = preview.collisions[i];
+
+		for (int axis = 0; axis < 3; axis++) {
+			btVector3 offset(0.0f, 0.0f, 0.0f);
+			offset[axis] = collisionSize;
+
+			btVector3 from = point - offset, to = point + offset;
+
+			GLfloat segment[12] = { from.x(), from.y(), from.z(), collisionColor.x, collisionColor.y, collisionColor.z,
+									to.x(), to.y(), to.z(), collisionColor.x, collisionColor.y, collisionColor.z };
+			previewVertices.insert(previewVertices.end(), segment, segment + 12);
+		}
+	}
+
+	previewVertexCount = previewVertices.size() / 6;
+
+	gl_state().BindBuffer(GL_ARRAY_BUFFER, previewVBO);
+	glBufferData(GL_ARRAY_BUFFER, previewVertices.size() * sizeof(GLfloat), previewVertices.data(), GL_DYNAMIC_DRAW);
+}
+
+//FUNZIONE UTILIZZATA PER CARICARE IL TIRO DA RIVEDERE
+//Se e' stato aperto un file di replay carico il tiro selezionato, altrimenti l'ultimo tiro della partita in corso.
+//Restituisce false se non c'e' alcun tiro da rivedere.
+bool load_replay_shot() {
+	if (!replayFile.getShots().empty())
+		return replayViewer.Load(replayFile, replayShotIndex);
+
+	if (!hasLastShot)
+		return false;
+
+	replayViewer.Load(lastShotState, lastShotPlayer, lastShotImpulse, lastShotRelPos);
+
+	return true;
+}
+
 //CARICO LE TEXTURE
 //Carico le immagini per formare una Cubemap
 GLuint load_cubemap(vector<string> faces) {
@@ -507,8 +1051,8 @@ GLuint load_cubemap(vector<string> faces) {
 	GLint width, height, nrChannels;
 
 	glGenTextures(1, &textureID);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+	gl_state().ActiveTexture(GL_TEXTURE0);
+	gl_state().BindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
 	for (GLuint i = 0; i < faces.size(); i++) {
 		unsigned char *face = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
@@ -528,257 +1072,336 @@ GLuint load_cubemap(vector<string> faces) {
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	gl_state().BindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
 	return textureID;
 }
 
-//RENDERIZZO GLI OGGETTI DELLA SCENA
-//Imposto lo shader e renderizzo i modelli degli oggetti senza texture
-void draw_model_notexture(Shader &shaderNT, Model &ball, btRigidBody* bodyWhite, btRigidBody* bodyRed, btRigidBody* bodyYellow) {
-	GLfloat matrix[16];
-	btTransform transform;
-
-	shaderNT.Use();
-
-	//RENDERIZZO LE BIGLIE DA BILIARDO
-	//INIZIO DALLA BIANCA
-	for (GLuint i = 0; i < NR_LIGHTS; i++) {
-		string number = to_string(i);
-		shaderNT.setVec3(("lightVectors[" + number + "]").c_str(), lightDirs[i]);
-		shaderNT.setFloat(("F0[" + number + "]").c_str(), F0[i]);
+//INVIO GLI OGGETTI DELLA SCENA ALLA CODA DI RENDERING
+//Aggiunge al frustum culling il volume del modello per ogni istanza del gruppo
+void cull_instances(SceneBatch &batch, const Model &model) {
+	for (size_t i = 0; i < batch.instances.size(); i++) {
+		size_t index = frustumCuller.Add(model.bounds, batch.instances[i].modelMatrix);
+		if (i == 0)
+			batch.firstBounds = index;
 	}
+}
 
-	shaderNT.setFloat("m", m);
-	shaderNT.setFloat("Kd", Kd);
+//Aggiunge al frustum culling il volume di ogni mesh di un gruppo con una sola istanza, in modo da scartarne le singole parti
+void cull_meshes(SceneBatch &batch, const vector<Mesh> &meshes) {
+	for (size_t i = 0; i < meshes.size(); i++) {
+		size_t index = frustumCuller.Add(meshes[i].bounds, batch.instances[0].modelMatrix);
+		if (i == 0)
+			batch.firstBounds = index;
+	}
+}
 
-	shaderNT.setVec3("diffuseColor", 1.0f, 1.0f, 1.0f);
+//Raccolgo le istanze dei modelli degli oggetti senza texture
+void collect_model_notexture(Model &ball, btRigidBody* bodyWhite, btRigidBody* bodyRed, btRigidBody* bodyYellow) {
+	//Le tre biglie condividono il modello: le invio come un pacchetto per mesh, ognuno con tutte le istanze visibili
+	glm::mat4 ballScale = glm::scale(glm::mat4(1.0f), sphereSize);
 
-	shaderNT.setMat4("projectionMatrix", projection);
+	ballBatch.instances.clear();
+	push_instance(ballBatch.instances, bodyWhite, ballScale, glm::vec3(1.0f, 1.0f, 1.0f));
+	push_instance(ballBatch.instances, bodyRed, ballScale, glm::vec3(1.0f, 0.0f, 0.0f));
+	push_instance(ballBatch.instances, bodyYellow, ballScale, glm::vec3(1.0f, 1.0f, 0.0f));
 
-	shaderNT.setMat4("viewMatrix", view);
+	cull_instances(ballBatch, ball);
+}
 
-	model = glm::mat4(1.0f);
-	normal = glm::mat3(1.0f);
+//Model matrix del tavolo: e' costante, per cui viene applicata ai vertici quando il tavolo entra nella geometria statica
+glm::mat4 table_model_matrix() {
+	glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -0.15f));
+	return glm::scale(matrix, glm::vec3(25.0f, 25.0f, 25.0f));
+}
 
-	bodyWhite->getMotionState()->getWorldTransform(transform);
-	transform.getOpenGLMatrix(matrix);
+//Raccolgo le istanze dei modelli degli oggetti con texture
+void collect_model_texture(Model &pin, const vector<btRigidBody*> &vectorPin) {
+	//INIZIO DAL TAVOLO
+	//La geometria statica e' gia' in coordinate mondo: e' un'unica istanza con model matrix identita', e la normal matrix
+	//dipende solo dalla view. Lo shader legge comunque matrici e colore dall'instance buffer
+	InstanceData tableInstance;
+	tableInstance.modelMatrix = glm::mat4(1.0f);
+	tableInstance.normalMatrix = glm::inverseTranspose(glm::mat3(view));
+	tableInstance.color = glm::vec3(1.0f);
 
-	model = glm::make_mat4(matrix) * glm::scale(model, sphereSize);
-	normal = glm::inverseTranspose(glm::mat3(view * model));
+	tableBatch.instances.assign(1, tableInstance);
 
-	shaderNT.setMat4("modelMatrix", model);
-	shaderNT.setMat3("normalMatrix", normal);
+	//Il tavolo e' spesso visto da vicino: le sue mesh, una per materiale, vengono testate una per una
+	cull_meshes(tableBatch, staticGeometry.meshes);
 
-	ball.Draw(shaderNT);
+	//RACCOLGO I BIRILLI
+	// Scala per modello birillo
+	glm::mat4 pinScale = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.1f, 0.0f)), glm::vec3(0.023f, 0.023f, 0.023f));
 
-	//RENDERIZZO LA BIGLIA ROSSA
-	shaderNT.setVec3("diffuseColor", 1.0f, 0.0f, 0.0f);
+	pinBatch.instances.clear();
+	for (size_t i = 0; i < vectorPin.size(); i++)
+		push_instance(pinBatch.instances, vectorPin[i], pinScale, glm::vec3(1.0f));
 
-	model = glm::mat4(1.0f);
-	normal = glm::mat3(1.0f);
+	cull_instances(pinBatch, pin);
+}
 
-	bodyRed->getMotionState()->getWorldTransform(transform);
-	transform.getOpenGLMatrix(matrix);
+//Sceglie il livello di dettaglio di una mesh renderizzata con le istanze indicate: conta l'istanza piu' vicina alla camera,
+//perche' tutte le istanze di un pacchetto vengono renderizzate con lo stesso livello
+int select_mesh_lod(Mesh &mesh, const vector<InstanceData> &instances) {
+	GLfloat distance = 0.0f, scale = 0.0f;
 
-	model = glm::make_mat4(matrix) * glm::scale(model, sphereSize);
-	normal = glm::inverseTranspose(glm::mat3(view * model));
+	for (size_t i = 0; i < instances.size(); i++) {
+		const glm::mat4 &matrix = instances[i].modelMatrix;
 
-	shaderNT.setMat4("modelMatrix", model);
-	shaderNT.setMat3("normalMatrix", normal);
+		//Il raggio e l'errore passano in coordinate mondo con la scala piu' grande della model matrix
+		GLfloat instanceScale = glm::max(glm::length(glm::vec3(matrix[0])), glm::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+		glm::vec3 center = glm::vec3(matrix * glm::vec4(mesh.bounds.center, 1.0f));
+		GLfloat instanceDistance = lodSelector.Distance(center, mesh.bounds.radius * instanceScale);
 
-	ball.Draw(shaderNT);
+		if (i == 0 || instanceDistance < distance)
+			distance = instanceDistance;
+		scale = glm::max(scale, instanceScale);
+	}
 
-	//RENDERIZZO LA BIGLIA GIALLA
-	shaderNT.setVec3("diffuseColor", 1.0f, 1.0f, 0.0f);
+	return lodSelector.Select(mesh.lods, distance, scale, mesh.lodLevel, (GLsizei) instances.size());
+}
 
-	model = glm::mat4(1.0f);
-	normal = glm::mat3(1.0f);
+//Invio alla coda di rendering le istanze indicate di un modello
+void submit_instances(const vector<InstanceData> &instances, Shader &shader, const RenderMaterial &material, Model &model) {
+	if (instances.empty())
+		return;
 
-	bodyYellow->getMotionState()->getWorldTransform(transform);
-	transform.getOpenGLMatrix(matrix);
+	model.UploadInstances(instances);
 
-	model = glm::make_mat4(matrix) * glm::scale(model, sphereSize);
-	normal = glm::inverseTranspose(glm::mat3(view * model));
+	//Ogni mesh viene inviata con il livello di dettaglio adatto alla sua distanza dalla camera
+	for (size_t i = 0; i < model.meshes.size(); i++) {
+		int lod = select_mesh_lod(model.meshes[i], instances);
+		renderQueue.SubmitMesh(RENDER_LAYER_OPAQUE, shader, material, model.meshes[i], (GLsizei) instances.size(), lod);
+	}
+}
 
-	shaderNT.setMat4("modelMatrix", model);
-	shaderNT.setMat3("normalMatrix", normal);
+//Invio alla coda di rendering le istanze visibili di un gruppo testato istanza per istanza
+void submit_visible_instances(SceneBatch &batch, Shader &shader, const RenderMaterial &material, Model &model) {
+	visibleInstances.clear();
+	for (size_t i = 0; i < batch.instances.size(); i++)
+		if (frustumCuller.isVisible(batch.firstBounds + i))
+			visibleInstances.push_back(batch.instances[i]);
 
-	ball.Draw(shaderNT);
+	submit_instances(visibleInstances, shader, material, model);
 }
 
-//Imposto lo shader e renderizzo i modelli degli oggetti con texture
-void draw_model_texture(Shader &shaderT, Model &table, Model &pin, vector<btRigidBody*> vectorPin) {
-	GLfloat matrix[16];
-	btTransform transform;
-
-	//RENDERIZZO I MODELLI CON TEXTURE
-	//INIZIO DAL TAVOLO
-	shaderT.Use();
+//Invio alla coda di rendering le istanze visibili di un gruppo con billboard: quelle oltre la distanza di passaggio
+//vengono renderizzate come billboard, le altre con la mesh del modello
+void submit_visible_billboards(SceneBatch &batch, Shader &shader, Shader &shaderBB, const RenderMaterial &material, const RenderMaterial &materialBB,
+		Model &model, BillboardImpostor &billboard) {
+	visibleInstances.clear();
+	billboardInstances.clear();
+	for (size_t i = 0; i < batch.instances.size(); i++) {
+		if (!frustumCuller.isVisible(batch.firstBounds + i))
+			continue;
 
-	for (GLuint i = 0; i < NR_LIGHTS; i++) {
-		string number = to_string(i);
-		shaderT.setVec3(("lightVectors[" + number + "]").c_str(), lightDirs[i]);
+		if (billboard.isReady() && billboard.isDistant(batch.instances[i].modelMatrix, camera.Position))
+			billboardInstances.push_back(batch.instances[i]);
+		else
+			visibleInstances.push_back(batch.instances[i]);
 	}
 
-	shaderT.setFloat("m", 0.6);
-	shaderT.setFloat("F0", 4.0);
-	shaderT.setFloat("Kd", 1.0);
+	billboard.CountFrame(visibleInstances.size(), billboardInstances.size());
 
-	shaderT.setFloat("repeat", 10.0f);
+	submit_instances(visibleInstances, shader, material, model);
 
-	shaderT.setMat4("projectionMatrix", projection);
+	if (!billboardInstances.empty()) {
+		billboard.UploadInstances(billboardInstances);
+		renderQueue.SubmitMesh(RENDER_LAYER_OPAQUE, shaderBB, materialBB, billboard.getMesh(), (GLsizei) billboardInstances.size());
+	}
+}
 
-	shaderT.setMat4("viewMatrix", view);
+//Invio alla coda di rendering le istanze visibili di un gruppo di sfere, renderizzate come impostor
+void submit_visible_impostors(SceneBatch &batch, Shader &shader, const RenderMaterial &material, SphereImpostor &impostor) {
+	visibleInstances.clear();
+	for (size_t i = 0; i < batch.instances.size(); i++)
+		if (frustumCuller.isVisible(batch.firstBounds + i))
+			visibleInstances.push_back(batch.instances[i]);
 
-	model = glm::mat4(1.0f);
-	normal = glm::mat3(1.0f);
+	if (visibleInstances.empty())
+		return;
 
-	model = glm::translate(model, glm::vec3(0.0f, 0.0f, -0.15f));
-	model = glm::scale(model, glm::vec3(25.0f, 25.0f, 25.0f));
-	normal = glm::inverseTranspose(glm::mat3(view * model));
+	impostor.UploadInstances(visibleInstances);
 
-	shaderT.setMat4("modelMatrix", model);
-	shaderT.setMat3("normalMatrix", normal);
+	renderQueue.SubmitMesh(RENDER_LAYER_OPAQUE, shader, material, impostor.getMesh(), (GLsizei) visibleInstances.size());
+}
 
-	table.Draw(shaderT);
+//Invio alla coda di rendering le mesh visibili della geometria statica, testata mesh per mesh: una draw call per materiale
+void submit_visible_meshes(SceneBatch &batch, Shader &shader, const RenderMaterial &material, GeometryPool &pool) {
+	bool uploaded = false;
 
-	//RENDERIZZO I BIRILLI
-	shaderT.setFloat("m", 0.4);
-	shaderT.setFloat("F0", 2.0);
-	shaderT.setFloat("Kd", 0.7);
+	for (size_t i = 0; i < pool.meshes.size(); i++) {
+		if (!frustumCuller.isVisible(batch.firstBounds + i))
+			continue;
 
-	shaderT.setFloat("repeat", 1.0f);
+		//L'instance buffer viene caricato solo se almeno una mesh e' visibile
+		if (!uploaded) {
+			pool.UploadInstances(batch.instances);
+			uploaded = true;
+		}
 
-	for (int i = 0; i < 5; i++) {
-		model = glm::mat4(1.0f);
-		normal = glm::mat3(1.0f);
+		int lod = select_mesh_lod(pool.meshes[i], batch.instances);
+		renderQueue.SubmitMesh(RENDER_LAYER_OPAQUE, shader, material, pool.meshes[i], (GLsizei) batch.instances.size(), lod);
+	}
+}
 
-		vectorPin[i]->getMotionState()->getWorldTransform(transform);
-		transform.getOpenGLMatrix(matrix);
+//Invio alla coda di rendering gli oggetti della scena sopravvissuti al frustum culling
+void submit_scene(Shader &shaderNT, Shader &shaderT, Shader &shaderIMP, Shader &shaderBB, Model &ball, Model &pin) {
+	//Le biglie vengono testate con i volumi della mesh in entrambi i casi: l'impostor ne occupa la stessa sfera
+	if (impostorMode)
+		submit_visible_impostors(ballBatch, shaderIMP, materialBallImpostor, ballImpostor);
+	else
+		submit_visible_instances(ballBatch, shaderNT, materialBall, ball);
+	submit_visible_meshes(tableBatch, shaderT, materialTable, staticGeometry);
+	submit_visible_billboards(pinBatch, shaderT, shaderBB, materialPin, materialPinBillboard, pin, pinBillboard);
+}
+
+//Aggiunge al vettore di istanze indicato il corpo rigido, con la trasformazione locale del modello ed il colore
+void push_instance(vector<InstanceData> &target, btRigidBody* body, const glm::mat4 &local, const glm::vec3 &color) {
+	GLfloat matrix[16];
+	btTransform transform;
 
-		model = glm::translate(model, glm::vec3(0.0f, -0.1f, 0.0f));
-		// Scala per modello birillo
-		model = glm::make_mat4(matrix) * glm::scale(model, glm::vec3(0.023f, 0.023f, 0.023f));
-		normal = glm::inverseTranspose(glm::mat3(view * model));
+	body->getMotionState()->getWorldTransform(transform);
+	transform.getOpenGLMatrix(matrix);
 
-		shaderT.setMat4("modelMatrix", model);
-		shaderT.setMat3("normalMatrix", normal);
+	InstanceData instance;
+	instance.modelMatrix = glm::make_mat4(matrix) * local;
+	instance.normalMatrix = glm::inverseTranspose(glm::mat3(view * instance.modelMatrix));
+	instance.color = color;
 
-		pin.Draw(shaderT);
-	}
+	target.push_back(instance);
 }
 
-//Imposto lo shader e renderizzo la Cubemap
-void draw_skybox(Shader &shaderSB, Model &box, GLuint texture) {
-	glDepthFunc(GL_LEQUAL);
-	shaderSB.Use();
+//Risolvo gli handle delle uniform usate ad ogni frame, in modo che il rendering non debba costruire nomi ne' cercare location
+void resolve_uniforms(Shader &shaderNT, Shader &shaderT, Shader &shaderIMP, Shader &shaderBB, Shader &shaderD, Shader &shaderSB, Shader &shaderTX) {
+	CookTorranceUniforms* cookTorrance[] = { &uniformsNT, &uniformsT, &uniformsIMP, &uniformsBB };
+	Shader* cookTorranceShader[] = { &shaderNT, &shaderT, &shaderIMP, &shaderBB };
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+	for (int s = 0; s < 4; s++) {
+		cookTorrance[s]->m = cookTorranceShader[s]->getUniform<float>("m");
+		cookTorrance[s]->Kd = cookTorranceShader[s]->getUniform<float>("Kd");
+	}
 
-	view = glm::mat4(glm::mat3(camera.GetViewMatrix()));
+	//Lo shader senza texture e quello degli impostor delle biglie hanno una riflettanza di Fresnel per ogni luce, quello con texture
+	//una sola e la ripetizione della texture, quello dei billboard una sola
+	for (int i = 0; i < NR_LIGHTS; i++) {
+		uniformsNT.F0[i] = shaderNT.getUniform<float>("F0[" + to_string(i) + "]");
+		uniformsIMP.F0[i] = shaderIMP.getUniform<float>("F0[" + to_string(i) + "]");
+	}
+	uniformsIMP.sphere = shaderIMP.getUniform<glm::vec4>("sphere");
 
-	shaderSB.setMat4("projectionMatrix", projection);
-	shaderSB.setMat4("viewMatrix", view);
-	shaderSB.setInt("skyboxTexture", 0);
+	uniformsBB.F0[0] = shaderBB.getUniform<float>("F0");
+	uniformsBB.sphere = shaderBB.getUniform<glm::vec4>("sphere");
 
-	box.Draw(shaderSB);
+	uniformsT.F0[0] = shaderT.getUniform<float>("F0");
+	uniformsT.repeat = shaderT.getUniform<float>("repeat");
 
-	glDepthFunc(GL_LESS);
-}
+	uniformsD.modelMatrix = shaderD.getUniform<glm::mat4>("modelMatrix");
 
-//FUNZIONE UTILIZZATA PER CONTROLLARE LA SITUAZIONE DI UNA BIGLIA
-//Se la linearVelocity assume un valore per cui la biglia  ferma, restituisco true in modo che venga cambiato giocatore/biglia
-bool check_idle_ball(btVector3 linearVelocity) {
-	if (abs(linearVelocity.getX()) < 0.01 && abs(linearVelocity.getY()) < 0.01 && abs(linearVelocity.getZ()) < 0.01)
-		return true;
+	uniformsSB.skyboxTexture = shaderSB.getUniform<int>("skyboxTexture");
 
-	return false;
+	uniformsTX.projectionMatrix = shaderTX.getUniform<glm::mat4>("projectionMatrix");
 }
 
-//FUNZIONE UTILIZZATA PER CARICARE IN MEMORIA I 128 CARATTERI
-void create_dictionary(FT_Face face) {
-	//Carico i primi 128 caratteri del codice ASCII
-	for (GLubyte c = 0; c < 128; c++) {
-
-		if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
-			cout << "Errore nel caricamento del Glyph!" << endl;
-			continue;
-		}
+//Carico nell'uniform buffer i dati comuni a tutti gli shader della scena, una sola volta per frame.
+//I vettori di incidenza delle luci vengono portati in coordinate vista sulla CPU, invece che per ogni vertice.
+void update_frame_uniforms() {
+	FrameUniforms frame;
 
-		GLuint texture;
+	frame.viewMatrix = view;
+	frame.projectionMatrix = projection;
 
-		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
-		glTexImage2D(GL_TEXTURE_2D, 0,
-		GL_RED, face->glyph->bitmap.width, face->glyph->bitmap.rows, 0,
-		GL_RED,
-		GL_UNSIGNED_BYTE, face->glyph->bitmap.buffer);
+	for (int i = 0; i < NR_LIGHTS; i++)
+		frame.lightDirs[i] = view * glm::vec4(lightDirs[i], 0.0f);
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		Character character = { texture, glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows), glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top), face->glyph->advance.x };
-		dictionary.insert(pair<GLchar, Character>(c, character));
-	}
+	gl_state().BindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
 }
 
-//FUNZIONE DI TEXTRENDERING
-void render_text(Shader &shader, string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color) {
-	GLuint VAO, VBO;
+//Imposto lo shader e renderizzo la traiettoria prevista del tiro
+void draw_aim_preview(Shader &shaderD) {
+	if (previewVertexCount == 0)
+		return;
 
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-
-	shader.Use();
-	glUniform3f(glGetUniformLocation(shader.ID, "textColor"), color.x, color.y, color.z);
-	glActiveTexture(GL_TEXTURE0);
-	glBindVertexArray(VAO);
+	shaderD.Use();
 
-	//Itero sui caratteri del testo che voglio scrivere
-	string::const_iterator c;
-	for (c = text.begin(); c != text.end(); c++)
-	{
-		Character ch = dictionary[*c];
+	shaderD.set(uniformsD.modelMatrix, glm::mat4(1.0f));
 
-		GLfloat xpos = x + ch.bearing.x * scale;
-		GLfloat ypos = y - (ch.size.y - ch.bearing.y) * scale;
+	gl_state().BindVertexArray(previewVAO);
+	glDrawArrays(GL_LINES, 0, previewVertexCount);
+}
 
-		GLfloat w = ch.size.x * scale;
-		GLfloat h = ch.size.y * scale;
+//Invio alla coda di rendering la Cubemap, nel livello di sfondo renderizzato dopo gli oggetti opachi
+void submit_skybox(Shader &shaderSB, Model &box) {
+	renderQueue.Submit(RENDER_LAYER_BACKGROUND, shaderSB, materialSkybox, box);
+}
 
-		GLfloat vertices[6][4] = {
-			{ xpos,     ypos + h,   0.0, 0.0 },
-			{ xpos,     ypos,       0.0, 1.0 },
-			{ xpos + w, ypos,       1.0, 1.0 },
+//Imposto i materiali degli oggetti della scena: i valori non cambiano durante la partita, per cui vengono preparati una sola volta
+void setup_materials(GLuint textureSkybox) {
+	//Biglie da biliardo
+	materialBall.uniforms = &uniformsNT;
+	for (int i = 0; i < NR_LIGHTS; i++)
+		materialBall.F0[i] = F0[i];
+	materialBall.m = m;
+	materialBall.Kd = Kd;
+	materialBall.repeat = 1.0f;
+
+	//Biglie renderizzate come impostor: stessi parametri, con la sfera dell'impostor
+	materialBallImpostor.uniforms = &uniformsIMP;
+	for (int i = 0; i < NR_LIGHTS; i++)
+		materialBallImpostor.F0[i] = F0[i];
+	materialBallImpostor.m = m;
+	materialBallImpostor.Kd = Kd;
+	materialBallImpostor.repeat = 1.0f;
+	materialBallImpostor.sphere = ballImpostor.getSphere();
+
+	//Tavolo
+	materialTable.uniforms = &uniformsT;
+	materialTable.F0[0] = 4.0f;
+	materialTable.m = 0.6f;
+	materialTable.Kd = 1.0f;
+	materialTable.repeat = 10.0f;
+
+	//Birilli
+	materialPin.uniforms = &uniformsT;
+	materialPin.F0[0] = 2.0f;
+	materialPin.m = 0.4f;
+	materialPin.Kd = 0.7f;
+	materialPin.repeat = 1.0f;
+
+	//Birilli renderizzati come billboard: stessi parametri, con la sfera di contenimento del birillo
+	materialPinBillboard.uniforms = &uniformsBB;
+	materialPinBillboard.F0[0] = materialPin.F0[0];
+	materialPinBillboard.m = materialPin.m;
+	materialPinBillboard.Kd = materialPin.Kd;
+	materialPinBillboard.repeat = 1.0f;
+	materialPinBillboard.sphere = pinBillboard.getSphere();
+
+	materialSkybox.texture = textureSkybox;
+}
 
-			{ xpos,     ypos + h,   0.0, 0.0 },
-			{ xpos + w, ypos,       1.0, 1.0 },
-			{ xpos + w, ypos + h,   1.0, 0.0 }
-		};
-		//Renderizzo il glyph c
-		glBindTexture(GL_TEXTURE_2D, ch.textureID);
+//FUNZIONE UTILIZZATA PER CONTROLLARE LA SITUAZIONE DI UNA BIGLIA
+//Se la linearVelocity assume un valore per cui la biglia  ferma, restituisco true in modo che venga cambiato giocatore/biglia
+bool check_idle_ball(btVector3 linearVelocity) {
+	if (abs(linearVelocity.getX()) < 0.01 && abs(linearVelocity.getY()) < 0.01 && abs(linearVelocity.getZ()) < 0.01)
+		return true;
 
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+	return false;
+}
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+//FUNZIONE CHIAMATA DALLA BULLET AD OGNI STEP INTERNO DELLA SIMULAZIONE
+//Registra le trasformazioni dei corpi dinamici nel file di replay.
+//La callback viene chiamata per ogni substep, mentre il replay procede a tick fissi: accumulo il tempo simulato e registro uno step
+//ogni PHYSICS_TICK, cosi' i substep fitti dei tiri forti non vengono scritti tutti.
+void physics_tick_callback(btDynamicsWorld *world, btScalar timeStep) {
+	static btScalar pendingTime = 0.0f;
+	const btScalar replayStep = PHYSICS_TICK;
 
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+	pendingTime += timeStep;
 
-		//Shift di 6 bit per andare al successivo carattere
-		x += (ch.advance >> 6) * scale;
+	while (pendingTime >= replayStep * 0.999f) {
+		replayRecorder.RecordStep(sceneBodies);
+		pendingTime -= replayStep;
 	}
-	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
 }
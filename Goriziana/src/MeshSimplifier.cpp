@@ -0,0 +1,371 @@
+#include "MeshSimplifier.h"
+
+#include <utils/lod.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <unordered_map>
+
+// Frazione dei triangoli che ogni livello mantiene rispetto al precedente
+static const float LOD_REDUCTION = 0.5f;
+// Sotto questo numero di triangoli una mesh non viene semplificata
+static const size_t LOD_MIN_TRIANGLES = 64;
+// Un livello che non scende sotto questa frazione del precedente (ad esempio perche' quasi tutti i vertici sono bloccati) non viene salvato
+static const float LOD_MIN_GAIN = 0.9f;
+
+// Raccoglie le mesh nello stesso ordine di Model::processNode, a cui corrisponde l'ordine dei livelli nel file
+static void collect_meshes(aiNode *node, const aiScene *scene, std::vector<aiMesh*> &meshes) {
+	for (unsigned int i = 0; i < node->mNumMeshes; i++)
+		meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+		collect_meshes(node->mChildren[i], scene, meshes);
+}
+
+static void write_u32(std::ofstream &file, uint32_t value) {
+	file.write((const char*) &value, sizeof(value));
+}
+
+/********** QUADRICHE **********/
+
+// La quadrica del piano ax + by + cz + d = 0 e' il prodotto esterno del vettore (a, b, c, d) con se stesso
+void MeshSimplifier::addPlane(Quadric &q, const double plane[4]) {
+	int k = 0;
+	for (int i = 0; i < 4; i++)
+		for (int j = i; j < 4; j++)
+			q.a[k++] += plane[i] * plane[j];
+}
+
+// Valuta v^T (Q + R) v con v = (x, y, z, 1): somma dei quadrati delle distanze di p dai piani accumulati nelle due quadriche
+double MeshSimplifier::evaluate(const Quadric &q, const Quadric &r, const glm::vec3 &p) {
+	double a[10];
+	for (int k = 0; k < 10; k++)
+		a[k] = q.a[k] + r.a[k];
+
+	double x = p.x, y = p.y, z = p.z;
+	double value = a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+			+ a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y
+			+ a[7] * z * z + 2.0 * a[8] * z
+			+ a[9];
+
+	return value > 0.0 ? value : 0.0;
+}
+
+/********** SEMPLIFICAZIONE **********/
+
+MeshSimplifier::MeshSimplifier(const std::vector<glm::vec3> &positions, const std::vector<uint32_t> &indices) :
+		positions(positions), triangles(indices), maxCost(0.0) {
+	size_t vertexCount = positions.size();
+	size_t triangleCount = indices.size() / 3;
+
+	this->removed.assign(triangleCount, false);
+	this->aliveTriangles = triangleCount;
+
+	Quadric zero;
+	memset(zero.a, 0, sizeof(zero.a));
+	this->quadrics.assign(vertexCount, zero);
+	this->vertexTriangles.resize(vertexCount);
+	this->versions.assign(vertexCount, 0);
+	this->locked.assign(vertexCount, false);
+
+	for (size_t t = 0; t < triangleCount; t++) {
+		const uint32_t *tri = &this->triangles[t * 3];
+
+		for (int k = 0; k < 3; k++)
+			this->vertexTriangles[tri[k]].push_back((uint32_t) t);
+
+		glm::vec3 p0 = positions[tri[0]], p1 = positions[tri[1]], p2 = positions[tri[2]];
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+
+		// I triangoli degeneri non definiscono un piano
+		if (length <= 0.0f)
+			continue;
+
+		normal /= length;
+		double plane[4] = { normal.x, normal.y, normal.z, -glm::dot(normal, p0) };
+
+		for (int k = 0; k < 3; k++)
+			addPlane(this->quadrics[tri[k]], plane);
+	}
+
+	this->lockBorders();
+
+	for (size_t v = 0; v < vertexCount; v++)
+		this->pushCollapses((uint32_t) v);
+}
+
+// Blocca i vertici che condividono la posizione con altri (cuciture delle texture o delle normali, separate da Assimp)
+// e quelli sugli spigoli di bordo, cioe' usati da un solo triangolo: spostarli aprirebbe un buco nella superficie
+void MeshSimplifier::lockBorders() {
+	std::vector<uint32_t> order(this->positions.size());
+	for (size_t v = 0; v < order.size(); v++)
+		order[v] = (uint32_t) v;
+
+	const std::vector<glm::vec3> &p = this->positions;
+	std::sort(order.begin(), order.end(), [&p](uint32_t a, uint32_t b) {
+		if (p[a].x != p[b].x)
+			return p[a].x < p[b].x;
+		if (p[a].y != p[b].y)
+			return p[a].y < p[b].y;
+		return p[a].z < p[b].z;
+	});
+
+	for (size_t i = 1; i < order.size(); i++)
+		if (p[order[i]] == p[order[i - 1]]) {
+			this->locked[order[i]] = true;
+			this->locked[order[i - 1]] = true;
+		}
+
+	std::unordered_map<uint64_t, int> edges;
+	for (size_t t = 0; t < this->triangles.size() / 3; t++)
+		for (int k = 0; k < 3; k++) {
+			uint32_t a = this->triangles[t * 3 + k], b = this->triangles[t * 3 + (k + 1) % 3];
+			edges[((uint64_t) std::min(a, b) << 32) | std::max(a, b)]++;
+		}
+
+	for (std::unordered_map<uint64_t, int>::const_iterator it = edges.begin(); it != edges.end(); ++it)
+		if (it->second == 1) {
+			this->locked[(uint32_t) (it->first >> 32)] = true;
+			this->locked[(uint32_t) (it->first & 0xFFFFFFFF)] = true;
+		}
+}
+
+// Inserisce nella coda i collassi degli spigoli del vertice, in entrambe le direzioni: il costo di un collasso dipende
+// dalle quadriche di entrambi gli estremi, per cui va ricalcolato anche per i vicini quando la quadrica del vertice cambia
+void MeshSimplifier::pushCollapses(uint32_t vertex) {
+	std::vector<uint32_t> &adjacent = this->vertexTriangles[vertex];
+
+	// Rimuovo i triangoli eliminati dai collassi precedenti
+	size_t alive = 0;
+	for (size_t i = 0; i < adjacent.size(); i++)
+		if (!this->removed[adjacent[i]])
+			adjacent[alive++] = adjacent[i];
+	adjacent.resize(alive);
+
+	for (size_t i = 0; i < adjacent.size(); i++) {
+		const uint32_t *tri = &this->triangles[adjacent[i] * 3];
+
+		for (int k = 0; k < 3; k++) {
+			uint32_t other = tri[k];
+			if (other == vertex)
+				continue;
+
+			uint32_t ends[2][2] = { { vertex, other }, { other, vertex } };
+			for (int d = 0; d < 2; d++) {
+				uint32_t from = ends[d][0], to = ends[d][1];
+				if (this->locked[from])
+					continue;
+
+				Collapse c;
+				c.cost = evaluate(this->quadrics[from], this->quadrics[to], this->positions[to]);
+				c.from = from;
+				c.to = to;
+				c.fromVersion = this->versions[from];
+				c.toVersion = this->versions[to];
+
+				this->heap.push_back(c);
+				std::push_heap(this->heap.begin(), this->heap.end(), std::greater<Collapse>());
+			}
+		}
+	}
+}
+
+// Un collasso viene rifiutato se ribalta l'orientamento di uno dei triangoli che restano, o se lo rende degenere
+bool MeshSimplifier::flips(uint32_t from, uint32_t to) const {
+	const std::vector<uint32_t> &adjacent = this->vertexTriangles[from];
+
+	for (size_t i = 0; i < adjacent.size(); i++) {
+		if (this->removed[adjacent[i]])
+			continue;
+
+		const uint32_t *tri = &this->triangles[adjacent[i] * 3];
+		if (tri[0] == to || tri[1] == to || tri[2] == to)
+			continue;
+
+		glm::vec3 before[3], after[3];
+		for (int k = 0; k < 3; k++) {
+			before[k] = this->positions[tri[k]];
+			after[k] = this->positions[tri[k] == from ? to : tri[k]];
+		}
+
+		glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+
+		if (glm::dot(normalBefore, normalAfter) <= 0.0f)
+			return true;
+	}
+
+	return false;
+}
+
+void MeshSimplifier::collapse(uint32_t from, uint32_t to) {
+	std::vector<uint32_t> &adjacent = this->vertexTriangles[from];
+
+	for (size_t i = 0; i < adjacent.size(); i++) {
+		uint32_t t = adjacent[i];
+		if (this->removed[t])
+			continue;
+
+		uint32_t *tri = &this->triangles[t * 3];
+
+		// I triangoli che contengono lo spigolo collassato diventano degeneri e vengono eliminati
+		if (tri[0] == to || tri[1] == to || tri[2] == to) {
+			this->removed[t] = true;
+			this->aliveTriangles--;
+			continue;
+		}
+
+		for (int k = 0; k < 3; k++)
+			if (tri[k] == from)
+				tri[k] = to;
+		this->vertexTriangles[to].push_back(t);
+	}
+	adjacent.clear();
+
+	for (int k = 0; k < 10; k++)
+		this->quadrics[to].a[k] += this->quadrics[from].a[k];
+
+	this->versions[from]++;
+	this->versions[to]++;
+
+	this->pushCollapses(to);
+}
+
+void MeshSimplifier::Simplify(size_t targetTriangles, std::vector<uint32_t> &indices, float &error) {
+	while (this->aliveTriangles > targetTriangles && !this->heap.empty()) {
+		std::pop_heap(this->heap.begin(), this->heap.end(), std::greater<Collapse>());
+		Collapse c = this->heap.back();
+		this->heap.pop_back();
+
+		// Il candidato e' obsoleto se uno dei due vertici e' stato coinvolto in un collasso dopo il suo inserimento
+		if (this->versions[c.from] != c.fromVersion || this->versions[c.to] != c.toVersion)
+			continue;
+
+		if (this->flips(c.from, c.to))
+			continue;
+
+		this->collapse(c.from, c.to);
+		this->maxCost = std::max(this->maxCost, c.cost);
+	}
+
+	indices.clear();
+	for (size_t t = 0; t < this->removed.size(); t++)
+		if (!this->removed[t])
+			indices.insert(indices.end(), &this->triangles[t * 3], &this->triangles[t * 3] + 3);
+
+	// Il costo e' una somma di distanze al quadrato dai piani originali: la radice e' una stima della distanza massima
+	error = (float) sqrt(this->maxCost);
+}
+
+/********** GENERAZIONE DEI LOD DI UN MODELLO **********/
+
+bool MeshSimplifier::BuildLods(const std::string &path) {
+	Assimp::Importer importer;
+	const aiScene *scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+
+	if (!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || !scene->mRootNode) {
+		std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+		return false;
+	}
+
+	std::vector<aiMesh*> meshes;
+	collect_meshes(scene->mRootNode, scene, meshes);
+
+	std::string lodPath = path + ".lod";
+	std::ofstream file(lodPath.c_str(), std::ios::binary);
+	if (!file) {
+		std::cout << "ERROR::LOD::FILE_NOT_WRITTEN: " << lodPath << std::endl;
+		return false;
+	}
+
+	file.write(LOD_FILE_MAGIC, 4);
+	write_u32(file, LOD_FILE_VERSION);
+	write_u32(file, (uint32_t) meshes.size());
+
+	std::cout << "LOD di " << path << ": " << meshes.size() << " mesh" << std::endl;
+
+	size_t totalTriangles = 0;
+	size_t totalLevelTriangles[LOD_MAX_LEVELS] = { 0 };
+
+	for (size_t m = 0; m < meshes.size(); m++) {
+		aiMesh *mesh = meshes[m];
+
+		std::vector<glm::vec3> positions(mesh->mNumVertices);
+		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+			positions[i] = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+
+		// Gli indici vengono raccolti come in Model::processMesh, in modo che il file corrisponda alla mesh caricata dal gioco
+		std::vector<uint32_t> indices;
+		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+			for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++)
+				indices.push_back(mesh->mFaces[i].mIndices[j]);
+
+		std::vector< std::vector<uint32_t> > levels;
+		std::vector<float> errors;
+
+		size_t triangles = indices.size() / 3;
+		bool triangulated = (mesh->mPrimitiveTypes & ~aiPrimitiveType_TRIANGLE) == 0;
+
+		if (triangulated && triangles >= LOD_MIN_TRIANGLES) {
+			MeshSimplifier simplifier(positions, indices);
+			size_t previous = triangles;
+
+			for (int l = 1; l < LOD_MAX_LEVELS; l++) {
+				std::vector<uint32_t> level;
+				float error;
+				simplifier.Simplify((size_t) (previous * LOD_REDUCTION), level, error);
+
+				if (level.size() / 3 > previous * LOD_MIN_GAIN)
+					break;
+
+				previous = level.size() / 3;
+				levels.push_back(level);
+				errors.push_back(error);
+			}
+		}
+
+		write_u32(file, (uint32_t) positions.size());
+		write_u32(file, (uint32_t) indices.size());
+		write_u32(file, (uint32_t) levels.size());
+		for (size_t l = 0; l < levels.size(); l++) {
+			file.write((const char*) &errors[l], sizeof(float));
+			write_u32(file, (uint32_t) levels[l].size());
+			if (!levels[l].empty())
+				file.write((const char*) &levels[l][0], levels[l].size() * sizeof(uint32_t));
+		}
+
+		std::cout << "  mesh " << m << ": " << triangles << " triangoli";
+		for (size_t l = 0; l < levels.size(); l++)
+			std::cout << " -> " << levels[l].size() / 3 << " (errore " << errors[l] << ")";
+		std::cout << std::endl;
+
+		// Le mesh con meno livelli restano al loro livello meno dettagliato, come nella selezione a runtime
+		size_t levelTriangles = triangles;
+		for (int l = 0; l < LOD_MAX_LEVELS; l++) {
+			if (l > 0 && l - 1 < (int) levels.size())
+				levelTriangles = levels[l - 1].size() / 3;
+			totalLevelTriangles[l] += levelTriangles;
+		}
+		totalTriangles += triangles;
+	}
+
+	std::cout << "  totale: " << totalTriangles << " triangoli";
+	for (int l = 1; l < LOD_MAX_LEVELS; l++)
+		std::cout << ", livello " << l << " " << totalLevelTriangles[l];
+	std::cout << std::endl;
+
+	if (!file) {
+		std::cout << "ERROR::LOD::FILE_NOT_WRITTEN: " << lodPath << std::endl;
+		return false;
+	}
+
+	return true;
+}
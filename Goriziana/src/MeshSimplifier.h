@@ -0,0 +1,94 @@
+/*
+Classe MeshSimplifier
+- Genera offline i livelli di dettaglio (LOD) delle mesh di un modello, con l'opzione --build-lod <modello.obj> ...
+- La semplificazione usa le quadriche dell'errore (Garland-Heckbert): ogni vertice accumula i piani dei suoi triangoli,
+  e gli spigoli vengono collassati in ordine di costo, cioe' della somma dei quadrati delle distanze dai piani originali
+- Il collasso sposta un vertice sull'altro estremo dello spigolo (half-edge collapse): i vertici non cambiano, per cui tutti
+  i livelli condividono il vertex buffer della mesh e differiscono solo per gli indici
+- I vertici di bordo e quelli duplicati sulle cuciture delle texture restano fissi, in modo che la semplificazione non apra buchi
+- I livelli vengono salvati nel file <modello>.lod, letto da Model al caricamento, con l'errore geometrico di ogni livello
+*/
+
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+/********** classe MESHSIMPLIFIER **********/
+class MeshSimplifier {
+public:
+	/*
+	 * Metodo che genera i LOD di tutte le mesh di un modello e li salva nel file <path>.lod, stampando un report per mesh.
+	 * Restituisce false se il modello non puo' essere caricato o il file non puo' essere scritto.
+	 * Prende in input i seguenti valori:
+	 * - path: string, path del modello
+	 */
+	static bool BuildLods(const std::string &path);
+
+	/*
+	 * Costruttore della classe: prepara quadriche e adiacenze della mesh.
+	 * Prende in input i seguenti valori:
+	 * - positions: vector<vec3>, posizioni dei vertici
+	 * - indices: vector<uint32_t>, indici dei triangoli
+	 */
+	MeshSimplifier(const std::vector<glm::vec3> &positions, const std::vector<uint32_t> &indices);
+
+	/*
+	 * Metodo che continua la semplificazione finche' i triangoli non scendono sotto il numero indicato, o finche' non ci sono
+	 * piu' spigoli collassabili. Chiamate successive con obiettivi decrescenti producono livelli sempre meno dettagliati.
+	 * Restituisce gli indici dei triangoli rimasti; error contiene la distanza massima stimata dalla superficie originale.
+	 * Prende in input i seguenti valori:
+	 * - targetTriangles: size_t, numero di triangoli da raggiungere
+	 * - indices: vector<uint32_t>&, indici del livello ottenuto
+	 * - error: float&, errore geometrico del livello, in unita' del modello
+	 */
+	void Simplify(size_t targetTriangles, std::vector<uint32_t> &indices, float &error);
+
+private:
+	/*
+	 * Struttura che rappresenta una quadrica simmetrica 4x4, memorizzata con i suoi 10 coefficienti distinti
+	 */
+	struct Quadric {
+		double a[10];
+	};
+
+	/*
+	 * Struttura che rappresenta un collasso candidato: il vertice from viene spostato su to.
+	 * Le versioni dei due vertici permettono di scartare i candidati diventati obsoleti dopo altri collassi.
+	 */
+	struct Collapse {
+		double cost;
+		uint32_t from, to;
+		uint32_t fromVersion, toVersion;
+
+		bool operator>(const Collapse &other) const {
+			return this->cost > other.cost;
+		}
+	};
+
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> triangles;
+	std::vector<bool> removed;
+	size_t aliveTriangles;
+	// Per ogni vertice: quadrica, triangoli adiacenti, versione (incrementata ad ogni collasso che lo coinvolge), blocco
+	std::vector<Quadric> quadrics;
+	std::vector< std::vector<uint32_t> > vertexTriangles;
+	std::vector<uint32_t> versions;
+	std::vector<bool> locked;
+	std::vector<Collapse> heap;
+	// Costo massimo dei collassi eseguiti finora
+	double maxCost;
+
+	static void addPlane(Quadric &q, const double plane[4]);
+	static double evaluate(const Quadric &q, const Quadric &r, const glm::vec3 &p);
+	void lockBorders();
+	void pushCollapses(uint32_t vertex);
+	bool flips(uint32_t from, uint32_t to) const;
+	void collapse(uint32_t from, uint32_t to);
+};
+
+#endif // MESHSIMPLIFIER_H
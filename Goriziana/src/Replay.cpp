@@ -0,0 +1,813 @@
+#include "Replay.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Limiti del volume in cui vengono quantizzate le posizioni: contiene il tavolo, con margine per i birilli che cadono
+static const float REPLAY_BOUNDS_MIN[3] = { -16.0f, 0.0f, -8.0f };
+static const float REPLAY_BOUNDS_MAX[3] = { 16.0f, 16.0f, 8.0f };
+
+// Dimensioni fisse dei record di tiro e di cambio turno, tag compreso
+static const size_t SHOT_RECORD_SIZE = 1 + 4 + 1 + 6 * 4;
+static const size_t TURN_RECORD_SIZE = 1 + 4 + 1 + 2 * 4;
+// Dimensione dello stato di un corpo all'interno di un keyframe
+static const size_t KEYFRAME_BODY_SIZE = 13 * 4 + 1;
+// Dimensione del footer: offset dell'indice e magic
+static const size_t FOOTER_SIZE = 8 + 4;
+
+/********** FUNZIONI DI CODIFICA **********/
+
+static uint16_t quantize_position(float value, float min, float max) {
+	float t = (value - min) / (max - min);
+
+	if (t < 0.0f)
+		t = 0.0f;
+	else if (t > 1.0f)
+		t = 1.0f;
+
+	return (uint16_t) (t * 65535.0f + 0.5f);
+}
+
+static float dequantize_position(uint16_t value, float min, float max) {
+	return min + (max - min) * (value / 65535.0f);
+}
+
+// Comprime il quaternione con la tecnica "smallest three": 2 bit per l'indice della componente maggiore, 10 bit per ognuna delle altre tre.
+// La componente maggiore viene ricostruita dalla norma unitaria, ed il segno del quaternione viene scelto in modo che sia positiva.
+static uint32_t pack_rotation(const float q[4]) {
+	int largest = 0;
+	for (int i = 1; i < 4; i++)
+		if (fabs(q[i]) > fabs(q[largest]))
+			largest = i;
+
+	float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+	uint32_t packed = (uint32_t) largest << 30;
+	int shift = 20;
+
+	for (int i = 0; i < 4; i++) {
+		if (i == largest)
+			continue;
+
+		// Le componenti non maggiori sono comprese in [-1/sqrt(2), 1/sqrt(2)]
+		float t = q[i] * sign * 0.70710678f + 0.5f;
+		if (t < 0.0f)
+			t = 0.0f;
+		else if (t > 1.0f)
+			t = 1.0f;
+
+		packed |= ((uint32_t) (t * 1023.0f + 0.5f)) << shift;
+		shift -= 10;
+	}
+
+	return packed;
+}
+
+static void unpack_rotation(uint32_t packed, float q[4]) {
+	int largest = packed >> 30;
+	int shift = 20;
+	float sum = 0.0f;
+
+	for (int i = 0; i < 4; i++) {
+		if (i == largest)
+			continue;
+
+		float t = ((packed >> shift) & 1023) / 1023.0f;
+		q[i] = (t - 0.5f) * 1.41421356f;
+		sum += q[i] * q[i];
+		shift -= 10;
+	}
+
+	q[largest] = sqrt(sum < 1.0f ? 1.0f - sum : 0.0f);
+}
+
+static ReplayQuantizedTransform quantize_transform(const btTransform &transform) {
+	ReplayQuantizedTransform quantized;
+	const btVector3 &origin = transform.getOrigin();
+	btQuaternion rotation = transform.getRotation();
+	float q[4] = { rotation.x(), rotation.y(), rotation.z(), rotation.w() };
+
+	for (int i = 0; i < 3; i++)
+		quantized.position[i] = quantize_position(origin[i], REPLAY_BOUNDS_MIN[i], REPLAY_BOUNDS_MAX[i]);
+
+	quantized.rotation = pack_rotation(q);
+
+	return quantized;
+}
+
+template<typename T> static T read_value(const uint8_t *data, size_t offset) {
+	T value;
+	memcpy(&value, data + offset, sizeof(T));
+	return value;
+}
+
+/********** classe REPLAYWRITER **********/
+
+ReplayWriter::ReplayWriter() : recording(false), overflow(false), bodyCount(0), step(0), lastEmittedStep(0), lastKeyframeStep(0), producedBytes(0), committedBytes(0), stopping(false) {}
+
+ReplayWriter::~ReplayWriter() {
+	this->Close();
+}
+
+bool ReplayWriter::Open(const std::string &path, int bodyCount, float stepSeconds) {
+	this->Close();
+
+	if (bodyCount <= 0 || bodyCount > 256) {
+		std::cout << "ERROR::REPLAY::INVALID_BODY_COUNT: " << bodyCount << std::endl;
+		return false;
+	}
+
+	this->file.open(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if (!this->file.is_open()) {
+		std::cout << "ERROR::REPLAY::FILE_NOT_CREATED: " << path << std::endl;
+		return false;
+	}
+
+	this->bodyCount = bodyCount;
+	this->step = 0;
+	this->lastEmittedStep = 0;
+	this->lastKeyframeStep = 0;
+	this->lastEmitted.clear();
+	this->current.resize(bodyCount);
+	this->index.clear();
+	this->producedBytes = 0;
+	this->committedBytes = 0;
+	this->overflow = false;
+	this->stopping = false;
+
+	this->block.clear();
+	this->block.reserve(BLOCK_SIZE + 1024);
+
+	// Header
+	uint16_t version = REPLAY_VERSION;
+	uint16_t count = (uint16_t) bodyCount;
+
+	this->put("GRPL", 4);
+	this->put(&version, sizeof(version));
+	this->put(&count, sizeof(count));
+	this->put(&stepSeconds, sizeof(stepSeconds));
+	this->put(REPLAY_BOUNDS_MIN, sizeof(REPLAY_BOUNDS_MIN));
+	this->put(REPLAY_BOUNDS_MAX, sizeof(REPLAY_BOUNDS_MAX));
+
+	this->recording = true;
+	this->ioThread = std::thread(&ReplayWriter::ioLoop, this);
+
+	return true;
+}
+
+void ReplayWriter::RecordStep(const std::vector<btRigidBody*> &bodies) {
+	if (!this->recording)
+		return;
+
+	this->step++;
+
+	// Senza un keyframe di partenza gli step non sarebbero decodificabili
+	if (this->lastEmitted.empty()) {
+		this->RecordKeyframe(bodies);
+		return;
+	}
+
+	uint8_t mask[32];
+	int maskBytes = (this->bodyCount + 7) / 8;
+	bool changed = false;
+
+	memset(mask, 0, maskBytes);
+
+	for (int i = 0; i < this->bodyCount; i++) {
+		this->current[i] = quantize_transform(bodies[i]->getWorldTransform());
+
+		const ReplayQuantizedTransform &last = this->lastEmitted[i];
+		const ReplayQuantizedTransform &now = this->current[i];
+
+		if (now.rotation != last.rotation || now.position[0] != last.position[0] || now.position[1] != last.position[1] || now.position[2] != last.position[2]) {
+			mask[i >> 3] |= 1 << (i & 7);
+			changed = true;
+		}
+	}
+
+	// Se nessun corpo si e' mosso non scrivo nulla: lo step successivo ne terra' conto nella distanza
+	if (!changed)
+		return;
+
+	uint8_t tag = REPLAY_TAG_STEP;
+
+	this->put(&tag, 1);
+	this->putVarint(this->step - this->lastEmittedStep);
+	this->put(mask, maskBytes);
+
+	for (int i = 0; i < this->bodyCount; i++) {
+		if (!(mask[i >> 3] & (1 << (i & 7))))
+			continue;
+
+		this->put(this->current[i].position, sizeof(this->current[i].position));
+		this->put(&this->current[i].rotation, sizeof(this->current[i].rotation));
+		this->lastEmitted[i] = this->current[i];
+	}
+
+	this->lastEmittedStep = this->step;
+
+	if (this->step - this->lastKeyframeStep >= KEYFRAME_INTERVAL)
+		this->RecordKeyframe(bodies);
+
+	if (this->block.size() >= BLOCK_SIZE)
+		this->submitBlock();
+}
+
+void ReplayWriter::RecordKeyframe(const std::vector<btRigidBody*> &bodies) {
+	if (!this->recording)
+		return;
+
+	ReplayIndexEntry entry = { this->step, REPLAY_TAG_KEYFRAME, this->producedBytes };
+	this->index.push_back(entry);
+
+	uint8_t tag = REPLAY_TAG_KEYFRAME;
+
+	this->put(&tag, 1);
+	this->put(&this->step, sizeof(this->step));
+
+	this->lastEmitted.resize(this->bodyCount);
+
+	for (int i = 0; i < this->bodyCount; i++) {
+		const btTransform &transform = bodies[i]->getWorldTransform();
+		btQuaternion rotation = transform.getRotation();
+		const btVector3 &linear = bodies[i]->getLinearVelocity();
+		const btVector3 &angular = bodies[i]->getAngularVelocity();
+
+		float values[13] = {
+			transform.getOrigin().x(), transform.getOrigin().y(), transform.getOrigin().z(),
+			rotation.x(), rotation.y(), rotation.z(), rotation.w(),
+			linear.x(), linear.y(), linear.z(),
+			angular.x(), angular.y(), angular.z()
+		};
+		uint8_t activation = (uint8_t) bodies[i]->getActivationState();
+
+		this->put(values, sizeof(values));
+		this->put(&activation, 1);
+
+		this->lastEmitted[i] = quantize_transform(transform);
+	}
+
+	this->lastEmittedStep = this->step;
+	this->lastKeyframeStep = this->step;
+
+	if (this->block.size() >= BLOCK_SIZE)
+		this->submitBlock();
+}
+
+void ReplayWriter::RecordShot(int player, const btVector3 &impulse, const btVector3 &relPos) {
+	if (!this->recording)
+		return;
+
+	ReplayIndexEntry entry = { this->step, REPLAY_TAG_SHOT, this->producedBytes };
+	this->index.push_back(entry);
+
+	uint8_t tag = REPLAY_TAG_SHOT;
+	uint8_t shooter = (uint8_t) player;
+	float values[6] = { impulse.x(), impulse.y(), impulse.z(), relPos.x(), relPos.y(), relPos.z() };
+
+	this->put(&tag, 1);
+	this->put(&this->step, sizeof(this->step));
+	this->put(&shooter, 1);
+	this->put(values, sizeof(values));
+
+	if (this->block.size() >= BLOCK_SIZE)
+		this->submitBlock();
+}
+
+void ReplayWriter::RecordTurn(int player, const int score[2]) {
+	if (!this->recording)
+		return;
+
+	ReplayIndexEntry entry = { this->step, REPLAY_TAG_TURN, this->producedBytes };
+	this->index.push_back(entry);
+
+	uint8_t tag = REPLAY_TAG_TURN;
+	uint8_t current = (uint8_t) player;
+	int32_t points[2] = { score[0], score[1] };
+
+	this->put(&tag, 1);
+	this->put(&this->step, sizeof(this->step));
+	this->put(&current, 1);
+	this->put(points, sizeof(points));
+
+	if (this->block.size() >= BLOCK_SIZE)
+		this->submitBlock();
+}
+
+void ReplayWriter::Close() {
+	if (!this->file.is_open())
+		return;
+
+	// Se il buffer e' andato in overflow il blocco corrente e' gia' stato scartato
+	if (this->recording)
+		this->submitBlock();
+
+	this->recording = false;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->condition.notify_one();
+
+	if (this->ioThread.joinable())
+		this->ioThread.join();
+
+	// Il thread e' terminato: scrivo indice e footer direttamente, scartando le voci dei record persi in caso di overflow
+	uint64_t indexOffset = this->committedBytes;
+	uint32_t count = 0;
+
+	for (size_t i = 0; i < this->index.size(); i++)
+		if (this->index[i].offset < this->committedBytes)
+			count++;
+
+	this->file.write((const char*) &count, sizeof(count));
+
+	for (size_t i = 0; i < this->index.size(); i++) {
+		if (this->index[i].offset >= this->committedBytes)
+			continue;
+
+		this->file.write((const char*) &this->index[i].step, sizeof(this->index[i].step));
+		this->file.write((const char*) &this->index[i].kind, sizeof(this->index[i].kind));
+		this->file.write((const char*) &this->index[i].offset, sizeof(this->index[i].offset));
+	}
+
+	this->file.write((const char*) &indexOffset, sizeof(indexOffset));
+	this->file.write("GRPX", 4);
+	this->file.close();
+
+	this->queue.clear();
+	this->freeBlocks.clear();
+	this->block.clear();
+}
+
+bool ReplayWriter::isOpen() const {
+	return this->recording;
+}
+
+uint32_t ReplayWriter::getStep() const {
+	return this->step;
+}
+
+uint64_t ReplayWriter::getSize() const {
+	return this->producedBytes;
+}
+
+void ReplayWriter::put(const void *data, size_t size) {
+	const uint8_t *bytes = (const uint8_t*) data;
+
+	this->block.insert(this->block.end(), bytes, bytes + size);
+	this->producedBytes += size;
+}
+
+void ReplayWriter::putVarint(uint32_t value) {
+	uint8_t bytes[5];
+	size_t count = 0;
+
+	while (value >= 0x80) {
+		bytes[count++] = (uint8_t) (value | 0x80);
+		value >>= 7;
+	}
+	bytes[count++] = (uint8_t) value;
+
+	this->put(bytes, count);
+}
+
+// Consegna il blocco corrente al thread di scrittura senza mai attendere il disco.
+// Se la coda e' piena la registrazione viene interrotta: il file resta valido fino all'ultimo blocco consegnato.
+void ReplayWriter::submitBlock() {
+	if (this->block.empty())
+		return;
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	if (this->queue.size() >= MAX_QUEUED_BLOCKS) {
+		this->overflow = true;
+		this->recording = false;
+		this->block.clear();
+
+		std::cout << "WARNING::REPLAY::BUFFER_OVERFLOW, recording stopped at step " << this->step << std::endl;
+		return;
+	}
+
+	this->committedBytes += this->block.size();
+
+	this->queue.push_back(std::vector<uint8_t>());
+	this->queue.back().swap(this->block);
+
+	// Riutilizzo un blocco gia' scritto, in modo da non allocare memoria durante il ciclo di rendering
+	if (!this->freeBlocks.empty()) {
+		this->block.swap(this->freeBlocks.back());
+		this->freeBlocks.pop_back();
+	}
+
+	lock.unlock();
+	this->condition.notify_one();
+
+	if (this->block.capacity() < BLOCK_SIZE)
+		this->block.reserve(BLOCK_SIZE + 1024);
+}
+
+// Ciclo del thread di scrittura: scrive i blocchi in coda finche' la coda non e' vuota e la chiusura non e' stata richiesta
+void ReplayWriter::ioLoop() {
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	while (true) {
+		while (!this->stopping && this->queue.empty())
+			this->condition.wait(lock);
+
+		if (this->queue.empty())
+			break;
+
+		std::vector<uint8_t> pending;
+		pending.swap(this->queue.front());
+		this->queue.pop_front();
+
+		lock.unlock();
+
+		this->file.write((const char*) &pending[0], pending.size());
+		pending.clear();
+
+		lock.lock();
+
+		this->freeBlocks.push_back(std::vector<uint8_t>());
+		this->freeBlocks.back().swap(pending);
+	}
+}
+
+/********** classe REPLAYREADER **********/
+
+ReplayReader::ReplayReader() : data(nullptr), size(0), fileHandle(nullptr), mapHandle(nullptr), bodyCount(0), stepSeconds(0.0f), indexOffset(0), lastStep(0) {}
+
+ReplayReader::~ReplayReader() {
+	this->Close();
+}
+
+bool ReplayReader::Open(const std::string &path) {
+	this->Close();
+
+	// Passo 1: mappo il file in memoria
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		std::cout << "ERROR::REPLAY::FILE_NOT_FOUND: " << path << std::endl;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		CloseHandle(file);
+		std::cout << "ERROR::REPLAY::MAPPING_FAILED: " << path << std::endl;
+		return false;
+	}
+
+	this->fileHandle = file;
+	this->mapHandle = mapping;
+	this->size = (size_t) fileSize.QuadPart;
+	this->data = (const uint8_t*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		std::cout << "ERROR::REPLAY::FILE_NOT_FOUND: " << path << std::endl;
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		std::cout << "ERROR::REPLAY::FILE_NOT_READABLE: " << path << std::endl;
+		return false;
+	}
+
+	this->size = (size_t) info.st_size;
+	void *mapped = this->size > 0 ? mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	close(fd);
+
+	this->data = mapped == MAP_FAILED ? nullptr : (const uint8_t*) mapped;
+#endif
+
+	const size_t headerSize = 4 + 2 + 2 + 4 + 6 * 4;
+
+	if (!this->data || this->size < headerSize || memcmp(this->data, "GRPL", 4) != 0) {
+		std::cout << "ERROR::REPLAY::INVALID_FILE: " << path << std::endl;
+		this->Close();
+		return false;
+	}
+
+	// Passo 2: leggo l'header. Un file scritto con un formato diverso non puo' essere interpretato con questo layout
+	uint16_t version = read_value<uint16_t>(this->data, 4);
+
+	if (version != REPLAY_VERSION) {
+		std::cout << "ERROR::REPLAY::UNSUPPORTED_VERSION: " << path << " (versione " << version << ")" << std::endl;
+		this->Close();
+		return false;
+	}
+
+	this->bodyCount = read_value<uint16_t>(this->data, 6);
+	this->stepSeconds = read_value<float>(this->data, 8);
+	memcpy(this->boundsMin, this->data + 12, sizeof(this->boundsMin));
+	memcpy(this->boundsMax, this->data + 24, sizeof(this->boundsMax));
+
+	// Passo 3: leggo l'indice. Se il footer manca (partita interrotta), ricostruisco l'indice scorrendo i record
+	std::vector<ReplayIndexEntry> entries;
+
+	if (this->size >= headerSize + FOOTER_SIZE && memcmp(this->data + this->size - 4, "GRPX", 4) == 0) {
+		this->indexOffset = read_value<uint64_t>(this->data, this->size - FOOTER_SIZE);
+
+		size_t offset = (size_t) this->indexOffset;
+		uint32_t count = offset + 4 <= this->size ? read_value<uint32_t>(this->data, offset) : 0;
+		offset += 4;
+
+		for (uint32_t i = 0; i < count && offset + 16 <= this->size - FOOTER_SIZE; i++, offset += 16) {
+			ReplayIndexEntry entry;
+			entry.step = read_value<uint32_t>(this->data, offset);
+			entry.kind = read_value<uint32_t>(this->data, offset + 4);
+			entry.offset = read_value<uint64_t>(this->data, offset + 8);
+			entries.push_back(entry);
+		}
+	}
+	else {
+		std::cout << "WARNING::REPLAY::MISSING_INDEX, scanning records of " << path << std::endl;
+
+		this->indexOffset = this->size;
+
+		size_t offset = headerSize;
+		size_t maskBytes = (this->bodyCount + 7) / 8;
+
+		while (offset < this->size) {
+			uint8_t tag = this->data[offset];
+			size_t length = 0;
+
+			if (tag == REPLAY_TAG_STEP) {
+				size_t cursor = offset + 1;
+				while (cursor < this->size && (this->data[cursor] & 0x80))
+					cursor++;
+				cursor++;
+
+				if (cursor + maskBytes > this->size)
+					break;
+
+				int changed = 0;
+				for (size_t i = 0; i < maskBytes; i++)
+					for (int b = 0; b < 8; b++)
+						changed += (this->data[cursor + i] >> b) & 1;
+
+				length = cursor + maskBytes + changed * 10 - offset;
+			}
+			else if (tag == REPLAY_TAG_KEYFRAME)
+				length = 1 + 4 + this->bodyCount * KEYFRAME_BODY_SIZE;
+			else if (tag == REPLAY_TAG_SHOT)
+				length = SHOT_RECORD_SIZE;
+			else if (tag == REPLAY_TAG_TURN)
+				length = TURN_RECORD_SIZE;
+			else
+				break;
+
+			if (offset + length > this->size)
+				break;
+
+			if (tag != REPLAY_TAG_STEP) {
+				ReplayIndexEntry entry = { read_value<uint32_t>(this->data, offset + 1), tag, offset };
+				entries.push_back(entry);
+			}
+
+			offset += length;
+		}
+
+		this->indexOffset = offset;
+	}
+
+	// Passo 4: separo keyframe e tiri
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].offset >= this->indexOffset)
+			continue;
+
+		if (entries[i].kind == REPLAY_TAG_KEYFRAME)
+			this->keyframes.push_back(entries[i]);
+		else if (entries[i].kind == REPLAY_TAG_SHOT && entries[i].offset + SHOT_RECORD_SIZE <= this->indexOffset) {
+			size_t offset = (size_t) entries[i].offset;
+			ReplayShot shot;
+
+			shot.step = read_value<uint32_t>(this->data, offset + 1);
+			shot.player = this->data[offset + 5];
+			memcpy(shot.impulse, this->data + offset + 6, sizeof(shot.impulse));
+			memcpy(shot.relPos, this->data + offset + 18, sizeof(shot.relPos));
+
+			this->shots.push_back(shot);
+		}
+
+		if (entries[i].step > this->lastStep)
+			this->lastStep = entries[i].step;
+	}
+
+	// Passo 5: l'ultimo step registrato segue l'ultimo keyframe, lo ricavo decodificando la coda del file
+	if (!this->keyframes.empty()) {
+		std::vector<ReplayTransform> transforms;
+		uint32_t decoded = this->decodeTransforms(0xFFFFFFFEu, transforms);
+
+		if (decoded != 0xFFFFFFFFu && decoded > this->lastStep)
+			this->lastStep = decoded;
+	}
+
+	return true;
+}
+
+void ReplayReader::Close() {
+#ifdef _WIN32
+	if (this->data)
+		UnmapViewOfFile(this->data);
+	if (this->mapHandle)
+		CloseHandle((HANDLE) this->mapHandle);
+	if (this->fileHandle)
+		CloseHandle((HANDLE) this->fileHandle);
+#else
+	if (this->data)
+		munmap((void*) this->data, this->size);
+#endif
+
+	this->data = nullptr;
+	this->size = 0;
+	this->fileHandle = nullptr;
+	this->mapHandle = nullptr;
+	this->bodyCount = 0;
+	this->indexOffset = 0;
+	this->lastStep = 0;
+	this->keyframes.clear();
+	this->shots.clear();
+}
+
+bool ReplayReader::getTransforms(uint32_t step, std::vector<ReplayTransform> &transforms) const {
+	return this->decodeTransforms(step, transforms) != 0xFFFFFFFFu;
+}
+
+// Decodifica i record a partire dal keyframe precedente allo step, e restituisce l'ultimo step effettivamente decodificato
+uint32_t ReplayReader::decodeTransforms(uint32_t step, std::vector<ReplayTransform> &transforms) const {
+	if (this->keyframes.empty() || this->keyframes[0].step > step)
+		return 0xFFFFFFFFu;
+
+	// Ricerca binaria dell'ultimo keyframe non successivo allo step
+	size_t first = 0, last = this->keyframes.size();
+	while (last - first > 1) {
+		size_t middle = (first + last) / 2;
+		if (this->keyframes[middle].step <= step)
+			first = middle;
+		else
+			last = middle;
+	}
+
+	uint32_t keyStep;
+	std::vector<ReplayBodyState> states;
+
+	if (!this->readKeyframe((size_t) this->keyframes[first].offset, keyStep, states))
+		return 0xFFFFFFFFu;
+
+	transforms.resize(this->bodyCount);
+
+	for (int i = 0; i < this->bodyCount; i++) {
+		memcpy(transforms[i].position, states[i].position, sizeof(transforms[i].position));
+		memcpy(transforms[i].rotation, states[i].rotation, sizeof(transforms[i].rotation));
+	}
+
+	size_t offset = (size_t) this->keyframes[first].offset + 1 + 4 + this->bodyCount * KEYFRAME_BODY_SIZE;
+	size_t maskBytes = (this->bodyCount + 7) / 8;
+	uint32_t cursor = keyStep;
+
+	while (offset < this->indexOffset) {
+		uint8_t tag = this->data[offset];
+
+		if (tag == REPLAY_TAG_STEP) {
+			uint32_t delta = 0;
+			int shift = 0;
+			size_t position = offset + 1;
+
+			while (position < this->indexOffset) {
+				uint8_t byte = this->data[position++];
+				delta |= (uint32_t) (byte & 0x7F) << shift;
+				shift += 7;
+				if (!(byte & 0x80))
+					break;
+			}
+
+			if (position + maskBytes > this->indexOffset || cursor + delta > step)
+				break;
+
+			cursor += delta;
+
+			const uint8_t *mask = this->data + position;
+			position += maskBytes;
+
+			for (int i = 0; i < this->bodyCount; i++) {
+				if (!(mask[i >> 3] & (1 << (i & 7))))
+					continue;
+
+				if (position + 10 > this->indexOffset)
+					return cursor;
+
+				for (int j = 0; j < 3; j++)
+					transforms[i].position[j] = dequantize_position(read_value<uint16_t>(this->data, position + j * 2), this->boundsMin[j], this->boundsMax[j]);
+
+				unpack_rotation(read_value<uint32_t>(this->data, position + 6), transforms[i].rotation);
+				position += 10;
+			}
+
+			offset = position;
+		}
+		else if (tag == REPLAY_TAG_KEYFRAME) {
+			uint32_t nextStep;
+
+			if (offset + 5 > this->indexOffset || read_value<uint32_t>(this->data, offset + 1) > step)
+				break;
+
+			// Un keyframe troncato o corrotto termina la decodifica: restituisco lo step raggiunto fin qui
+			size_t length = this->readKeyframe(offset, nextStep, states);
+			if (length == 0)
+				break;
+
+			offset += length;
+			cursor = nextStep;
+
+			for (int i = 0; i < this->bodyCount; i++) {
+				memcpy(transforms[i].position, states[i].position, sizeof(transforms[i].position));
+				memcpy(transforms[i].rotation, states[i].rotation, sizeof(transforms[i].rotation));
+			}
+		}
+		else if (tag == REPLAY_TAG_SHOT)
+			offset += SHOT_RECORD_SIZE;
+		else if (tag == REPLAY_TAG_TURN)
+			offset += TURN_RECORD_SIZE;
+		else
+			break;
+	}
+
+	return cursor;
+}
+
+bool ReplayReader::getKeyframe(uint32_t step, uint32_t &keyStep, std::vector<ReplayBodyState> &states) const {
+	if (this->keyframes.empty() || this->keyframes[0].step > step)
+		return false;
+
+	// Ricerca binaria dell'ultimo keyframe non successivo allo step
+	size_t first = 0, last = this->keyframes.size();
+	while (last - first > 1) {
+		size_t middle = (first + last) / 2;
+		if (this->keyframes[middle].step <= step)
+			first = middle;
+		else
+			last = middle;
+	}
+
+	return this->readKeyframe((size_t) this->keyframes[first].offset, keyStep, states) > 0;
+}
+
+size_t ReplayReader::readKeyframe(size_t offset, uint32_t &keyStep, std::vector<ReplayBodyState> &states) const {
+	size_t length = 1 + 4 + this->bodyCount * KEYFRAME_BODY_SIZE;
+
+	if (offset + length > this->indexOffset || this->data[offset] != REPLAY_TAG_KEYFRAME)
+		return 0;
+
+	keyStep = read_value<uint32_t>(this->data, offset + 1);
+	states.resize(this->bodyCount);
+
+	size_t position = offset + 5;
+
+	for (int i = 0; i < this->bodyCount; i++) {
+		memcpy(states[i].position, this->data + position, sizeof(states[i].position));
+		memcpy(states[i].rotation, this->data + position + 12, sizeof(states[i].rotation));
+		memcpy(states[i].linearVelocity, this->data + position + 28, sizeof(states[i].linearVelocity));
+		memcpy(states[i].angularVelocity, this->data + position + 40, sizeof(states[i].angularVelocity));
+		states[i].activationState = this->data[position + 52];
+
+		position += KEYFRAME_BODY_SIZE;
+	}
+
+	return length;
+}
+
+const std::vector<ReplayShot>& ReplayReader::getShots() const {
+	return this->shots;
+}
+
+int ReplayReader::getBodyCount() const {
+	return this->bodyCount;
+}
+
+float ReplayReader::getStepSeconds() const {
+	return this->stepSeconds;
+}
+
+uint32_t ReplayReader::getLastStep() const {
+	return this->lastStep;
+}
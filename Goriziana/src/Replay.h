@@ -0,0 +1,265 @@
+/*
+Classi ReplayWriter e ReplayReader
+- ReplayWriter registra ogni partita in un file binario compatto: comandi di tiro, trasformazioni quantizzate di biglie e birilli ad ogni step
+  della simulazione, keyframe periodici con lo stato completo dei corpi ed un indice finale per la ricerca rapida
+- La scrittura su disco avviene in un thread dedicato, alimentato da un buffer di dimensione limitata: il ciclo di rendering non attende mai il disco
+- ReplayReader mappa il file in memoria e ricostruisce le trasformazioni dei corpi ad uno step qualsiasi partendo dal keyframe precedente
+
+Formato del file (little endian):
+- Header: magic "GRPL", versione (uint16), numero di corpi (uint16), durata dello step (float), limiti di quantizzazione delle posizioni (6 float)
+- Record, ognuno preceduto da un tag (uint8):
+  - REPLAY_TAG_STEP: distanza in step dal record precedente (varint), maschera dei corpi modificati, per ogni corpo modificato
+    posizione (3 uint16) e rotazione compressa "smallest three" (uint32)
+  - REPLAY_TAG_KEYFRAME: step (uint32), per ogni corpo posizione, rotazione, velocita' lineare ed angolare (13 float) e activation state (uint8)
+  - REPLAY_TAG_SHOT: step (uint32), giocatore (uint8), impulso (3 float), punto di applicazione relPos (3 float)
+  - REPLAY_TAG_TURN: step (uint32), giocatore di turno (uint8), punteggi dei due giocatori (2 int32)
+- Indice: numero di voci (uint32), per ogni voce step (uint32), tipo (uint32) ed offset del record nel file (uint64)
+- Footer: offset dell'indice (uint64), magic "GRPX"
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+// Tag dei record contenuti nel file di replay
+#define REPLAY_TAG_STEP 1
+#define REPLAY_TAG_KEYFRAME 2
+#define REPLAY_TAG_SHOT 3
+#define REPLAY_TAG_TURN 4
+
+// Versione del formato scritta nell'header
+#define REPLAY_VERSION 1
+
+/*
+ * Struttura che rappresenta lo stato completo di un corpo rigido, memorizzato nei keyframe.
+ * Contiene tutto il necessario per riportare il corpo nello stesso stato e risimulare da quel punto.
+ */
+struct ReplayBodyState {
+	float position[3];
+	float rotation[4];
+	float linearVelocity[3];
+	float angularVelocity[3];
+	uint8_t activationState;
+};
+
+/*
+ * Struttura che rappresenta la trasformazione (posizione e rotazione) di un corpo ad un certo step
+ */
+struct ReplayTransform {
+	float position[3];
+	float rotation[4];
+};
+
+/*
+ * Struttura che rappresenta un tiro registrato nel file
+ */
+struct ReplayShot {
+	uint32_t step;
+	uint8_t player;
+	float impulse[3];
+	float relPos[3];
+};
+
+/*
+ * Struttura che rappresenta una voce dell'indice finale del file
+ */
+struct ReplayIndexEntry {
+	uint32_t step;
+	uint32_t kind;
+	uint64_t offset;
+};
+
+/*
+ * Struttura che rappresenta la trasformazione quantizzata di un corpo, cosi' come viene scritta nei record di step
+ */
+struct ReplayQuantizedTransform {
+	uint16_t position[3];
+	uint32_t rotation;
+};
+
+/********** classe REPLAYWRITER **********/
+class ReplayWriter {
+public:
+	// Costruttore della classe
+	ReplayWriter();
+	// Distruttore della classe, chiude il file se ancora aperto
+	~ReplayWriter();
+
+	/*
+	 * Metodo che crea il file di replay, scrive l'header ed avvia il thread di scrittura.
+	 * Prende in input i seguenti valori:
+	 * - path: string, path del file da creare
+	 * - bodyCount: int, numero di corpi dinamici registrati ad ogni step
+	 * - stepSeconds: float, durata di uno step interno della simulazione
+	 * Restituisce true se il file e' stato aperto correttamente.
+	 */
+	bool Open(const std::string &path, int bodyCount, float stepSeconds);
+
+	/*
+	 * Metodo da chiamare ad ogni step interno della simulazione fisica.
+	 * Scrive solo i corpi la cui trasformazione quantizzata e' cambiata, ed inserisce un keyframe periodico finche' qualcosa si muove.
+	 * Prende in input i seguenti valori:
+	 * - bodies: vector<btRigidBody*>, corpi dinamici della scena, sempre nello stesso ordine
+	 */
+	void RecordStep(const std::vector<btRigidBody*> &bodies);
+
+	/*
+	 * Metodo che scrive un keyframe con lo stato completo di tutti i corpi allo step corrente
+	 */
+	void RecordKeyframe(const std::vector<btRigidBody*> &bodies);
+
+	/*
+	 * Metodo che registra un tiro del giocatore.
+	 * Prende in input i seguenti valori:
+	 * - player: int, indice del giocatore che ha effettuato il tiro
+	 * - impulse: btVector3, impulso applicato alla biglia
+	 * - relPos: btVector3, punto di applicazione dell'impulso relativo al centro della biglia
+	 */
+	void RecordShot(int player, const btVector3 &impulse, const btVector3 &relPos);
+
+	/*
+	 * Metodo che registra il cambio di turno, con il giocatore di turno ed i punteggi aggiornati
+	 */
+	void RecordTurn(int player, const int score[2]);
+
+	/*
+	 * Metodo che svuota il buffer, attende il thread di scrittura e chiude il file scrivendo indice e footer
+	 */
+	void Close();
+
+	/*
+	 * Metodo get per lo stato di apertura del file
+	 */
+	bool isOpen() const;
+
+	/*
+	 * Metodo get per il numero di step registrati finora
+	 */
+	uint32_t getStep() const;
+
+	/*
+	 * Metodo get per il numero di byte prodotti finora
+	 */
+	uint64_t getSize() const;
+
+private:
+	// Dimensione di un blocco del buffer e numero massimo di blocchi in attesa di scrittura
+	static const size_t BLOCK_SIZE = 16 * 1024;
+	static const size_t MAX_QUEUED_BLOCKS = 64;
+	// Numero di step tra due keyframe periodici
+	static const uint32_t KEYFRAME_INTERVAL = 120;
+
+	// Attributi che rappresentano il file e lo stato di registrazione
+	std::ofstream file;
+	bool recording;
+	bool overflow;
+	int bodyCount;
+
+	// Attributi per la codifica delta degli step
+	uint32_t step;
+	uint32_t lastEmittedStep;
+	uint32_t lastKeyframeStep;
+	std::vector<ReplayQuantizedTransform> lastEmitted;
+	std::vector<ReplayQuantizedTransform> current;
+
+	// Attributo che contiene l'indice dei record scritti
+	std::vector<ReplayIndexEntry> index;
+
+	// Attributi che rappresentano il buffer limitato condiviso con il thread di scrittura
+	std::vector<uint8_t> block;
+	std::deque<std::vector<uint8_t> > queue;
+	std::vector<std::vector<uint8_t> > freeBlocks;
+	uint64_t producedBytes;
+	uint64_t committedBytes;
+
+	std::thread ioThread;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping;
+
+	void put(const void *data, size_t size);
+	void putVarint(uint32_t value);
+	void submitBlock();
+	void ioLoop();
+};
+
+/********** classe REPLAYREADER **********/
+class ReplayReader {
+public:
+	// Costruttore della classe
+	ReplayReader();
+	// Distruttore della classe, rilascia la mappatura del file
+	~ReplayReader();
+
+	/*
+	 * Metodo che mappa in memoria il file di replay e ne legge header ed indice.
+	 * Prende in input i seguenti valori:
+	 * - path: string, path del file da leggere
+	 * Restituisce true se il file e' valido.
+	 */
+	bool Open(const std::string &path);
+
+	/*
+	 * Metodo che rilascia la mappatura del file
+	 */
+	void Close();
+
+	/*
+	 * Metodo che ricostruisce le trasformazioni di tutti i corpi ad uno step, decodificando i record a partire dal keyframe precedente.
+	 * Prende in input i seguenti valori:
+	 * - step: uint32_t, step da ricostruire
+	 * - transforms: vector<ReplayTransform>, vettore in cui vengono scritte le trasformazioni
+	 * Restituisce false se prima dello step non e' presente alcun keyframe.
+	 */
+	bool getTransforms(uint32_t step, std::vector<ReplayTransform> &transforms) const;
+
+	/*
+	 * Metodo che restituisce il keyframe piu' vicino allo step indicato, non successivo ad esso.
+	 * Prende in input i seguenti valori:
+	 * - step: uint32_t, step di riferimento
+	 * - keyStep: uint32_t, step del keyframe trovato
+	 * - states: vector<ReplayBodyState>, vettore in cui viene scritto lo stato dei corpi
+	 */
+	bool getKeyframe(uint32_t step, uint32_t &keyStep, std::vector<ReplayBodyState> &states) const;
+
+	/*
+	 * Metodi get per i tiri registrati, il numero di corpi, la durata dello step e l'ultimo step registrato
+	 */
+	const std::vector<ReplayShot>& getShots() const;
+	int getBodyCount() const;
+	float getStepSeconds() const;
+	uint32_t getLastStep() const;
+
+private:
+	// Attributi che rappresentano la mappatura del file in memoria
+	const uint8_t *data;
+	size_t size;
+	void *fileHandle;
+	void *mapHandle;
+
+	// Attributi letti da header ed indice
+	int bodyCount;
+	float stepSeconds;
+	float boundsMin[3];
+	float boundsMax[3];
+	uint64_t indexOffset;
+	uint32_t lastStep;
+	std::vector<ReplayIndexEntry> keyframes;
+	std::vector<ReplayShot> shots;
+
+	uint32_t decodeTransforms(uint32_t step, std::vector<ReplayTransform> &transforms) const;
+	size_t readKeyframe(size_t offset, uint32_t &keyStep, std::vector<ReplayBodyState> &states) const;
+};
+
+#endif // REPLAY_H
@@ -0,0 +1,188 @@
+#include "ReplayViewer.h"
+
+#include <chrono>
+#include <cmath>
+
+const float ReplayViewer::STEP_SECONDS = PHYSICS_TICK;
+const double ReplayViewer::SEEK_BUDGET_SECONDS = 0.008;
+
+typedef std::chrono::high_resolution_clock ReplayClock;
+
+static double elapsed_seconds(ReplayClock::time_point start) {
+	return std::chrono::duration<double>(ReplayClock::now() - start).count();
+}
+
+ReplayViewer::ReplayViewer(SceneBuilder builder) : clone(builder), currentStep(0), lastStep(0), loaded(false), lastSeekSeconds(0.0) {}
+
+void ReplayViewer::Load(const WorldSnapshot &start, int player, const btVector3 &impulse, const btVector3 &relPos) {
+	this->snapshots.clear();
+	this->snapshotSteps.clear();
+
+	// Stato iniziale: ricostruisco il mondo, applico il tiro e salvo lo snapshot dello step 0.
+	// Dopo ogni cattura il mondo viene ricostruito dallo snapshot stesso, esattamente come avverra' durante un Seek:
+	// cosi' la simulazione continua e quella ripartita da uno snapshot producono gli stessi risultati.
+	ReplayClock::time_point start_time = ReplayClock::now();
+	this->clone.Reset(start);
+
+	btRigidBody* ball = this->clone.getBodies()[player];
+	ball->activate(true);
+	ball->applyImpulse(impulse, relPos);
+
+	WorldSnapshot snapshot;
+	snapshot.Capture(this->clone.getBodies());
+	this->clone.Reset(snapshot);
+
+	this->snapshots.push_back(snapshot);
+	this->snapshotSteps.push_back(0);
+
+	// Costo della ricostruzione del mondo, che fa parte di ogni Seek
+	double resetCost = elapsed_seconds(start_time) / 2.0;
+	double accumulated = resetCost;
+
+	uint32_t step = 0;
+
+	while (step < MAX_STEPS) {
+		ReplayClock::time_point stepStart = ReplayClock::now();
+		this->clone.Step();
+		double stepCost = elapsed_seconds(stepStart);
+
+		step++;
+		accumulated += stepCost;
+
+		if (this->clone.isIdle())
+			break;
+
+		// Se lo step successivo rischia di superare il budget, salvo uno snapshot: la distanza tra gli snapshot si adatta da sola
+		// alle fasi piu' costose del tiro (urti con i birilli) e si allarga quando restano solo biglie che rotolano
+		if (accumulated + stepCost > SEEK_BUDGET_SECONDS) {
+			ReplayClock::time_point captureStart = ReplayClock::now();
+
+			snapshot.Capture(this->clone.getBodies());
+			this->clone.Reset(snapshot);
+
+			this->snapshots.push_back(snapshot);
+			this->snapshotSteps.push_back(step);
+
+			resetCost = elapsed_seconds(captureStart);
+			accumulated = resetCost;
+		}
+	}
+
+	this->lastStep = step;
+	this->currentStep = step;
+	this->loaded = true;
+}
+
+bool ReplayViewer::Load(const ReplayReader &reader, size_t shotIndex) {
+	const std::vector<ReplayShot> &shots = reader.getShots();
+
+	if (shotIndex >= shots.size())
+		return false;
+
+	const ReplayShot &shot = shots[shotIndex];
+
+	uint32_t keyStep;
+	std::vector<ReplayBodyState> states;
+
+	if (!reader.getKeyframe(shot.step, keyStep, states) || keyStep != shot.step)
+		return false;
+
+	WorldSnapshot start;
+	start.bodies.resize(states.size());
+
+	for (size_t i = 0; i < states.size(); i++) {
+		const ReplayBodyState &state = states[i];
+		BodySnapshot &body = start.bodies[i];
+
+		body.transform.setOrigin(btVector3(state.position[0], state.position[1], state.position[2]));
+		body.transform.setRotation(btQuaternion(state.rotation[0], state.rotation[1], state.rotation[2], state.rotation[3]));
+		body.linearVelocity = btVector3(state.linearVelocity[0], state.linearVelocity[1], state.linearVelocity[2]);
+		body.angularVelocity = btVector3(state.angularVelocity[0], state.angularVelocity[1], state.angularVelocity[2]);
+		body.activationState = state.activationState;
+		body.deactivationTime = 0.0f;
+	}
+
+	this->Load(start, shot.player, btVector3(shot.impulse[0], shot.impulse[1], shot.impulse[2]), btVector3(shot.relPos[0], shot.relPos[1], shot.relPos[2]));
+
+	return true;
+}
+
+void ReplayViewer::Seek(float seconds) {
+	if (!this->loaded)
+		return;
+
+	ReplayClock::time_point start = ReplayClock::now();
+
+	float position = seconds / STEP_SECONDS;
+	uint32_t target = position <= 0.0f ? 0 : (uint32_t) (position + 0.5f);
+
+	if (target > this->lastStep)
+		target = this->lastStep;
+
+	if (target == this->currentStep) {
+		this->lastSeekSeconds = elapsed_seconds(start);
+		return;
+	}
+
+	// Snapshot piu' vicino non successivo al target: se e' piu' avanti dello stato corrente, o se bisogna tornare indietro, riparto da li'
+	size_t index = this->nextSnapshot(target) - 1;
+
+	if (target < this->currentStep || this->snapshotSteps[index] > this->currentStep) {
+		this->clone.Reset(this->snapshots[index]);
+		this->currentStep = this->snapshotSteps[index];
+	}
+
+	// Risimulo gli step mancanti. Quando attraverso uno snapshot ricostruisco il mondo da esso, come nella simulazione di caricamento
+	size_t next = this->nextSnapshot(this->currentStep);
+
+	while (this->currentStep < target) {
+		this->clone.Step();
+		this->currentStep++;
+
+		if (next < this->snapshotSteps.size() && this->snapshotSteps[next] == this->currentStep) {
+			this->clone.Reset(this->snapshots[next]);
+			next++;
+		}
+	}
+
+	this->lastSeekSeconds = elapsed_seconds(start);
+}
+
+bool ReplayViewer::isLoaded() const {
+	return this->loaded;
+}
+
+float ReplayViewer::getDuration() const {
+	return this->lastStep * STEP_SECONDS;
+}
+
+float ReplayViewer::getTime() const {
+	return this->currentStep * STEP_SECONDS;
+}
+
+const std::vector<btRigidBody*>& ReplayViewer::getBodies() const {
+	return this->clone.getBodies();
+}
+
+size_t ReplayViewer::getSnapshotCount() const {
+	return this->snapshots.size();
+}
+
+double ReplayViewer::getLastSeekMilliseconds() const {
+	return this->lastSeekSeconds * 1000.0;
+}
+
+// Restituisce l'indice del primo snapshot catturato dopo lo step indicato
+size_t ReplayViewer::nextSnapshot(uint32_t step) const {
+	size_t first = 0, last = this->snapshotSteps.size();
+
+	while (first < last) {
+		size_t middle = (first + last) / 2;
+		if (this->snapshotSteps[middle] <= step)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	return first;
+}
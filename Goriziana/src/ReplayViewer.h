@@ -0,0 +1,104 @@
+/*
+Classe ReplayViewer
+- Permette di scorrere avanti ed indietro nel tempo un tiro registrato, senza conservare le trasformazioni di ogni frame
+- Al caricamento il tiro viene simulato una volta in un mondo clonato, salvando in memoria degli snapshot dello stato completo.
+  La distanza tra due snapshot e' scelta in base al costo misurato degli step, in modo che la risimulazione da uno snapshot
+  qualsiasi rientri nel budget di tempo di un frame
+- Per posizionarsi ad un istante viene ripristinato lo snapshot precedente e si risimula fino allo step richiesto
+*/
+
+#ifndef REPLAYVIEWER_H
+#define REPLAYVIEWER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include <utils/snapshot.h>
+
+#include "Replay.h"
+
+/********** classe REPLAYVIEWER **********/
+class ReplayViewer {
+public:
+	/*
+	 * Costruttore
+	 * Prende in input i seguenti valori:
+	 * - builder: SceneBuilder, funzione che crea gli oggetti della scena, la stessa usata per il mondo di gioco
+	 */
+	ReplayViewer(SceneBuilder builder);
+
+	/*
+	 * Metodo che carica un tiro: ripristina lo stato iniziale, applica l'impulso e simula il tiro fino a quando i corpi si fermano,
+	 * salvando gli snapshot lungo il percorso.
+	 * Prende in input i seguenti valori:
+	 * - start: WorldSnapshot, stato dei corpi dinamici prima del tiro
+	 * - player: int, indice della biglia che effettua il tiro
+	 * - impulse: btVector3, impulso applicato alla biglia
+	 * - relPos: btVector3, punto di applicazione dell'impulso relativo al centro della biglia
+	 */
+	void Load(const WorldSnapshot &start, int player, const btVector3 &impulse, const btVector3 &relPos);
+
+	/*
+	 * Metodo che carica un tiro da un file di replay, partendo dal keyframe registrato insieme al tiro.
+	 * Prende in input i seguenti valori:
+	 * - reader: ReplayReader, file di replay gia' aperto
+	 * - shotIndex: size_t, indice del tiro da caricare
+	 * Restituisce false se il tiro non esiste o non ha un keyframe associato.
+	 */
+	bool Load(const ReplayReader &reader, size_t shotIndex);
+
+	/*
+	 * Metodo che porta la simulazione all'istante indicato, ripristinando lo snapshot precedente e risimulando solo gli step mancanti.
+	 * Se l'istante richiesto e' successivo a quello corrente e non c'e' uno snapshot piu' vicino, prosegue dallo stato attuale.
+	 * Prende in input i seguenti valori:
+	 * - seconds: float, istante del tiro a cui posizionarsi
+	 */
+	void Seek(float seconds);
+
+	/*
+	 * Metodo get per lo stato di caricamento di un tiro
+	 */
+	bool isLoaded() const;
+
+	/*
+	 * Metodi get per la durata del tiro e l'istante corrente, in secondi
+	 */
+	float getDuration() const;
+	float getTime() const;
+
+	/*
+	 * Metodo get per i corpi dinamici del mondo del replay, nello stesso ordine del mondo di gioco
+	 */
+	const std::vector<btRigidBody*>& getBodies() const;
+
+	/*
+	 * Metodi get per il numero di snapshot salvati ed il tempo impiegato dall'ultimo Seek, in millisecondi
+	 */
+	size_t getSnapshotCount() const;
+	double getLastSeekMilliseconds() const;
+
+private:
+	// Durata di uno step della risimulazione, uguale al tick del mondo di gioco
+	static const float STEP_SECONDS;
+	// Budget di tempo per un Seek: la risimulazione tra due snapshot non deve superarlo
+	static const double SEEK_BUDGET_SECONDS;
+	// Numero massimo di step simulati per un tiro
+	static const uint32_t MAX_STEPS = PHYSICS_TICKS_PER_SECOND * 20;
+
+	SimulationClone clone;
+
+	// Attributi che rappresentano gli snapshot salvati e lo step a cui sono stati catturati
+	std::vector<WorldSnapshot> snapshots;
+	std::vector<uint32_t> snapshotSteps;
+
+	uint32_t currentStep;
+	uint32_t lastStep;
+	bool loaded;
+	double lastSeekSeconds;
+
+	size_t nextSnapshot(uint32_t step) const;
+};
+
+#endif // REPLAYVIEWER_H
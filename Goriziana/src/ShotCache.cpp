@@ -0,0 +1,349 @@
+#include "ShotCache.h"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// Passi di quantizzazione dello stato dei corpi e del tiro
+static const float CACHE_POSITION_QUANTUM = 0.001f;
+static const float CACHE_ROTATION_QUANTUM = 0.001f;
+static const float CACHE_VELOCITY_QUANTUM = 0.001f;
+static const float CACHE_IMPULSE_QUANTUM = 0.02f;
+
+/********** FUNZIONI DI CODIFICA **********/
+
+// Hash FNV-1a a 64 bit, applicato ai valori quantizzati
+static void hash_value(uint64_t &hash, int64_t value) {
+	for (int i = 0; i < 8; i++) {
+		hash ^= (uint64_t) ((value >> (i * 8)) & 0xFF);
+		hash *= 1099511628211ULL;
+	}
+}
+
+static void hash_quantized(uint64_t &hash, float value, float quantum) {
+	hash_value(hash, (int64_t) floor(value / quantum + 0.5f));
+}
+
+static void hash_vector(uint64_t &hash, const btVector3 &value, float quantum) {
+	hash_quantized(hash, value.x(), quantum);
+	hash_quantized(hash, value.y(), quantum);
+	hash_quantized(hash, value.z(), quantum);
+}
+
+template<typename T>
+static void write_value(std::ofstream &file, const T &value) {
+	file.write((const char*) &value, sizeof(T));
+}
+
+template<typename T>
+static bool read_value(std::ifstream &file, T &value) {
+	return (bool) file.read((char*) &value, sizeof(T));
+}
+
+static void write_points(std::ofstream &file, const std::vector<btVector3> &points) {
+	write_value(file, (uint32_t) points.size());
+
+	for (size_t i = 0; i < points.size(); i++) {
+		float values[3] = { points[i].x(), points[i].y(), points[i].z() };
+		file.write((const char*) values, sizeof(values));
+	}
+}
+
+// Numero massimo di corpi di una voce: i conteggi letti dal file vengono verificati prima di allocare memoria
+static const uint32_t MAX_BODIES = 64;
+// Numero massimo di punti di un percorso: la previsione ne aggiunge al piu' uno per tick, oltre alla posizione iniziale
+static const uint32_t MAX_POINTS = PREVIEW_MAX_STEPS + 1;
+
+static bool read_points(std::ifstream &file, std::vector<btVector3> &points) {
+	uint32_t count;
+	if (!read_value(file, count) || count > MAX_POINTS)
+		return false;
+
+	points.resize(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		float values[3];
+		if (!file.read((char*) values, sizeof(values)))
+			return false;
+
+		points[i] = btVector3(values[0], values[1], values[2]);
+	}
+
+	return true;
+}
+
+/********** classe SHOTCACHE **********/
+
+ShotCache::ShotCache(size_t maxBytes) : stripeCapacity(maxBytes / STRIPES), hits(0), misses(0), insertions(0), evictions(0) {
+	for (size_t i = 0; i < STRIPES; i++)
+		this->stripes[i].bytes = 0;
+}
+
+uint64_t ShotCache::MakeKey(const WorldSnapshot &state, int player, const btVector3 &impulse, const btVector3 &relPos) {
+	uint64_t hash = 14695981039346656037ULL;
+
+	hash_value(hash, player);
+	hash_vector(hash, impulse, CACHE_IMPULSE_QUANTUM);
+	hash_vector(hash, relPos, CACHE_IMPULSE_QUANTUM);
+
+	for (size_t i = 0; i < state.bodies.size(); i++) {
+		const BodySnapshot &body = state.bodies[i];
+
+		// q e -q rappresentano la stessa rotazione: scelgo quella con w positivo, in modo che abbiano la stessa chiave
+		btQuaternion rotation = body.transform.getRotation();
+		float sign = rotation.w() < 0.0f ? -1.0f : 1.0f;
+
+		hash_vector(hash, body.transform.getOrigin(), CACHE_POSITION_QUANTUM);
+		hash_quantized(hash, rotation.x() * sign, CACHE_ROTATION_QUANTUM);
+		hash_quantized(hash, rotation.y() * sign, CACHE_ROTATION_QUANTUM);
+		hash_quantized(hash, rotation.z() * sign, CACHE_ROTATION_QUANTUM);
+		hash_quantized(hash, rotation.w() * sign, CACHE_ROTATION_QUANTUM);
+		hash_vector(hash, body.linearVelocity, CACHE_VELOCITY_QUANTUM);
+		hash_vector(hash, body.angularVelocity, CACHE_VELOCITY_QUANTUM);
+		hash_value(hash, body.activationState);
+	}
+
+	// Mescolo i bit finali, perche' i bit alti scelgono il gruppo
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+std::shared_ptr<const ShotOutcome> ShotCache::Find(uint64_t key) {
+	Stripe &stripe = this->getStripe(key);
+	std::lock_guard<std::mutex> lock(stripe.mutex);
+
+	std::unordered_map<uint64_t, std::list<Entry>::iterator>::iterator found = stripe.table.find(key);
+
+	if (found == stripe.table.end()) {
+		this->misses++;
+		return std::shared_ptr<const ShotOutcome>();
+	}
+
+	// La voce diventa la piu' recente del gruppo
+	stripe.lru.splice(stripe.lru.begin(), stripe.lru, found->second);
+	this->hits++;
+
+	return found->second->second;
+}
+
+void ShotCache::Insert(uint64_t key, const std::shared_ptr<const ShotOutcome> &outcome) {
+	if (!outcome)
+		return;
+
+	size_t bytes = getOutcomeBytes(*outcome);
+
+	if (bytes > this->stripeCapacity)
+		return;
+
+	Stripe &stripe = this->getStripe(key);
+	std::lock_guard<std::mutex> lock(stripe.mutex);
+
+	std::unordered_map<uint64_t, std::list<Entry>::iterator>::iterator found = stripe.table.find(key);
+
+	if (found != stripe.table.end()) {
+		stripe.bytes -= getOutcomeBytes(*found->second->second);
+		stripe.lru.erase(found->second);
+		stripe.table.erase(found);
+	}
+
+	stripe.lru.push_front(Entry(key, outcome));
+	stripe.table[key] = stripe.lru.begin();
+	stripe.bytes += bytes;
+	this->insertions++;
+
+	// Elimino le voci usate meno di recente finche' il gruppo non rientra nel limite
+	while (stripe.bytes > this->stripeCapacity) {
+		const Entry &last = stripe.lru.back();
+
+		stripe.bytes -= getOutcomeBytes(*last.second);
+		stripe.table.erase(last.first);
+		stripe.lru.pop_back();
+		this->evictions++;
+	}
+}
+
+void ShotCache::Clear() {
+	for (size_t i = 0; i < STRIPES; i++) {
+		std::lock_guard<std::mutex> lock(this->stripes[i].mutex);
+
+		this->stripes[i].lru.clear();
+		this->stripes[i].table.clear();
+		this->stripes[i].bytes = 0;
+	}
+}
+
+bool ShotCache::Save(const std::string &path) {
+	std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+
+	if (!file) {
+		std::cout << "ERROR::SHOT_CACHE::FILE_NOT_CREATED: " << path << std::endl;
+		return false;
+	}
+
+	// Copio i riferimenti alle voci gruppo per gruppo, per non tenere bloccata l'intera cache durante la scrittura.
+	// Le voci di ogni gruppo vengono scritte dalla meno recente, in modo che al caricamento l'ordine LRU si ricostruisca da solo.
+	std::vector<Entry> entries;
+
+	for (size_t i = 0; i < STRIPES; i++) {
+		std::lock_guard<std::mutex> lock(this->stripes[i].mutex);
+		entries.insert(entries.end(), this->stripes[i].lru.rbegin(), this->stripes[i].lru.rend());
+	}
+
+	file.write("GSCH", 4);
+	write_value(file, (uint32_t) SHOT_CACHE_VERSION);
+	write_value(file, (float) PHYSICS_TICK);
+	write_value(file, (float) PHYSICS_MIN_STEP);
+	write_value(file, (float) PHYSICS_SAFE_DISTANCE);
+	write_value(file, (uint32_t) entries.size());
+
+	for (size_t i = 0; i < entries.size(); i++) {
+		const ShotOutcome &outcome = *entries[i].second;
+		const std::vector<BodySnapshot> &bodies = outcome.finalState.bodies;
+
+		write_value(file, entries[i].first);
+		write_value(file, (uint32_t) bodies.size());
+
+		for (size_t j = 0; j < bodies.size(); j++) {
+			const btVector3 &origin = bodies[j].transform.getOrigin();
+			btQuaternion rotation = bodies[j].transform.getRotation();
+
+			float values[13] = {
+				origin.x(), origin.y(), origin.z(),
+				rotation.x(), rotation.y(), rotation.z(), rotation.w(),
+				bodies[j].linearVelocity.x(), bodies[j].linearVelocity.y(), bodies[j].linearVelocity.z(),
+				bodies[j].angularVelocity.x(), bodies[j].angularVelocity.y(), bodies[j].angularVelocity.z()
+			};
+
+			file.write((const char*) values, sizeof(values));
+			write_value(file, (int32_t) bodies[j].activationState);
+			write_value(file, (float) bodies[j].deactivationTime);
+		}
+
+		for (int j = 0; j < PREVIEW_BALLS; j++)
+			write_points(file, outcome.preview.paths[j]);
+
+		write_points(file, outcome.preview.collisions);
+		write_value(file, (uint8_t) outcome.preview.complete);
+	}
+
+	return (bool) file;
+}
+
+bool ShotCache::Load(const std::string &path) {
+	std::ifstream file(path.c_str(), std::ios::binary);
+
+	// La cache potrebbe non essere mai stata salvata: non e' un errore
+	if (!file)
+		return false;
+
+	char magic[4];
+	uint32_t version, count;
+	float tick, minStep, safeDistance;
+
+	if (!file.read(magic, 4) || magic[0] != 'G' || magic[1] != 'S' || magic[2] != 'C' || magic[3] != 'H' ||
+		!read_value(file, version) || version != SHOT_CACHE_VERSION ||
+		!read_value(file, tick) || !read_value(file, minStep) || !read_value(file, safeDistance) || !read_value(file, count)) {
+		std::cout << "ERROR::SHOT_CACHE::INVALID_FILE: " << path << std::endl;
+		return false;
+	}
+
+	// Gli esiti calcolati con passi di simulazione diversi da quelli attuali non corrispondono piu' ai tiri di questa sessione
+	if (tick != (float) PHYSICS_TICK || minStep != (float) PHYSICS_MIN_STEP || safeDistance != (float) PHYSICS_SAFE_DISTANCE) {
+		std::cout << "ERROR::SHOT_CACHE::PHYSICS_MISMATCH: " << path << std::endl;
+		return false;
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		std::shared_ptr<ShotOutcome> outcome = std::make_shared<ShotOutcome>();
+		uint64_t key;
+		uint32_t bodyCount;
+
+		if (!read_value(file, key) || !read_value(file, bodyCount) || bodyCount > MAX_BODIES) {
+			std::cout << "ERROR::SHOT_CACHE::TRUNCATED_FILE: " << path << std::endl;
+			return false;
+		}
+
+		outcome->finalState.bodies.resize(bodyCount);
+
+		for (uint32_t j = 0; j < bodyCount; j++) {
+			BodySnapshot &body = outcome->finalState.bodies[j];
+			float values[13];
+			int32_t activation;
+			float deactivation;
+
+			if (!file.read((char*) values, sizeof(values)) || !read_value(file, activation) || !read_value(file, deactivation)) {
+				std::cout << "ERROR::SHOT_CACHE::TRUNCATED_FILE: " << path << std::endl;
+				return false;
+			}
+
+			body.transform.setOrigin(btVector3(values[0], values[1], values[2]));
+			body.transform.setRotation(btQuaternion(values[3], values[4], values[5], values[6]));
+			body.linearVelocity = btVector3(values[7], values[8], values[9]);
+			body.angularVelocity = btVector3(values[10], values[11], values[12]);
+			body.activationState = activation;
+			body.deactivationTime = deactivation;
+		}
+
+		bool valid = true;
+		for (int j = 0; j < PREVIEW_BALLS && valid; j++)
+			valid = read_points(file, outcome->preview.paths[j]);
+
+		uint8_t complete;
+
+		if (!valid || !read_points(file, outcome->preview.collisions) || !read_value(file, complete)) {
+			std::cout << "ERROR::SHOT_CACHE::TRUNCATED_FILE: " << path << std::endl;
+			return false;
+		}
+
+		outcome->preview.complete = complete != 0;
+
+		this->Insert(key, outcome);
+	}
+
+	// Le voci caricate, e quelle eliminate per farle entrare, non vengono conteggiate come inserimenti ed eliminazioni della sessione
+	this->insertions = 0;
+	this->evictions = 0;
+
+	return true;
+}
+
+ShotCacheStats ShotCache::getStats() {
+	ShotCacheStats stats;
+
+	stats.hits = this->hits;
+	stats.misses = this->misses;
+	stats.insertions = this->insertions;
+	stats.evictions = this->evictions;
+	stats.entries = 0;
+	stats.bytes = 0;
+
+	for (size_t i = 0; i < STRIPES; i++) {
+		std::lock_guard<std::mutex> lock(this->stripes[i].mutex);
+
+		stats.entries += this->stripes[i].table.size();
+		stats.bytes += this->stripes[i].bytes;
+	}
+
+	return stats;
+}
+
+ShotCache::Stripe& ShotCache::getStripe(uint64_t key) {
+	return this->stripes[key >> 60];
+}
+
+// Stima della memoria occupata da una voce: esito, vettori dinamici e strutture della lista e della tabella
+size_t ShotCache::getOutcomeBytes(const ShotOutcome &outcome) {
+	size_t bytes = sizeof(ShotOutcome) + sizeof(Entry) + 4 * sizeof(void*);
+
+	bytes += outcome.finalState.bodies.capacity() * sizeof(BodySnapshot);
+	bytes += outcome.preview.collisions.capacity() * sizeof(btVector3);
+
+	for (int i = 0; i < PREVIEW_BALLS; i++)
+		bytes += outcome.preview.paths[i].capacity() * sizeof(btVector3);
+
+	return bytes;
+}
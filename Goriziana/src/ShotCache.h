@@ -0,0 +1,139 @@
+/*
+Classe ShotCache
+- Memorizza l'esito dei tiri gia' simulati, in modo che valutare di nuovo lo stesso tiro dalla stessa disposizione diventi una ricerca
+- La chiave e' un hash a 64 bit dello stato quantizzato dei corpi dinamici, della biglia che tira, dell'impulso e del punto relPos
+  quantizzati: tiri quasi identici ricadono nella stessa voce
+- La cache e' condivisa tra piu' thread: le voci sono divise in gruppi (stripe), ognuno con il proprio mutex ed una propria lista LRU,
+  e la memoria occupata da ogni gruppo e' limitata
+- Il contenuto puo' essere salvato su disco e ricaricato alla sessione successiva
+
+Formato del file (little endian):
+- Header: magic "GSCH", versione (uint32), tick, step minimo e spostamento massimo per substep della simulazione (3 float),
+  numero di voci (uint32)
+- Per ogni voce: chiave (uint64), numero di corpi (uint32), per ogni corpo posizione, rotazione, velocita' lineare ed angolare (13 float),
+  activation state (int32) e deactivation time (float), percorso di ogni biglia (numero di punti uint32 e 3 float per punto),
+  urti (numero di punti uint32 e 3 float per punto), simulazione completa (uint8)
+*/
+
+#ifndef SHOTCACHE_H
+#define SHOTCACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include <utils/snapshot.h>
+
+#include "ShotPreview.h"
+
+// Versione del formato del file della cache, da incrementare anche quando cambia il modo in cui la simulazione fa evolvere un tiro
+// (ad esempio il solver): gli esiti salvati con la fisica precedente non sono piu' validi
+#define SHOT_CACHE_VERSION 2
+
+/*
+ * Struttura che rappresenta l'esito di un tiro
+ */
+struct ShotOutcome {
+	// Stato dei corpi dinamici alla fine del tiro
+	WorldSnapshot finalState;
+	// Percorsi delle biglie ed urti, come mostrati dalla previsione del tiro
+	ShotPreviewResult preview;
+};
+
+/*
+ * Struttura che raccoglie i contatori della cache
+ */
+struct ShotCacheStats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t insertions;
+	uint64_t evictions;
+	size_t entries;
+	size_t bytes;
+};
+
+/********** classe SHOTCACHE **********/
+class ShotCache {
+public:
+	/*
+	 * Costruttore
+	 * Prende in input i seguenti valori:
+	 * - maxBytes: size_t, memoria massima occupata dagli esiti memorizzati, divisa in parti uguali tra i gruppi
+	 */
+	ShotCache(size_t maxBytes);
+
+	/*
+	 * Metodo che calcola la chiave di un tiro.
+	 * Prende in input i seguenti valori:
+	 * - state: WorldSnapshot, stato dei corpi dinamici prima del tiro
+	 * - player: int, indice della biglia che effettua il tiro
+	 * - impulse: btVector3, impulso applicato alla biglia
+	 * - relPos: btVector3, punto di applicazione dell'impulso relativo al centro della biglia
+	 */
+	static uint64_t MakeKey(const WorldSnapshot &state, int player, const btVector3 &impulse, const btVector3 &relPos);
+
+	/*
+	 * Metodo che cerca l'esito di un tiro, spostandolo in cima alla lista LRU del suo gruppo.
+	 * Restituisce nullptr se il tiro non e' presente.
+	 */
+	std::shared_ptr<const ShotOutcome> Find(uint64_t key);
+
+	/*
+	 * Metodo che inserisce l'esito di un tiro, eliminando le voci usate meno di recente se il gruppo supera il limite di memoria
+	 */
+	void Insert(uint64_t key, const std::shared_ptr<const ShotOutcome> &outcome);
+
+	/*
+	 * Metodo che svuota la cache
+	 */
+	void Clear();
+
+	/*
+	 * Metodi che salvano e ricaricano il contenuto della cache su disco.
+	 * Restituiscono false se il file non puo' essere scritto o letto.
+	 */
+	bool Save(const std::string &path);
+	bool Load(const std::string &path);
+
+	/*
+	 * Metodo get per i contatori della cache
+	 */
+	ShotCacheStats getStats();
+
+private:
+	// Numero di gruppi in cui sono divise le voci
+	static const size_t STRIPES = 16;
+
+	typedef std::pair<uint64_t, std::shared_ptr<const ShotOutcome> > Entry;
+
+	/*
+	 * Struttura che rappresenta un gruppo di voci: lista LRU (in testa le piu' recenti) e tabella per la ricerca
+	 */
+	struct Stripe {
+		std::mutex mutex;
+		std::list<Entry> lru;
+		std::unordered_map<uint64_t, std::list<Entry>::iterator> table;
+		size_t bytes;
+	};
+
+	Stripe stripes[STRIPES];
+	size_t stripeCapacity;
+
+	std::atomic<uint64_t> hits;
+	std::atomic<uint64_t> misses;
+	std::atomic<uint64_t> insertions;
+	std::atomic<uint64_t> evictions;
+
+	Stripe& getStripe(uint64_t key);
+	static size_t getOutcomeBytes(const ShotOutcome &outcome);
+};
+
+#endif // SHOTCACHE_H
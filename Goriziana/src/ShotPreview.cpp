@@ -0,0 +1,230 @@
+#include "ShotPreview.h"
+#include "ShotCache.h"
+
+#include <cmath>
+#include <utility>
+
+
+// Distanza minima tra due punti consecutivi del percorso di una biglia
+static const btScalar PREVIEW_SAMPLE_DISTANCE = 0.05f;
+
+ShotPreview::ShotPreview(SceneBuilder builder, ShotCache *cache) : builder(builder), cache(cache), requestPlayer(0), pending(false), generation(0), publishedVersion(0), readVersion(0), running(false), stopping(false) {
+	this->published.complete = false;
+}
+
+ShotPreview::~ShotPreview() {
+	this->Stop();
+}
+
+void ShotPreview::Start() {
+	if (this->running)
+		return;
+
+	this->stopping = false;
+	this->running = true;
+	this->worker = std::thread(&ShotPreview::workerLoop, this);
+}
+
+void ShotPreview::Stop() {
+	if (!this->running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+		this->generation++;
+	}
+
+	this->condition.notify_one();
+	this->worker.join();
+
+	this->running = false;
+}
+
+void ShotPreview::Request(const WorldSnapshot &state, int player, const btVector3 &impulse, const btVector3 &relPos) {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		this->requestState = state;
+		this->requestPlayer = player;
+		this->requestImpulse = impulse;
+		this->requestRelPos = relPos;
+		this->pending = true;
+
+		// La simulazione in corso si interrompe al prossimo step
+		this->generation++;
+	}
+
+	this->condition.notify_one();
+}
+
+void ShotPreview::Cancel() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->pending = false;
+	this->generation++;
+
+	for (int i = 0; i < PREVIEW_BALLS; i++)
+		this->published.paths[i].clear();
+	this->published.collisions.clear();
+	this->published.complete = false;
+	this->publishedVersion++;
+}
+
+bool ShotPreview::getResult(ShotPreviewResult &result) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (this->publishedVersion == this->readVersion)
+		return false;
+
+	for (int i = 0; i < PREVIEW_BALLS; i++)
+		result.paths[i] = this->published.paths[i];
+	result.collisions = this->published.collisions;
+	result.complete = this->published.complete;
+
+	this->readVersion = this->publishedVersion;
+
+	return true;
+}
+
+void ShotPreview::workerLoop() {
+	// Il mondo clonato appartiene solo a questo thread
+	SimulationClone clone(this->builder);
+
+	WorldSnapshot state;
+	int player;
+	btVector3 impulse, relPos;
+	uint64_t requestGeneration;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->condition.wait(lock, [this] { return this->stopping || this->pending; });
+
+			if (this->stopping)
+				return;
+
+			std::swap(state, this->requestState);
+			player = this->requestPlayer;
+			impulse = this->requestImpulse;
+			relPos = this->requestRelPos;
+			requestGeneration = this->generation;
+			this->pending = false;
+		}
+
+		this->simulate(clone, state, player, impulse, relPos, requestGeneration);
+	}
+}
+
+void ShotPreview::simulate(SimulationClone &clone, const WorldSnapshot &state, int player, const btVector3 &impulse, const btVector3 &relPos, uint64_t requestGeneration) {
+	// Se lo stesso tiro e' gia' stato simulato dalla stessa disposizione, il risultato e' immediato
+	uint64_t key = 0;
+
+	if (this->cache) {
+		key = ShotCache::MakeKey(state, player, impulse, relPos);
+
+		std::shared_ptr<const ShotOutcome> cached = this->cache->Find(key);
+
+		if (cached) {
+			this->publish(cached->preview, requestGeneration);
+			return;
+		}
+	}
+
+	clone.Reset(state);
+
+	const std::vector<btRigidBody*> &bodies = clone.getBodies();
+
+	bodies[player]->activate(true);
+	bodies[player]->applyImpulse(impulse, relPos);
+
+	ShotPreviewResult result;
+	result.complete = false;
+
+	for (int i = 0; i < PREVIEW_BALLS; i++)
+		result.paths[i].push_back(bodies[i]->getWorldTransform().getOrigin());
+
+	// Coppie di corpi di cui e' gia' stato registrato il primo urto
+	std::vector<std::pair<const btCollisionObject*, const btCollisionObject*> > touched;
+
+	btDispatcher* dispatcher = clone.getSimulation()->dynamicsWorld->getDispatcher();
+
+	for (int step = 0; step < PREVIEW_MAX_STEPS;) {
+		for (int chunk = 0; chunk < CHUNK_STEPS && step < PREVIEW_MAX_STEPS; chunk++, step++) {
+			if (this->generation != requestGeneration)
+				return;
+
+			clone.Step();
+
+			for (int i = 0; i < PREVIEW_BALLS; i++) {
+				const btVector3 &origin = bodies[i]->getWorldTransform().getOrigin();
+
+				if (origin.distance2(result.paths[i].back()) > PREVIEW_SAMPLE_DISTANCE * PREVIEW_SAMPLE_DISTANCE)
+					result.paths[i].push_back(origin);
+			}
+
+			// Registro il primo contatto di ogni coppia di corpi, ignorando quelli con il piano del tavolo (normale verticale)
+			for (int i = 0; i < dispatcher->getNumManifolds() && result.collisions.size() < MAX_COLLISIONS; i++) {
+				btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+
+				if (manifold->getNumContacts() == 0)
+					continue;
+
+				btManifoldPoint &point = manifold->getContactPoint(0);
+
+				if (point.getDistance() > 0.01f || fabs(point.m_normalWorldOnB.y()) > 0.7f)
+					continue;
+
+				std::pair<const btCollisionObject*, const btCollisionObject*> pair(manifold->getBody0(), manifold->getBody1());
+				bool found = false;
+
+				for (size_t j = 0; j < touched.size() && !found; j++)
+					found = (touched[j] == pair);
+
+				if (!found) {
+					touched.push_back(pair);
+					result.collisions.push_back(point.getPositionWorldOnB());
+				}
+			}
+		}
+
+		bool idle = true;
+		for (int i = 0; i < PREVIEW_BALLS && idle; i++)
+			idle = !bodies[i]->isActive() || bodies[i]->getLinearVelocity().length2() < 0.0001f;
+
+		result.complete = idle || step >= PREVIEW_MAX_STEPS;
+
+		if (!this->publish(result, requestGeneration))
+			return;
+
+		// Solo le simulazioni arrivate alla fine finiscono nella cache: quelle annullate restano parziali
+		if (result.complete) {
+			if (this->cache) {
+				std::shared_ptr<ShotOutcome> outcome = std::make_shared<ShotOutcome>();
+
+				outcome->preview = result;
+				outcome->finalState.Capture(bodies);
+
+				this->cache->Insert(key, outcome);
+			}
+
+			return;
+		}
+	}
+}
+
+bool ShotPreview::publish(const ShotPreviewResult &result, uint64_t requestGeneration) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	// Se nel frattempo e' arrivata una nuova richiesta, il risultato non e' piu' valido
+	if (this->generation != requestGeneration)
+		return false;
+
+	for (int i = 0; i < PREVIEW_BALLS; i++)
+		this->published.paths[i] = result.paths[i];
+	this->published.collisions = result.collisions;
+	this->published.complete = result.complete;
+	this->publishedVersion++;
+
+	return true;
+}
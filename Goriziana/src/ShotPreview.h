@@ -0,0 +1,124 @@
+/*
+Classe ShotPreview
+- Calcola in un thread dedicato la traiettoria prevista di un tiro, simulandolo in anticipo in un mondo clonato
+- Ogni nuova richiesta (ad esempio ad ogni movimento del mouse) annulla quella in corso: il thread se ne accorge tra uno step e l'altro
+- La simulazione procede a blocchi di pochi step: dopo ogni blocco il risultato parziale viene pubblicato, cosi' la traiettoria
+  si allunga nei frame successivi senza che il ciclo di rendering debba mai attendere il thread
+- Se viene fornita una ShotCache, i tiri gia' simulati completamente vengono ripresi dalla cache invece di essere risimulati
+*/
+
+#ifndef SHOTPREVIEW_H
+#define SHOTPREVIEW_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include <utils/snapshot.h>
+
+class ShotCache;
+
+// Numero di biglie di cui viene calcolato il percorso, nell'ordine dei corpi della scena: bianca, gialla e rossa
+#define PREVIEW_BALLS 3
+// Numero massimo di tick di PHYSICS_TICK simulati per un tiro, pari a 4 secondi
+#define PREVIEW_MAX_STEPS (PHYSICS_TICKS_PER_SECOND * 4)
+
+/*
+ * Struttura che rappresenta la traiettoria prevista di un tiro
+ */
+struct ShotPreviewResult {
+	// Percorso di ogni biglia, campionato lungo la simulazione
+	std::vector<btVector3> paths[PREVIEW_BALLS];
+	// Punti dei primi urti tra i corpi o con le sponde
+	std::vector<btVector3> collisions;
+	// Indica se la simulazione del tiro e' terminata
+	bool complete;
+};
+
+/********** classe SHOTPREVIEW **********/
+class ShotPreview {
+public:
+	/*
+	 * Costruttore
+	 * Prende in input i seguenti valori:
+	 * - builder: SceneBuilder, funzione che crea gli oggetti della scena, la stessa usata per il mondo di gioco
+	 * - cache: ShotCache*, cache degli esiti dei tiri, puo' essere nullptr
+	 */
+	ShotPreview(SceneBuilder builder, ShotCache *cache = nullptr);
+	// Distruttore della classe, ferma il thread se ancora attivo
+	~ShotPreview();
+
+	/*
+	 * Metodo che avvia il thread di simulazione
+	 */
+	void Start();
+
+	/*
+	 * Metodo che ferma il thread di simulazione, annullando la richiesta in corso
+	 */
+	void Stop();
+
+	/*
+	 * Metodo che richiede la previsione di un tiro, sostituendo ed annullando quella precedente.
+	 * Prende in input i seguenti valori:
+	 * - state: WorldSnapshot, stato attuale dei corpi dinamici della scena
+	 * - player: int, indice della biglia che effettua il tiro
+	 * - impulse: btVector3, impulso che verrebbe applicato alla biglia
+	 * - relPos: btVector3, punto di applicazione dell'impulso relativo al centro della biglia
+	 */
+	void Request(const WorldSnapshot &state, int player, const btVector3 &impulse, const btVector3 &relPos);
+
+	/*
+	 * Metodo che annulla la previsione in corso e scarta l'ultimo risultato
+	 */
+	void Cancel();
+
+	/*
+	 * Metodo che copia l'ultimo risultato pubblicato dal thread, se piu' recente di quello gia' letto.
+	 * Prende in input i seguenti valori:
+	 * - result: ShotPreviewResult, struttura in cui viene copiato il risultato
+	 * Restituisce true se il risultato e' stato aggiornato.
+	 */
+	bool getResult(ShotPreviewResult &result);
+
+private:
+	// Numero di tick simulati prima di pubblicare un risultato parziale, pari a un quarto di secondo
+	static const int CHUNK_STEPS = PHYSICS_TICKS_PER_SECOND / 4;
+	// Numero massimo di urti mostrati
+	static const size_t MAX_COLLISIONS = 6;
+
+	SceneBuilder builder;
+	ShotCache *cache;
+
+	// Attributi che rappresentano la richiesta in attesa, condivisa con il thread
+	WorldSnapshot requestState;
+	int requestPlayer;
+	btVector3 requestImpulse;
+	btVector3 requestRelPos;
+	bool pending;
+
+	// Attributo incrementato ad ogni richiesta: il thread interrompe la simulazione se non corrisponde piu' alla propria
+	std::atomic<uint64_t> generation;
+
+	// Attributi che rappresentano l'ultimo risultato pubblicato
+	ShotPreviewResult published;
+	uint64_t publishedVersion;
+	uint64_t readVersion;
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool running;
+	bool stopping;
+
+	void workerLoop();
+	void simulate(SimulationClone &clone, const WorldSnapshot &state, int player, const btVector3 &impulse, const btVector3 &relPos, uint64_t requestGeneration);
+	bool publish(const ShotPreviewResult &result, uint64_t requestGeneration);
+};
+
+#endif // SHOTPREVIEW_H
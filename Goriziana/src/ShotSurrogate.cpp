@@ -0,0 +1,747 @@
+#include "ShotSurrogate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SURROGATE_SSE
+#include <xmmintrin.h>
+#endif
+
+// Semi-dimensioni del piano del tavolo, usate per normalizzare le posizioni delle biglie
+static const float TABLE_HALF_X = 12.3f;
+static const float TABLE_HALF_Z = 5.5f;
+// Peso dell'errore sulle posizioni rispetto a quello sui birilli durante l'addestramento
+static const float POSITION_LOSS_WEIGHT = 4.0f;
+// Numero massimo di tick di PHYSICS_TICK della simulazione esatta
+static const int SIMULATION_MAX_STEPS = PHYSICS_TICKS_PER_SECOND * 20;
+// Punto di applicazione dell'impulso, lo stesso usato dal gioco
+static const btVector3 SHOT_REL_POS(1.0f, 1.0f, 1.0f);
+
+typedef std::chrono::high_resolution_clock SurrogateClock;
+
+static double elapsed_seconds(SurrogateClock::time_point start) {
+	return std::chrono::duration<double>(SurrogateClock::now() - start).count();
+}
+
+static int pad4(int value) {
+	return (value + 3) & ~3;
+}
+
+static float sigmoid(float value) {
+	return 1.0f / (1.0f + exp(-value));
+}
+
+/********** KERNEL DI CALCOLO **********/
+
+// Livello completamente connesso: y = W x + b, con ReLU opzionale.
+// Con i pesi memorizzati colonna per colonna, ogni ingresso moltiplica una colonna contigua e la somma a tutte le uscite:
+// le istruzioni SSE lavorano su 4 uscite alla volta senza somme orizzontali, e gli ingressi nulli dopo la ReLU vengono saltati.
+static void dense(const float *weights, const float *bias, const float *x, int inputs, int outputs, float *y, bool relu) {
+#ifdef SURROGATE_SSE
+	for (int o = 0; o < outputs; o += 4)
+		_mm_storeu_ps(y + o, _mm_loadu_ps(bias + o));
+
+	for (int i = 0; i < inputs; i++) {
+		if (x[i] == 0.0f)
+			continue;
+
+		__m128 value = _mm_set1_ps(x[i]);
+		const float *column = weights + i * outputs;
+
+		for (int o = 0; o < outputs; o += 4)
+			_mm_storeu_ps(y + o, _mm_add_ps(_mm_loadu_ps(y + o), _mm_mul_ps(_mm_loadu_ps(column + o), value)));
+	}
+
+	if (relu) {
+		__m128 zero = _mm_setzero_ps();
+
+		for (int o = 0; o < outputs; o += 4)
+			_mm_storeu_ps(y + o, _mm_max_ps(_mm_loadu_ps(y + o), zero));
+	}
+#else
+	for (int o = 0; o < outputs; o++)
+		y[o] = bias[o];
+
+	for (int i = 0; i < inputs; i++) {
+		if (x[i] == 0.0f)
+			continue;
+
+		const float *column = weights + i * outputs;
+
+		for (int o = 0; o < outputs; o++)
+			y[o] += column[o] * x[i];
+	}
+
+	if (relu)
+		for (int o = 0; o < outputs; o++)
+			y[o] = y[o] > 0.0f ? y[o] : 0.0f;
+#endif
+}
+
+/********** GENERAZIONE DEL DATASET **********/
+
+// Crea una disposizione casuale delle biglie, con i birilli nella posizione iniziale, ed un tiro casuale
+static void random_shot(const WorldSnapshot &base, std::mt19937 &rng, WorldSnapshot &layout, int &player, btVector3 &impulse) {
+	std::uniform_real_distribution<float> positionX(-TABLE_HALF_X + 0.9f, TABLE_HALF_X - 0.9f);
+	std::uniform_real_distribution<float> positionZ(-TABLE_HALF_Z + 0.7f, TABLE_HALF_Z - 0.7f);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> strength(4.0f, 20.0f);
+	std::uniform_real_distribution<float> slope(0.1f, 0.6f);
+
+	layout = base;
+
+	for (int i = 0; i < SURROGATE_BALLS; i++) {
+		btVector3 position;
+		bool valid = false;
+
+		// Scarto le posizioni che si sovrappongono alle biglie gia' posizionate o ai birilli
+		while (!valid) {
+			position = btVector3(positionX(rng), base.bodies[i].transform.getOrigin().y(), positionZ(rng));
+			valid = true;
+
+			for (int j = 0; j < i && valid; j++)
+				valid = position.distance2(layout.bodies[j].transform.getOrigin()) > 1.0f;
+
+			for (size_t j = SURROGATE_BALLS; j < base.bodies.size() && valid; j++) {
+				btVector3 pin = base.bodies[j].transform.getOrigin();
+				pin.setY(position.y());
+
+				valid = position.distance2(pin) > 0.36f;
+			}
+		}
+
+		layout.bodies[i].transform.setOrigin(position);
+	}
+
+	player = rng() % 2;
+
+	// Come nel gioco l'impulso punta verso il basso, perche' la camera guarda il tavolo dall'alto
+	float direction = angle(rng), magnitude = strength(rng);
+	impulse = btVector3(cos(direction) * magnitude, -slope(rng) * magnitude, sin(direction) * magnitude);
+}
+
+// Punteggio reale di un tiro: somma dei punti dei birilli abbattuti
+static int shot_score(const float *output, const int *pinPoints) {
+	int score = 0;
+
+	for (int i = 0; i < SURROGATE_PINS; i++)
+		if (output[i] > 0.5f)
+			score += pinPoints[i];
+
+	return score;
+}
+
+/********** classe SHOTSURROGATE **********/
+
+ShotSurrogate::ShotSurrogate() : trained(false) {
+	for (int i = 0; i < SURROGATE_INPUTS; i++) {
+		this->inputMean[i] = 0.0f;
+		this->inputScale[i] = 1.0f;
+	}
+
+	this->initLayers();
+}
+
+void ShotSurrogate::MakeInput(const WorldSnapshot &state, int player, const btVector3 &impulse, float *input) {
+	for (int i = 0; i < SURROGATE_BALLS; i++) {
+		const btVector3 &origin = state.bodies[i].transform.getOrigin();
+
+		input[i * 2] = origin.x();
+		input[i * 2 + 1] = origin.z();
+	}
+
+	input[SURROGATE_BALLS * 2] = (float) player;
+	input[SURROGATE_BALLS * 2 + 1] = impulse.x();
+	input[SURROGATE_BALLS * 2 + 2] = impulse.y();
+	input[SURROGATE_BALLS * 2 + 3] = impulse.z();
+}
+
+void ShotSurrogate::Simulate(SimulationClone &clone, const WorldSnapshot &state, int player, const btVector3 &impulse, const btVector3 &relPos, float *output) {
+	clone.Reset(state);
+
+	const std::vector<btRigidBody*> &bodies = clone.getBodies();
+
+	bodies[player]->activate(true);
+	bodies[player]->applyImpulse(impulse, relPos);
+
+	for (int step = 0; step < SIMULATION_MAX_STEPS; step++) {
+		clone.Step();
+
+		if (clone.isIdle())
+			break;
+	}
+
+	// Stesso criterio del gioco: il birillo e' abbattuto se il suo asse y non e' piu' prevalentemente verticale
+	btScalar matrix[16];
+
+	for (int i = 0; i < SURROGATE_PINS; i++) {
+		bodies[SURROGATE_BALLS + i]->getWorldTransform().getOpenGLMatrix(matrix);
+		output[i] = fabs(matrix[4]) > fabs(matrix[5]) ? 1.0f : 0.0f;
+	}
+
+	for (int i = 0; i < SURROGATE_BALLS; i++) {
+		const btVector3 &origin = bodies[i]->getWorldTransform().getOrigin();
+
+		output[SURROGATE_PINS + i * 2] = origin.x();
+		output[SURROGATE_PINS + i * 2 + 1] = origin.z();
+	}
+}
+
+void ShotSurrogate::Train(const std::vector<SurrogateSample> &samples, int epochs, unsigned seed) {
+	if (samples.empty())
+		return;
+
+	std::mt19937 rng(seed);
+	size_t count = samples.size();
+
+	// Normalizzo gli ingressi a media nulla e varianza unitaria
+	for (int i = 0; i < SURROGATE_INPUTS; i++) {
+		double sum = 0.0, squares = 0.0;
+
+		for (size_t j = 0; j < count; j++) {
+			sum += samples[j].input[i];
+			squares += samples[j].input[i] * samples[j].input[i];
+		}
+
+		double mean = sum / count;
+		double deviation = sqrt(std::max(squares / count - mean * mean, 1e-6));
+
+		this->inputMean[i] = (float) mean;
+		this->inputScale[i] = (float) (1.0 / deviation);
+	}
+
+	// Inizializzazione dei pesi di He, adatta alla ReLU
+	this->initLayers();
+
+	for (int l = 0; l < LAYERS; l++) {
+		Layer &layer = this->layers[l];
+		int fanIn = (l == 0) ? SURROGATE_INPUTS : layer.inputs;
+		int realOutputs = (l == LAYERS - 1) ? SURROGATE_OUTPUTS : layer.outputs;
+		std::normal_distribution<float> distribution(0.0f, sqrt(2.0f / fanIn));
+
+		for (int i = 0; i < fanIn; i++)
+			for (int o = 0; o < realOutputs; o++)
+				layer.weights[i * layer.outputs + o] = distribution(rng);
+	}
+
+	int inputSize = this->layers[0].inputs, outputSize = this->layers[LAYERS - 1].outputs;
+
+	// Ingressi normalizzati ed uscite attese: birilli 0/1, posizioni normalizzate sulle dimensioni del tavolo
+	std::vector<float> inputs(count * inputSize, 0.0f), targets(count * outputSize, 0.0f);
+
+	for (size_t j = 0; j < count; j++) {
+		this->normalizeInput(samples[j].input, &inputs[j * inputSize]);
+
+		for (int o = 0; o < SURROGATE_PINS; o++)
+			targets[j * outputSize + o] = samples[j].output[o];
+
+		for (int b = 0; b < SURROGATE_BALLS; b++) {
+			targets[j * outputSize + SURROGATE_PINS + b * 2] = samples[j].output[SURROGATE_PINS + b * 2] / TABLE_HALF_X;
+			targets[j * outputSize + SURROGATE_PINS + b * 2 + 1] = samples[j].output[SURROGATE_PINS + b * 2 + 1] / TABLE_HALF_Z;
+		}
+	}
+
+	// Gradienti e momenti di Adam per ogni livello
+	std::vector<float> gradWeights[LAYERS], gradBias[LAYERS];
+	std::vector<float> momentWeights[LAYERS], momentBias[LAYERS], varianceWeights[LAYERS], varianceBias[LAYERS];
+
+	for (int l = 0; l < LAYERS; l++) {
+		gradWeights[l].assign(this->layers[l].weights.size(), 0.0f);
+		momentWeights[l].assign(this->layers[l].weights.size(), 0.0f);
+		varianceWeights[l].assign(this->layers[l].weights.size(), 0.0f);
+		gradBias[l].assign(this->layers[l].bias.size(), 0.0f);
+		momentBias[l].assign(this->layers[l].bias.size(), 0.0f);
+		varianceBias[l].assign(this->layers[l].bias.size(), 0.0f);
+	}
+
+	std::vector<float> buffers[LAYERS + 1], deltas[LAYERS + 1];
+	float *activations[LAYERS + 1];
+
+	for (int l = 0; l < LAYERS; l++) {
+		buffers[l + 1].assign(this->layers[l].outputs, 0.0f);
+		deltas[l + 1].assign(this->layers[l].outputs, 0.0f);
+		activations[l + 1] = buffers[l + 1].data();
+	}
+	deltas[0].assign(inputSize, 0.0f);
+
+	std::vector<size_t> order(count);
+	for (size_t j = 0; j < count; j++)
+		order[j] = j;
+
+	const size_t batchSize = 32;
+	const float beta1 = 0.9f, beta2 = 0.999f, epsilon = 1e-8f;
+	int iteration = 0;
+
+	for (int epoch = 0; epoch < epochs; epoch++) {
+		// Learning rate che decresce esponenzialmente da 2e-3 a 1e-4
+		float learningRate = 0.002f * pow(0.05f, (float) epoch / epochs);
+		double epochLoss = 0.0;
+
+		std::shuffle(order.begin(), order.end(), rng);
+
+		for (size_t start = 0; start < count; start += batchSize) {
+			size_t end = std::min(start + batchSize, count);
+
+			for (int l = 0; l < LAYERS; l++) {
+				std::fill(gradWeights[l].begin(), gradWeights[l].end(), 0.0f);
+				std::fill(gradBias[l].begin(), gradBias[l].end(), 0.0f);
+			}
+
+			for (size_t k = start; k < end; k++) {
+				size_t j = order[k];
+				const float *target = &targets[j * outputSize];
+
+				activations[0] = &inputs[j * inputSize];
+				this->forward(activations[0], activations);
+
+				// Errore sulle uscite: entropia incrociata per i birilli, errore quadratico per le posizioni
+				float *output = activations[LAYERS], *delta = deltas[LAYERS].data();
+
+				for (int o = 0; o < outputSize; o++) {
+					if (o < SURROGATE_PINS) {
+						float probability = sigmoid(output[o]);
+
+						delta[o] = probability - target[o];
+						epochLoss -= target[o] > 0.5f ? log(std::max(probability, 1e-7f)) : log(std::max(1.0f - probability, 1e-7f));
+					} else if (o < SURROGATE_OUTPUTS) {
+						float error = output[o] - target[o];
+
+						delta[o] = POSITION_LOSS_WEIGHT * error;
+						epochLoss += 0.5f * POSITION_LOSS_WEIGHT * error * error;
+					} else {
+						delta[o] = 0.0f;
+					}
+				}
+
+				// Retropropagazione dall'ultimo livello al primo
+				for (int l = LAYERS - 1; l >= 0; l--) {
+					const Layer &layer = this->layers[l];
+					const float *input = activations[l];
+					const float *layerDelta = deltas[l + 1].data();
+
+					for (int i = 0; i < layer.inputs; i++) {
+						if (input[i] == 0.0f)
+							continue;
+
+						float *gradient = &gradWeights[l][i * layer.outputs];
+
+						for (int o = 0; o < layer.outputs; o++)
+							gradient[o] += input[i] * layerDelta[o];
+					}
+
+					for (int o = 0; o < layer.outputs; o++)
+						gradBias[l][o] += layerDelta[o];
+
+					if (l == 0)
+						break;
+
+					for (int i = 0; i < layer.inputs; i++) {
+						// Derivata della ReLU del livello precedente
+						if (input[i] <= 0.0f) {
+							deltas[l][i] = 0.0f;
+							continue;
+						}
+
+						const float *column = &layer.weights[i * layer.outputs];
+						float sum = 0.0f;
+
+						for (int o = 0; o < layer.outputs; o++)
+							sum += column[o] * layerDelta[o];
+
+						deltas[l][i] = sum;
+					}
+				}
+			}
+
+			// Aggiornamento di Adam con il gradiente medio del minibatch
+			iteration++;
+
+			float scale = 1.0f / (end - start);
+			float correction1 = 1.0f - pow(beta1, (float) iteration);
+			float correction2 = 1.0f - pow(beta2, (float) iteration);
+
+			for (int l = 0; l < LAYERS; l++) {
+				std::vector<float> *parameters[2] = { &this->layers[l].weights, &this->layers[l].bias };
+				std::vector<float> *gradients[2] = { &gradWeights[l], &gradBias[l] };
+				std::vector<float> *moments[2] = { &momentWeights[l], &momentBias[l] };
+				std::vector<float> *variances[2] = { &varianceWeights[l], &varianceBias[l] };
+
+				for (int p = 0; p < 2; p++) {
+					for (size_t i = 0; i < parameters[p]->size(); i++) {
+						float gradient = (*gradients[p])[i] * scale;
+						float &moment = (*moments[p])[i], &variance = (*variances[p])[i];
+
+						moment = beta1 * moment + (1.0f - beta1) * gradient;
+						variance = beta2 * variance + (1.0f - beta2) * gradient * gradient;
+
+						(*parameters[p])[i] -= learningRate * (moment / correction1) / (sqrt(variance / correction2) + epsilon);
+					}
+				}
+			}
+		}
+
+		if ((epoch + 1) % 10 == 0 || epoch == 0)
+			std::cout << "Epoca " << epoch + 1 << "/" << epochs << ": loss " << epochLoss / count << std::endl;
+	}
+
+	this->trained = true;
+}
+
+void ShotSurrogate::Predict(const float *inputs, size_t count, float *outputs) const {
+	float buffers[LAYERS + 1][HIDDEN];
+	float *activations[LAYERS + 1];
+
+	for (int l = 0; l <= LAYERS; l++)
+		activations[l] = buffers[l];
+
+	for (size_t j = 0; j < count; j++) {
+		this->normalizeInput(inputs + j * SURROGATE_INPUTS, activations[0]);
+		this->forward(activations[0], activations);
+
+		const float *result = activations[LAYERS];
+		float *output = outputs + j * SURROGATE_OUTPUTS;
+
+		for (int o = 0; o < SURROGATE_PINS; o++)
+			output[o] = sigmoid(result[o]);
+
+		for (int b = 0; b < SURROGATE_BALLS; b++) {
+			output[SURROGATE_PINS + b * 2] = result[SURROGATE_PINS + b * 2] * TABLE_HALF_X;
+			output[SURROGATE_PINS + b * 2 + 1] = result[SURROGATE_PINS + b * 2 + 1] * TABLE_HALF_Z;
+		}
+	}
+}
+
+void ShotSurrogate::Predict(const WorldSnapshot &state, int player, const btVector3 &impulse, ShotPrediction &prediction) const {
+	float input[SURROGATE_INPUTS], output[SURROGATE_OUTPUTS];
+
+	MakeInput(state, player, impulse, input);
+	this->Predict(input, 1, output);
+
+	for (int i = 0; i < SURROGATE_PINS; i++)
+		prediction.pinProbability[i] = output[i];
+
+	for (int b = 0; b < SURROGATE_BALLS; b++) {
+		prediction.ballPosition[b][0] = output[SURROGATE_PINS + b * 2];
+		prediction.ballPosition[b][1] = output[SURROGATE_PINS + b * 2 + 1];
+	}
+}
+
+void ShotSurrogate::Prefilter(const WorldSnapshot &state, int player, const std::vector<btVector3> &impulses, const int *pinPoints, size_t keep, std::vector<size_t> &selected) const {
+	size_t count = impulses.size();
+	std::vector<float> inputs(count * SURROGATE_INPUTS), outputs(count * SURROGATE_OUTPUTS);
+	std::vector<std::pair<float, size_t> > scores(count);
+
+	for (size_t j = 0; j < count; j++)
+		MakeInput(state, player, impulses[j], &inputs[j * SURROGATE_INPUTS]);
+
+	this->Predict(inputs.data(), count, outputs.data());
+
+	// Punteggio atteso: somma dei punti dei birilli pesati per la probabilita' di abbatterli
+	for (size_t j = 0; j < count; j++) {
+		float expected = 0.0f;
+
+		for (int i = 0; i < SURROGATE_PINS; i++)
+			expected += outputs[j * SURROGATE_OUTPUTS + i] * pinPoints[i];
+
+		scores[j] = std::make_pair(-expected, j);
+	}
+
+	keep = std::min(keep, count);
+	std::partial_sort(scores.begin(), scores.begin() + keep, scores.end());
+
+	selected.resize(keep);
+	for (size_t j = 0; j < keep; j++)
+		selected[j] = scores[j].second;
+}
+
+bool ShotSurrogate::Save(const std::string &path) const {
+	std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+
+	if (!file) {
+		std::cout << "ERROR::SURROGATE::FILE_NOT_CREATED: " << path << std::endl;
+		return false;
+	}
+
+	uint32_t version = SURROGATE_VERSION;
+
+	file.write("GSUR", 4);
+	file.write((const char*) &version, sizeof(version));
+	file.write((const char*) this->inputMean, sizeof(this->inputMean));
+	file.write((const char*) this->inputScale, sizeof(this->inputScale));
+
+	for (int l = 0; l < LAYERS; l++) {
+		file.write((const char*) this->layers[l].weights.data(), this->layers[l].weights.size() * sizeof(float));
+		file.write((const char*) this->layers[l].bias.data(), this->layers[l].bias.size() * sizeof(float));
+	}
+
+	return (bool) file;
+}
+
+bool ShotSurrogate::Load(const std::string &path) {
+	std::ifstream file(path.c_str(), std::ios::binary);
+
+	if (!file)
+		return false;
+
+	char magic[4];
+	uint32_t version;
+
+	if (!file.read(magic, 4) || memcmp(magic, "GSUR", 4) != 0 || !file.read((char*) &version, sizeof(version)) || version != SURROGATE_VERSION) {
+		std::cout << "ERROR::SURROGATE::INVALID_FILE: " << path << std::endl;
+		return false;
+	}
+
+	file.read((char*) this->inputMean, sizeof(this->inputMean));
+	file.read((char*) this->inputScale, sizeof(this->inputScale));
+
+	for (int l = 0; l < LAYERS; l++) {
+		file.read((char*) this->layers[l].weights.data(), this->layers[l].weights.size() * sizeof(float));
+		file.read((char*) this->layers[l].bias.data(), this->layers[l].bias.size() * sizeof(float));
+	}
+
+	if (!file) {
+		std::cout << "ERROR::SURROGATE::TRUNCATED_FILE: " << path << std::endl;
+		this->initLayers();
+		return false;
+	}
+
+	this->trained = true;
+
+	return true;
+}
+
+bool ShotSurrogate::isTrained() const {
+	return this->trained;
+}
+
+void ShotSurrogate::RunTraining(SceneBuilder builder, const int *pinPoints, size_t sampleCount, const std::string &path) {
+	if (sampleCount < SURROGATE_MIN_SAMPLES) {
+		std::cout << "ERROR::SURROGATE::INVALID_SAMPLE_COUNT: " << sampleCount << " (minimo " << SURROGATE_MIN_SAMPLES << ")" << std::endl;
+		return;
+	}
+
+	unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	// Stato iniziale della scena, da cui partono tutte le disposizioni casuali
+	WorldSnapshot base;
+	{
+		SimulationClone clone(builder);
+		clone.Reset(WorldSnapshot());
+		base.Capture(clone.getBodies());
+	}
+
+	//GENERO IL DATASET SIMULANDO I TIRI CON LA BULLET, UN MONDO CLONATO PER OGNI THREAD
+	std::cout << "Generazione del dataset: " << sampleCount << " tiri su " << threadCount << " thread" << std::endl;
+
+	std::vector<SurrogateSample> samples(sampleCount);
+	std::vector<double> threadSeconds(threadCount, 0.0);
+	std::vector<std::thread> workers;
+
+	SurrogateClock::time_point start = SurrogateClock::now();
+
+	for (unsigned t = 0; t < threadCount; t++) {
+		workers.push_back(std::thread([&, t]() {
+			SimulationClone clone(builder);
+			std::mt19937 rng(1000 + t);
+			WorldSnapshot layout;
+			int player;
+			btVector3 impulse;
+
+			SurrogateClock::time_point threadStart = SurrogateClock::now();
+
+			for (size_t j = sampleCount * t / threadCount; j < sampleCount * (t + 1) / threadCount; j++) {
+				random_shot(base, rng, layout, player, impulse);
+
+				MakeInput(layout, player, impulse, samples[j].input);
+				Simulate(clone, layout, player, impulse, SHOT_REL_POS, samples[j].output);
+			}
+
+			threadSeconds[t] = elapsed_seconds(threadStart);
+		}));
+	}
+
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+
+	double simulationSeconds = 0.0;
+	for (unsigned t = 0; t < threadCount; t++)
+		simulationSeconds += threadSeconds[t];
+
+	double exactMilliseconds = 1000.0 * simulationSeconds / sampleCount;
+
+	std::cout << "Dataset generato in " << elapsed_seconds(start) << " s, simulazione esatta: " << exactMilliseconds << " ms per tiro" << std::endl;
+
+	//ADDESTRO LA RETE SULL'80% DEI CAMPIONI, IL RESTO SERVE PER LA VALUTAZIONE
+	size_t trainCount = sampleCount * 4 / 5, testCount = sampleCount - trainCount;
+	std::vector<SurrogateSample> training(samples.begin(), samples.begin() + trainCount);
+
+	ShotSurrogate surrogate;
+
+	start = SurrogateClock::now();
+	surrogate.Train(training, 80, 42);
+	std::cout << "Addestramento completato in " << elapsed_seconds(start) << " s" << std::endl;
+
+	//VALUTO L'ACCURATEZZA SUI CAMPIONI DI TEST
+	std::vector<float> inputs(testCount * SURROGATE_INPUTS), outputs(testCount * SURROGATE_OUTPUTS);
+
+	for (size_t j = 0; j < testCount; j++)
+		memcpy(&inputs[j * SURROGATE_INPUTS], samples[trainCount + j].input, sizeof(samples[j].input));
+
+	surrogate.Predict(inputs.data(), testCount, outputs.data());
+
+	size_t pinCorrect[SURROGATE_PINS] = { 0 }, shotCorrect = 0, knocked = 0, knockedFound = 0;
+	double positionError[SURROGATE_BALLS] = { 0.0 }, baselineError[SURROGATE_BALLS] = { 0.0 };
+
+	for (size_t j = 0; j < testCount; j++) {
+		const SurrogateSample &sample = samples[trainCount + j];
+		const float *output = &outputs[j * SURROGATE_OUTPUTS];
+		bool allCorrect = true;
+
+		for (int i = 0; i < SURROGATE_PINS; i++) {
+			bool predicted = output[i] > 0.5f, real = sample.output[i] > 0.5f;
+
+			pinCorrect[i] += (predicted == real);
+			allCorrect = allCorrect && (predicted == real);
+			knocked += real;
+			knockedFound += (real && predicted);
+		}
+
+		shotCorrect += allCorrect;
+
+		// Errore rispetto alla posizione reale, confrontato con quello di chi prevede che la biglia resti ferma
+		for (int b = 0; b < SURROGATE_BALLS; b++) {
+			float realX = sample.output[SURROGATE_PINS + b * 2], realZ = sample.output[SURROGATE_PINS + b * 2 + 1];
+			float dx = output[SURROGATE_PINS + b * 2] - realX, dz = output[SURROGATE_PINS + b * 2 + 1] - realZ;
+			float sx = sample.input[b * 2] - realX, sz = sample.input[b * 2 + 1] - realZ;
+
+			positionError[b] += sqrt(dx * dx + dz * dz);
+			baselineError[b] += sqrt(sx * sx + sz * sz);
+		}
+	}
+
+	std::cout << "Report su " << testCount << " tiri di test:" << std::endl;
+
+	for (int i = 0; i < SURROGATE_PINS; i++)
+		std::cout << "  birillo " << i << ": accuratezza " << 100.0 * pinCorrect[i] / testCount << "%" << std::endl;
+
+	std::cout << "  tiri con tutti i birilli previsti correttamente: " << 100.0 * shotCorrect / testCount << "%" << std::endl;
+	std::cout << "  birilli abbattuti riconosciuti: " << (knocked ? 100.0 * knockedFound / knocked : 0.0) << "%" << std::endl;
+
+	const char *ballNames[SURROGATE_BALLS] = { "bianca", "gialla", "rossa" };
+	for (int b = 0; b < SURROGATE_BALLS; b++)
+		std::cout << "  biglia " << ballNames[b] << ": errore medio " << positionError[b] / testCount << " m (biglia ferma: " << baselineError[b] / testCount << " m)" << std::endl;
+
+	//MISURO LA VELOCITA' DELL'INFERENZA RISPETTO ALLA SIMULAZIONE ESATTA
+	size_t predictions = 0;
+	start = SurrogateClock::now();
+
+	while (elapsed_seconds(start) < 0.25) {
+		surrogate.Predict(inputs.data(), testCount, outputs.data());
+		predictions += testCount;
+	}
+
+	double surrogateMicroseconds = 1e6 * elapsed_seconds(start) / predictions;
+
+	std::cout << "  inferenza: " << surrogateMicroseconds << " us per tiro (" << predictions / elapsed_seconds(start) << " tiri/s), "
+#ifdef SURROGATE_SSE
+			  << "SSE, "
+#endif
+			  << exactMilliseconds * 1000.0 / surrogateMicroseconds << "x piu' veloce della simulazione esatta" << std::endl;
+
+	//VALUTO LA PRESELEZIONE: IL MIGLIOR TIRO REALE DEVE RESTARE TRA I CANDIDATI MANTENUTI
+	const size_t layouts = 16, candidates = 32, keep = 8;
+	std::vector<int> bestKept(layouts, 0);
+	workers.clear();
+
+	for (unsigned t = 0; t < threadCount; t++) {
+		workers.push_back(std::thread([&, t]() {
+			SimulationClone clone(builder);
+			std::mt19937 rng(5000 + t);
+			WorldSnapshot layout;
+			int player;
+			btVector3 impulse;
+			std::vector<btVector3> impulses(candidates);
+			std::vector<int> scores(candidates);
+			std::vector<size_t> selected;
+			float output[SURROGATE_OUTPUTS];
+
+			for (size_t l = t; l < layouts; l += threadCount) {
+				random_shot(base, rng, layout, player, impulse);
+
+				int best = 0;
+
+				for (size_t c = 0; c < candidates; c++) {
+					WorldSnapshot ignored;
+					int ignoredPlayer;
+
+					random_shot(base, rng, ignored, ignoredPlayer, impulses[c]);
+					Simulate(clone, layout, player, impulses[c], SHOT_REL_POS, output);
+
+					scores[c] = shot_score(output, pinPoints);
+					best = std::max(best, scores[c]);
+				}
+
+				surrogate.Prefilter(layout, player, impulses, pinPoints, keep, selected);
+
+				for (size_t k = 0; k < selected.size(); k++)
+					if (scores[selected[k]] == best)
+						bestKept[l] = 1;
+			}
+		}));
+	}
+
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+
+	int recall = 0;
+	for (size_t l = 0; l < layouts; l++)
+		recall += bestKept[l];
+
+	std::cout << "  preselezione di " << keep << " candidati su " << candidates << ": miglior tiro mantenuto in " << recall << "/" << layouts
+			  << " disposizioni, " << 100 - 100 * keep / candidates << "% di simulazioni esatte risparmiate" << std::endl;
+
+	if (surrogate.Save(path))
+		std::cout << "Pesi salvati in " << path << std::endl;
+}
+
+void ShotSurrogate::initLayers() {
+	int sizes[LAYERS + 1] = { pad4(SURROGATE_INPUTS), HIDDEN, HIDDEN, pad4(SURROGATE_OUTPUTS) };
+
+	for (int l = 0; l < LAYERS; l++) {
+		this->layers[l].inputs = sizes[l];
+		this->layers[l].outputs = sizes[l + 1];
+		this->layers[l].weights.assign(sizes[l] * sizes[l + 1], 0.0f);
+		this->layers[l].bias.assign(sizes[l + 1], 0.0f);
+	}
+
+	this->trained = false;
+}
+
+void ShotSurrogate::normalizeInput(const float *input, float *normalized) const {
+	int i = 0;
+
+	for (; i < SURROGATE_INPUTS; i++)
+		normalized[i] = (input[i] - this->inputMean[i]) * this->inputScale[i];
+
+	for (; i < this->layers[0].inputs; i++)
+		normalized[i] = 0.0f;
+}
+
+void ShotSurrogate::forward(const float *normalized, float *activations[LAYERS + 1]) const {
+	const float *input = normalized;
+
+	for (int l = 0; l < LAYERS; l++) {
+		const Layer &layer = this->layers[l];
+
+		dense(layer.weights.data(), layer.bias.data(), input, layer.inputs, layer.outputs, activations[l + 1], l < LAYERS - 1);
+		input = activations[l + 1];
+	}
+}
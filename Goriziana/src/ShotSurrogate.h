@@ -0,0 +1,160 @@
+/*
+Classe ShotSurrogate
+- Rete neurale (MLP) che approssima l'esito di un tiro: probabilita' di abbattimento di ogni birillo e posizione finale delle biglie
+- Serve a scartare in pochi microsecondi i tiri candidati poco promettenti, prima di simulare con la Bullet solo quelli rimasti
+- Addestramento ed inferenza avvengono interamente su CPU: i prodotti matrice-vettore usano istruzioni SSE quando disponibili
+- Il dataset viene generato simulando con la Bullet tiri casuali da disposizioni casuali delle biglie, con i birilli nella posizione
+  iniziale (il gioco li riposiziona ad ogni cambio di turno)
+
+Ingressi: posizione (x, z) delle tre biglie, biglia che tira, impulso (x, y, z)
+Uscite: birilli abbattuti (5 valori), posizione finale (x, z) delle tre biglie
+*/
+
+#ifndef SHOTSURROGATE_H
+#define SHOTSURROGATE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include <utils/snapshot.h>
+
+// Dimensioni degli ingressi e delle uscite della rete
+#define SURROGATE_BALLS 3
+#define SURROGATE_PINS 5
+#define SURROGATE_INPUTS (SURROGATE_BALLS * 2 + 1 + 3)
+#define SURROGATE_OUTPUTS (SURROGATE_PINS + SURROGATE_BALLS * 2)
+
+// Versione del formato del file dei pesi
+#define SURROGATE_VERSION 1
+// Numero minimo di tiri del dataset: un quinto viene tenuto da parte per la valutazione, che non puo' essere vuota
+#define SURROGATE_MIN_SAMPLES 10
+
+/*
+ * Struttura che rappresenta un campione del dataset: ingressi della rete ed esito reale del tiro
+ * (1 per i birilli abbattuti, posizioni finali delle biglie in metri)
+ */
+struct SurrogateSample {
+	float input[SURROGATE_INPUTS];
+	float output[SURROGATE_OUTPUTS];
+};
+
+/*
+ * Struttura che rappresenta l'esito previsto di un tiro
+ */
+struct ShotPrediction {
+	float pinProbability[SURROGATE_PINS];
+	float ballPosition[SURROGATE_BALLS][2];
+};
+
+/********** classe SHOTSURROGATE **********/
+class ShotSurrogate {
+public:
+	// Costruttore della classe, la rete non e' addestrata finche' non vengono chiamati Train o Load
+	ShotSurrogate();
+
+	/*
+	 * Metodo che calcola gli ingressi della rete per un tiro.
+	 * Prende in input i seguenti valori:
+	 * - state: WorldSnapshot, stato dei corpi dinamici prima del tiro (biglia bianca, gialla, rossa e birilli)
+	 * - player: int, indice della biglia che effettua il tiro
+	 * - impulse: btVector3, impulso applicato alla biglia
+	 * - input: float*, vettore di SURROGATE_INPUTS valori in cui vengono scritti gli ingressi
+	 */
+	static void MakeInput(const WorldSnapshot &state, int player, const btVector3 &impulse, float *input);
+
+	/*
+	 * Metodo che simula esattamente un tiro con la Bullet fino a quando i corpi si fermano, e ne scrive l'esito nel formato delle uscite della rete.
+	 * Prende in input i seguenti valori:
+	 * - clone: SimulationClone, mondo in cui simulare il tiro
+	 * - state, player, impulse, relPos: stato iniziale e parametri del tiro
+	 * - output: float*, vettore di SURROGATE_OUTPUTS valori in cui viene scritto l'esito
+	 */
+	static void Simulate(SimulationClone &clone, const WorldSnapshot &state, int player, const btVector3 &impulse, const btVector3 &relPos, float *output);
+
+	/*
+	 * Metodo che addestra la rete con discesa del gradiente (Adam) a minibatch.
+	 * Prende in input i seguenti valori:
+	 * - samples: vector<SurrogateSample>, dataset di addestramento
+	 * - epochs: int, numero di passate sull'intero dataset
+	 * - seed: unsigned, seme per l'inizializzazione dei pesi e l'ordine dei campioni
+	 */
+	void Train(const std::vector<SurrogateSample> &samples, int epochs, unsigned seed);
+
+	/*
+	 * Metodo che calcola l'esito previsto di un insieme di tiri.
+	 * Prende in input i seguenti valori:
+	 * - inputs: float*, count vettori di ingressi consecutivi
+	 * - count: size_t, numero di tiri
+	 * - outputs: float*, count vettori di uscite consecutivi: probabilita' di abbattimento dei birilli e posizioni in metri
+	 */
+	void Predict(const float *inputs, size_t count, float *outputs) const;
+
+	/*
+	 * Metodo che calcola l'esito previsto di un singolo tiro
+	 */
+	void Predict(const WorldSnapshot &state, int player, const btVector3 &impulse, ShotPrediction &prediction) const;
+
+	/*
+	 * Metodo che seleziona i tiri candidati piu' promettenti secondo il punteggio previsto, da simulare poi con la Bullet.
+	 * Prende in input i seguenti valori:
+	 * - state, player: stato della scena e biglia che tira
+	 * - impulses: vector<btVector3>, impulsi candidati
+	 * - pinPoints: int*, punteggio di ogni birillo
+	 * - keep: size_t, numero di candidati da mantenere
+	 * - selected: vector<size_t>, indici dei candidati selezionati, in ordine di punteggio previsto decrescente
+	 */
+	void Prefilter(const WorldSnapshot &state, int player, const std::vector<btVector3> &impulses, const int *pinPoints, size_t keep, std::vector<size_t> &selected) const;
+
+	/*
+	 * Metodi che salvano e caricano i pesi della rete
+	 */
+	bool Save(const std::string &path) const;
+	bool Load(const std::string &path);
+
+	/*
+	 * Metodo get per lo stato di addestramento della rete
+	 */
+	bool isTrained() const;
+
+	/*
+	 * Metodo che genera il dataset, addestra la rete, salva i pesi e stampa il report di accuratezza e velocita' rispetto alla simulazione esatta.
+	 * Prende in input i seguenti valori:
+	 * - builder: SceneBuilder, funzione che crea gli oggetti della scena
+	 * - pinPoints: int*, punteggio di ogni birillo, usato per valutare la preselezione dei tiri
+	 * - sampleCount: size_t, numero di tiri simulati per il dataset, almeno SURROGATE_MIN_SAMPLES
+	 * - path: string, file in cui salvare i pesi
+	 */
+	static void RunTraining(SceneBuilder builder, const int *pinPoints, size_t sampleCount, const std::string &path);
+
+private:
+	// Numero di neuroni dei due livelli nascosti
+	static const int HIDDEN = 64;
+	// Numero di livelli della rete
+	static const int LAYERS = 3;
+
+	/*
+	 * Struttura che rappresenta un livello completamente connesso.
+	 * Ingressi ed uscite sono arrotondati a multipli di 4 per le istruzioni SSE, ed i pesi sono memorizzati colonna per colonna:
+	 * il peso tra l'ingresso i e l'uscita o si trova in weights[i * outputs + o].
+	 */
+	struct Layer {
+		int inputs;
+		int outputs;
+		std::vector<float> weights;
+		std::vector<float> bias;
+	};
+
+	Layer layers[LAYERS];
+	float inputMean[SURROGATE_INPUTS];
+	float inputScale[SURROGATE_INPUTS];
+	bool trained;
+
+	void initLayers();
+	void normalizeInput(const float *input, float *normalized) const;
+	void forward(const float *normalized, float *activations[LAYERS + 1]) const;
+};
+
+#endif // SHOTSURROGATE_H
@@ -0,0 +1,151 @@
+#include "SolverBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+// Numero massimo di tick di PHYSICS_TICK di un tiro
+static const int SIMULATION_MAX_STEPS = PHYSICS_TICKS_PER_SECOND * 20;
+// Punto di applicazione dell'impulso, lo stesso usato dal gioco
+static const btVector3 SHOT_REL_POS(1.0f, 1.0f, 1.0f);
+
+typedef std::chrono::high_resolution_clock BenchmarkClock;
+
+void SolverBenchmark::simulate(SimulationClone &clone, const WorldSnapshot &state, int player, const btVector3 &impulse, ShotResult &result) {
+	clone.Reset(state);
+
+	const std::vector<btRigidBody*> &bodies = clone.getBodies();
+
+	bodies[player]->activate(true);
+	bodies[player]->applyImpulse(impulse, SHOT_REL_POS);
+
+	// Misuro solo gli step, la ricostruzione del mondo ha lo stesso costo nelle due modalita'
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+
+	for (int step = 0; step < SIMULATION_MAX_STEPS; step++) {
+		clone.Step();
+
+		if (clone.isIdle())
+			break;
+	}
+
+	result.stepSeconds = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+	result.solver = clone.getSimulation()->solver->getTotals();
+
+	// Stesso criterio del gioco: il birillo e' abbattuto se il suo asse y non e' piu' prevalentemente verticale
+	btScalar matrix[16];
+
+	for (int i = 0; i < PINS; i++) {
+		bodies[BALLS + i]->getWorldTransform().getOpenGLMatrix(matrix);
+		result.pinDown[i] = fabs(matrix[4]) > fabs(matrix[5]);
+	}
+
+	for (int i = 0; i < BALLS; i++)
+		result.ballPosition[i] = bodies[i]->getWorldTransform().getOrigin();
+}
+
+void SolverBenchmark::Run(SceneBuilder builder, size_t shotCount) {
+	SimulationClone fixedClone(builder), adaptiveClone(builder), repeatClone(builder);
+	fixedClone.setAdaptiveSolver(false);
+	adaptiveClone.setAdaptiveSolver(true);
+	repeatClone.setAdaptiveSolver(true);
+
+	// Stato iniziale della scena, da cui partono tutti i tiri
+	WorldSnapshot base;
+	fixedClone.Reset(WorldSnapshot());
+	base.Capture(fixedClone.getBodies());
+
+	btVector3 pinCenter(0.0f, 0.0f, 0.0f);
+	for (int i = 0; i < PINS; i++)
+		pinCenter += base.bodies[BALLS + i].transform.getOrigin();
+	pinCenter /= (btScalar) PINS;
+
+	std::mt19937 rng(2024);
+	std::uniform_real_distribution<float> spread(-0.6f, 0.6f);
+	std::uniform_real_distribution<float> strength(4.0f, 20.0f);
+	std::uniform_real_distribution<float> slope(0.1f, 0.6f);
+
+	double fixedSeconds = 0.0, adaptiveSeconds = 0.0;
+	SolverStepStats fixedTotals = SolverStepStats(), adaptiveTotals = SolverStepStats();
+	size_t sameOutcome = 0, sameRepeat = 0;
+	double positionError = 0.0, maxPositionError = 0.0;
+
+	std::cout << "Confronto del solver: " << shotCount << " tiri con iterazioni fisse e adattive" << std::endl;
+
+	for (size_t s = 0; s < shotCount; s++) {
+		int player = (int) (s % 2);
+
+		// Direzione verso il centro dei birilli, deviata di un angolo casuale
+		btVector3 toPins = pinCenter - base.bodies[player].transform.getOrigin();
+		float direction = atan2(toPins.z(), toPins.x()) + spread(rng), magnitude = strength(rng);
+		btVector3 impulse(cos(direction) * magnitude, -slope(rng) * magnitude, sin(direction) * magnitude);
+
+		ShotResult fixed, adaptive, repeat;
+		simulate(fixedClone, base, player, impulse, fixed);
+		simulate(adaptiveClone, base, player, impulse, adaptive);
+		simulate(repeatClone, base, player, impulse, repeat);
+
+		// Due mondi ricostruiti dallo stesso stato devono eseguire gli stessi substep ed arrivare allo stesso stato finale
+		bool repeated = true;
+		for (int i = 0; i < BALLS; i++)
+			repeated = repeated && adaptive.ballPosition[i] == repeat.ballPosition[i];
+		for (int i = 0; i < PINS; i++)
+			repeated = repeated && adaptive.pinDown[i] == repeat.pinDown[i];
+
+		if (repeated)
+			sameRepeat++;
+
+		fixedSeconds += fixed.stepSeconds;
+		adaptiveSeconds += adaptive.stepSeconds;
+
+		SolverStepStats *totals[2] = { &fixedTotals, &adaptiveTotals };
+		const SolverStepStats *shot[2] = { &fixed.solver, &adaptive.solver };
+
+		for (int m = 0; m < 2; m++) {
+			totals[m]->steps += shot[m]->steps;
+			totals[m]->islands += shot[m]->islands;
+			totals[m]->contacts += shot[m]->contacts;
+			totals[m]->iterations += shot[m]->iterations;
+			totals[m]->maxIslandIterations = std::max(totals[m]->maxIslandIterations, shot[m]->maxIslandIterations);
+		}
+
+		bool same = true;
+		for (int i = 0; i < PINS; i++)
+			same = same && fixed.pinDown[i] == adaptive.pinDown[i];
+
+		if (same)
+			sameOutcome++;
+
+		for (int i = 0; i < BALLS; i++) {
+			double error = fixed.ballPosition[i].distance(adaptive.ballPosition[i]);
+
+			positionError += error;
+			maxPositionError = std::max(maxPositionError, error);
+		}
+	}
+
+	//REPORT
+	const char *names[2] = { "Fisso:    ", "Adattivo: " };
+	const SolverStepStats *totals[2] = { &fixedTotals, &adaptiveTotals };
+	double seconds[2] = { fixedSeconds, adaptiveSeconds };
+
+	for (int m = 0; m < 2; m++) {
+		double steps = std::max<double>(1.0, totals[m]->steps);
+		double islands = std::max<double>(1.0, totals[m]->islands);
+
+		std::cout << names[m] << totals[m]->iterations / steps << " iterazioni per step, "
+				  << totals[m]->iterations / islands << " per isola (massimo " << totals[m]->maxIslandIterations << "), "
+				  << 1000.0 * seconds[m] / steps << " ms per step" << std::endl;
+	}
+
+	if (shotCount > 0) {
+		std::cout << "Birilli abbattuti uguali in " << sameOutcome << " tiri su " << shotCount << " ("
+				  << 100.0 * sameOutcome / shotCount << "%)" << std::endl;
+		std::cout << "Scarto della posizione finale delle biglie: medio " << positionError / (shotCount * BALLS)
+				  << " m, massimo " << maxPositionError << " m" << std::endl;
+		std::cout << "Risimulazioni adattive identiche: " << sameRepeat << " su " << shotCount << std::endl;
+		std::cout << "Tempo degli step ridotto del " << (fixedSeconds > 0.0 ? 100.0 * (1.0 - adaptiveSeconds / fixedSeconds) : 0.0) << "%" << std::endl;
+	}
+}
@@ -0,0 +1,52 @@
+/*
+Classe SolverBenchmark
+- Confronta il solver con iterazioni adattive con quello a numero fisso di iterazioni della Bullet
+- Simula gli stessi tiri in due mondi clonati, uno per modalita', misurando il tempo ed il numero di iterazioni per step
+- Confronta gli esiti: birilli abbattuti e posizione finale delle biglie
+- Risimula ogni tiro adattivo in un terzo mondo clonato, come fanno previsione e replay, e verifica che lo stato finale sia identico
+*/
+
+#ifndef SOLVERBENCHMARK_H
+#define SOLVERBENCHMARK_H
+
+#include <cstddef>
+
+#include <bullet/btBulletDynamicsCommon.h>
+
+#include <utils/snapshot.h>
+
+// Numero minimo di tiri del confronto
+#define SOLVER_BENCHMARK_MIN_SHOTS 1
+
+/********** classe SOLVERBENCHMARK **********/
+class SolverBenchmark {
+public:
+	/*
+	 * Metodo che esegue il confronto e ne stampa il report.
+	 * I tiri partono dalla disposizione iniziale, con la biglia bianca o gialla diretta verso i birilli con un angolo ed una forza casuali,
+	 * in modo da coprire sia gli step con pochi contatti sia gli urti tra i birilli.
+	 * Prende in input i seguenti valori:
+	 * - builder: SceneBuilder, funzione che crea gli oggetti della scena
+	 * - shotCount: size_t, numero di tiri simulati per ogni modalita'
+	 */
+	static void Run(SceneBuilder builder, size_t shotCount);
+
+private:
+	// Numero di biglie e di birilli, nell'ordine dei corpi restituiti dal SceneBuilder
+	static const int BALLS = 3;
+	static const int PINS = 5;
+
+	/*
+	 * Struttura che rappresenta l'esito di un tiro e il costo della sua simulazione
+	 */
+	struct ShotResult {
+		bool pinDown[PINS];
+		btVector3 ballPosition[BALLS];
+		double stepSeconds;
+		SolverStepStats solver;
+	};
+
+	static void simulate(SimulationClone &clone, const WorldSnapshot &state, int player, const btVector3 &impulse, ShotResult &result);
+};
+
+#endif // SOLVERBENCHMARK_H